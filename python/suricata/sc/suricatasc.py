@@ -80,7 +80,7 @@ class SuricataCompleter:
 
 class SuricataSC:
     def __init__(self, sck_path, verbose=False):
-        self.cmd_list=['shutdown','quit','pcap-file','pcap-file-continuous','pcap-file-number','pcap-file-list','pcap-last-processed','pcap-interrupt','iface-list','iface-stat','register-tenant','unregister-tenant','register-tenant-handler','unregister-tenant-handler', 'add-hostbit', 'remove-hostbit', 'list-hostbit', 'memcap-set', 'memcap-show']
+        self.cmd_list=['shutdown','quit','pcap-file','pcap-file-continuous','pcap-file-number','pcap-file-list','pcap-last-processed','pcap-interrupt','iface-list','iface-stat','register-tenant','unregister-tenant','register-tenant-handler','unregister-tenant-handler', 'add-hostbit', 'remove-hostbit', 'list-hostbit', 'dataset-add', 'dataset-remove', 'memcap-set', 'memcap-show', 'ruleset-sampling-top', 'ruleset-sampling-reset']
         self.sck_path = sck_path
         self.verbose = verbose
 
@@ -341,6 +341,30 @@ class SuricataSC:
                 else:
                     arguments = {}
                     arguments["ipaddress"] = ipaddress
+            elif "dataset-add" in command:
+                try:
+                    [cmd, setname, settype, datavalue] = command.split(' ', 3)
+                except:
+                    raise SuricataCommandException("Arguments to command '%s' is missing" % (command))
+                if cmd != "dataset-add":
+                    raise SuricataCommandException("Invalid command '%s'" % (command))
+                else:
+                    arguments = {}
+                    arguments["setname"] = setname
+                    arguments["settype"] = settype
+                    arguments["datavalue"] = datavalue
+            elif "dataset-remove" in command:
+                try:
+                    [cmd, setname, settype, datavalue] = command.split(' ', 3)
+                except:
+                    raise SuricataCommandException("Arguments to command '%s' is missing" % (command))
+                if cmd != "dataset-remove":
+                    raise SuricataCommandException("Invalid command '%s'" % (command))
+                else:
+                    arguments = {}
+                    arguments["setname"] = setname
+                    arguments["settype"] = settype
+                    arguments["datavalue"] = datavalue
             elif "memcap-set" in command:
                 try:
                     [cmd, config, memcap] = command.split(' ', 2)
@@ -362,6 +386,18 @@ class SuricataSC:
                 else:
                     arguments = {}
                     arguments["config"] = config
+            elif "ruleset-sampling-top" in command:
+                parts = command.split(' ')
+                cmd = parts[0]
+                if cmd != "ruleset-sampling-top":
+                    raise SuricataCommandException("Invalid command '%s'" % (command))
+                else:
+                    arguments = {}
+                    if len(parts) > 1:
+                        try:
+                            arguments["count"] = int(parts[1])
+                        except ValueError:
+                            raise SuricataCommandException("Invalid count '%s'" % (parts[1]))
             else:
                 cmd = command
         else:
@@ -17,6 +17,7 @@
 
 extern crate libc;
 use std;
+use std::collections::VecDeque;
 
 #[repr(C)]
 pub struct AppLayerGetTxIterTuple {
@@ -38,6 +39,73 @@ impl AppLayerGetTxIterTuple {
     }
 }
 
+/// Transactions that can be stored in a TxDeque. The id is the internal
+/// one, which is the C API tx_id + 1.
+pub trait TxId {
+    fn tx_id(&self) -> u64;
+}
+
+/// Transaction storage for parsers that keep many transactions per flow.
+///
+/// Transactions are appended in the order their ids are handed out and
+/// freeing one leaves a hole in the id space, so the deque stays sorted
+/// by id and a tx is never stored past `id - front_id`. Freeing the
+/// oldest tx, the common case, is O(1).
+pub type TxDeque<T> = VecDeque<T>;
+
+/// Get the index of the first tx with an id >= `id`, or the length of
+/// the deque if there is none.
+pub fn tx_index_ge<T: TxId>(txs: &TxDeque<T>, id: u64) -> usize {
+    let len = txs.len();
+    if len == 0 {
+        return 0;
+    }
+    let front = txs[0].tx_id();
+    if id <= front {
+        return 0;
+    }
+    // without holes the tx is at this offset, otherwise it's before it
+    let hint = std::cmp::min(id - front, len as u64) as usize;
+    if hint < len && txs[hint].tx_id() == id {
+        return hint;
+    }
+    let mut lo = 0;
+    let mut hi = std::cmp::min(hint + 1, len);
+    while lo < hi {
+        let mid = lo + (hi - lo) / 2;
+        if txs[mid].tx_id() < id {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/// Get the index of the tx with id `id`.
+pub fn tx_index<T: TxId>(txs: &TxDeque<T>, id: u64) -> Option<usize> {
+    let index = tx_index_ge(txs, id);
+    if index < txs.len() && txs[index].tx_id() == id {
+        return Some(index);
+    }
+    return None;
+}
+
+/// Remove the tx with id `id`, if it is still present.
+pub fn tx_remove<T: TxId>(txs: &mut TxDeque<T>, id: u64) -> bool {
+    match tx_index(txs, id) {
+        Some(0) => {
+            txs.pop_front();
+            true
+        },
+        Some(index) => {
+            txs.remove(index);
+            true
+        },
+        None => false,
+    }
+}
+
 /// LoggerFlags tracks which loggers have already been executed.
 #[derive(Debug)]
 pub struct LoggerFlags {
@@ -97,3 +165,45 @@ macro_rules!export_tx_set_detect_state {
         }
     )
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    struct Tx {
+        id: u64,
+    }
+
+    impl TxId for Tx {
+        fn tx_id(&self) -> u64 {
+            self.id
+        }
+    }
+
+    #[test]
+    fn test_tx_deque_lookup() {
+        let mut txs: TxDeque<Tx> = TxDeque::new();
+        for i in 1..11 {
+            txs.push_back(Tx{id: i});
+        }
+        assert_eq!(tx_index(&txs, 1), Some(0));
+        assert_eq!(tx_index(&txs, 10), Some(9));
+        assert_eq!(tx_index(&txs, 11), None);
+
+        // free the oldest and some in the middle
+        assert!(tx_remove(&mut txs, 1));
+        assert!(tx_remove(&mut txs, 4));
+        assert!(tx_remove(&mut txs, 5));
+        assert!(!tx_remove(&mut txs, 5));
+        assert_eq!(txs.len(), 7);
+
+        assert_eq!(tx_index(&txs, 1), None);
+        assert_eq!(tx_index(&txs, 2), Some(0));
+        assert_eq!(tx_index(&txs, 4), None);
+        assert_eq!(tx_index(&txs, 6), Some(2));
+        assert_eq!(tx_index(&txs, 10), Some(6));
+        assert_eq!(tx_index_ge(&txs, 4), 2);
+        assert_eq!(tx_index_ge(&txs, 0), 0);
+        assert_eq!(tx_index_ge(&txs, 100), 7);
+    }
+}
@@ -22,7 +22,8 @@ use std;
 use std::mem::transmute;
 
 use log::*;
-use applayer::LoggerFlags;
+use applayer;
+use applayer::{LoggerFlags, TxDeque, TxId};
 use core;
 use dns::parser;
 
@@ -237,6 +238,12 @@ impl DNSTransaction {
 
 }
 
+impl TxId for DNSTransaction {
+    fn tx_id(&self) -> u64 {
+        self.id
+    }
+}
+
 impl Drop for DNSTransaction {
     fn drop(&mut self) {
         self.free();
@@ -248,7 +255,7 @@ pub struct DNSState {
     pub tx_id: u64,
 
     // Transactions.
-    pub transactions: Vec<DNSTransaction>,
+    pub transactions: TxDeque<DNSTransaction>,
 
     pub events: u16,
 
@@ -263,7 +270,7 @@ impl DNSState {
     pub fn new() -> DNSState {
         return DNSState{
             tx_id: 0,
-            transactions: Vec::new(),
+            transactions: TxDeque::new(),
             events: 0,
             request_buffer: Vec::new(),
             response_buffer: Vec::new(),
@@ -276,7 +283,7 @@ impl DNSState {
     pub fn new_tcp() -> DNSState {
         return DNSState{
             tx_id: 0,
-            transactions: Vec::new(),
+            transactions: TxDeque::new(),
             events: 0,
             request_buffer: Vec::with_capacity(0xffff),
             response_buffer: Vec::with_capacity(0xffff),
@@ -293,47 +300,32 @@ impl DNSState {
 
     pub fn free_tx(&mut self, tx_id: u64) {
         SCLogDebug!("************** Freeing TX with ID {}", tx_id);
-        let len = self.transactions.len();
-        let mut found = false;
-        let mut index = 0;
-        for i in 0..len {
-            let tx = &self.transactions[i];
-            if tx.id == tx_id + 1 {
-                found = true;
-                index = i;
-                break;
-            }
-        }
-        if found {
-            self.transactions.remove(index);
-        }
+        applayer::tx_remove(&mut self.transactions, tx_id + 1);
     }
 
-    // Purges all transactions except one. This is a stateless parser
+    // Purges the oldest transactions. This is a stateless parser
     // so we don't need to hang onto old transactions.
     //
     // This is to actually handle an edge case where a DNS flood
     // occurs in a single direction with no response packets. In such
     // a case the functions to free a transaction are never called by
     // the app-layer as they require bidirectional traffic.
-    pub fn purge(&mut self, tx_id: u64) {
+    //
+    // This is done when adding a transaction, so that looking up
+    // transactions never frees any and tx pointers handed out to the
+    // app-layer stay valid until the next parser call.
+    fn purge(&mut self) {
         while self.transactions.len() > MAX_TRANSACTIONS {
-            if self.transactions[0].id == tx_id + 1 {
-                return;
-            }
             SCLogDebug!("Purging DNS TX with ID {}", self.transactions[0].id);
-            self.transactions.remove(0);
+            self.transactions.pop_front();
         }
     }
 
     pub fn get_tx(&mut self, tx_id: u64) -> Option<&DNSTransaction> {
         SCLogDebug!("get_tx: tx_id={}", tx_id);
-        self.purge(tx_id);
-        for tx in &mut self.transactions {
-            if tx.id == tx_id + 1 {
-                SCLogDebug!("Found DNS TX with ID {}", tx_id);
-                return Some(tx);
-            }
+        if let Some(index) = applayer::tx_index(&self.transactions, tx_id + 1) {
+            SCLogDebug!("Found DNS TX with ID {}", tx_id);
+            return Some(&self.transactions[index]);
         }
         SCLogDebug!("Failed to find DNS TX with ID {}", tx_id);
         return None;
@@ -369,7 +361,8 @@ impl DNSState {
 
                 let mut tx = self.new_tx();
                 tx.request = Some(request);
-                self.transactions.push(tx);
+                self.transactions.push_back(tx);
+                self.purge();
                 return true;
             }
             nom::IResult::Incomplete(_) => {
@@ -406,7 +399,8 @@ impl DNSState {
 
                 let mut tx = self.new_tx();
                 tx.response = Some(response);
-                self.transactions.push(tx);
+                self.transactions.push_back(tx);
+                self.purge();
                 return true;
             }
             nom::IResult::Incomplete(_) => {
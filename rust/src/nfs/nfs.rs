@@ -28,7 +28,7 @@ use nom::IResult;
 
 use log::*;
 use applayer;
-use applayer::LoggerFlags;
+use applayer::{LoggerFlags, TxDeque, TxId};
 use core::*;
 use filetracker::*;
 use filecontainer::*;
@@ -214,6 +214,12 @@ impl NFSTransaction {
     }
 }
 
+impl TxId for NFSTransaction {
+    fn tx_id(&self) -> u64 {
+        self.id
+    }
+}
+
 impl Drop for NFSTransaction {
     fn drop(&mut self) {
         self.free();
@@ -302,7 +308,7 @@ pub struct NFSState {
     pub namemap: HashMap<Vec<u8>, Vec<u8>>,
 
     /// transactions list
-    pub transactions: Vec<NFSTransaction>,
+    pub transactions: TxDeque<NFSTransaction>,
 
     /// TCP segments defragmentation buffer
     pub tcp_buffer_ts: Vec<u8>,
@@ -339,7 +345,7 @@ impl NFSState {
         NFSState {
             requestmap:HashMap::new(),
             namemap:HashMap::new(),
-            transactions: Vec::new(),
+            transactions: TxDeque::new(),
             tcp_buffer_ts:Vec::with_capacity(8192),
             tcp_buffer_tc:Vec::with_capacity(8192),
             files:NFSFiles::new(),
@@ -370,30 +376,16 @@ impl NFSState {
 
     pub fn free_tx(&mut self, tx_id: u64) {
         //SCLogNotice!("Freeing TX with ID {}", tx_id);
-        let len = self.transactions.len();
-        let mut found = false;
-        let mut index = 0;
-        for i in 0..len {
-            let tx = &self.transactions[i];
-            if tx.id == tx_id + 1 {
-                found = true;
-                index = i;
-                break;
-            }
-        }
-        if found {
-            SCLogDebug!("freeing TX with ID {} at index {}", tx_id, index);
-            self.transactions.remove(index);
+        if applayer::tx_remove(&mut self.transactions, tx_id + 1) {
+            SCLogDebug!("freed TX with ID {}", tx_id);
         }
     }
 
     pub fn get_tx_by_id(&mut self, tx_id: u64) -> Option<&NFSTransaction> {
         SCLogDebug!("get_tx_by_id: tx_id={}", tx_id);
-        for tx in &mut self.transactions {
-            if tx.id == tx_id + 1 {
-                SCLogDebug!("Found NFS TX with ID {}", tx_id);
-                return Some(tx);
-            }
+        if let Some(index) = applayer::tx_index(&self.transactions, tx_id + 1) {
+            SCLogDebug!("Found NFS TX with ID {}", tx_id);
+            return Some(&self.transactions[index]);
         }
         SCLogDebug!("Failed to find NFS TX with ID {}", tx_id);
         return None;
@@ -419,6 +411,9 @@ impl NFSState {
         let len = self.transactions.len();
 
         // find tx that is >= min_tx_id
+        if index == 0 {
+            index = applayer::tx_index_ge(&self.transactions, min_tx_id + 1);
+        }
         while index < len {
             let tx = &self.transactions[index];
             if tx.id < min_tx_id + 1 {
@@ -525,8 +520,8 @@ impl NFSState {
         }
         SCLogDebug!("new_file_tx: TX FILE created: ID {} NAME {}",
                 tx.id, String::from_utf8_lossy(file_name));
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         let (files, flags) = self.files.get(direction);
         return (tx_ref.unwrap(), files, flags)
     }
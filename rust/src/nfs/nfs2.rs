@@ -85,7 +85,7 @@ impl NFSState {
             }
             SCLogDebug!("NFSv2: TX created: ID {} XID {} PROCEDURE {}",
                     tx.id, tx.xid, tx.procedure);
-            self.transactions.push(tx);
+            self.transactions.push_back(tx);
         }
 
         SCLogDebug!("NFSv2: TS creating xidmap {}", r.hdr.xid);
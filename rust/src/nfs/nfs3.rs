@@ -207,7 +207,7 @@ impl NFSState {
             }
             SCLogDebug!("TX created: ID {} XID {} PROCEDURE {}",
                     tx.id, tx.xid, tx.procedure);
-            self.transactions.push(tx);
+            self.transactions.push_back(tx);
 
         } else if r.procedure == NFSPROC3_READ {
 
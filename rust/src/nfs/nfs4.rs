@@ -146,7 +146,7 @@ impl NFSState {
         }
         SCLogDebug!("NFSv4: TX created: ID {} XID {} PROCEDURE {}",
                 tx.id, tx.xid, tx.procedure);
-        self.transactions.push(tx);
+        self.transactions.push_back(tx);
     }
 
     /* A normal READ request looks like: PUTFH (file handle) READ (read opts).
@@ -36,7 +36,7 @@ use std::collections::HashMap;
 use core::*;
 use log::*;
 use applayer;
-use applayer::LoggerFlags;
+use applayer::{LoggerFlags, TxDeque, TxId};
 
 use smb::nbss_records::*;
 use smb::smb1_records::*;
@@ -404,8 +404,8 @@ impl SMBState {
         tx.response_done = self.tc_trunc; // no response expected if tc is truncated
 
         SCLogDebug!("SMB: TX SETFILEPATHINFO created: ID {}", tx.id);
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 
@@ -423,8 +423,8 @@ impl SMBState {
         tx.response_done = self.tc_trunc; // no response expected if tc is truncated
 
         SCLogDebug!("SMB: TX SETFILEPATHINFO created: ID {}", tx.id);
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 }
@@ -456,8 +456,8 @@ impl SMBState {
         tx.response_done = self.tc_trunc; // no response expected if tc is truncated
 
         SCLogDebug!("SMB: TX RENAME created: ID {}", tx.id);
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 }
@@ -607,6 +607,12 @@ impl SMBTransaction {
     }
 }
 
+impl TxId for SMBTransaction {
+    fn tx_id(&self) -> u64 {
+        self.id
+    }
+}
+
 impl Drop for SMBTransaction {
     fn drop(&mut self) {
         self.free();
@@ -778,7 +784,7 @@ pub struct SMBState<> {
     pub tc_trunc: bool, // no more data for TOCLIENT
 
     /// transactions list
-    pub transactions: Vec<SMBTransaction>,
+    pub transactions: TxDeque<SMBTransaction>,
 
     /// tx counter for assigning incrementing id's to tx's
     tx_id: u64,
@@ -818,7 +824,7 @@ impl SMBState {
             tc_gap: false,
             ts_trunc: false,
             tc_trunc: false,
-            transactions: Vec::new(),
+            transactions: TxDeque::new(),
             tx_id:0,
             dialect:0,
             dialect_vec: None,
@@ -842,22 +848,9 @@ impl SMBState {
 
     pub fn free_tx(&mut self, tx_id: u64) {
         SCLogDebug!("Freeing TX with ID {} TX.ID {}", tx_id, tx_id+1);
-        let len = self.transactions.len();
-        let mut found = false;
-        let mut index = 0;
-        for i in 0..len {
-            let tx = &self.transactions[i];
-            if tx.id == tx_id + 1 {
-                found = true;
-                index = i;
-                SCLogDebug!("tx {} progress {}/{}", tx.id, tx.request_done, tx.response_done);
-                break;
-            }
-        }
-        if found {
-            SCLogDebug!("freeing TX with ID {} TX.ID {} at index {} left: {} max id: {}",
-                    tx_id, tx_id+1, index, self.transactions.len(), self.tx_id);
-            self.transactions.remove(index);
+        if applayer::tx_remove(&mut self.transactions, tx_id + 1) {
+            SCLogDebug!("freed TX with ID {} TX.ID {} left: {} max id: {}",
+                    tx_id, tx_id+1, self.transactions.len(), self.tx_id);
         }
     }
 
@@ -869,6 +862,9 @@ impl SMBState {
         let len = self.transactions.len();
 
         // find tx that is >= min_tx_id
+        if index == 0 {
+            index = applayer::tx_index_ge(&self.transactions, min_tx_id + 1);
+        }
         while index < len {
             let tx = &self.transactions[index];
             if tx.id < min_tx_id + 1 {
@@ -891,21 +887,20 @@ impl SMBState {
             panic!("txs exploded");
         }
 */
-        for tx in &mut self.transactions {
-            if tx.id == tx_id + 1 {
-                let ver = tx.vercmd.get_version();
-                let mut _smbcmd;
-                if ver == 2 {
-                    let (_, cmd) = tx.vercmd.get_smb2_cmd();
-                    _smbcmd = cmd;
-                } else {
-                    let (_, cmd) = tx.vercmd.get_smb1_cmd();
-                    _smbcmd = cmd as u16;
-                }
-                SCLogDebug!("Found SMB TX: id {} ver:{} cmd:{} progress {}/{} type_data {:?}",
-                        tx.id, ver, _smbcmd, tx.request_done, tx.response_done, tx.type_data);
-                return Some(tx);
+        if let Some(index) = applayer::tx_index(&self.transactions, tx_id + 1) {
+            let tx = &self.transactions[index];
+            let ver = tx.vercmd.get_version();
+            let mut _smbcmd;
+            if ver == 2 {
+                let (_, cmd) = tx.vercmd.get_smb2_cmd();
+                _smbcmd = cmd;
+            } else {
+                let (_, cmd) = tx.vercmd.get_smb1_cmd();
+                _smbcmd = cmd as u16;
             }
+            SCLogDebug!("Found SMB TX: id {} ver:{} cmd:{} progress {}/{} type_data {:?}",
+                    tx.id, ver, _smbcmd, tx.request_done, tx.response_done, tx.type_data);
+            return Some(tx);
         }
         SCLogDebug!("Failed to find SMB TX with ID {}", tx_id);
         return None;
@@ -931,15 +926,15 @@ impl SMBState {
 
         SCLogDebug!("SMB: TX GENERIC created: ID {} tx list {} {:?}",
                 tx.id, self.transactions.len(), &tx);
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 
     pub fn get_last_tx(&mut self, smb_ver: u8, smb_cmd: u16)
         -> Option<&mut SMBTransaction>
     {
-        let tx_ref = self.transactions.last_mut();
+        let tx_ref = self.transactions.back_mut();
         match tx_ref {
             Some(tx) => {
                 let found = if tx.vercmd.get_version() == smb_ver {
@@ -1004,8 +999,8 @@ impl SMBState {
         tx.response_done = self.tc_trunc; // no response expected if tc is truncated
 
         SCLogDebug!("SMB: TX NEGOTIATE created: ID {} SMB ver {}", tx.id, smb_ver);
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 
@@ -1043,8 +1038,8 @@ impl SMBState {
 
         SCLogDebug!("SMB: TX TREECONNECT created: ID {} NAME {}",
                 tx.id, String::from_utf8_lossy(&name));
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 
@@ -1077,8 +1072,8 @@ impl SMBState {
         tx.request_done = true;
         tx.response_done = self.tc_trunc; // no response expected if tc is truncated
 
-        self.transactions.push(tx);
-        let tx_ref = self.transactions.last_mut();
+        self.transactions.push_back(tx);
+        let tx_ref = self.transactions.back_mut();
         return tx_ref.unwrap();
     }
 
@@ -1143,7 +1138,7 @@ impl SMBState {
             return;
         }
 
-        let (last_done, id) = match self.transactions.last() {
+        let (last_done, id) = match self.transactions.back() {
             Some(tx) => {
                 (tx.request_done && tx.response_done, tx.id)
             },
@@ -274,6 +274,9 @@ void AppLayerParserThreadCtxFree(AppLayerParserThreadCtx *tctx)
         }
     }
 
+    /* the tx list is per thread as well, free it with the rest */
+    AppLayerTxListFree();
+
     SCFree(tctx);
     SCReturn;
 }
@@ -657,6 +660,136 @@ AppLayerGetTxIteratorFunc AppLayerGetTxIterator(const uint8_t ipproto,
     return Func ? Func : AppLayerDefaultGetTxIterator;
 }
 
+/** \brief per thread list of the txs of the flow being processed
+ *
+ *  Detection, the tx loggers and the tx cleanup all walk the txs of
+ *  the flow for each packet. The first walk stores the txs here so
+ *  the others don't have to go through the parser's iterator again.
+ *  The list is only valid until the flow is parsed again or txs are
+ *  freed. */
+typedef struct AppLayerTxListItem_ {
+    void *tx_ptr;
+    uint64_t tx_id;
+} AppLayerTxListItem;
+
+typedef struct AppLayerTxList_ {
+    void *alstate;      /**< state the list was built for, NULL if not valid */
+    uint64_t min_id;    /**< tx id the list was built from */
+    uint64_t max_id;    /**< tx count when the list was built */
+    uint32_t cnt;
+    uint32_t size;
+    AppLayerTxListItem *items;
+} AppLayerTxList;
+
+static __thread AppLayerTxList tx_list = { NULL, 0, 0, 0, 0, NULL };
+
+static int AppLayerTxListBuild(AppLayerTxList *l,
+        const uint8_t ipproto, const AppProto alproto,
+        void *alstate, uint64_t min_tx_id, uint64_t max_tx_id)
+{
+    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxIterator(ipproto, alproto);
+    AppLayerGetTxIterState state;
+    memset(&state, 0, sizeof(state));
+
+    l->alstate = NULL;
+    l->cnt = 0;
+
+    while (1) {
+        AppLayerGetTxIterTuple ires = IterFunc(ipproto, alproto, alstate,
+                min_tx_id, max_tx_id, &state);
+        if (ires.tx_ptr == NULL)
+            break;
+
+        if (l->cnt == l->size) {
+            uint32_t new_size = l->size ? l->size * 2 : 8;
+            void *ptr = SCRealloc(l->items, new_size * sizeof(AppLayerTxListItem));
+            if (ptr == NULL)
+                return -1;
+            l->items = ptr;
+            l->size = new_size;
+        }
+        l->items[l->cnt].tx_ptr = ires.tx_ptr;
+        l->items[l->cnt].tx_id = ires.tx_id;
+        l->cnt++;
+
+        if (!ires.has_next)
+            break;
+    }
+
+    l->alstate = alstate;
+    l->min_id = min_tx_id;
+    l->max_id = max_tx_id;
+    return 0;
+}
+
+/** \internal
+ *  \brief tx iterator over the per thread tx list
+ *
+ *  Only handed out by AppLayerGetTxListIterator after the list was
+ *  built. 'state' holds the index of the next item.
+ */
+static AppLayerGetTxIterTuple AppLayerTxListIterator(
+        const uint8_t ipproto, const AppProto alproto,
+        void *alstate, uint64_t min_tx_id, uint64_t max_tx_id,
+        AppLayerGetTxIterState *state)
+{
+    const AppLayerTxList *l = &tx_list;
+    uint64_t idx = state->un.u64;
+
+#ifdef DEBUG_VALIDATION
+    BUG_ON(l->alstate != alstate);
+#endif
+    for ( ; idx < l->cnt; idx++) {
+        const AppLayerTxListItem *item = &l->items[idx];
+        if (item->tx_id < min_tx_id)
+            continue;
+
+        state->un.u64 = idx + 1;
+        AppLayerGetTxIterTuple tuple = {
+            .tx_ptr = item->tx_ptr,
+            .tx_id = item->tx_id,
+            .has_next = (idx + 1 < l->cnt),
+        };
+        return tuple;
+    }
+
+    AppLayerGetTxIterTuple no_tuple = { NULL, 0, false };
+    return no_tuple;
+}
+
+/** \brief get a tx iterator backed by the per thread tx list
+ *
+ *  Builds the list if it isn't valid for this state and range yet. If
+ *  that fails the parser's own iterator is returned.
+ */
+AppLayerGetTxIteratorFunc AppLayerGetTxListIterator(const uint8_t ipproto,
+        const AppProto alproto, void *alstate,
+        uint64_t min_tx_id, uint64_t max_tx_id)
+{
+    AppLayerTxList *l = &tx_list;
+    if (l->alstate != alstate || l->max_id != max_tx_id || min_tx_id < l->min_id) {
+        if (AppLayerTxListBuild(l, ipproto, alproto, alstate,
+                    min_tx_id, max_tx_id) < 0) {
+            return AppLayerGetTxIterator(ipproto, alproto);
+        }
+    }
+    return AppLayerTxListIterator;
+}
+
+/** \brief invalidate the per thread tx list */
+void AppLayerTxListReset(void)
+{
+    tx_list.alstate = NULL;
+}
+
+/** \brief free the per thread tx list. Call from the thread using it. */
+void AppLayerTxListFree(void)
+{
+    if (tx_list.items != NULL)
+        SCFree(tx_list.items);
+    memset(&tx_list, 0, sizeof(tx_list));
+}
+
 void AppLayerParserSetTxLogged(uint8_t ipproto, AppProto alproto,
                                void *alstate, void *tx, LoggerId logger)
 {
@@ -871,15 +1004,23 @@ void AppLayerParserTransactionsCleanup(Flow *f)
 
     const uint64_t min = alparser->min_id;
     const uint64_t total_txs = AppLayerParserGetTxCnt(f, alstate);
+    if (total_txs <= min)
+        return;
+    const bool tx_in_order = (p->option_flags & APP_LAYER_PARSER_OPT_TX_IN_ORDER) != 0;
     const LoggerId logger_expectation = AppLayerParserProtocolGetLoggerBits(ipproto, alproto);
     const int tx_end_state_ts = AppLayerParserGetStateProgressCompletionStatus(alproto, STREAM_TOSERVER);
     const int tx_end_state_tc = AppLayerParserGetStateProgressCompletionStatus(alproto, STREAM_TOCLIENT);
 
+    /* not using the tx list here: freeing a tx may move the remaining
+     * ones around in the parser's storage */
     AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxIterator(ipproto, alproto);
     AppLayerGetTxIterState state;
     memset(&state, 0, sizeof(state));
     uint64_t i = min;
     uint64_t new_min = min;
+    /* set once we leave a tx in place, min stops there */
+    bool skipped = false;
+    bool freed = false;
 
     while (1) {
         AppLayerGetTxIterTuple ires = IterFunc(ipproto, alproto, alstate, i, total_txs, &state);
@@ -894,11 +1035,23 @@ void AppLayerParserTransactionsCleanup(Flow *f)
         const int tx_progress_tc = AppLayerParserGetStateProgress(ipproto, alproto, tx, STREAM_TOCLIENT);
         if (tx_progress_tc < tx_end_state_tc) {
             SCLogDebug("%p/%"PRIu64" skipping: tc parser not done", tx, i);
+            if (tx_in_order) {
+                if (!skipped)
+                    new_min = i;
+                skipped = true;
+                break;
+            }
             goto next;
         }
         const int tx_progress_ts = AppLayerParserGetStateProgress(ipproto, alproto, tx, STREAM_TOSERVER);
         if (tx_progress_ts < tx_end_state_ts) {
             SCLogDebug("%p/%"PRIu64" skipping: ts parser not done", tx, i);
+            if (tx_in_order) {
+                if (!skipped)
+                    new_min = i;
+                skipped = true;
+                break;
+            }
             goto next;
         }
         if (f->sgh_toserver != NULL) {
@@ -929,16 +1082,36 @@ void AppLayerParserTransactionsCleanup(Flow *f)
         /* if we are here, the tx can be freed. */
         p->StateTransactionFree(alstate, i);
         SCLogDebug("%p/%"PRIu64" freed", tx, i);
-
-        /* if this tx was the minimum, up the minimum */
-        if (i == new_min)
-            new_min = i + 1;
-
+        freed = true;
+
+        /* freeing the tx may have moved the ones after it in the
+         * parser's storage, which invalidates the position kept by
+         * index based iterators like those of the rust parsers. Start
+         * a new walk just past the freed tx so none are missed. */
+        memset(&state, 0, sizeof(state));
+        i++;
+        goto done;
 next:
+        /* the first tx we leave in place is the new minimum. Ids
+         * freed before it, in this pass or an earlier one, are all
+         * gone. */
+        if (!skipped)
+            new_min = i;
+        skipped = true;
+done:
         if (!ires.has_next)
             break;
     }
 
+    /* nothing was left in place: all txs up to the count are gone,
+     * including freed ones at the end the loop never got to see. The
+     * walk restarts after each free, so it can't have missed a tx. */
+    if (!skipped)
+        new_min = total_txs;
+
+    if (freed)
+        AppLayerTxListReset();
+
     /* see if we need to bring all trackers up to date. */
     SCLogDebug("update f->alparser->min_id? %"PRIu64, alparser->min_id);
     if (new_min > alparser->min_id) {
@@ -1105,6 +1278,9 @@ int AppLayerParserParse(ThreadVars *tv, AppLayerParserThreadCtx *alp_tctx, Flow
     void *alstate = NULL;
     uint64_t p_tx_cnt = 0;
 
+    /* txs may be added, moved or freed by the parser */
+    AppLayerTxListReset();
+
     /* we don't have the parser registered for this protocol */
     if (p->StateAlloc == NULL)
         goto end;
@@ -1343,8 +1519,10 @@ void AppLayerParserStateCleanup(const Flow *f, void *alstate,
 
     AppLayerParserProtoCtx *ctx = &alp_ctx.ctxs[f->protomap][f->alproto];
 
-    if (ctx->StateFree != NULL && alstate != NULL)
+    if (ctx->StateFree != NULL && alstate != NULL) {
+        AppLayerTxListReset();
         ctx->StateFree(alstate);
+    }
 
     /* free the app layer parser api state */
     if (pstate != NULL)
@@ -2077,6 +2255,392 @@ static int AppLayerParserTest02(void)
     return result;
 }
 
+/* test protocol with a fixed set of txs that complete when the test says
+ * so. Freed txs leave a hole in the id space, like most parsers. */
+#define TEST_TX_MAX 8
+
+typedef struct TestTx_ {
+    uint64_t tx_id;
+    int progress_ts;
+    int progress_tc;
+} TestTx;
+
+typedef struct TestTxState_ {
+    TestTx *txs[TEST_TX_MAX];
+    uint64_t tx_cnt;
+} TestTxState;
+
+static void *TestTxStateAlloc(void)
+{
+    void *s = SCMalloc(sizeof(TestTxState));
+    if (unlikely(s == NULL))
+        return NULL;
+    memset(s, 0, sizeof(TestTxState));
+    return s;
+}
+
+static void TestTxStateFree(void *s)
+{
+    TestTxState *state = s;
+    uint64_t i;
+    for (i = 0; i < state->tx_cnt; i++) {
+        if (state->txs[i] != NULL)
+            SCFree(state->txs[i]);
+    }
+    SCFree(state);
+}
+
+static TestTx *TestTxNew(TestTxState *state)
+{
+    if (state->tx_cnt == TEST_TX_MAX)
+        return NULL;
+    TestTx *tx = SCCalloc(1, sizeof(*tx));
+    if (unlikely(tx == NULL))
+        return NULL;
+    tx->tx_id = state->tx_cnt++;
+    state->txs[tx->tx_id] = tx;
+    return tx;
+}
+
+static void TestTxComplete(TestTxState *state, uint64_t tx_id)
+{
+    state->txs[tx_id]->progress_ts = 1;
+    state->txs[tx_id]->progress_tc = 1;
+}
+
+static void *TestTxGetTx(void *alstate, uint64_t tx_id)
+{
+    TestTxState *state = alstate;
+    if (tx_id >= state->tx_cnt)
+        return NULL;
+    return state->txs[tx_id];
+}
+
+static uint64_t TestTxGetTxCnt(void *alstate)
+{
+    return ((TestTxState *)alstate)->tx_cnt;
+}
+
+static void TestTxFree(void *alstate, uint64_t tx_id)
+{
+    TestTxState *state = alstate;
+    SCFree(state->txs[tx_id]);
+    state->txs[tx_id] = NULL;
+}
+
+static int TestTxGetProgress(void *tx, uint8_t direction)
+{
+    TestTx *ttx = tx;
+    return (direction & STREAM_TOSERVER) ? ttx->progress_ts : ttx->progress_tc;
+}
+
+static int TestTxGetProgressCompletionStatus(uint8_t direction)
+{
+    return 1;
+}
+
+/** \internal
+ *  \brief iterator working like those of the rust parsers
+ *
+ *  'state' is the index into the list of txs that are left, so freeing
+ *  a tx moves the ones after it down by one, like a VecDeque removal.
+ */
+static AppLayerGetTxIterTuple TestTxIndexIterator(
+        const uint8_t ipproto, const AppProto alproto,
+        void *alstate, uint64_t min_tx_id, uint64_t max_tx_id,
+        AppLayerGetTxIterState *state)
+{
+    TestTxState *ts = alstate;
+    const uint64_t index = state->un.u64;
+    uint64_t live = 0;
+    uint64_t tx_id;
+
+    for (tx_id = 0; tx_id < ts->tx_cnt; tx_id++) {
+        if (ts->txs[tx_id] == NULL)
+            continue;
+        if (live++ < index || tx_id < min_tx_id)
+            continue;
+
+        uint64_t next_id = tx_id + 1;
+        while (next_id < ts->tx_cnt && ts->txs[next_id] == NULL)
+            next_id++;
+        state->un.u64 = live;
+        AppLayerGetTxIterTuple tuple = {
+            .tx_ptr = ts->txs[tx_id],
+            .tx_id = tx_id,
+            .has_next = (next_id < ts->tx_cnt),
+        };
+        return tuple;
+    }
+
+    AppLayerGetTxIterTuple no_tuple = { NULL, 0, false };
+    return no_tuple;
+}
+
+/** \internal
+ *  \brief register the tx test protocol and set up a flow using it */
+static Flow *TestTxSetup(void)
+{
+    AppLayerParserBackupParserTable();
+
+    AppLayerParserRegisterStateFuncs(IPPROTO_TCP, ALPROTO_TEST,
+            TestTxStateAlloc, TestTxStateFree);
+    AppLayerParserRegisterTxFreeFunc(IPPROTO_TCP, ALPROTO_TEST, TestTxFree);
+    AppLayerParserRegisterGetTx(IPPROTO_TCP, ALPROTO_TEST, TestTxGetTx);
+    AppLayerParserRegisterGetTxCnt(IPPROTO_TCP, ALPROTO_TEST, TestTxGetTxCnt);
+    AppLayerParserRegisterGetStateProgressFunc(IPPROTO_TCP, ALPROTO_TEST,
+            TestTxGetProgress);
+    AppLayerParserRegisterGetStateProgressCompletionStatus(ALPROTO_TEST,
+            TestTxGetProgressCompletionStatus);
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "4.3.2.1", 20, 40);
+    if (f == NULL)
+        return NULL;
+    f->proto = IPPROTO_TCP;
+    f->protomap = FlowGetProtoMapping(f->proto);
+    f->alproto = ALPROTO_TEST;
+    f->alstate = TestTxStateAlloc();
+    f->alparser = AppLayerParserStateAlloc();
+    if (f->alstate == NULL || f->alparser == NULL) {
+        if (f->alstate != NULL)
+            TestTxStateFree(f->alstate);
+        if (f->alparser != NULL)
+            AppLayerParserStateFree(f->alparser);
+        UTHFreeFlow(f);
+        return NULL;
+    }
+    return f;
+}
+
+static void TestTxTeardown(Flow *f)
+{
+    if (f != NULL) {
+        AppLayerTxListReset();
+        TestTxStateFree(f->alstate);
+        AppLayerParserStateFree(f->alparser);
+        f->alstate = NULL;
+        f->alparser = NULL;
+        UTHFreeFlow(f);
+    }
+    AppLayerParserRestoreParserTable();
+}
+
+/** \internal
+ *  \brief walk the txs the way detection and the tx loggers do
+ *  \retval cnt number of txs returned, their ids are stored in 'ids' */
+static uint32_t TestTxWalk(Flow *f, uint64_t *ids, uint32_t ids_size)
+{
+    const uint64_t total_txs = AppLayerParserGetTxCnt(f, f->alstate);
+    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxListIterator(f->proto,
+            f->alproto, f->alstate, 0, total_txs);
+    AppLayerGetTxIterState state;
+    memset(&state, 0, sizeof(state));
+    uint32_t cnt = 0;
+
+    while (cnt < ids_size) {
+        AppLayerGetTxIterTuple ires = IterFunc(f->proto, f->alproto,
+                f->alstate, 0, total_txs, &state);
+        if (ires.tx_ptr == NULL)
+            break;
+        if (ires.tx_ptr != TestTxGetTx(f->alstate, ires.tx_id))
+            return UINT32_MAX;
+        ids[cnt++] = ires.tx_id;
+        if (!ires.has_next)
+            break;
+    }
+    return cnt;
+}
+
+/**
+ * \test a tx freed after the detect walk built the tx list must not be
+ *       returned to the next walk, and the list goes away with the
+ *       thread ctx.
+ */
+static int AppLayerParserTest03(void)
+{
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+    Flow *f = TestTxSetup();
+    FAIL_IF_NULL(f);
+    TestTxState *state = f->alstate;
+
+    FAIL_IF_NULL(TestTxNew(state));
+    FAIL_IF_NULL(TestTxNew(state));
+    FAIL_IF_NULL(TestTxNew(state));
+
+    /* detect walk: builds the list */
+    uint64_t ids[TEST_TX_MAX];
+    FAIL_IF_NOT(TestTxWalk(f, ids, TEST_TX_MAX) == 3);
+    FAIL_IF_NOT(tx_list.alstate == f->alstate);
+    FAIL_IF_NOT(tx_list.cnt == 3);
+
+    /* tx 1 is done and gets freed */
+    TestTxComplete(state, 1);
+    FLOWLOCK_WRLOCK(f);
+    AppLayerParserTransactionsCleanup(f);
+    FLOWLOCK_UNLOCK(f);
+    FAIL_IF_NOT_NULL(state->txs[1]);
+    FAIL_IF_NOT(tx_list.alstate == NULL);
+
+    /* output walk: must only see the txs that are left */
+    FAIL_IF_NOT(TestTxWalk(f, ids, TEST_TX_MAX) == 2);
+    FAIL_IF_NOT(ids[0] == 0);
+    FAIL_IF_NOT(ids[1] == 2);
+
+    TestTxTeardown(f);
+
+    FAIL_IF_NULL(tx_list.items);
+    AppLayerParserThreadCtxFree(alp_tctx);
+    FAIL_IF_NOT_NULL(tx_list.items);
+    FAIL_IF_NOT(tx_list.size == 0);
+    PASS;
+}
+
+/**
+ * \test txs completing out of order: cleanup frees each tx as soon as
+ *       it is done, but min_id only moves past txs that are freed.
+ */
+static int AppLayerParserTest04(void)
+{
+    Flow *f = TestTxSetup();
+    FAIL_IF_NULL(f);
+    TestTxState *state = f->alstate;
+    AppLayerParserState *pstate = f->alparser;
+    int i;
+
+    for (i = 0; i < 5; i++)
+        FAIL_IF_NULL(TestTxNew(state));
+
+    FLOWLOCK_WRLOCK(f);
+
+    /* nothing done yet */
+    AppLayerParserTransactionsCleanup(f);
+    for (i = 0; i < 5; i++)
+        FAIL_IF_NULL(state->txs[i]);
+    FAIL_IF_NOT(pstate->min_id == 0);
+
+    /* 2 and 4 finish first: freed, but 0 holds min_id */
+    TestTxComplete(state, 2);
+    TestTxComplete(state, 4);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NULL(state->txs[0]);
+    FAIL_IF_NULL(state->txs[1]);
+    FAIL_IF_NOT_NULL(state->txs[2]);
+    FAIL_IF_NULL(state->txs[3]);
+    FAIL_IF_NOT_NULL(state->txs[4]);
+    FAIL_IF_NOT(pstate->min_id == 0);
+
+    /* 0 done: min_id moves up to 1, which is still open */
+    TestTxComplete(state, 0);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[0]);
+    FAIL_IF_NULL(state->txs[1]);
+    FAIL_IF_NULL(state->txs[3]);
+    FAIL_IF_NOT(pstate->min_id == 1);
+
+    /* 1 done: min_id skips the hole left by 2 and stops at 3 */
+    TestTxComplete(state, 1);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[1]);
+    FAIL_IF_NULL(state->txs[3]);
+    FAIL_IF_NOT(pstate->min_id == 3);
+    FAIL_IF_NOT(pstate->inspect_id[0] == 3);
+    FAIL_IF_NOT(pstate->inspect_id[1] == 3);
+    FAIL_IF_NOT(pstate->log_id == 3);
+
+    /* 3 done: everything is gone, including the hole at the end */
+    TestTxComplete(state, 3);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[3]);
+    FAIL_IF_NOT(pstate->min_id == 5);
+
+    FLOWLOCK_UNLOCK(f);
+
+    TestTxTeardown(f);
+    PASS;
+}
+
+/**
+ * \test with APP_LAYER_PARSER_OPT_TX_IN_ORDER cleanup stops at the first
+ *       open tx, done txs after it are left for a later pass.
+ */
+static int AppLayerParserTest05(void)
+{
+    Flow *f = TestTxSetup();
+    FAIL_IF_NULL(f);
+    AppLayerParserRegisterOptionFlags(IPPROTO_TCP, ALPROTO_TEST,
+            APP_LAYER_PARSER_OPT_TX_IN_ORDER);
+    TestTxState *state = f->alstate;
+    AppLayerParserState *pstate = f->alparser;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        FAIL_IF_NULL(TestTxNew(state));
+
+    FLOWLOCK_WRLOCK(f);
+
+    TestTxComplete(state, 0);
+    TestTxComplete(state, 2);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[0]);
+    FAIL_IF_NULL(state->txs[1]);
+    FAIL_IF_NULL(state->txs[2]);
+    FAIL_IF_NOT(pstate->min_id == 1);
+
+    TestTxComplete(state, 1);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[1]);
+    FAIL_IF_NOT_NULL(state->txs[2]);
+    FAIL_IF_NOT(pstate->min_id == 3);
+
+    FLOWLOCK_UNLOCK(f);
+
+    TestTxTeardown(f);
+    PASS;
+}
+
+/**
+ * \test cleanup with an index based iterator: freeing a tx moves the
+ *       next one to the freed index, it must still be seen.
+ */
+static int AppLayerParserTest06(void)
+{
+    Flow *f = TestTxSetup();
+    FAIL_IF_NULL(f);
+    AppLayerParserRegisterGetTxIterator(IPPROTO_TCP, ALPROTO_TEST,
+            TestTxIndexIterator);
+    TestTxState *state = f->alstate;
+    AppLayerParserState *pstate = f->alparser;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        FAIL_IF_NULL(TestTxNew(state));
+
+    FLOWLOCK_WRLOCK(f);
+
+    /* 0 and 1 done: 1 moves to the index of 0 when that is freed */
+    TestTxComplete(state, 0);
+    TestTxComplete(state, 1);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[0]);
+    FAIL_IF_NOT_NULL(state->txs[1]);
+    FAIL_IF_NULL(state->txs[2]);
+    FAIL_IF_NULL(state->txs[3]);
+    FAIL_IF_NOT(pstate->min_id == 2);
+
+    /* same for the last two, with nothing left after them */
+    TestTxComplete(state, 2);
+    TestTxComplete(state, 3);
+    AppLayerParserTransactionsCleanup(f);
+    FAIL_IF_NOT_NULL(state->txs[2]);
+    FAIL_IF_NOT_NULL(state->txs[3]);
+    FAIL_IF_NOT(pstate->min_id == 4);
+
+    FLOWLOCK_UNLOCK(f);
+
+    TestTxTeardown(f);
+    PASS;
+}
 
 void AppLayerParserRegisterUnittests(void)
 {
@@ -2097,6 +2661,10 @@ void AppLayerParserRegisterUnittests(void)
 
     UtRegisterTest("AppLayerParserTest01", AppLayerParserTest01);
     UtRegisterTest("AppLayerParserTest02", AppLayerParserTest02);
+    UtRegisterTest("AppLayerParserTest03", AppLayerParserTest03);
+    UtRegisterTest("AppLayerParserTest04", AppLayerParserTest04);
+    UtRegisterTest("AppLayerParserTest05", AppLayerParserTest05);
+    UtRegisterTest("AppLayerParserTest06", AppLayerParserTest06);
 
     SCReturn;
 }
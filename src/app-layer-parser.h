@@ -39,6 +39,9 @@
 
 /* Flags for AppLayerParserProtoCtx. */
 #define APP_LAYER_PARSER_OPT_ACCEPT_GAPS        BIT_U32(0)
+/** transactions complete in the order they are created, so cleanup can
+ *  stop at the first tx the parser is not done with */
+#define APP_LAYER_PARSER_OPT_TX_IN_ORDER        BIT_U32(1)
 
 #define APP_LAYER_PARSER_INT_STREAM_DEPTH_SET   BIT_U32(0)
 
@@ -178,6 +181,11 @@ void AppLayerParserRegisterDetectFlagsFuncs(uint8_t ipproto, AppProto alproto,
 
 AppLayerGetTxIteratorFunc AppLayerGetTxIterator(const uint8_t ipproto,
          const AppProto alproto);
+AppLayerGetTxIteratorFunc AppLayerGetTxListIterator(const uint8_t ipproto,
+        const AppProto alproto, void *alstate,
+        uint64_t min_tx_id, uint64_t max_tx_id);
+void AppLayerTxListReset(void);
+void AppLayerTxListFree(void);
 
 void *AppLayerParserGetProtocolParserLocalStorage(uint8_t ipproto, AppProto alproto);
 void AppLayerParserDestroyProtocolParserLocalStorage(uint8_t ipproto, AppProto alproto,
@@ -52,6 +52,7 @@
 #include "util-pool.h"
 #include "util-byte.h"
 #include "util-ja3.h"
+#include "util-hashlist.h"
 #include "flow-util.h"
 #include "flow-private.h"
 
@@ -95,10 +96,52 @@ enum SslConfigEncryptHandling {
 typedef struct SslConfig_ {
     enum SslConfigEncryptHandling encrypt_mode;
     int enable_ja3;
+    uint32_t cert_cache_size;   /**< entries per thread, 0 disables */
+
+    /** bypass allowlists. If neither is set all flows are bypassed
+     *  in bypass mode. SNI wildcards '*.example.com' are stored as
+     *  '.example.com'. */
+    HashListTable *bypass_sni;
+    HashListTable *bypass_ja3;
 } SslConfig;
 
 SslConfig ssl_config;
 
+/* bypass policy decision, made once per flow */
+enum {
+    SSL_BYPASS_POLICY_UNKNOWN = 0,
+    SSL_BYPASS_POLICY_ALLOW,
+    SSL_BYPASS_POLICY_DENY,
+};
+
+SC_ATOMIC_DECLARE(uint64_t, ssl_bypass_all);
+SC_ATOMIC_DECLARE(uint64_t, ssl_bypass_sni);
+SC_ATOMIC_DECLARE(uint64_t, ssl_bypass_ja3);
+SC_ATOMIC_DECLARE(uint64_t, ssl_bypass_not_listed);
+
+/* default number of certificates in the per thread cache */
+#define SSL_CONFIG_DEFAULT_CERT_CACHE_SIZE 256
+
+/** fields decoded from a server certificate, keyed by the SHA1 of the
+ *  certificate. Lets us skip the DER decoding for certificates we've
+ *  seen before, like those of big CDNs. */
+typedef struct SSLCertCacheEntry_ {
+    uint8_t sha1[SHA1_LENGTH];
+    bool in_use;
+    char *subject;
+    char *issuerdn;
+    char *serial;
+    time_t not_before;
+    time_t not_after;
+} SSLCertCacheEntry;
+
+/** per thread parser storage. The cert cache is 2-way set associative,
+ *  with the most recently used entry of a set in its first slot. */
+typedef struct SSLThreadCtx_ {
+    SSLCertCacheEntry *cert_cache;
+    uint32_t cert_cache_sets;
+} SSLThreadCtx;
+
 /* SSLv3 record types */
 #define SSLV3_CHANGE_CIPHER_SPEC       20
 #define SSLV3_ALERT_PROTOCOL           21
@@ -366,6 +409,115 @@ static void TlsDecodeHSCertificateErrSetEvent(SSLState *ssl_state, uint32_t err)
     }
 }
 
+static void SSLCertCacheEntryClear(SSLCertCacheEntry *e)
+{
+    if (e->subject != NULL)
+        SCFree(e->subject);
+    if (e->issuerdn != NULL)
+        SCFree(e->issuerdn);
+    if (e->serial != NULL)
+        SCFree(e->serial);
+    memset(e, 0, sizeof(*e));
+}
+
+static SSLCertCacheEntry *SSLCertCacheLookup(SSLThreadCtx *td, const uint8_t *sha1)
+{
+    if (td == NULL || td->cert_cache == NULL)
+        return NULL;
+
+    uint32_t hash;
+    memcpy(&hash, sha1, sizeof(hash));
+    SSLCertCacheEntry *set = &td->cert_cache[(hash % td->cert_cache_sets) * 2];
+
+    if (set[0].in_use && memcmp(set[0].sha1, sha1, SHA1_LENGTH) == 0)
+        return &set[0];
+    if (set[1].in_use && memcmp(set[1].sha1, sha1, SHA1_LENGTH) == 0) {
+        /* move to the front of the set */
+        SSLCertCacheEntry tmp = set[0];
+        set[0] = set[1];
+        set[1] = tmp;
+        return &set[0];
+    }
+    return NULL;
+}
+
+static void SSLCertCacheAdd(SSLThreadCtx *td, const uint8_t *sha1,
+                            const SSLStateConnp *connp)
+{
+    if (td == NULL || td->cert_cache == NULL)
+        return;
+
+    uint32_t hash;
+    memcpy(&hash, sha1, sizeof(hash));
+    SSLCertCacheEntry *set = &td->cert_cache[(hash % td->cert_cache_sets) * 2];
+
+    SSLCertCacheEntry e;
+    memset(&e, 0, sizeof(e));
+    e.subject = SCStrdup(connp->cert0_subject);
+    e.issuerdn = SCStrdup(connp->cert0_issuerdn);
+    e.serial = SCStrdup(connp->cert0_serial);
+    if (e.subject == NULL || e.issuerdn == NULL || e.serial == NULL) {
+        SSLCertCacheEntryClear(&e);
+        return;
+    }
+    memcpy(e.sha1, sha1, SHA1_LENGTH);
+    e.not_before = connp->cert0_not_before;
+    e.not_after = connp->cert0_not_after;
+    e.in_use = true;
+
+    /* evict the least recently used entry of the set */
+    SSLCertCacheEntryClear(&set[1]);
+    set[1] = set[0];
+    set[0] = e;
+}
+
+/** \internal
+ *  \brief get the cert cache size from the config
+ *
+ *  The cache is made of sets of 2 entries, so a size of 1 would leave
+ *  no sets at all. It's rounded up to 2 instead.
+ *
+ *  \retval size number of entries, 0 if the cache is disabled
+ */
+static uint32_t SSLCertCacheSizeFromConf(void)
+{
+    intmax_t cache_size = 0;
+    if (ConfGetInt("app-layer.protocols.tls.certificate-cache-size",
+                   &cache_size) != 1) {
+        return SSL_CONFIG_DEFAULT_CERT_CACHE_SIZE;
+    }
+    if (cache_size < 0 || cache_size > UINT16_MAX) {
+        SCLogWarning(SC_ERR_INVALID_VALUE, "invalid value for "
+                "app-layer.protocols.tls.certificate-cache-size, "
+                "using default %u", SSL_CONFIG_DEFAULT_CERT_CACHE_SIZE);
+        return SSL_CONFIG_DEFAULT_CERT_CACHE_SIZE;
+    }
+    if (cache_size == 1) {
+        SCLogWarning(SC_ERR_INVALID_VALUE, "app-layer.protocols.tls."
+                "certificate-cache-size of 1 is too small, the minimum "
+                "is 2. Using 2, set it to 0 to disable the cache.");
+        return 2;
+    }
+    return (uint32_t)cache_size;
+}
+
+static int TlsDecodeHSCertificateFromCache(SSLState *ssl_state,
+                                           const SSLCertCacheEntry *e)
+{
+    ssl_state->server_connp.cert0_subject = SCStrdup(e->subject);
+    if (ssl_state->server_connp.cert0_subject == NULL)
+        return -1;
+    ssl_state->server_connp.cert0_issuerdn = SCStrdup(e->issuerdn);
+    if (ssl_state->server_connp.cert0_issuerdn == NULL)
+        return -1;
+    ssl_state->server_connp.cert0_serial = SCStrdup(e->serial);
+    if (ssl_state->server_connp.cert0_serial == NULL)
+        return -1;
+    ssl_state->server_connp.cert0_not_before = e->not_before;
+    ssl_state->server_connp.cert0_not_after = e->not_after;
+    return 0;
+}
+
 static inline int TlsDecodeHSCertificateSubject(SSLState *ssl_state,
                                                 Asn1Generic *cert)
 {
@@ -378,7 +530,7 @@ static inline int TlsDecodeHSCertificateSubject(SSLState *ssl_state,
     int rc = Asn1DerGetSubjectDN(cert, buffer, sizeof(buffer), &err);
     if (rc != 0) {
         TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
-        return 0;
+        return 1;
     }
 
     ssl_state->server_connp.cert0_subject = SCStrdup(buffer);
@@ -400,7 +552,7 @@ static inline int TlsDecodeHSCertificateIssuer(SSLState *ssl_state,
     int rc = Asn1DerGetIssuerDN(cert, buffer, sizeof(buffer), &err);
     if (rc != 0) {
         TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
-        return 0;
+        return 1;
     }
 
     ssl_state->server_connp.cert0_issuerdn = SCStrdup(buffer);
@@ -422,7 +574,7 @@ static inline int TlsDecodeHSCertificateSerial(SSLState *ssl_state,
     int rc = Asn1DerGetSerial(cert, buffer, sizeof(buffer), &err);
     if (rc != 0) {
         TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
-        return 0;
+        return 1;
     }
 
     ssl_state->server_connp.cert0_serial = SCStrdup(buffer);
@@ -442,7 +594,7 @@ static inline int TlsDecodeHSCertificateValidity(SSLState *ssl_state,
     int rc = Asn1DerGetValidity(cert, &not_before, &not_after, &err);
     if (rc != 0) {
         TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
-        return 0;
+        return 1;
     }
 
     ssl_state->server_connp.cert0_not_before = not_before;
@@ -452,8 +604,7 @@ static inline int TlsDecodeHSCertificateValidity(SSLState *ssl_state,
 }
 
 static inline int TlsDecodeHSCertificateFingerprint(SSLState *ssl_state,
-                                                    const uint8_t *input,
-                                                    uint32_t cert_len)
+                                                    const uint8_t *hash)
 {
     if (unlikely(ssl_state->server_connp.cert0_fingerprint != NULL))
         return 0;
@@ -463,7 +614,6 @@ static inline int TlsDecodeHSCertificateFingerprint(SSLState *ssl_state,
     if (ssl_state->server_connp.cert0_fingerprint == NULL)
         return -1;
 
-    uint8_t *hash = ComputeSHA1((uint8_t *)input, cert_len);
     if (hash == NULL)
         return 0;
 
@@ -475,8 +625,6 @@ static inline int TlsDecodeHSCertificateFingerprint(SSLState *ssl_state,
                       *(hash + x));
     }
 
-    SCFree(hash);
-
     return 0;
 }
 
@@ -495,13 +643,61 @@ static inline int TlsDecodeHSCertificateAddCertToChain(SSLState *ssl_state,
     return 0;
 }
 
-static int TlsDecodeHSCertificate(SSLState *ssl_state,
+/**
+ * \internal
+ * \brief Decode the fields we keep from the first certificate
+ *
+ * \retval 0 on success, 1 if some fields could not be decoded, 2 if
+ *         the certificate could not be decoded at all, -1 on memory
+ *         error
+ */
+static int TlsDecodeHSCertificateFields(SSLState *ssl_state,
+                                        const uint8_t *input, uint32_t cert_len)
+{
+    uint32_t err = 0;
+    int decode_err = 0;
+
+    /* coverity[tainted_data] */
+    Asn1Generic *cert = DecodeDer(input, cert_len, &err);
+    if (cert == NULL) {
+        TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
+        return 2;
+    }
+
+    int rc = TlsDecodeHSCertificateSubject(ssl_state, cert);
+    if (rc < 0)
+        goto error;
+    decode_err |= rc;
+
+    rc = TlsDecodeHSCertificateIssuer(ssl_state, cert);
+    if (rc < 0)
+        goto error;
+    decode_err |= rc;
+
+    rc = TlsDecodeHSCertificateSerial(ssl_state, cert);
+    if (rc < 0)
+        goto error;
+    decode_err |= rc;
+
+    rc = TlsDecodeHSCertificateValidity(ssl_state, cert);
+    if (rc < 0)
+        goto error;
+    decode_err |= rc;
+
+    DerFree(cert);
+    return decode_err;
+
+error:
+    DerFree(cert);
+    return -1;
+}
+
+static int TlsDecodeHSCertificate(SSLState *ssl_state, SSLThreadCtx *td,
                                   const uint8_t * const initial_input,
                                   const uint32_t input_len)
 {
     const uint8_t *input = (uint8_t *)initial_input;
-
-    Asn1Generic *cert = NULL;
+    uint8_t *hash = NULL;
 
     if (!(HAS_SPACE(3)))
         return 1;
@@ -525,40 +721,43 @@ static int TlsDecodeHSCertificate(SSLState *ssl_state,
         if (!(HAS_SPACE(cert_len)))
             goto invalid_cert;
 
-        uint32_t err = 0;
         int rc = 0;
 
         /* only store fields from the first certificate in the chain */
         if (processed_len == 0) {
-            /* coverity[tainted_data] */
-            cert = DecodeDer(input, cert_len, &err);
-            if (cert == NULL) {
-                TlsDecodeHSCertificateErrSetEvent(ssl_state, err);
-                goto next;
+            SSLStateConnp *connp = &ssl_state->server_connp;
+            /* the cache is only used if none of the fields were set by
+             * an earlier certificate message */
+            const bool use_cache = (connp->cert0_subject == NULL &&
+                    connp->cert0_issuerdn == NULL && connp->cert0_serial == NULL);
+
+            hash = ComputeSHA1((uint8_t *)input, cert_len);
+
+            const SSLCertCacheEntry *ce = NULL;
+            if (use_cache && hash != NULL)
+                ce = SSLCertCacheLookup(td, hash);
+            if (ce != NULL) {
+                rc = TlsDecodeHSCertificateFromCache(ssl_state, ce);
+                if (rc != 0)
+                    goto error;
+            } else {
+                rc = TlsDecodeHSCertificateFields(ssl_state, input, cert_len);
+                if (rc < 0)
+                    goto error;
+                if (rc == 2)
+                    goto next;
+                if (rc == 0 && use_cache && hash != NULL)
+                    SSLCertCacheAdd(td, hash, connp);
             }
 
-            rc = TlsDecodeHSCertificateSubject(ssl_state, cert);
-            if (rc != 0)
-                goto error;
-
-            rc = TlsDecodeHSCertificateIssuer(ssl_state, cert);
+            rc = TlsDecodeHSCertificateFingerprint(ssl_state, hash);
             if (rc != 0)
                 goto error;
 
-            rc = TlsDecodeHSCertificateSerial(ssl_state, cert);
-            if (rc != 0)
-                goto error;
-
-            rc = TlsDecodeHSCertificateValidity(ssl_state, cert);
-            if (rc != 0)
-                goto error;
-
-            rc = TlsDecodeHSCertificateFingerprint(ssl_state, input, cert_len);
-            if (rc != 0)
-                goto error;
-
-            DerFree(cert);
-            cert = NULL;
+            if (hash != NULL) {
+                SCFree(hash);
+                hash = NULL;
+            }
         }
 
         rc = TlsDecodeHSCertificateAddCertToChain(ssl_state, input, cert_len);
@@ -566,6 +765,10 @@ static int TlsDecodeHSCertificate(SSLState *ssl_state,
             goto error;
 
 next:
+        if (hash != NULL) {
+            SCFree(hash);
+            hash = NULL;
+        }
         input += cert_len;
         processed_len += cert_len + 3;
     }
@@ -573,8 +776,8 @@ next:
     return (input - initial_input);
 
 error:
-    if (cert != NULL)
-        DerFree(cert);
+    if (hash != NULL)
+        SCFree(hash);
     return -1;
 
 invalid_cert:
@@ -1318,7 +1521,8 @@ end:
 }
 
 static int SSLv3ParseHandshakeType(SSLState *ssl_state, uint8_t *input,
-                                   uint32_t input_len, uint8_t direction)
+                                   uint32_t input_len, uint8_t direction,
+                                   SSLThreadCtx *td)
 {
     void *ptmp;
     uint8_t *initial_input = input;
@@ -1425,7 +1629,7 @@ static int SSLv3ParseHandshakeType(SSLState *ssl_state, uint8_t *input,
                     ssl_state->curr_connp->trec_pos, initial_input, write_len);
             ssl_state->curr_connp->trec_pos += write_len;
 
-            rc = TlsDecodeHSCertificate(ssl_state, ssl_state->curr_connp->trec,
+            rc = TlsDecodeHSCertificate(ssl_state, td, ssl_state->curr_connp->trec,
                                         ssl_state->curr_connp->trec_pos);
 
             if (rc > 0) {
@@ -1516,7 +1720,8 @@ static int SSLv3ParseHandshakeType(SSLState *ssl_state, uint8_t *input,
 }
 
 static int SSLv3ParseHandshakeProtocol(SSLState *ssl_state, uint8_t *input,
-                                       uint32_t input_len, uint8_t direction)
+                                       uint32_t input_len, uint8_t direction,
+                                       SSLThreadCtx *td)
 {
     uint8_t *initial_input = input;
     int retval;
@@ -1569,7 +1774,7 @@ static int SSLv3ParseHandshakeProtocol(SSLState *ssl_state, uint8_t *input,
             /* fall through */
     }
 
-    retval = SSLv3ParseHandshakeType(ssl_state, input, input_len, direction);
+    retval = SSLv3ParseHandshakeType(ssl_state, input, input_len, direction, td);
     if (retval < 0) {
         return retval;
     }
@@ -1872,6 +2077,85 @@ static int SSLv2ParseRecord(uint8_t direction, SSLState *ssl_state,
     return (input - initial_input);
 }
 
+/**
+ * \brief check if the SNI is on the bypass list
+ *
+ * Looks up the full name first, then each parent domain against
+ * the wildcard entries.
+ */
+static bool SSLBypassSniListed(const char *sni)
+{
+    char name[256];
+    size_t len = strlen(sni);
+    if (len == 0 || len >= sizeof(name))
+        return false;
+
+    for (size_t i = 0; i < len; i++)
+        name[i] = tolower((unsigned char)sni[i]);
+    name[len] = '\0';
+
+    if (HashListTableLookup(ssl_config.bypass_sni, name, (uint16_t)len) != NULL)
+        return true;
+
+    for (size_t i = 1; i < len; i++) {
+        if (name[i] == '.' &&
+                HashListTableLookup(ssl_config.bypass_sni, name + i,
+                    (uint16_t)(len - i)) != NULL)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * \brief decide whether a flow can be bypassed once it's encrypted
+ *
+ * The decision is made once per flow and accounted to the policy
+ * that allowed it.
+ */
+static bool SSLBypassAllowed(SSLState *ssl_state)
+{
+    if (ssl_state->bypass_policy != SSL_BYPASS_POLICY_UNKNOWN)
+        return (ssl_state->bypass_policy == SSL_BYPASS_POLICY_ALLOW);
+
+    ssl_state->bypass_policy = SSL_BYPASS_POLICY_ALLOW;
+    if (ssl_config.bypass_sni == NULL && ssl_config.bypass_ja3 == NULL) {
+        (void) SC_ATOMIC_ADD(ssl_bypass_all, 1);
+    } else if (ssl_config.bypass_sni != NULL &&
+            ssl_state->client_connp.sni != NULL &&
+            SSLBypassSniListed(ssl_state->client_connp.sni)) {
+        (void) SC_ATOMIC_ADD(ssl_bypass_sni, 1);
+    } else if (ssl_config.bypass_ja3 != NULL && ssl_state->ja3_hash != NULL &&
+            HashListTableLookup(ssl_config.bypass_ja3, ssl_state->ja3_hash,
+                (uint16_t)strlen(ssl_state->ja3_hash)) != NULL) {
+        (void) SC_ATOMIC_ADD(ssl_bypass_ja3, 1);
+    } else {
+        ssl_state->bypass_policy = SSL_BYPASS_POLICY_DENY;
+        (void) SC_ATOMIC_ADD(ssl_bypass_not_listed, 1);
+    }
+    SCLogDebug("bypass policy %u", ssl_state->bypass_policy);
+    return (ssl_state->bypass_policy == SSL_BYPASS_POLICY_ALLOW);
+}
+
+uint64_t SSLBypassAllGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_bypass_all);
+}
+
+uint64_t SSLBypassSniGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_bypass_sni);
+}
+
+uint64_t SSLBypassJa3GlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_bypass_ja3);
+}
+
+uint64_t SSLBypassNotListedGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_bypass_not_listed);
+}
+
 static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
                        AppLayerParserState *pstate, uint8_t *input,
                        uint32_t input_len)
@@ -2107,7 +2391,8 @@ static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
                                 APP_LAYER_PARSER_NO_INSPECTION);
                     }
 
-                    if (ssl_config.encrypt_mode == SSL_CNF_ENC_HANDLE_BYPASS) {
+                    if (ssl_config.encrypt_mode == SSL_CNF_ENC_HANDLE_BYPASS &&
+                            SSLBypassAllowed(ssl_state)) {
                         AppLayerParserStateSetFlag(pstate, APP_LAYER_PARSER_NO_REASSEMBLY);
                         AppLayerParserStateSetFlag(pstate, APP_LAYER_PARSER_BYPASS_READY);
                     }
@@ -2149,7 +2434,7 @@ static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
 
 static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
                        AppLayerParserState *pstate, uint8_t *input,
-                       uint32_t input_len)
+                       uint32_t input_len, SSLThreadCtx *td)
 {
     int retval = 0;
     uint32_t parsed = 0;
@@ -2210,7 +2495,8 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
 
             /* Encrypted data, reassembly not asked, bypass asked, let's sacrifice
              * heartbeat lke inspection to be able to be able to bypass the flow */
-            if (ssl_config.encrypt_mode == SSL_CNF_ENC_HANDLE_BYPASS) {
+            if (ssl_config.encrypt_mode == SSL_CNF_ENC_HANDLE_BYPASS &&
+                    SSLBypassAllowed(ssl_state)) {
                 SCLogDebug("setting APP_LAYER_PARSER_NO_REASSEMBLY");
                 AppLayerParserStateSetFlag(pstate, APP_LAYER_PARSER_NO_REASSEMBLY);
                 AppLayerParserStateSetFlag(pstate, APP_LAYER_PARSER_NO_INSPECTION);
@@ -2230,7 +2516,7 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
             }
 
             retval = SSLv3ParseHandshakeProtocol(ssl_state, input + parsed,
-                                                 input_len, direction);
+                                                 input_len, direction, td);
             if (retval < 0) {
                 SSLSetEvent(ssl_state,
                         TLS_DECODER_EVENT_INVALID_HANDSHAKE_MESSAGE);
@@ -2331,7 +2617,7 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
  * \retval >=0 On success.
  */
 static int SSLDecode(Flow *f, uint8_t direction, void *alstate, AppLayerParserState *pstate,
-                     uint8_t *input, uint32_t ilen)
+                     uint8_t *input, uint32_t ilen, SSLThreadCtx *td)
 {
     SSLState *ssl_state = (SSLState *)alstate;
     int retval = 0;
@@ -2397,7 +2683,7 @@ static int SSLDecode(Flow *f, uint8_t direction, void *alstate, AppLayerParserSt
                 } else {
                     SCLogDebug("SSLv3.x detected");
                     retval = SSLv3Decode(direction, ssl_state, pstate, input,
-                                         input_len);
+                                         input_len, td);
                     if (retval < 0) {
                         SCLogDebug("Error parsing SSLv3.x. Reseting parser "
                                    "state. Let's get outta here");
@@ -2439,7 +2725,7 @@ static int SSLDecode(Flow *f, uint8_t direction, void *alstate, AppLayerParserSt
                     SCLogDebug("Continuing parsing SSLv3.x record from where we "
                                "previously left off");
                     retval = SSLv3Decode(direction, ssl_state, pstate, input,
-                                         input_len);
+                                         input_len, td);
                     if (retval < 0) {
                         SCLogDebug("Error parsing SSLv3.x.  Reseting parser "
                                    "state.  Let's get outta here");
@@ -2483,20 +2769,51 @@ static int SSLParseClientRecord(Flow *f, void *alstate, AppLayerParserState *pst
                          uint8_t *input, uint32_t input_len,
                          void *local_data, const uint8_t flags)
 {
-    return SSLDecode(f, 0 /* toserver */, alstate, pstate, input, input_len);
+    return SSLDecode(f, 0 /* toserver */, alstate, pstate, input, input_len,
+            local_data);
 }
 
 static int SSLParseServerRecord(Flow *f, void *alstate, AppLayerParserState *pstate,
                          uint8_t *input, uint32_t input_len,
                          void *local_data, const uint8_t flags)
 {
-    return SSLDecode(f, 1 /* toclient */, alstate, pstate, input, input_len);
+    return SSLDecode(f, 1 /* toclient */, alstate, pstate, input, input_len,
+            local_data);
 }
 
 /**
  * \internal
  * \brief Function to allocate the SSL state memory.
  */
+static void *SSLLocalStorageAlloc(void)
+{
+    SSLThreadCtx *td = SCCalloc(1, sizeof(*td));
+    if (unlikely(td == NULL))
+        return NULL;
+
+    if (ssl_config.cert_cache_size >= 2) {
+        td->cert_cache_sets = ssl_config.cert_cache_size / 2;
+        td->cert_cache = SCCalloc(td->cert_cache_sets * 2, sizeof(SSLCertCacheEntry));
+        if (td->cert_cache == NULL)
+            td->cert_cache_sets = 0;
+    }
+    return td;
+}
+
+static void SSLLocalStorageFree(void *ptr)
+{
+    SSLThreadCtx *td = ptr;
+    if (td == NULL)
+        return;
+
+    if (td->cert_cache != NULL) {
+        for (uint32_t i = 0; i < td->cert_cache_sets * 2; i++)
+            SSLCertCacheEntryClear(&td->cert_cache[i]);
+        SCFree(td->cert_cache);
+    }
+    SCFree(td);
+}
+
 static void *SSLStateAlloc(void)
 {
     SSLState *ssl_state = SCMalloc(sizeof(SSLState));
@@ -2751,6 +3068,70 @@ static int SSLRegisterPatternsForProtocolDetection(void)
     return 0;
 }
 
+static void SSLBypassListFree(void *data)
+{
+    SCFree(data);
+}
+
+/**
+ * \brief load a bypass allowlist from the config
+ *
+ * \param sni true for SNI names, which are lowercased and may
+ *            use a '*.' wildcard prefix; false for JA3 hashes
+ *
+ * \retval ht table or NULL if the list is not set or empty
+ */
+static HashListTable *SSLBypassListSetup(const char *name, bool sni)
+{
+    ConfNode *node = ConfGetNode(name);
+    if (node == NULL)
+        return NULL;
+
+    HashListTable *ht = HashListTableInit(256, HashListTableGenericHash,
+            NULL, SSLBypassListFree);
+    if (ht == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate %s table", name);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t cnt = 0;
+    ConfNode *item;
+    TAILQ_FOREACH(item, &node->head, next) {
+        if (item->val == NULL)
+            continue;
+        const char *val = item->val;
+        if (sni && val[0] == '*' && val[1] == '.')
+            val++;
+        size_t len = strlen(val);
+        if (len == 0 || len > UINT8_MAX) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "%s: ignoring invalid "
+                    "entry \"%s\"", name, item->val);
+            continue;
+        }
+        char *entry = SCStrdup(val);
+        if (unlikely(entry == NULL)) {
+            SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate %s entry", name);
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < len; i++)
+            entry[i] = tolower((unsigned char)entry[i]);
+
+        if (HashListTableLookup(ht, entry, (uint16_t)len) != NULL ||
+                HashListTableAdd(ht, entry, (uint16_t)len) != 0) {
+            SCFree(entry);
+            continue;
+        }
+        cnt++;
+    }
+
+    if (cnt == 0) {
+        HashListTableFree(ht);
+        return NULL;
+    }
+    SCLogConfig("%s: %u entries", name, cnt);
+    return ht;
+}
+
 /**
  * \brief Function to register the SSL protocol parser and other functions
  */
@@ -2795,6 +3176,9 @@ void RegisterSSLParsers(void)
 
         AppLayerParserRegisterStateFuncs(IPPROTO_TCP, ALPROTO_TLS, SSLStateAlloc, SSLStateFree);
 
+        AppLayerParserRegisterLocalStorageFunc(IPPROTO_TCP, ALPROTO_TLS,
+                SSLLocalStorageAlloc, SSLLocalStorageFree);
+
         AppLayerParserRegisterParserAcceptableDataDirection(IPPROTO_TCP, ALPROTO_TLS, STREAM_TOSERVER);
 
         AppLayerParserRegisterTxFreeFunc(IPPROTO_TCP, ALPROTO_TLS, SSLStateTransactionFree);
@@ -2843,12 +3227,43 @@ void RegisterSSLParsers(void)
         }
         SCLogDebug("ssl_config.encrypt_mode %u", ssl_config.encrypt_mode);
 
+        /* allowlists limiting which encrypted flows get bypassed */
+        if (ssl_config.bypass_sni != NULL) {
+            HashListTableFree(ssl_config.bypass_sni);
+            ssl_config.bypass_sni = NULL;
+        }
+        if (ssl_config.bypass_ja3 != NULL) {
+            HashListTableFree(ssl_config.bypass_ja3);
+            ssl_config.bypass_ja3 = NULL;
+        }
+        if (ssl_config.encrypt_mode == SSL_CNF_ENC_HANDLE_BYPASS) {
+            ssl_config.bypass_sni = SSLBypassListSetup(
+                    "app-layer.protocols.tls.bypass-sni", true);
+            ssl_config.bypass_ja3 = SSLBypassListSetup(
+                    "app-layer.protocols.tls.bypass-ja3", false);
+        }
+        SC_ATOMIC_INIT(ssl_bypass_all);
+        SC_ATOMIC_INIT(ssl_bypass_sni);
+        SC_ATOMIC_INIT(ssl_bypass_ja3);
+        SC_ATOMIC_INIT(ssl_bypass_not_listed);
+
         /* Check if we should generate JA3 fingerprints */
         if (ConfGetBool("app-layer.protocols.tls.ja3-fingerprints",
                         &ssl_config.enable_ja3) != 1) {
             ssl_config.enable_ja3 = SSL_CONFIG_DEFAULT_JA3;
         }
 
+        /* per thread cache of decoded server certificates */
+        ssl_config.cert_cache_size = SSLCertCacheSizeFromConf();
+        SCLogDebug("ssl_config.cert_cache_size %u", ssl_config.cert_cache_size);
+
+        /* the JA3 allowlist needs the hashes */
+        if (ssl_config.bypass_ja3 != NULL && !ssl_config.enable_ja3) {
+            SCLogConfig("enabling JA3 fingerprints for "
+                    "app-layer.protocols.tls.bypass-ja3");
+            ssl_config.enable_ja3 = 1;
+        }
+
 #ifndef HAVE_NSS
         if (ssl_config.enable_ja3) {
             SCLogWarning(SC_WARN_NO_JA3_SUPPORT,
@@ -2875,6 +3290,7 @@ void RegisterSSLParsers(void)
 /***************************************Unittests******************************/
 
 #ifdef UNITTESTS
+#include "conf-yaml-loader.h"
 
 /**
  *\test Send a get request in one chunk.
@@ -5293,6 +5709,152 @@ static int SSLParserTest26(void)
     PASS;
 }
 
+/** \test bypass allowlist matching on SNI */
+static int SSLBypassPolicyTest01(void)
+{
+    char input[] = "\
+%YAML 1.1\n\
+---\n\
+app-layer:\n\
+  protocols:\n\
+    tls:\n\
+      bypass-sni:\n\
+        - \"*.Example.com\"\n\
+        - \"exact.org\"\n\
+";
+    SslConfig backup = ssl_config;
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(input, strlen(input));
+    ssl_config.bypass_sni = SSLBypassListSetup(
+            "app-layer.protocols.tls.bypass-sni", true);
+    ssl_config.bypass_ja3 = NULL;
+    FAIL_IF_NULL(ssl_config.bypass_sni);
+
+    FAIL_IF_NOT(SSLBypassSniListed("www.example.com"));
+    FAIL_IF_NOT(SSLBypassSniListed("a.b.EXAMPLE.com"));
+    FAIL_IF(SSLBypassSniListed("example.com"));
+    FAIL_IF(SSLBypassSniListed("badexample.com"));
+    FAIL_IF_NOT(SSLBypassSniListed("exact.org"));
+    FAIL_IF(SSLBypassSniListed("www.exact.org"));
+
+    SSLState state;
+    memset(&state, 0, sizeof(state));
+    state.client_connp.sni = (char *)"cdn.example.com";
+    FAIL_IF_NOT(SSLBypassAllowed(&state));
+    FAIL_IF_NOT(state.bypass_policy == SSL_BYPASS_POLICY_ALLOW);
+
+    memset(&state, 0, sizeof(state));
+    state.client_connp.sni = (char *)"other.net";
+    FAIL_IF(SSLBypassAllowed(&state));
+    /* decision sticks */
+    state.client_connp.sni = (char *)"cdn.example.com";
+    FAIL_IF(SSLBypassAllowed(&state));
+
+    HashListTableFree(ssl_config.bypass_sni);
+    ssl_config = backup;
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
+/** \internal
+ *  \brief fill a connp with cert fields like TlsDecodeHSCertificateFields */
+static void SSLCertCacheTestConnp(SSLStateConnp *connp, const char *subject,
+                                  time_t not_before)
+{
+    memset(connp, 0, sizeof(*connp));
+    connp->cert0_subject = (char *)subject;
+    connp->cert0_issuerdn = (char *)"C=US, O=Test CA";
+    connp->cert0_serial = (char *)"01:02:03";
+    connp->cert0_not_before = not_before;
+    connp->cert0_not_after = not_before + 3600;
+}
+
+/** \test cert cache hit, LRU eviction within a set and the fields copied
+ *        out of the cache */
+static int SSLCertCacheTest01(void)
+{
+    SslConfig backup = ssl_config;
+    /* one set, so all certs compete for the same 2 slots */
+    ssl_config.cert_cache_size = 2;
+    SSLThreadCtx *td = SSLLocalStorageAlloc();
+    ssl_config = backup;
+    FAIL_IF_NULL(td);
+    FAIL_IF_NULL(td->cert_cache);
+    FAIL_IF_NOT(td->cert_cache_sets == 1);
+
+    uint8_t sha1_a[SHA1_LENGTH], sha1_b[SHA1_LENGTH], sha1_c[SHA1_LENGTH];
+    memset(sha1_a, 0xaa, sizeof(sha1_a));
+    memset(sha1_b, 0xbb, sizeof(sha1_b));
+    memset(sha1_c, 0xcc, sizeof(sha1_c));
+
+    SSLStateConnp connp;
+    FAIL_IF_NOT_NULL(SSLCertCacheLookup(td, sha1_a));
+    SSLCertCacheTestConnp(&connp, "CN=a.example.com", 1000);
+    SSLCertCacheAdd(td, sha1_a, &connp);
+    SSLCertCacheTestConnp(&connp, "CN=b.example.com", 2000);
+    SSLCertCacheAdd(td, sha1_b, &connp);
+
+    /* hit on the older entry moves it to the front */
+    const SSLCertCacheEntry *e = SSLCertCacheLookup(td, sha1_a);
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(e == &td->cert_cache[0]);
+    FAIL_IF(strcmp(e->subject, "CN=a.example.com") != 0);
+
+    /* so adding a third evicts b, not a */
+    SSLCertCacheTestConnp(&connp, "CN=c.example.com", 3000);
+    SSLCertCacheAdd(td, sha1_c, &connp);
+    FAIL_IF_NOT_NULL(SSLCertCacheLookup(td, sha1_b));
+    FAIL_IF_NULL(SSLCertCacheLookup(td, sha1_c));
+    e = SSLCertCacheLookup(td, sha1_a);
+    FAIL_IF_NULL(e);
+
+    /* the fields come out of the cache as they went in, as copies */
+    SSLState *ssl_state = SSLStateAlloc();
+    FAIL_IF_NULL(ssl_state);
+    FAIL_IF_NOT(TlsDecodeHSCertificateFromCache(ssl_state, e) == 0);
+    SSLStateConnp *sc = &ssl_state->server_connp;
+    FAIL_IF_NULL(sc->cert0_subject);
+    FAIL_IF(sc->cert0_subject == e->subject);
+    FAIL_IF(strcmp(sc->cert0_subject, "CN=a.example.com") != 0);
+    FAIL_IF(strcmp(sc->cert0_issuerdn, "C=US, O=Test CA") != 0);
+    FAIL_IF(strcmp(sc->cert0_serial, "01:02:03") != 0);
+    FAIL_IF_NOT(sc->cert0_not_before == 1000);
+    FAIL_IF_NOT(sc->cert0_not_after == 4600);
+    SSLStateFree(ssl_state);
+
+    SSLLocalStorageFree(td);
+    PASS;
+}
+
+/** \test a cert cache size of 1 is rounded up to the minimum */
+static int SSLCertCacheTest02(void)
+{
+    char input[] = "\
+%YAML 1.1\n\
+---\n\
+app-layer:\n\
+  protocols:\n\
+    tls:\n\
+      certificate-cache-size: 1\n\
+";
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(input, strlen(input));
+    FAIL_IF_NOT(SSLCertCacheSizeFromConf() == 2);
+
+    ConfSet("app-layer.protocols.tls.certificate-cache-size", "0");
+    FAIL_IF_NOT(SSLCertCacheSizeFromConf() == 0);
+    ConfSet("app-layer.protocols.tls.certificate-cache-size", "-1");
+    FAIL_IF_NOT(SSLCertCacheSizeFromConf() == SSL_CONFIG_DEFAULT_CERT_CACHE_SIZE);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void SSLParserRegisterTests(void)
@@ -5329,6 +5891,11 @@ void SSLParserRegisterTests(void)
 
     UtRegisterTest("SSLParserMultimsgTest01", SSLParserMultimsgTest01);
     UtRegisterTest("SSLParserMultimsgTest02", SSLParserMultimsgTest02);
+
+    UtRegisterTest("SSLBypassPolicyTest01", SSLBypassPolicyTest01);
+
+    UtRegisterTest("SSLCertCacheTest01", SSLCertCacheTest01);
+    UtRegisterTest("SSLCertCacheTest02", SSLCertCacheTest02);
 #endif /* UNITTESTS */
 
     return;
@@ -230,6 +230,9 @@ typedef struct SSLState_ {
 
     uint32_t current_flags;
 
+    /* encrypted bypass decision, see SSLBypassAllowed() */
+    uint8_t bypass_policy;
+
     JA3Buffer *ja3_str;
     char *ja3_hash;
 
@@ -247,4 +250,9 @@ void SSLParserRegisterTests(void);
 void SSLSetEvent(SSLState *ssl_state, uint8_t event);
 void SSLVersionToString(uint16_t, char *);
 
+uint64_t SSLBypassAllGlobalCounter(void);
+uint64_t SSLBypassSniGlobalCounter(void);
+uint64_t SSLBypassJa3GlobalCounter(void);
+uint64_t SSLBypassNotListedGlobalCounter(void);
+
 #endif /* __APP_LAYER_SSL_H__ */
@@ -49,6 +49,7 @@
 
 #include "app-layer-htp-mem.h"
 #include "app-layer-dns-common.h"
+#include "app-layer-ssl.h"
 
 /**
  * \brief This is for the app layer in general and it contains per thread
@@ -840,6 +841,10 @@ void AppLayerRegisterGlobalCounters(void)
     StatsRegisterGlobalCounter("ftp.memuse", FTPMemuseGlobalCounter);
     StatsRegisterGlobalCounter("ftp.memcap", FTPMemcapGlobalCounter);
     StatsRegisterGlobalCounter("app_layer.expectations", ExpectationGetCounter);
+    StatsRegisterGlobalCounter("tls.bypass.all", SSLBypassAllGlobalCounter);
+    StatsRegisterGlobalCounter("tls.bypass.sni", SSLBypassSniGlobalCounter);
+    StatsRegisterGlobalCounter("tls.bypass.ja3", SSLBypassJa3GlobalCounter);
+    StatsRegisterGlobalCounter("tls.bypass.not_listed", SSLBypassNotListedGlobalCounter);
 }
 
 #define IPPROTOS_MAX 2
@@ -0,0 +1,729 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Datasets: named sets of strings, md5/sha256 hashes and IP addresses.
+ *
+ * Sets are defined in the 'datasets' section of the yaml or by the
+ * dataset keyword, and are loaded from a file with one entry per line.
+ * Entries can be added and removed at runtime over the unix socket.
+ *
+ * Each set is a chained hash table. Lookups are lock free: chains are
+ * only ever prepended to, and removed entries are flagged instead of
+ * unlinked. Entries live in an arena that is released with the set.
+ * Sets are kept until shutdown, so rule reloads reuse them.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "datasets.h"
+
+#include "util-hash-lookup3.h"
+#include "util-misc.h"
+#include "util-path.h"
+#include "util-debug.h"
+#include "util-fmemopen.h"
+#include "util-unittest.h"
+
+#define DATASET_HASHSIZE_DEFAULT    65536
+#define DATASET_HASHSIZE_MAX        (1 << 26)
+#define DATASET_MEMCAP_DEFAULT      (256 * 1024 * 1024)
+#define DATASET_ARENA_CHUNK_SIZE    (1024 * 1024)
+#define DATASET_STRING_MAX_LEN      UINT16_MAX
+
+static SCMutex sets_lock = SCMUTEX_INITIALIZER;
+static Dataset *sets = NULL;
+
+enum DatasetTypes DatasetGetTypeFromString(const char *s)
+{
+    if (strcasecmp("string", s) == 0)
+        return DATASET_TYPE_STRING;
+    if (strcasecmp("md5", s) == 0)
+        return DATASET_TYPE_MD5;
+    if (strcasecmp("sha256", s) == 0)
+        return DATASET_TYPE_SHA256;
+    if (strcasecmp("ipv4", s) == 0)
+        return DATASET_TYPE_IPV4;
+    if (strcasecmp("ipv6", s) == 0)
+        return DATASET_TYPE_IPV6;
+    return DATASET_TYPE_NOTSET;
+}
+
+const char *DatasetTypeToString(enum DatasetTypes type)
+{
+    switch (type) {
+        case DATASET_TYPE_STRING:
+            return "string";
+        case DATASET_TYPE_MD5:
+            return "md5";
+        case DATASET_TYPE_SHA256:
+            return "sha256";
+        case DATASET_TYPE_IPV4:
+            return "ipv4";
+        case DATASET_TYPE_IPV6:
+            return "ipv6";
+        case DATASET_TYPE_NOTSET:
+            break;
+    }
+    return "unknown";
+}
+
+/** \internal
+ *  \brief entry size for the fixed size types, 0 for strings */
+static uint32_t DatasetTypeLen(enum DatasetTypes type)
+{
+    switch (type) {
+        case DATASET_TYPE_MD5:
+            return 16;
+        case DATASET_TYPE_SHA256:
+            return 32;
+        case DATASET_TYPE_IPV4:
+            return 4;
+        case DATASET_TYPE_IPV6:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+static inline bool DatasetLenValid(const Dataset *set, const uint32_t len)
+{
+    const uint32_t type_len = DatasetTypeLen(set->type);
+    if (type_len != 0)
+        return len == type_len;
+    return len > 0 && len <= DATASET_STRING_MAX_LEN;
+}
+
+static inline uint32_t DatasetHash(const uint8_t *data, const uint32_t len)
+{
+    return hashlittle_safe(data, len, 0);
+}
+
+static DatasetEntry *DatasetFindEntry(const Dataset *set,
+        const uint32_t hash, const uint8_t *data, const uint32_t len)
+{
+    DatasetEntry *e = *(DatasetEntry * volatile *)&set->buckets[hash & set->hash_mask];
+    for ( ; e != NULL; e = e->next) {
+        if (e->hash == hash && e->len == len && memcmp(e->data, data, len) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+/**
+ *  \brief check if data is in the set
+ *
+ *  \retval 1 found
+ *  \retval 0 not found
+ *  \retval -1 data can't be in a set of this type
+ */
+int DatasetLookup(const Dataset *set, const uint8_t *data, const uint32_t data_len)
+{
+    if (!DatasetLenValid(set, data_len))
+        return -1;
+
+    const DatasetEntry *e = DatasetFindEntry(set, DatasetHash(data, data_len),
+            data, data_len);
+    if (e == NULL || SC_ATOMIC_GET(e->removed))
+        return 0;
+    return 1;
+}
+
+/**
+ *  \retval 1 added
+ *  \retval 0 already in the set
+ *  \retval -1 error: bad data, memcap reached or out of memory
+ */
+int DatasetAdd(Dataset *set, const uint8_t *data, const uint32_t data_len)
+{
+    if (!DatasetLenValid(set, data_len))
+        return -1;
+
+    const uint32_t hash = DatasetHash(data, data_len);
+    int r = -1;
+
+    SCMutexLock(&set->lock);
+    DatasetEntry *e = DatasetFindEntry(set, hash, data, data_len);
+    if (e != NULL) {
+        if (SC_ATOMIC_GET(e->removed)) {
+            SC_ATOMIC_SET(e->removed, 0);
+            (void)SC_ATOMIC_ADD(set->cnt, 1);
+            r = 1;
+        } else {
+            r = 0;
+        }
+        goto end;
+    }
+
+    const size_t size = sizeof(DatasetEntry) + data_len;
+    if (set->arena->memuse + size > set->memcap) {
+        SCLogDebug("set %s: memcap reached", set->name);
+        goto end;
+    }
+    e = MemArenaAlloc(set->arena, size);
+    if (e == NULL)
+        goto end;
+
+    e->hash = hash;
+    e->len = (uint16_t)data_len;
+    SC_ATOMIC_INIT(e->removed);
+    memcpy(e->data, data, data_len);
+
+    /* publish: readers see either the old or the new head, and the
+     * entry is complete before it's reachable */
+    DatasetEntry **bucket = &set->buckets[hash & set->hash_mask];
+    do {
+        e->next = *bucket;
+    } while (!SCAtomicCompareAndSwap(bucket, e->next, e));
+
+    (void)SC_ATOMIC_ADD(set->cnt, 1);
+    r = 1;
+end:
+    SCMutexUnlock(&set->lock);
+    return r;
+}
+
+/**
+ *  \retval 1 removed
+ *  \retval 0 not in the set
+ *  \retval -1 data can't be in a set of this type
+ */
+int DatasetRemove(Dataset *set, const uint8_t *data, const uint32_t data_len)
+{
+    if (!DatasetLenValid(set, data_len))
+        return -1;
+
+    int r = 0;
+    SCMutexLock(&set->lock);
+    DatasetEntry *e = DatasetFindEntry(set, DatasetHash(data, data_len),
+            data, data_len);
+    if (e != NULL && !SC_ATOMIC_GET(e->removed)) {
+        SC_ATOMIC_SET(e->removed, 1);
+        (void)SC_ATOMIC_SUB(set->cnt, 1);
+        r = 1;
+    }
+    SCMutexUnlock(&set->lock);
+    return r;
+}
+
+static int DatasetHexToRaw(const char *in, uint8_t *out, const uint32_t out_len)
+{
+    if (strlen(in) != out_len * 2)
+        return -1;
+
+    for (uint32_t i = 0; i < out_len; i++) {
+        char hex[3] = { in[i * 2], in[i * 2 + 1], '\0' };
+        if (!isxdigit((unsigned char)hex[0]) || !isxdigit((unsigned char)hex[1]))
+            return -1;
+        out[i] = (uint8_t)strtoul(hex, NULL, 16);
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief convert the text form of an entry: the string itself, a hex
+ *         encoded hash or an IP address
+ *
+ *  \retval len length of the data in 'out' or -1 on error
+ */
+static int DatasetParse(const Dataset *set, const char *string,
+        uint8_t *out, const uint32_t out_size, const uint8_t **data)
+{
+    switch (set->type) {
+        case DATASET_TYPE_STRING:
+            *data = (const uint8_t *)string;
+            return (int)strlen(string);
+        case DATASET_TYPE_MD5:
+        case DATASET_TYPE_SHA256: {
+            const uint32_t len = DatasetTypeLen(set->type);
+            if (len > out_size || DatasetHexToRaw(string, out, len) < 0)
+                return -1;
+            *data = out;
+            return (int)len;
+        }
+        case DATASET_TYPE_IPV4:
+            if (inet_pton(AF_INET, string, out) != 1)
+                return -1;
+            *data = out;
+            return 4;
+        case DATASET_TYPE_IPV6:
+            if (inet_pton(AF_INET6, string, out) != 1)
+                return -1;
+            *data = out;
+            return 16;
+        case DATASET_TYPE_NOTSET:
+            break;
+    }
+    return -1;
+}
+
+/**
+ *  \brief add an entry in its text form
+ *
+ *  \retval 1 added, 0 already in the set, -1 error
+ */
+int DatasetAddSerialized(Dataset *set, const char *string)
+{
+    uint8_t buf[32];
+    const uint8_t *data = NULL;
+    int len = DatasetParse(set, string, buf, sizeof(buf), &data);
+    if (len < 0)
+        return -1;
+    return DatasetAdd(set, data, (uint32_t)len);
+}
+
+/**
+ *  \brief remove an entry in its text form
+ *
+ *  \retval 1 removed, 0 not in the set, -1 error
+ */
+int DatasetRemoveSerialized(Dataset *set, const char *string)
+{
+    uint8_t buf[32];
+    const uint8_t *data = NULL;
+    int len = DatasetParse(set, string, buf, sizeof(buf), &data);
+    if (len < 0)
+        return -1;
+    return DatasetRemove(set, data, (uint32_t)len);
+}
+
+/**
+ *  \brief check if a buffer in text form is in the set
+ *
+ *  Buffers are matched as is against string sets. For the other types
+ *  the buffer holds the hex encoded hash or the IP address as text.
+ *
+ *  \retval 1 found, 0 not found, -1 buffer can't be in the set
+ */
+int DatasetLookupBuffer(const Dataset *set, const uint8_t *buf, const uint32_t buf_len)
+{
+    if (set->type == DATASET_TYPE_STRING)
+        return DatasetLookup(set, buf, buf_len);
+
+    /* long enough for a sha256 in hex or an ipv6 address */
+    char string[72];
+    if (buf_len == 0 || buf_len >= sizeof(string))
+        return -1;
+    memcpy(string, buf, buf_len);
+    string[buf_len] = '\0';
+
+    uint8_t raw[32];
+    const uint8_t *data = NULL;
+    int len = DatasetParse(set, string, raw, sizeof(raw), &data);
+    if (len < 0)
+        return -1;
+    return DatasetLookup(set, data, (uint32_t)len);
+}
+
+static char *DatasetCompleteFilePath(const char *file)
+{
+    const char *defaultpath = NULL;
+    if (!PathIsRelative(file) ||
+            ConfGet("default-rule-path", &defaultpath) != 1 || defaultpath == NULL) {
+        return SCStrdup(file);
+    }
+
+    size_t path_len = strlen(defaultpath) + strlen(file) + 2;
+    char *path = SCMalloc(path_len);
+    if (unlikely(path == NULL))
+        return NULL;
+    strlcpy(path, defaultpath, path_len);
+    if (path[strlen(path) - 1] != '/')
+        strlcat(path, "/", path_len);
+    strlcat(path, file, path_len);
+    return path;
+}
+
+/** \internal
+ *  \brief count the lines of the file to size the hash */
+static uint32_t DatasetCountLines(FILE *fp)
+{
+    uint32_t cnt = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        if (c == '\n')
+            cnt++;
+    }
+    rewind(fp);
+    return cnt;
+}
+
+static int DatasetLoad(Dataset *set, FILE *fp)
+{
+    char line[DATASET_STRING_MAX_LEN + 2];
+    uint32_t cnt = 0, lineno = 0;
+
+    while (fgets(line, (int)sizeof(line), fp) != NULL) {
+        lineno++;
+        size_t len = strlen(line);
+        /* fgets returns an over-long line in pieces, skip all of them */
+        if (len > 0 && line[len - 1] != '\n' && !feof(fp)) {
+            int c = fgetc(fp);
+            if (c != '\n' && c != EOF) {
+                SCLogError(SC_ERR_INVALID_VALUE, "dataset %s: line %u is "
+                        "longer than %u bytes, skipping it", set->name,
+                        lineno, DATASET_STRING_MAX_LEN);
+                while ((c = fgetc(fp)) != '\n' && c != EOF)
+                    ;
+                continue;
+            }
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        /* ignore comments and empty lines */
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        uint8_t buf[32];
+        const uint8_t *data = NULL;
+        int data_len = DatasetParse(set, line, buf, sizeof(buf), &data);
+        if (data_len <= 0) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "dataset %s: bad %s entry "
+                    "on line %u", set->name, DatasetTypeToString(set->type),
+                    lineno);
+            continue;
+        }
+        int r = DatasetAdd(set, data, (uint32_t)data_len);
+        if (r < 0) {
+            SCLogError(SC_ERR_MEM_ALLOC, "dataset %s: memcap of %"PRIu64
+                    " reached at line %u", set->name, set->memcap, lineno);
+            return -1;
+        }
+        cnt += r;
+    }
+    SCLogConfig("dataset %s: loaded %u entries from %s", set->name, cnt,
+            set->load);
+    return 0;
+}
+
+static void DatasetFree(Dataset *set)
+{
+    if (set == NULL)
+        return;
+    if (set->arena != NULL)
+        MemArenaDestroy(set->arena);
+    if (set->buckets != NULL)
+        SCFree(set->buckets);
+    if (set->load != NULL)
+        SCFree(set->load);
+    SCMutexDestroy(&set->lock);
+    SC_ATOMIC_DESTROY(set->cnt);
+    SCFree(set);
+}
+
+static Dataset *DatasetFindLocked(const char *name)
+{
+    for (Dataset *set = sets; set != NULL; set = set->next) {
+        if (strcmp(set->name, name) == 0)
+            return set;
+    }
+    return NULL;
+}
+
+/**
+ *  \brief get a set by name and type
+ *
+ *  \retval set or NULL if there is no such set
+ */
+Dataset *DatasetFind(const char *name, enum DatasetTypes type)
+{
+    SCMutexLock(&sets_lock);
+    Dataset *set = DatasetFindLocked(name);
+    if (set != NULL && set->type != type)
+        set = NULL;
+    SCMutexUnlock(&sets_lock);
+    return set;
+}
+
+/**
+ *  \brief get a set, creating and loading it if it doesn't exist yet
+ *
+ *  \param type type of the set, DATASET_TYPE_NOTSET to only get an
+ *              existing set
+ *  \param load optional file to load the set from
+ *  \param memcap memcap of the set, 0 for the default
+ *  \param hashsize hash rows, 0 to size for the entries in the file
+ *
+ *  \retval set or NULL on error
+ */
+Dataset *DatasetGet(const char *name, enum DatasetTypes type,
+        const char *load, uint64_t memcap, uint32_t hashsize)
+{
+    if (strlen(name) == 0 || strlen(name) > DATASET_NAME_MAX_LEN) {
+        SCLogError(SC_ERR_INVALID_VALUE, "dataset name \"%s\" is empty or "
+                "too long", name);
+        return NULL;
+    }
+
+    SCMutexLock(&sets_lock);
+    Dataset *set = DatasetFindLocked(name);
+    if (set != NULL) {
+        if (type != DATASET_TYPE_NOTSET && set->type != type) {
+            SCLogError(SC_ERR_INVALID_VALUE, "dataset %s already exists with "
+                    "type %s", name, DatasetTypeToString(set->type));
+            set = NULL;
+        }
+        SCMutexUnlock(&sets_lock);
+        return set;
+    }
+    if (type == DATASET_TYPE_NOTSET) {
+        SCLogError(SC_ERR_INVALID_VALUE, "dataset %s is not defined, a type "
+                "is needed to create it", name);
+        goto error;
+    }
+
+    set = SCCalloc(1, sizeof(*set));
+    if (unlikely(set == NULL))
+        goto error;
+    strlcpy(set->name, name, sizeof(set->name));
+    set->type = type;
+    set->memcap = memcap ? memcap : DATASET_MEMCAP_DEFAULT;
+    SCMutexInit(&set->lock, NULL);
+    SC_ATOMIC_INIT(set->cnt);
+
+    FILE *fp = NULL;
+    if (load != NULL) {
+        set->load = DatasetCompleteFilePath(load);
+        if (set->load == NULL)
+            goto error;
+        fp = fopen(set->load, "r");
+        if (fp == NULL) {
+            SCLogError(SC_ERR_OPENING_RULE_FILE, "opening dataset file %s: %s",
+                    set->load, strerror(errno));
+            goto error;
+        }
+        if (hashsize == 0)
+            hashsize = DatasetCountLines(fp);
+    }
+    if (hashsize == 0)
+        hashsize = DATASET_HASHSIZE_DEFAULT;
+
+    /* round up to a power of 2 so the hash can be masked */
+    uint32_t rows = 1024;
+    while (rows < hashsize && rows < DATASET_HASHSIZE_MAX)
+        rows <<= 1;
+    set->hash_mask = rows - 1;
+    set->buckets = SCCalloc(rows, sizeof(DatasetEntry *));
+    set->arena = MemArenaCreate(DATASET_ARENA_CHUNK_SIZE, NULL, NULL, NULL);
+    if (set->buckets == NULL || set->arena == NULL) {
+        if (fp != NULL)
+            fclose(fp);
+        goto error;
+    }
+
+    if (fp != NULL) {
+        int r = DatasetLoad(set, fp);
+        fclose(fp);
+        if (r < 0)
+            goto error;
+    }
+
+    set->next = sets;
+    sets = set;
+    SCMutexUnlock(&sets_lock);
+    SCLogDebug("dataset %s: type %s, %u rows", set->name,
+            DatasetTypeToString(set->type), rows);
+    return set;
+
+error:
+    DatasetFree(set);
+    SCMutexUnlock(&sets_lock);
+    return NULL;
+}
+
+/**
+ *  \brief create the sets from the 'datasets' section of the yaml
+ *
+ *  \retval 0 ok
+ *  \retval -1 error in the config
+ */
+int DatasetsInit(void)
+{
+    ConfNode *datasets = ConfGetNode("datasets");
+    if (datasets == NULL)
+        return 0;
+
+    ConfNode *set_node;
+    TAILQ_FOREACH(set_node, &datasets->head, next) {
+        if (set_node->name == NULL)
+            continue;
+
+        const char *type_str = ConfNodeLookupChildValue(set_node, "type");
+        if (type_str == NULL) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "dataset %s has no type",
+                    set_node->name);
+            return -1;
+        }
+        enum DatasetTypes type = DatasetGetTypeFromString(type_str);
+        if (type == DATASET_TYPE_NOTSET) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "dataset %s: unknown "
+                    "type %s", set_node->name, type_str);
+            return -1;
+        }
+
+        uint64_t memcap = 0;
+        const char *memcap_str = ConfNodeLookupChildValue(set_node, "memcap");
+        if (memcap_str != NULL && ParseSizeStringU64(memcap_str, &memcap) < 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "dataset %s: invalid "
+                    "memcap %s", set_node->name, memcap_str);
+            return -1;
+        }
+        intmax_t hashsize = 0;
+        if (ConfGetChildValueInt(set_node, "hashsize", &hashsize) == 1 &&
+                (hashsize < 0 || hashsize > DATASET_HASHSIZE_MAX)) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "dataset %s: invalid "
+                    "hashsize %"PRIdMAX, set_node->name, hashsize);
+            return -1;
+        }
+
+        const char *load = ConfNodeLookupChildValue(set_node, "load");
+        if (DatasetGet(set_node->name, type, load, memcap,
+                    (uint32_t)hashsize) == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+void DatasetsDestroy(void)
+{
+    SCMutexLock(&sets_lock);
+    Dataset *set = sets;
+    while (set != NULL) {
+        Dataset *next = set->next;
+        DatasetFree(set);
+        set = next;
+    }
+    sets = NULL;
+    SCMutexUnlock(&sets_lock);
+}
+
+#ifdef UNITTESTS
+static int DatasetsTest01(void)
+{
+    Dataset *set = DatasetGet("datasets-test01", DATASET_TYPE_STRING,
+            NULL, 0, 0);
+    FAIL_IF_NULL(set);
+    FAIL_IF_NOT(DatasetFind("datasets-test01", DATASET_TYPE_STRING) == set);
+    FAIL_IF_NOT(DatasetFind("datasets-test01", DATASET_TYPE_MD5) == NULL);
+    FAIL_IF_NOT(DatasetGet("datasets-test01", DATASET_TYPE_MD5, NULL, 0, 0) == NULL);
+
+    FAIL_IF_NOT(DatasetAddSerialized(set, "example.com") == 1);
+    FAIL_IF_NOT(DatasetAddSerialized(set, "example.com") == 0);
+    FAIL_IF_NOT(DatasetAddSerialized(set, "example.net") == 1);
+    FAIL_IF_NOT(SC_ATOMIC_GET(set->cnt) == 2);
+
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.com", 11) == 1);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.co", 10) == 0);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"", 0) == -1);
+
+    /* removed entries are flagged, adding them again clears that */
+    FAIL_IF_NOT(DatasetRemoveSerialized(set, "example.com") == 1);
+    FAIL_IF_NOT(DatasetRemoveSerialized(set, "example.com") == 0);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.com", 11) == 0);
+    FAIL_IF_NOT(DatasetAddSerialized(set, "example.com") == 1);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.com", 11) == 1);
+    FAIL_IF_NOT(SC_ATOMIC_GET(set->cnt) == 2);
+    PASS;
+}
+
+static int DatasetsTest02(void)
+{
+    Dataset *md5 = DatasetGet("datasets-test02-md5", DATASET_TYPE_MD5,
+            NULL, 0, 0);
+    FAIL_IF_NULL(md5);
+    FAIL_IF_NOT(DatasetAddSerialized(md5, "d41d8cd98f00b204e9800998ecf8427e") == 1);
+    FAIL_IF_NOT(DatasetAddSerialized(md5, "d41d8cd98f00b204e9800998ecf8427") == -1);
+    FAIL_IF_NOT(DatasetAddSerialized(md5, "x41d8cd98f00b204e9800998ecf8427e") == -1);
+    const uint8_t raw[16] = { 0xd4, 0x1d, 0x8c, 0xd9, 0x8f, 0x00, 0xb2, 0x04,
+                              0xe9, 0x80, 0x09, 0x98, 0xec, 0xf8, 0x42, 0x7e };
+    FAIL_IF_NOT(DatasetLookup(md5, raw, sizeof(raw)) == 1);
+    FAIL_IF_NOT(DatasetLookup(md5, raw, 15) == -1);
+
+    Dataset *ip = DatasetGet("datasets-test02-ipv4", DATASET_TYPE_IPV4,
+            NULL, 0, 0);
+    FAIL_IF_NULL(ip);
+    FAIL_IF_NOT(DatasetAddSerialized(ip, "192.168.1.1") == 1);
+    FAIL_IF_NOT(DatasetAddSerialized(ip, "192.168.1.256") == -1);
+    const uint8_t addr[4] = { 192, 168, 1, 1 };
+    FAIL_IF_NOT(DatasetLookup(ip, addr, sizeof(addr)) == 1);
+    PASS;
+}
+
+/** \test many entries in a small hash, so the chains are long */
+static int DatasetsTest03(void)
+{
+    Dataset *set = DatasetGet("datasets-test03", DATASET_TYPE_STRING,
+            NULL, 0, 1);
+    FAIL_IF_NULL(set);
+    FAIL_IF_NOT(set->hash_mask == 1023);
+
+    char entry[32];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(entry, sizeof(entry), "host%d.example.com", i);
+        FAIL_IF_NOT(DatasetAddSerialized(set, entry) == 1);
+    }
+    for (int i = 0; i < 10000; i += 7) {
+        snprintf(entry, sizeof(entry), "host%d.example.com", i);
+        FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)entry, strlen(entry)) == 1);
+    }
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"host10000.example.com", 21) == 0);
+    PASS;
+}
+
+/** \test over-long lines in a load file are skipped as a whole */
+static int DatasetsTest04(void)
+{
+    Dataset *set = DatasetGet("datasets-test04", DATASET_TYPE_STRING,
+            NULL, 0, 0);
+    FAIL_IF_NULL(set);
+
+    const size_t long_len = DATASET_STRING_MAX_LEN + 100;
+    const char *rest = "\nexample.org\n# comment\r\nexample.net";
+    const size_t size = long_len + strlen(rest);
+    char *buf = SCMalloc(size + 1);
+    FAIL_IF_NULL(buf);
+    memset(buf, 'a', long_len);
+    strlcpy(buf + long_len, rest, size + 1 - long_len);
+
+    set->load = SCStrdup("datasets-test04.lst");
+    FAIL_IF_NULL(set->load);
+    FILE *fp = SCFmemopen(buf, size, "r");
+    FAIL_IF_NULL(fp);
+    int r = DatasetLoad(set, fp);
+    fclose(fp);
+
+    FAIL_IF_NOT(r == 0);
+    FAIL_IF_NOT(SC_ATOMIC_GET(set->cnt) == 2);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.org", 11) == 1);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)"example.net", 11) == 1);
+    FAIL_IF_NOT(DatasetLookup(set, (const uint8_t *)buf, DATASET_STRING_MAX_LEN) == 0);
+    SCFree(buf);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void DatasetsRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DatasetsTest01", DatasetsTest01);
+    UtRegisterTest("DatasetsTest02", DatasetsTest02);
+    UtRegisterTest("DatasetsTest03", DatasetsTest03);
+    UtRegisterTest("DatasetsTest04", DatasetsTest04);
+#endif
+}
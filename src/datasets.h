@@ -0,0 +1,88 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Named sets of strings, hashes and IP addresses for the dataset keyword.
+ */
+
+#ifndef __DATASETS_H__
+#define __DATASETS_H__
+
+#include "util-arena.h"
+
+#define DATASET_NAME_MAX_LEN 63
+
+enum DatasetTypes {
+    DATASET_TYPE_NOTSET = 0,
+    DATASET_TYPE_STRING,
+    DATASET_TYPE_MD5,
+    DATASET_TYPE_SHA256,
+    DATASET_TYPE_IPV4,
+    DATASET_TYPE_IPV6,
+};
+
+/** set member. Never freed while the set exists: a removed entry is
+ *  only flagged, so lookups can walk the chains without locking. */
+typedef struct DatasetEntry_ {
+    struct DatasetEntry_ *next;
+    uint32_t hash;
+    uint16_t len;
+    SC_ATOMIC_DECLARE(uint8_t, removed);
+    uint8_t data[];
+} DatasetEntry;
+
+typedef struct Dataset_ {
+    char name[DATASET_NAME_MAX_LEN + 1];
+    enum DatasetTypes type;
+    char *load;                     /**< file the set was loaded from */
+
+    /** chains are only prepended to, with a CAS on the bucket */
+    DatasetEntry **buckets;
+    uint32_t hash_mask;
+
+    /** serializes adds and removes. Lookups don't take it. */
+    SCMutex lock;
+    MemArena *arena;                /**< entries */
+    uint64_t memcap;
+    SC_ATOMIC_DECLARE(uint32_t, cnt);
+
+    struct Dataset_ *next;
+} Dataset;
+
+enum DatasetTypes DatasetGetTypeFromString(const char *s);
+const char *DatasetTypeToString(enum DatasetTypes type);
+
+Dataset *DatasetGet(const char *name, enum DatasetTypes type,
+        const char *load, uint64_t memcap, uint32_t hashsize);
+Dataset *DatasetFind(const char *name, enum DatasetTypes type);
+
+int DatasetLookup(const Dataset *set, const uint8_t *data, const uint32_t data_len);
+int DatasetLookupBuffer(const Dataset *set, const uint8_t *buf, const uint32_t buf_len);
+int DatasetAdd(Dataset *set, const uint8_t *data, const uint32_t data_len);
+int DatasetRemove(Dataset *set, const uint8_t *data, const uint32_t data_len);
+
+int DatasetAddSerialized(Dataset *set, const char *string);
+int DatasetRemoveSerialized(Dataset *set, const char *string);
+
+int DatasetsInit(void);
+void DatasetsDestroy(void);
+
+void DatasetsRegisterTests(void);
+
+#endif /* __DATASETS_H__ */
@@ -487,6 +487,21 @@ static int DecodeIPV4Options(Packet *p, uint8_t *pkt, uint16_t len, IPV4Options
 
 static int DecodeIPV4Packet(Packet *p, uint8_t *pkt, uint16_t len)
 {
+    /* fast path: version 4, 20 byte header without options and a
+     * consistent total length. Covers the vast majority of traffic
+     * with a single check on the ver/hlen byte and the length. Anything
+     * unusual falls through to the full validation below, so the
+     * decoder events are set exactly as before. */
+    if (likely(len >= IPV4_HEADER_LEN && pkt[0] == 0x45)) {
+        p->ip4h = (IPV4Hdr *)pkt;
+        const uint16_t iplen = IPV4_GET_IPLEN(p);
+        if (likely(iplen >= IPV4_HEADER_LEN && iplen <= len)) {
+            SET_IPV4_SRC_ADDR(p,&p->src);
+            SET_IPV4_DST_ADDR(p,&p->dst);
+            return 0;
+        }
+    }
+
     if (unlikely(len < IPV4_HEADER_LEN)) {
         ENGINE_SET_INVALID_EVENT(p, IPV4_PKT_TOO_SMALL);
         return -1;
@@ -545,7 +560,7 @@ int DecodeIPV4(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p, uint8_t *pkt, u
     p->proto = IPV4_GET_IPPROTO(p);
 
     /* If a fragment, pass off for re-assembly. */
-    if (unlikely(IPV4_GET_IPOFFSET(p) > 0 || IPV4_GET_MF(p) == 1)) {
+    if (unlikely(IPV4_IS_FRAGMENT(p))) {
         Packet *rp = Defrag(tv, dtv, p, pq);
         if (rp != NULL) {
             PacketEnqueue(pq, rp);
@@ -1631,6 +1646,39 @@ end:
     return result;
 }
 
+/** \test plain header takes the fast path, a truncated one must still
+ *        set the trunc event */
+static int DecodeIPV4FastPathTest01(void)
+{
+    uint8_t raw_ipv4[] = {
+        0x45, 0x00, 0x00, 0x14, 0x00, 0x00, 0x40, 0x00,
+        0x40, 0xff, 0xb7, 0x52, 0xc0, 0xa8, 0x01, 0x03,
+        0xc0, 0xa8, 0x01, 0x04};
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+
+    FAIL_IF(DecodeIPV4(&tv, &dtv, p, raw_ipv4, sizeof(raw_ipv4), NULL) != TM_ECODE_OK);
+    FAIL_IF_NULL(p->ip4h);
+    FAIL_IF_NOT(PKT_IS_IPV4(p));
+    FAIL_IF(p->proto != 0xff);
+    FAIL_IF(GET_IPV4_DST_ADDR_U32(p) != htonl(0xc0a80104));
+    FAIL_IF(p->events.cnt != 0);
+    PACKET_RECYCLE(p);
+
+    /* total length larger than the data we have */
+    raw_ipv4[3] = 0x28;
+    FAIL_IF(DecodeIPV4(&tv, &dtv, p, raw_ipv4, sizeof(raw_ipv4), NULL) != TM_ECODE_FAILED);
+    FAIL_IF_NOT(ENGINE_ISSET_EVENT(p, IPV4_TRUNC_PKT));
+
+    PACKET_RECYCLE(p);
+    SCFree(p);
+    PASS;
+}
 #endif /* UNITTESTS */
 
 void DecodeIPV4RegisterTests(void)
@@ -1674,6 +1722,7 @@ void DecodeIPV4RegisterTests(void)
     UtRegisterTest("DecodeIPV4DefragTest01", DecodeIPV4DefragTest01);
     UtRegisterTest("DecodeIPV4DefragTest02", DecodeIPV4DefragTest02);
     UtRegisterTest("DecodeIPV4DefragTest03", DecodeIPV4DefragTest03);
+    UtRegisterTest("DecodeIPV4FastPathTest01", DecodeIPV4FastPathTest01);
 #endif /* UNITTESTS */
 }
 /**
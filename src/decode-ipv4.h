@@ -143,6 +143,10 @@ typedef struct IPV4Hdr_
 /* IPV4_GET_MF: get the MF flag. Use _IPV4_GET_IPOFFSET to save a SCNtohs call. */
 #define IPV4_GET_MF(p) \
     (uint8_t)((_IPV4_GET_IPOFFSET((p)) & 0x2000) >> 13)
+/* IPV4_IS_FRAGMENT: MF set or offset > 0, checked on the raw field so only
+ * a single mask is needed. */
+#define IPV4_IS_FRAGMENT(p) \
+    ((IPV4_GET_RAW_IPOFFSET((p)->ip4h) & htons(0x3fff)) != 0)
 #define IPV4_GET_IPTTL(p) \
      IPV4_GET_RAW_IPTTL(p->ip4h)
 #define IPV4_GET_IPPROTO(p) \
@@ -47,6 +47,11 @@
     (dst).len  = (src).len; \
     (dst).data = (src).data
 
+/** NOP, NOP, TS kind, TS len: the option prefix used by most stacks */
+static const uint8_t tcp_opt_nop_nop_ts[4] = {
+    TCP_OPT_NOP, TCP_OPT_NOP, TCP_OPT_TS, TCP_OPT_TS_LEN };
+#define TCP_OPT_NOP_NOP_TS_LEN  (2 + TCP_OPT_TS_LEN)
+
 static int DecodeTCPOptions(Packet *p, uint8_t *pkt, uint16_t len)
 {
     uint8_t tcp_opt_cnt = 0;
@@ -181,7 +186,19 @@ static int DecodeTCPPacket(ThreadVars *tv, Packet *p, uint8_t *pkt, uint16_t len
         return -1;
     }
 
-    if (likely(tcp_opt_len > 0)) {
+    /* fast path for the most common option layout on established
+     * sessions: NOP, NOP, TS. Anything else goes through the full
+     * options parser so all events are still set. */
+    if (likely(tcp_opt_len == TCP_OPT_NOP_NOP_TS_LEN &&
+               memcmp(pkt + TCP_HEADER_LEN, tcp_opt_nop_nop_ts,
+                   sizeof(tcp_opt_nop_nop_ts)) == 0))
+    {
+        uint32_t values[2];
+        memcpy(&values, pkt + TCP_HEADER_LEN + 4, sizeof(values));
+        p->tcpvars.ts_val = SCNtohl(values[0]);
+        p->tcpvars.ts_ecr = SCNtohl(values[1]);
+        p->tcpvars.ts_set = TRUE;
+    } else if (likely(tcp_opt_len > 0)) {
         DecodeTCPOptions(p, pkt + TCP_HEADER_LEN, tcp_opt_len);
     }
 
@@ -512,6 +529,58 @@ end:
     SCFree(p);
     return retval;
 }
+/** \test NOP,NOP,TS options take the fast path and must give the
+ *        same result as the full options parser */
+static int TCPGetTimestampTest01(void)
+{
+    static uint8_t raw_tcp[] = {0xda, 0xc1, 0x00, 0x50, 0xb6, 0x21, 0x7f, 0x59,
+                                0xdd, 0xa3, 0x6f, 0xf8, 0x80, 0x10, 0x05, 0xb4,
+                                0x7c, 0x70, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a,
+                                0x00, 0x62, 0x88, 0x9e, 0x00, 0x00, 0x00, 0x01};
+    /* same timestamp, but as NOP, TS, NOP, EOL padding so the generic
+     * options parser is used */
+    static uint8_t raw_tcp_slow[] = {0xda, 0xc1, 0x00, 0x50, 0xb6, 0x21, 0x7f, 0x59,
+                                     0xdd, 0xa3, 0x6f, 0xf8, 0x90, 0x10, 0x05, 0xb4,
+                                     0x7c, 0x70, 0x00, 0x00, 0x01, 0x08, 0x0a, 0x00,
+                                     0x62, 0x88, 0x9e, 0x00, 0x00, 0x00, 0x01, 0x01,
+                                     0x00, 0x00, 0x00, 0x00};
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    IPV4Hdr ip4h;
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+    memset(&ip4h, 0, sizeof(IPV4Hdr));
+
+    p->src.family = AF_INET;
+    p->dst.family = AF_INET;
+    p->ip4h = &ip4h;
+
+    FlowInitConfig(FLOW_QUIET);
+    DecodeTCP(&tv, &dtv, p, raw_tcp, sizeof(raw_tcp), NULL);
+    FAIL_IF_NULL(p->tcph);
+    FAIL_IF_NOT(TCP_HAS_TS(p));
+    FAIL_IF(TCP_GET_TSVAL(p) != 0x0062889e);
+    FAIL_IF(TCP_GET_TSECR(p) != 1);
+    FAIL_IF(p->payload_len != 0);
+    PACKET_RECYCLE(p);
+
+    p->src.family = AF_INET;
+    p->dst.family = AF_INET;
+    p->ip4h = &ip4h;
+    DecodeTCP(&tv, &dtv, p, raw_tcp_slow, sizeof(raw_tcp_slow), NULL);
+    FAIL_IF_NULL(p->tcph);
+    FAIL_IF_NOT(TCP_HAS_TS(p));
+    FAIL_IF(TCP_GET_TSVAL(p) != 0x0062889e);
+    FAIL_IF(TCP_GET_TSECR(p) != 1);
+
+    PACKET_RECYCLE(p);
+    FlowShutdown();
+    SCFree(p);
+    PASS;
+}
 #endif /* UNITTESTS */
 
 void DecodeTCPRegisterTests(void)
@@ -529,6 +598,7 @@ void DecodeTCPRegisterTests(void)
     UtRegisterTest("TCPGetWscaleTest02", TCPGetWscaleTest02);
     UtRegisterTest("TCPGetWscaleTest03", TCPGetWscaleTest03);
     UtRegisterTest("TCPGetSackTest01", TCPGetSackTest01);
+    UtRegisterTest("TCPGetTimestampTest01", TCPGetTimestampTest01);
 #endif /* UNITTESTS */
 }
 /**
@@ -145,6 +145,27 @@ DefragFragInit(void *data, void *initdata)
     return 1;
 }
 
+/**
+ * \brief Release the in order fragments of a tracker.
+ */
+static void
+DefragTrainFree(DefragTracker *tracker)
+{
+    DefragTrain *train = &tracker->train;
+
+    if (train->cnt > 0) {
+        SCMutexLock(&defrag_context->frag_pool_lock);
+        for (uint8_t i = 0; i < train->cnt; i++) {
+            if (train->frags[i] != NULL)
+                PoolReturn(defrag_context->frag_pool, train->frags[i]);
+        }
+        SCMutexUnlock(&defrag_context->frag_pool_lock);
+    }
+    if (train->buf != NULL)
+        SCFree(train->buf);
+    memset(train, 0, sizeof(*train));
+}
+
 /**
  * \brief Free all frags associated with a tracker.
  */
@@ -153,6 +174,8 @@ DefragTrackerFreeFrags(DefragTracker *tracker)
 {
     Frag *frag, *tmp;
 
+    DefragTrainFree(tracker);
+
     /* Lock the frag pool as we'll be return items to it. */
     SCMutexLock(&defrag_context->frag_pool_lock);
 
@@ -489,6 +512,262 @@ error_remove_tracker:
     return NULL;
 }
 
+/**
+ * \brief Check if a fragment can be added to the in order fast path.
+ *
+ * The first fragment starts a train, the next ones have to start
+ * exactly where the data so far ends. The fragment completing the
+ * packet isn't stored, so it doesn't need to fit in the buffer.
+ */
+static int
+DefragTrainAccepts(const DefragTrain *train, const Frag *frag)
+{
+    if (frag->data_len == 0)
+        return 0;
+    if (train->cnt == 0)
+        return (frag->offset == 0 && frag->more_frags);
+    if (frag->offset != train->end[train->cnt - 1])
+        return 0;
+    if (!frag->more_frags)
+        return 1;
+    return (train->cnt < DEFRAG_TRAIN_FRAGS - 1);
+}
+
+/**
+ * \brief Append a fragment accepted by DefragTrainAccepts() to the train.
+ *
+ * The buffer is sized for the first fragment and grown for the next.
+ *
+ * \retval 0 ok, -1 no fragment left in the pool or out of memory
+ */
+static int
+DefragTrainAppend(DefragTrain *train, const Frag *frag,
+        int ip6_nh_set_offset, uint8_t ip6_nh_set_value)
+{
+    SCMutexLock(&defrag_context->frag_pool_lock);
+    Frag *pool_frag = PoolGet(defrag_context->frag_pool);
+    SCMutexUnlock(&defrag_context->frag_pool_lock);
+    if (pool_frag == NULL)
+        return -1;
+
+    if (train->cnt == 0) {
+        uint32_t len = frag->data_offset + frag->data_len;
+
+        train->buf = SCMalloc(len);
+        if (train->buf == NULL)
+            goto error;
+        memcpy(train->buf, frag->pkt, len);
+        /* see DefragInsertFrag */
+        if (ip6_nh_set_offset > 0 && (uint32_t)ip6_nh_set_offset < len) {
+            train->buf[ip6_nh_set_offset] = ip6_nh_set_value;
+        }
+
+        train->size = len;
+        train->hlen = frag->hlen;
+        train->ip_hdr_offset = frag->ip_hdr_offset;
+        train->frag_hdr_offset = frag->frag_hdr_offset;
+        train->data_offset = frag->data_offset;
+    } else {
+        uint32_t size = (uint32_t)train->data_offset + frag->offset +
+            frag->data_len;
+        if (size > train->size) {
+            uint8_t *buf = SCRealloc(train->buf, size);
+            if (buf == NULL)
+                goto error;
+            train->buf = buf;
+            train->size = size;
+        }
+        memcpy(train->buf + train->data_offset + frag->offset,
+                frag->pkt + frag->data_offset, frag->data_len);
+    }
+    train->frags[train->cnt] = pool_frag;
+    train->end[train->cnt++] = frag->offset + frag->data_len;
+    return 0;
+
+error:
+    SCMutexLock(&defrag_context->frag_pool_lock);
+    PoolReturn(defrag_context->frag_pool, pool_frag);
+    SCMutexUnlock(&defrag_context->frag_pool_lock);
+    return -1;
+}
+
+/**
+ * \brief Move the train into the fragment tree, so the reassembly
+ *        policies can deal with a fragment that's out of order or
+ *        overlapping.
+ *
+ * The pool fragments held by the train are used for the tree.
+ *
+ * \retval 0 ok, -1 out of memory
+ */
+static int
+DefragTrainToTree(DefragTracker *tracker)
+{
+    DefragTrain *train = &tracker->train;
+    uint16_t start = 0;
+
+    for (uint8_t i = 0; i < train->cnt; i++) {
+        Frag *frag = train->frags[i];
+
+        frag->offset = start;
+        frag->data_len = train->end[i] - start;
+        frag->more_frags = 1;
+        if (i == 0) {
+            frag->hlen = train->hlen;
+            frag->ip_hdr_offset = train->ip_hdr_offset;
+            frag->frag_hdr_offset = train->frag_hdr_offset;
+            frag->data_offset = train->data_offset;
+            frag->len = train->data_offset + frag->data_len;
+            frag->pkt = SCMalloc(frag->len);
+            if (frag->pkt != NULL)
+                memcpy(frag->pkt, train->buf, frag->len);
+        } else {
+            /* only the data of the other fragments is used */
+            frag->len = frag->data_len;
+            frag->pkt = SCMalloc(frag->len);
+            if (frag->pkt != NULL)
+                memcpy(frag->pkt, train->buf + train->data_offset + start,
+                        frag->len);
+        }
+        /* returned to the pool with the train */
+        if (frag->pkt == NULL)
+            return -1;
+
+        IP_FRAGMENTS_RB_INSERT(&tracker->fragment_tree, frag);
+        train->frags[i] = NULL;
+        start = train->end[i];
+    }
+
+    DefragTrainFree(tracker);
+    return 0;
+}
+
+/**
+ * \brief Reassemble a packet from the train and the fragment
+ *        completing it.
+ *
+ * \param frag The last fragment, pointing into the packet data of p.
+ */
+static Packet *
+DefragTrainReassemble(ThreadVars *tv, DefragTracker *tracker, Packet *p,
+        const Frag *frag)
+{
+    const DefragTrain *train = &tracker->train;
+    const int stored_len = train->end[train->cnt - 1];
+    const int fragmentable_len = frag->offset + frag->data_len;
+    Packet *rp = NULL;
+
+    tracker->seen_last = 1;
+
+    if (tracker->af == AF_INET) {
+        if (train->data_offset + fragmentable_len > (int)MAX_PAYLOAD_SIZE) {
+            SCLogWarning(SC_ERR_REASSEMBLY, "Failed re-assemble "
+                    "fragmented packet, exceeds size of packet buffer.");
+            goto error_remove_tracker;
+        }
+
+        rp = PacketDefragPktSetup(p, NULL, 0, IPV4_GET_IPPROTO(p));
+        if (rp == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate packet for "
+                    "fragmentation re-assembly, dumping fragments.");
+            goto error_remove_tracker;
+        }
+        PKT_SET_SRC(rp, PKT_SRC_DEFRAG);
+        rp->flags |= PKT_REBUILT_FRAGMENT;
+        rp->recursion_level = p->recursion_level;
+
+        if (PacketCopyData(rp, train->buf, train->data_offset + stored_len) == -1)
+            goto error_remove_tracker;
+        if (PacketCopyDataOffset(rp, train->data_offset + frag->offset,
+                frag->pkt + frag->data_offset, frag->data_len) == -1)
+            goto error_remove_tracker;
+
+        rp->ip4h = (IPV4Hdr *)(GET_PKT_DATA(rp) + train->ip_hdr_offset);
+        int old = rp->ip4h->ip_len + rp->ip4h->ip_off;
+        rp->ip4h->ip_len = htons(fragmentable_len + train->hlen);
+        rp->ip4h->ip_off = 0;
+        rp->ip4h->ip_csum = FixChecksum(rp->ip4h->ip_csum,
+            old, rp->ip4h->ip_len + rp->ip4h->ip_off);
+        SET_PKT_LEN(rp, train->data_offset + fragmentable_len);
+    } else {
+        /* the frag header is stripped, the data goes where it was */
+        const int fragmentable_offset = train->frag_hdr_offset;
+        const int unfragmentable_len = (fragmentable_offset -
+                train->ip_hdr_offset) - IPV6_HEADER_LEN;
+        if (unfragmentable_len >= fragmentable_offset)
+            goto error_remove_tracker;
+        const uint8_t next_hdr =
+            ((IPV6FragHdr *)(train->buf + train->frag_hdr_offset))->ip6fh_nxt;
+
+        rp = PacketDefragPktSetup(p, NULL, 0, 0);
+        if (rp == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate packet for "
+                    "fragmentation re-assembly, dumping fragments.");
+            goto error_remove_tracker;
+        }
+        PKT_SET_SRC(rp, PKT_SRC_DEFRAG);
+
+        if (PacketCopyData(rp, train->buf, fragmentable_offset) == -1)
+            goto error_remove_tracker;
+        if (PacketCopyDataOffset(rp, fragmentable_offset,
+                train->buf + train->data_offset, stored_len) == -1)
+            goto error_remove_tracker;
+        if (PacketCopyDataOffset(rp, fragmentable_offset + frag->offset,
+                frag->pkt + frag->data_offset, frag->data_len) == -1)
+            goto error_remove_tracker;
+
+        rp->ip6h = (IPV6Hdr *)(GET_PKT_DATA(rp) + train->ip_hdr_offset);
+        rp->ip6h->s_ip6_plen = htons(fragmentable_len + unfragmentable_len);
+        if (unfragmentable_len == 0)
+            rp->ip6h->s_ip6_nxt = next_hdr;
+        SET_PKT_LEN(rp, train->ip_hdr_offset + sizeof(IPV6Hdr) +
+                unfragmentable_len + fragmentable_len);
+    }
+
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    return rp;
+
+error_remove_tracker:
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    if (rp != NULL)
+        PacketFreeOrRelease(rp);
+    return NULL;
+}
+
+/**
+ * \brief Update the stats for a reassembled packet and decode it.
+ *
+ * \retval the reassembled packet or NULL if it failed to decode
+ */
+static Packet *
+DefragDecodeReassembled(ThreadVars *tv, DecodeThreadVars *dtv, int af,
+        Packet *p, Packet *r, PacketQueue *pq)
+{
+    if (r == NULL || tv == NULL || dtv == NULL)
+        return r;
+
+    int ret;
+    if (af == AF_INET) {
+        StatsIncr(tv, dtv->counter_defrag_ipv4_reassembled);
+        ret = pq ? DecodeIPV4(tv, dtv, r, (void *)r->ip4h,
+                IPV4_GET_IPLEN(r), pq) : TM_ECODE_OK;
+    } else {
+        StatsIncr(tv, dtv->counter_defrag_ipv6_reassembled);
+        ret = pq ? DecodeIPV6(tv, dtv, r, (uint8_t *)r->ip6h,
+                IPV6_GET_PLEN(r) + IPV6_HEADER_LEN, pq) : TM_ECODE_OK;
+    }
+    if (ret != TM_ECODE_OK) {
+        UNSET_TUNNEL_PKT(r);
+        r->root = NULL;
+        TmqhOutputPacketpool(tv, r);
+        return NULL;
+    }
+    PacketDefragPktSetupParent(p);
+    return r;
+}
+
 /**
  * The RB_TREE compare function for fragments.
  *
@@ -614,6 +893,44 @@ DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker,
     int overlap = 0;
     ltrim = 0;
 
+    /* Fast path for fragments arriving in order. */
+    if (RB_EMPTY(&tracker->fragment_tree)) {
+        Frag cur = {
+            .offset = frag_offset,
+            .len = GET_PKT_LEN(p),
+            .hlen = hlen,
+            .more_frags = more_frags,
+            .ip_hdr_offset = ip_hdr_offset,
+            .frag_hdr_offset = frag_hdr_offset,
+            .data_offset = data_offset,
+            .data_len = data_len,
+            .pkt = GET_PKT_DATA(p),
+        };
+        if (DefragTrainAccepts(&tracker->train, &cur)) {
+            if (!more_frags) {
+                r = DefragTrainReassemble(tv, tracker, p, &cur);
+                r = DefragDecodeReassembled(tv, dtv, af, p, r, pq);
+                goto done;
+            }
+            if (DefragTrainAppend(&tracker->train, &cur,
+                        ip6_nh_set_offset, ip6_nh_set_value) == 0) {
+                goto done;
+            }
+            /* no fragment or memory left, try the tree */
+        }
+        if (tracker->train.cnt > 0) {
+            if (DefragTrainToTree(tracker) < 0) {
+                DefragTrackerFreeFrags(tracker);
+                if (af == AF_INET) {
+                    ENGINE_SET_EVENT(p, IPV4_FRAG_IGNORED);
+                } else {
+                    ENGINE_SET_EVENT(p, IPV6_FRAG_IGNORED);
+                }
+                goto done;
+            }
+        }
+    }
+
     if (!RB_EMPTY(&tracker->fragment_tree)) {
         Frag key = {
             .offset = frag_offset - 1,
@@ -862,37 +1179,11 @@ DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker,
     if (tracker->seen_last) {
         if (tracker->af == AF_INET) {
             r = Defrag4Reassemble(tv, tracker, p);
-            if (r != NULL && tv != NULL && dtv != NULL) {
-                StatsIncr(tv, dtv->counter_defrag_ipv4_reassembled);
-                if (pq && DecodeIPV4(tv, dtv, r, (void *)r->ip4h,
-                               IPV4_GET_IPLEN(r), pq) != TM_ECODE_OK) {
-
-                    UNSET_TUNNEL_PKT(r);
-                    r->root = NULL;
-                    TmqhOutputPacketpool(tv, r);
-                    r = NULL;
-                } else {
-                    PacketDefragPktSetupParent(p);
-                }
-            }
         }
         else if (tracker->af == AF_INET6) {
             r = Defrag6Reassemble(tv, tracker, p);
-            if (r != NULL && tv != NULL && dtv != NULL) {
-                StatsIncr(tv, dtv->counter_defrag_ipv6_reassembled);
-                if (pq && DecodeIPV6(tv, dtv, r, (uint8_t *)r->ip6h,
-                               IPV6_GET_PLEN(r) + IPV6_HEADER_LEN,
-                               pq) != TM_ECODE_OK) {
-
-                    UNSET_TUNNEL_PKT(r);
-                    r->root = NULL;
-                    TmqhOutputPacketpool(tv, r);
-                    r = NULL;
-                } else {
-                    PacketDefragPktSetupParent(p);
-                }
-            }
         }
+        r = DefragDecodeReassembled(tv, dtv, tracker->af, p, r, pq);
     }
 
 
@@ -2456,6 +2747,171 @@ static int DefragTestJeremyLinux(void)
     PASS;
 }
 
+/**
+ * \test In order fragments stay out of the fragment tree until one
+ *       arrives out of order.
+ */
+static int DefragTrainTest(void)
+{
+    DefragTracker *tracker;
+    Packet *r;
+
+    DefragInit();
+
+    Packet *p1 = BuildTestPacket(IPPROTO_ICMP, 1, 0, 1, 'A', 8);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = BuildTestPacket(IPPROTO_ICMP, 1, 1, 1, 'B', 8);
+    FAIL_IF_NULL(p2);
+    Packet *p3 = BuildTestPacket(IPPROTO_ICMP, 1, 2, 0, 'C', 3);
+    FAIL_IF_NULL(p3);
+
+    /* in order */
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p1, NULL));
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p2, NULL));
+    tracker = DefragLookupTrackerFromHash(p1);
+    FAIL_IF_NULL(tracker);
+    FAIL_IF(tracker->train.cnt != 2);
+    FAIL_IF(!RB_EMPTY(&tracker->fragment_tree));
+    /* the train counts against max-frags */
+    FAIL_IF(defrag_context->frag_pool->outstanding != 2);
+    DefragTrackerRelease(tracker);
+
+    r = Defrag(NULL, NULL, p3, NULL);
+    FAIL_IF_NULL(r);
+    FAIL_IF(IPV4_GET_IPLEN(r) != 39);
+    FAIL_IF(memcmp(GET_PKT_DATA(r) + 20, "AAAAAAAABBBBBBBBCCC", 19) != 0);
+    FAIL_IF(defrag_context->frag_pool->outstanding != 0);
+    SCFree(r);
+
+    SCFree(p1);
+    SCFree(p2);
+    SCFree(p3);
+
+    /* out of order: the train moves to the tree */
+    p1 = BuildTestPacket(IPPROTO_ICMP, 2, 0, 1, 'A', 8);
+    FAIL_IF_NULL(p1);
+    p2 = BuildTestPacket(IPPROTO_ICMP, 2, 1, 1, 'B', 8);
+    FAIL_IF_NULL(p2);
+    p3 = BuildTestPacket(IPPROTO_ICMP, 2, 2, 0, 'C', 3);
+    FAIL_IF_NULL(p3);
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p1, NULL));
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p3, NULL));
+    tracker = DefragLookupTrackerFromHash(p1);
+    FAIL_IF_NULL(tracker);
+    FAIL_IF(tracker->train.cnt != 0);
+    FAIL_IF(RB_EMPTY(&tracker->fragment_tree));
+    FAIL_IF(defrag_context->frag_pool->outstanding != 2);
+    DefragTrackerRelease(tracker);
+
+    r = Defrag(NULL, NULL, p2, NULL);
+    FAIL_IF_NULL(r);
+    FAIL_IF(IPV4_GET_IPLEN(r) != 39);
+    FAIL_IF(memcmp(GET_PKT_DATA(r) + 20, "AAAAAAAABBBBBBBBCCC", 19) != 0);
+    SCFree(r);
+
+    SCFree(p1);
+    SCFree(p2);
+    SCFree(p3);
+    DefragDestroy();
+    PASS;
+}
+
+/**
+ * Build an IPv6 fragment with a hop-by-hop header before the fragment
+ * header, i.e. with an unfragmentable part.
+ */
+static Packet *IPV6BuildTestPacketHop(uint8_t proto, uint32_t id,
+        uint16_t off, int mf, const char content, int content_len)
+{
+    uint8_t buf[sizeof(IPV6Hdr) + 8 + sizeof(IPV6FragHdr) + 64];
+    if (content_len > 64)
+        return NULL;
+    memset(buf, 0, sizeof(buf));
+
+    IPV6Hdr *ip6h = (IPV6Hdr *)buf;
+    IPV6_SET_RAW_VER(ip6h, 6);
+    ip6h->s_ip6_nxt = IPPROTO_HOPOPTS;
+    ip6h->s_ip6_hlim = 2;
+    ip6h->s_ip6_plen = htons(8 + sizeof(IPV6FragHdr) + content_len);
+    memset(ip6h->s_ip6_src, 0x01, sizeof(ip6h->s_ip6_src));
+    memset(ip6h->s_ip6_dst, 0x02, sizeof(ip6h->s_ip6_dst));
+
+    /* hop-by-hop header, 8 bytes with a PadN option */
+    uint8_t *hop = buf + sizeof(IPV6Hdr);
+    hop[0] = 44;
+    hop[1] = 0;
+    hop[2] = 1;
+    hop[3] = 4;
+
+    IPV6FragHdr *fh = (IPV6FragHdr *)(hop + 8);
+    fh->ip6fh_nxt = proto;
+    fh->ip6fh_ident = htonl(id);
+    fh->ip6fh_offlg = htons((off << 3) | mf);
+
+    memset((uint8_t *)fh + sizeof(IPV6FragHdr), content, content_len);
+    const int len = sizeof(IPV6Hdr) + 8 + sizeof(IPV6FragHdr) + content_len;
+
+    Packet *p = SCCalloc(1, sizeof(*p) + default_packet_size);
+    if (unlikely(p == NULL))
+        return NULL;
+    PACKET_INITIALIZE(p);
+    gettimeofday(&p->ts, NULL);
+    if (PacketCopyData(p, buf, len) != 0) {
+        SCFree(p);
+        return NULL;
+    }
+    p->ip6h = (IPV6Hdr *)GET_PKT_DATA(p);
+    DecodeIPV6FragHeader(p, GET_PKT_DATA(p) + sizeof(IPV6Hdr) + 8,
+            sizeof(IPV6FragHdr), sizeof(IPV6FragHdr) + content_len, 8);
+
+    SET_IPV6_SRC_ADDR(p, &p->src);
+    SET_IPV6_DST_ADDR(p, &p->dst);
+    return p;
+}
+
+/**
+ * \test In order IPv6 fragments with a hop-by-hop header before the
+ *       fragment header: the next header field of the hop-by-hop
+ *       header is patched in the train's first fragment.
+ */
+static int IPV6DefragTrainHopTest(void)
+{
+    DefragInit();
+
+    Packet *p1 = IPV6BuildTestPacketHop(IPPROTO_ICMPV6, 1, 0, 1, 'A', 8);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = IPV6BuildTestPacketHop(IPPROTO_ICMPV6, 1, 1, 1, 'B', 8);
+    FAIL_IF_NULL(p2);
+    Packet *p3 = IPV6BuildTestPacketHop(IPPROTO_ICMPV6, 1, 2, 0, 'C', 3);
+    FAIL_IF_NULL(p3);
+
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p1, NULL));
+    FAIL_IF_NOT_NULL(Defrag(NULL, NULL, p2, NULL));
+    DefragTracker *tracker = DefragLookupTrackerFromHash(p1);
+    FAIL_IF_NULL(tracker);
+    FAIL_IF(tracker->train.cnt != 2);
+    FAIL_IF(!RB_EMPTY(&tracker->fragment_tree));
+    DefragTrackerRelease(tracker);
+
+    Packet *r = Defrag(NULL, NULL, p3, NULL);
+    FAIL_IF_NULL(r);
+    /* hop-by-hop header stays, the frag header is gone */
+    FAIL_IF(GET_PKT_LEN(r) != sizeof(IPV6Hdr) + 8 + 19);
+    FAIL_IF(IPV6_GET_RAW_PLEN(r->ip6h) != 8 + 19);
+    FAIL_IF(IPV6_GET_RAW_NH(r->ip6h) != IPPROTO_HOPOPTS);
+    FAIL_IF(GET_PKT_DATA(r)[sizeof(IPV6Hdr)] != IPPROTO_ICMPV6);
+    FAIL_IF(memcmp(GET_PKT_DATA(r) + sizeof(IPV6Hdr) + 8,
+                "AAAAAAAABBBBBBBBCCC", 19) != 0);
+    FAIL_IF(defrag_context->frag_pool->outstanding != 0);
+    SCFree(r);
+
+    SCFree(p1);
+    SCFree(p2);
+    SCFree(p3);
+    DefragDestroy();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void DefragRegisterTests(void)
@@ -2500,5 +2956,7 @@ void DefragRegisterTests(void)
     UtRegisterTest("DefragTestBadProto", DefragTestBadProto);
 
     UtRegisterTest("DefragTestJeremyLinux", DefragTestJeremyLinux);
+    UtRegisterTest("DefragTrainTest", DefragTrainTest);
+    UtRegisterTest("IPV6DefragTrainHopTest", IPV6DefragTrainHopTest);
 #endif /* UNITTESTS */
 }
@@ -77,6 +77,39 @@ int DefragRbFragCompare(struct Frag_ *a, struct Frag_ *b);
 RB_HEAD(IP_FRAGMENTS, Frag_);
 RB_PROTOTYPE(IP_FRAGMENTS, Frag_, rb, DefragRbFragCompare);
 
+/** Max number of fragments the in order fast path reassembles. */
+#define DEFRAG_TRAIN_FRAGS 3
+
+/**
+ * In order fast path. As long as the fragments of a packet arrive in
+ * order and without overlap they are appended to a single buffer
+ * instead of being stored in the fragment tree. The buffer holds the
+ * first fragment as it was on the wire, followed by the data of the
+ * next ones, so the reassembled packet is built with one copy.
+ *
+ * A fragment from the pool is held for every stored fragment, so
+ * trains count against defrag.max-frags like the tree does.
+ */
+typedef struct DefragTrain_ {
+    uint8_t *buf;
+    uint32_t size;              /**< Allocated size of buf. */
+
+    uint16_t ip_hdr_offset;     /**< IP header offset of the first
+                                 *   fragment. */
+    uint16_t frag_hdr_offset;   /**< Frag header offset of the first
+                                 *   fragment. IPv6 only. */
+    uint16_t data_offset;       /**< Offset in buf where the fragmentable
+                                 *   data starts. */
+    uint8_t hlen;               /**< IP header length. IPv4 only. */
+
+    uint8_t cnt;                /**< Fragments stored in buf. */
+    uint16_t end[DEFRAG_TRAIN_FRAGS - 1]; /**< Where the data of each
+                                 *   stored fragment ends, relative to
+                                 *   data_offset. */
+    struct Frag_ *frags[DEFRAG_TRAIN_FRAGS - 1]; /**< Pool fragments held
+                                 *   for the stored fragments. */
+} DefragTrain;
+
 /**
  * A defragmentation tracker.  Used to track fragments that make up a
  * single packet.
@@ -112,6 +145,9 @@ typedef struct DefragTracker_ {
 
     struct IP_FRAGMENTS fragment_tree;
 
+    /** in order fragments, only used while fragment_tree is empty */
+    DefragTrain train;
+
     /** hash pointers, protected by hash row mutex/spin */
     struct DefragTracker_ *hnext;
     struct DefragTracker_ *hprev;
@@ -53,6 +53,42 @@ void DetectBase64DecodeRegister(void)
     DetectSetupParseRegexes(decode_pattern, &decode_pcre, &decode_pcre_study);
 }
 
+/**
+ * \brief get the cache entry for decoding 'len' bytes at 'src'
+ *
+ * Entries are valid for the packet and tx they were made in. On a miss
+ * the oldest entry is taken over and its key set, the caller decodes.
+ *
+ * \param hit set to true if the entry already holds the decoded data
+ */
+static DetectBase64CacheEntry *DetectBase64CacheGet(
+        DetectEngineThreadCtx *det_ctx, const uint8_t *src, uint32_t len,
+        bool *hit)
+{
+    for (uint32_t i = 0; i < det_ctx->base64_cache_size; i++) {
+        DetectBase64CacheEntry *e = &det_ctx->base64_cache[i];
+        if (e->src == src && e->src_len == len &&
+                e->ticker == det_ctx->ticker &&
+                e->tx_id_set == det_ctx->tx_id_set &&
+                e->tx_id == det_ctx->tx_id) {
+            *hit = true;
+            return e;
+        }
+    }
+
+    DetectBase64CacheEntry *e = &det_ctx->base64_cache[det_ctx->base64_cache_next];
+    det_ctx->base64_cache_next = (det_ctx->base64_cache_next + 1) %
+        det_ctx->base64_cache_size;
+    e->src = src;
+    e->src_len = len;
+    e->ticker = det_ctx->ticker;
+    e->tx_id_set = det_ctx->tx_id_set;
+    e->tx_id = det_ctx->tx_id;
+    e->decoded_len = 0;
+    *hit = false;
+    return e;
+}
+
 int DetectBase64DecodeDoMatch(DetectEngineThreadCtx *det_ctx, const Signature *s,
     const SigMatchData *smd, uint8_t *payload, uint32_t payload_len)
 {
@@ -84,10 +120,16 @@ int DetectBase64DecodeDoMatch(DetectEngineThreadCtx *det_ctx, const Signature *s
     PrintRawDataFp(stdout, payload, decode_len);
 #endif
 
-    det_ctx->base64_decoded_len = DecodeBase64(det_ctx->base64_decoded,
-        payload, decode_len, 0);
-    SCLogDebug("Decoded %d bytes from base64 data.",
-        det_ctx->base64_decoded_len);
+    bool hit;
+    DetectBase64CacheEntry *e = DetectBase64CacheGet(det_ctx, payload,
+            (uint32_t)decode_len, &hit);
+    if (!hit) {
+        e->decoded_len = DecodeBase64(e->decoded, payload, decode_len, 0);
+    }
+    det_ctx->base64_decoded = e->decoded;
+    det_ctx->base64_decoded_len = e->decoded_len;
+    SCLogDebug("Decoded %d bytes from base64 data (cached %s).",
+        det_ctx->base64_decoded_len, hit ? "yes" : "no");
 #if 0
     if (det_ctx->base64_decoded_len) {
         printf("Decoded data:\n");
@@ -658,6 +700,51 @@ end:
     return retval;
 }
 
+/** \test rules decoding the same data share the decode */
+static int DetectBase64DecodeTestCache(void)
+{
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+
+    uint8_t payload[] = {
+        'S', 'G', 'V', 's', 'b', 'G', '8', 'g',
+        'V', '2', '9', 'y', 'b', 'G', 'Q', '=',
+    };
+
+    memset(&tv, 0, sizeof(tv));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+
+    de_ctx->sig_list = SigInit(de_ctx,
+        "alert tcp any any -> any any (base64_decode; sid:1;)");
+    FAIL_IF_NULL(de_ctx->sig_list);
+    de_ctx->sig_list->next = SigInit(de_ctx,
+        "alert tcp any any -> any any (base64_decode; sid:2;)");
+    FAIL_IF_NULL(de_ctx->sig_list->next);
+    de_ctx->sig_list->next->next = SigInit(de_ctx,
+        "alert tcp any any -> any any (base64_decode:offset 8; sid:3;)");
+    FAIL_IF_NULL(de_ctx->sig_list->next->next);
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+    FAIL_IF_NOT(det_ctx->base64_cache_size == DETECT_BASE64_CACHE_SIZE);
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    /* sid 1 and 2 share an entry, sid 3 decodes other data */
+    FAIL_IF_NOT(det_ctx->base64_cache_next == 2);
+    FAIL_IF_NOT(det_ctx->base64_cache[0].decoded_len == 11);
+    FAIL_IF_NOT(det_ctx->base64_cache[1].decoded_len == 5);
+
+    UTHFreePacket(p);
+    DetectEngineThreadCtxDeinit(&tv, det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
 #endif
 
 static void DetectBase64DecodeRegisterTests(void)
@@ -677,5 +764,6 @@ static void DetectBase64DecodeRegisterTests(void)
                    DetectBase64DecodeTestDecodeLargeOffset);
     UtRegisterTest("DetectBase64DecodeTestDecodeRelative",
                    DetectBase64DecodeTestDecodeRelative);
+    UtRegisterTest("DetectBase64DecodeTestCache", DetectBase64DecodeTestCache);
 #endif /* UNITTESTS */
 }
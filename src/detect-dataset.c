@@ -0,0 +1,229 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Implements the dataset keyword: match a sticky buffer against a set.
+ *
+ * dataset:<isset|isnotset>,<name>[, type <type>, load <file>,
+ *         memcap <size>, hashsize <rows>];
+ *
+ * The options are only needed if the set isn't defined in the yaml.
+ */
+
+#include "suricata-common.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+
+#include "datasets.h"
+#include "detect-dataset.h"
+
+#include "util-misc.h"
+
+static int DetectDatasetSetup (DetectEngineCtx *, Signature *, const char *);
+static void DetectDatasetFree (void *);
+#ifdef UNITTESTS
+static void DetectDatasetRegisterTests (void);
+#endif
+
+void DetectDatasetRegister(void)
+{
+    sigmatch_table[DETECT_DATASET].name = "dataset";
+    sigmatch_table[DETECT_DATASET].desc = "match sticky buffer against datasets";
+    sigmatch_table[DETECT_DATASET].url = DOC_URL DOC_VERSION "/rules/datasets.html#dataset";
+    sigmatch_table[DETECT_DATASET].Match = NULL;
+    sigmatch_table[DETECT_DATASET].Setup = DetectDatasetSetup;
+    sigmatch_table[DETECT_DATASET].Free = DetectDatasetFree;
+#ifdef UNITTESTS
+    sigmatch_table[DETECT_DATASET].RegisterTests = DetectDatasetRegisterTests;
+#endif
+}
+
+/**
+ *  \brief dataset match, called from the content inspection engine
+ *
+ *  \retval 1 match
+ *  \retval 0 no match
+ */
+int DetectDatasetBufferMatch(DetectEngineThreadCtx *det_ctx,
+    const DetectDatasetData *sd,
+    const uint8_t *data, const uint32_t data_len)
+{
+    if (data == NULL || data_len == 0)
+        return 0;
+
+    const int r = DatasetLookupBuffer(sd->set, data, data_len);
+    SCLogDebug("set %s lookup %d", sd->set->name, r);
+    switch (sd->cmd) {
+        case DETECT_DATASET_CMD_ISSET:
+            return (r == 1);
+        case DETECT_DATASET_CMD_ISNOTSET:
+            /* -1 means the buffer isn't valid for the set's type */
+            return (r == 0);
+    }
+    return 0;
+}
+
+typedef struct DetectDatasetOpts_ {
+    uint8_t cmd;
+    char name[DATASET_NAME_MAX_LEN + 1];
+    enum DatasetTypes type;
+    char load[PATH_MAX];
+    uint64_t memcap;
+    uint32_t hashsize;
+} DetectDatasetOpts;
+
+static int DetectDatasetParse(const char *str, DetectDatasetOpts *opts)
+{
+    char copy[1024];
+    if (strlcpy(copy, str, sizeof(copy)) >= sizeof(copy))
+        return -1;
+
+    memset(opts, 0, sizeof(*opts));
+
+    char *saveptr = NULL;
+    int i = 0;
+    for (char *opt = strtok_r(copy, ",", &saveptr); opt != NULL;
+            opt = strtok_r(NULL, ",", &saveptr), i++) {
+        while (isspace((unsigned char)*opt))
+            opt++;
+        size_t len = strlen(opt);
+        while (len > 0 && isspace((unsigned char)opt[len - 1]))
+            opt[--len] = '\0';
+
+        if (i == 0) {
+            if (strcmp(opt, "isset") == 0) {
+                opts->cmd = DETECT_DATASET_CMD_ISSET;
+            } else if (strcmp(opt, "isnotset") == 0) {
+                opts->cmd = DETECT_DATASET_CMD_ISNOTSET;
+            } else {
+                SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: unknown "
+                        "command '%s', expected isset or isnotset", opt);
+                return -1;
+            }
+            continue;
+        }
+        if (i == 1) {
+            if (len == 0 || strlcpy(opts->name, opt, sizeof(opts->name)) >= sizeof(opts->name)) {
+                SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: invalid "
+                        "set name '%s'", opt);
+                return -1;
+            }
+            continue;
+        }
+
+        /* key value options */
+        char *val = opt;
+        while (*val != '\0' && !isspace((unsigned char)*val))
+            val++;
+        if (*val == '\0') {
+            SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: option '%s' "
+                    "needs a value", opt);
+            return -1;
+        }
+        *val++ = '\0';
+        while (isspace((unsigned char)*val))
+            val++;
+
+        if (strcmp(opt, "type") == 0) {
+            opts->type = DatasetGetTypeFromString(val);
+            if (opts->type == DATASET_TYPE_NOTSET) {
+                SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: unknown "
+                        "type '%s'", val);
+                return -1;
+            }
+        } else if (strcmp(opt, "load") == 0) {
+            strlcpy(opts->load, val, sizeof(opts->load));
+        } else if (strcmp(opt, "memcap") == 0) {
+            if (ParseSizeStringU64(val, &opts->memcap) < 0) {
+                SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: invalid "
+                        "memcap '%s'", val);
+                return -1;
+            }
+        } else if (strcmp(opt, "hashsize") == 0) {
+            if (ParseSizeStringU32(val, &opts->hashsize) < 0) {
+                SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: invalid "
+                        "hashsize '%s'", val);
+                return -1;
+            }
+        } else {
+            SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: unknown "
+                    "option '%s'", opt);
+            return -1;
+        }
+    }
+
+    if (i < 2) {
+        SCLogError(SC_ERR_INVALID_RULE_ARGUMENT, "dataset: expected "
+                "'<isset|isnotset>,<name>'");
+        return -1;
+    }
+    return 0;
+}
+
+static int DetectDatasetSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
+{
+    SCEnter();
+
+    int list = s->init_data->list;
+    if (list == DETECT_SM_LIST_NOTSET) {
+        SCLogError(SC_ERR_INVALID_SIGNATURE, "dataset must be set after "
+                "a sticky buffer");
+        SCReturnInt(-1);
+    }
+
+    DetectDatasetOpts opts;
+    if (DetectDatasetParse(rawstr, &opts) < 0)
+        SCReturnInt(-1);
+
+    Dataset *set = DatasetGet(opts.name, opts.type,
+            opts.load[0] != '\0' ? opts.load : NULL, opts.memcap, opts.hashsize);
+    if (set == NULL)
+        SCReturnInt(-1);
+
+    DetectDatasetData *cd = SCCalloc(1, sizeof(*cd));
+    if (unlikely(cd == NULL))
+        SCReturnInt(-1);
+    cd->set = set;
+    cd->cmd = opts.cmd;
+
+    SigMatch *sm = SigMatchAlloc();
+    if (sm == NULL) {
+        DetectDatasetFree(cd);
+        SCReturnInt(-1);
+    }
+    sm->type = DETECT_DATASET;
+    sm->ctx = (SigMatchCtx *)cd;
+    SigMatchAppendSMToList(s, sm, list);
+    SCReturnInt(0);
+}
+
+static void DetectDatasetFree (void *ptr)
+{
+    /* the set itself is owned by the datasets code */
+    if (ptr != NULL)
+        SCFree(ptr);
+}
+
+#ifdef UNITTESTS
+#include "tests/detect-dataset.c"
+#endif
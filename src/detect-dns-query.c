@@ -238,9 +238,8 @@ static void PrefilterTxDnsQuery(DetectEngineThreadCtx *det_ctx,
             break;
 
         if (buffer->inspect_len >= mpm_ctx->minlen) {
-            (void)mpm_table[mpm_ctx->mpm_type].Search(mpm_ctx,
-                    &det_ctx->mtcu, &det_ctx->pmq,
-                    buffer->inspect, buffer->inspect_len);
+            PrefilterVectorAdd(det_ctx, mpm_ctx,
+                    buffer->inspect, buffer->inspect_len, local_id);
         }
 
         local_id++;
@@ -255,13 +254,13 @@ static void PrefilterTxDnsQuery(DetectEngineThreadCtx *det_ctx,
                 f, &cbdata, list_id, true);
 
         if (buffer != NULL && buffer->inspect_len >= mpm_ctx->minlen) {
-            (void)mpm_table[mpm_ctx->mpm_type].Search(mpm_ctx,
-                    &det_ctx->mtcu, &det_ctx->pmq,
-                    buffer->inspect, buffer->inspect_len);
+            PrefilterVectorAdd(det_ctx, mpm_ctx,
+                    buffer->inspect, buffer->inspect_len, local_id);
         }
         local_id++;
     }
 #endif
+    PrefilterVectorSearch(det_ctx, mpm_ctx);
 }
 
 static void PrefilterMpmDnsQueryFree(void *ptr)
@@ -27,6 +27,7 @@
 #include "detect-engine-siggroup.h"
 #include "detect-engine-port.h"
 #include "detect-engine-prefilter.h"
+#include "detect-engine-prefilter-pcre.h"
 #include "detect-engine-proto.h"
 
 #include "detect-dsize.h"
@@ -1379,11 +1380,24 @@ int SigAddressPrepareStage1(DetectEngineCtx *de_ctx)
             int i;
             int prefilter_list = DETECT_TBLSIZE;
 
+            /* pcre is the only keyword here that looks at the payload, so
+             * it's preferred over the header keywords. It's picked here
+             * as not every pcre of the rule may be usable. */
+            SigMatch *pcre_sm = PrefilterPcreGetSm(de_ctx, tmp_s);
+            if (pcre_sm != NULL) {
+                tmp_s->init_data->prefilter_sm = pcre_sm;
+                tmp_s->flags |= SIG_FLAG_PREFILTER;
+                SCLogConfig("sid %u: prefilter is on \"%s\"", tmp_s->id,
+                        sigmatch_table[DETECT_PCRE].name);
+            }
+
             /* get the keyword supporting prefilter with the lowest type */
-            for (i = 0; i < (int)tmp_s->init_data->smlists_array_size; i++) {
+            for (i = 0; pcre_sm == NULL &&
+                    i < (int)tmp_s->init_data->smlists_array_size; i++) {
                 SigMatch *sm = tmp_s->init_data->smlists[i];
                 while (sm != NULL) {
-                    if (sigmatch_table[sm->type].SupportsPrefilter != NULL) {
+                    if (sm->type != DETECT_PCRE &&
+                            sigmatch_table[sm->type].SupportsPrefilter != NULL) {
                         if (sigmatch_table[sm->type].SupportsPrefilter(tmp_s) == TRUE) {
                             prefilter_list = MIN(prefilter_list, sm->type);
                         }
@@ -1931,6 +1945,10 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
         exit(EXIT_FAILURE);
     }
 
+#ifdef BENCHMARKS
+    MpmStoreBenchmark(de_ctx);
+#endif
+
     if (SigMatchPrepare(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
@@ -42,6 +42,7 @@
 #include "detect-uricontent.h"
 #include "detect-urilen.h"
 #include "detect-bsize.h"
+#include "detect-dataset.h"
 #include "detect-lua.h"
 #include "detect-base64-decode.h"
 #include "detect-base64-data.h"
@@ -545,6 +546,17 @@ int DetectEngineContentInspection(DetectEngineCtx *de_ctx, DetectEngineThreadCtx
         }
         goto match;
 
+    } else if (smd->type == DETECT_DATASET) {
+
+        /* sets hold whole values, so only the complete buffer is checked */
+        if (stream_start_offset != 0 || !(flags & DETECT_CI_FLAGS_END))
+            goto no_match;
+
+        const DetectDatasetData *sd = (const DetectDatasetData *)smd->ctx;
+        if (DetectDatasetBufferMatch(det_ctx, sd, buffer, buffer_len) != 1)
+            goto no_match;
+        goto match;
+
     } else if (smd->type == DETECT_AL_URILEN) {
         SCLogDebug("inspecting uri len");
 
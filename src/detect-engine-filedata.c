@@ -230,11 +230,12 @@ static void PrefilterTxFiledata(DetectEngineThreadCtx *det_ctx,
                 continue;
 
             if (buffer->inspect_len >= mpm_ctx->minlen) {
-                (void)mpm_table[mpm_ctx->mpm_type].Search(mpm_ctx,
-                        &det_ctx->mtcu, &det_ctx->pmq,
-                        buffer->inspect, buffer->inspect_len);
+                PrefilterVectorAdd(det_ctx, mpm_ctx,
+                        buffer->inspect, buffer->inspect_len, local_file_id);
             }
+            local_file_id++;
         }
+        PrefilterVectorSearch(det_ctx, mpm_ctx);
     }
 }
 
@@ -54,6 +54,8 @@
 #include "util-unittest-helper.h"
 #include "util-print.h"
 #include "util-profiling.h"
+#include "util-hashlist.h"
+#include "util-hash-lookup3.h"
 
 #ifdef OS_WIN32
 #include <winsock.h>
@@ -468,6 +470,23 @@ static void IPOnlyCIDRListPrint(IPOnlyCIDRItem *tmphead)
 }
 #endif
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/** arrays are padded to a multiple of a cache line, so they can be
+ *  intersected a full vector at a time */
+#define SIGNUMARRAY_ALIGN   64
+
+/**
+ * \brief size in 64 bit words of the SigNumArrays for max_idx
+ */
+static inline uint32_t SigNumArrayWords(uint32_t max_idx)
+{
+    const uint32_t align = SIGNUMARRAY_ALIGN / sizeof(uint64_t);
+    return ((max_idx / 64 + 1) + (align - 1)) & ~(align - 1);
+}
+
 /**
  * \brief This function print a SigNumArray, it's used with the
  *        radix tree print function to help debugging
@@ -479,12 +498,12 @@ static void SigNumArrayPrint(void *tmp)
     uint32_t u;
 
     for (u = 0; u < sna->size; u++) {
-        uint8_t bitarray = sna->array[u];
+        uint64_t bitarray = sna->array[u];
         uint8_t i = 0;
 
-        for (; i < 8; i++) {
+        for (; i < 64; i++) {
             if (bitarray & 0x01)
-                printf(", %"PRIu32"", u * 8 + i);
+                printf(", %"PRIu32"", u * 64 + i);
             else
                 printf(", ");
 
@@ -512,13 +531,14 @@ static SigNumArray *SigNumArrayNew(DetectEngineCtx *de_ctx,
     }
     memset(new, 0, sizeof(SigNumArray));
 
-    new->array = SCMalloc(io_ctx->max_idx / 8 + 1);
+    new->size = SigNumArrayWords(io_ctx->max_idx);
+    new->array = SCMallocAligned(new->size * sizeof(uint64_t), SIGNUMARRAY_ALIGN);
     if (new->array == NULL) {
        exit(EXIT_FAILURE);
     }
 
-    memset(new->array, 0, io_ctx->max_idx / 8 + 1);
-    new->size = io_ctx->max_idx / 8 + 1;
+    memset(new->array, 0, new->size * sizeof(uint64_t));
+    new->refcnt = 1;
 
     SCLogDebug("max idx= %u", io_ctx->max_idx);
 
@@ -545,12 +565,13 @@ static SigNumArray *SigNumArrayCopy(SigNumArray *orig)
     memset(new, 0, sizeof(SigNumArray));
     new->size = orig->size;
 
-    new->array = SCMalloc(orig->size);
+    new->array = SCMallocAligned(orig->size * sizeof(uint64_t), SIGNUMARRAY_ALIGN);
     if (new->array == NULL) {
         exit(EXIT_FAILURE);
     }
 
-    memcpy(new->array, orig->array, orig->size);
+    memcpy(new->array, orig->array, orig->size * sizeof(uint64_t));
+    new->refcnt = 1;
     return new;
 }
 
@@ -565,12 +586,115 @@ static void SigNumArrayFree(void *tmp)
     if (sna == NULL)
         return;
 
+    /* shared after IPOnlyPrepare deduplicated the arrays */
+    if (--sna->refcnt > 0)
+        return;
+
     if (sna->array != NULL)
-        SCFree(sna->array);
+        SCFreeAligned(sna->array);
 
     SCFree(sna);
 }
 
+static uint32_t SigNumArrayHashFunc(HashListTable *ht, void *data, uint16_t datalen)
+{
+    const SigNumArray *sna = (SigNumArray *)data;
+    return hashlittle_safe(sna->array, sna->size * sizeof(uint64_t), 0) % ht->array_size;
+}
+
+static char SigNumArrayCompareFunc(void *data1, uint16_t len1, void *data2, uint16_t len2)
+{
+    const SigNumArray *sna1 = (SigNumArray *)data1;
+    const SigNumArray *sna2 = (SigNumArray *)data2;
+
+    return (sna1->size == sna2->size &&
+            memcmp(sna1->array, sna2->array, sna1->size * sizeof(uint64_t)) == 0);
+}
+
+/**
+ * \brief Replace the SigNumArrays of a radix tree by the identical
+ *        array already in the hash, if any.
+ *
+ * \retval cnt number of arrays freed
+ */
+static uint32_t SigNumArrayDedupTree(HashListTable *ht, SCRadixNode *node)
+{
+    uint32_t cnt = 0;
+
+    for ( ; node != NULL; node = node->right) {
+        if (node->prefix != NULL) {
+            SCRadixUserData *ud;
+            for (ud = node->prefix->user_data; ud != NULL; ud = ud->next) {
+                SigNumArray *sna = (SigNumArray *)ud->user;
+                if (sna == NULL)
+                    continue;
+
+                SigNumArray *found = HashListTableLookup(ht, sna, 0);
+                if (found == NULL) {
+                    if (HashListTableAdd(ht, sna, 0) != 0)
+                        return cnt;
+                } else if (found != sna) {
+                    found->refcnt++;
+                    ud->user = found;
+                    SigNumArrayFree(sna);
+                    cnt++;
+                }
+            }
+        }
+        cnt += SigNumArrayDedupTree(ht, node->left);
+    }
+    return cnt;
+}
+
+/**
+ * \brief Share identical SigNumArrays between all radix tree entries
+ *
+ * Large lists of addresses in the same rules (e.g. blocklists) result
+ * in many entries with the same set of signatures.
+ */
+static void IPOnlyDedupSigNumArrays(DetectEngineIPOnlyCtx *io_ctx)
+{
+    HashListTable *ht = HashListTableInit(4096, SigNumArrayHashFunc,
+                                          SigNumArrayCompareFunc, NULL);
+    if (ht == NULL)
+        return;
+
+    uint32_t cnt = 0;
+    if (io_ctx->tree_ipv4src != NULL)
+        cnt += SigNumArrayDedupTree(ht, io_ctx->tree_ipv4src->head);
+    if (io_ctx->tree_ipv4dst != NULL)
+        cnt += SigNumArrayDedupTree(ht, io_ctx->tree_ipv4dst->head);
+    if (io_ctx->tree_ipv6src != NULL)
+        cnt += SigNumArrayDedupTree(ht, io_ctx->tree_ipv6src->head);
+    if (io_ctx->tree_ipv6dst != NULL)
+        cnt += SigNumArrayDedupTree(ht, io_ctx->tree_ipv6dst->head);
+
+    SCLogDebug("%u duplicate sig num arrays freed", cnt);
+    HashListTableFree(ht);
+}
+
+/**
+ * \brief intersect the src and dst arrays
+ *
+ * The arrays are SIGNUMARRAY_ALIGN aligned and padded.
+ */
+static inline void SigNumArrayAnd(uint64_t *res, const uint64_t *a,
+                                  const uint64_t *b, const uint32_t size)
+{
+    uint32_t u;
+#if defined(__AVX2__)
+    for (u = 0; u < size; u += 4) {
+        __m256i va = _mm256_load_si256((const __m256i *)(a + u));
+        __m256i vb = _mm256_load_si256((const __m256i *)(b + u));
+        _mm256_store_si256((__m256i *)(res + u), _mm256_and_si256(va, vb));
+    }
+#else
+    for (u = 0; u < size; u++) {
+        res[u] = a[u] & b[u];
+    }
+#endif
+}
+
 /**
  * \brief This function parses and return a list of IPOnlyCIDRItem
  *
@@ -876,13 +1000,14 @@ void DetectEngineIPOnlyThreadInit(DetectEngineCtx *de_ctx,
                                   DetectEngineIPOnlyThreadCtx *io_tctx)
 {
     /* initialize the signature bitarray */
-    io_tctx->sig_match_size = de_ctx->io_ctx.max_idx / 8 + 1;
-    io_tctx->sig_match_array = SCMalloc(io_tctx->sig_match_size);
+    io_tctx->sig_match_size = SigNumArrayWords(de_ctx->io_ctx.max_idx);
+    io_tctx->sig_match_array = SCMallocAligned(io_tctx->sig_match_size * sizeof(uint64_t),
+                                               SIGNUMARRAY_ALIGN);
     if (io_tctx->sig_match_array == NULL) {
         exit(EXIT_FAILURE);
     }
 
-    memset(io_tctx->sig_match_array, 0, io_tctx->sig_match_size);
+    memset(io_tctx->sig_match_array, 0, io_tctx->sig_match_size * sizeof(uint64_t));
 }
 
 /**
@@ -924,6 +1049,15 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx)
         SCRadixReleaseRadixTree(io_ctx->tree_ipv6dst);
     io_ctx->tree_ipv6dst = NULL;
 
+    SCLpmFree(io_ctx->lpm_ipv4src);
+    io_ctx->lpm_ipv4src = NULL;
+    SCLpmFree(io_ctx->lpm_ipv4dst);
+    io_ctx->lpm_ipv4dst = NULL;
+    SCLpmFree(io_ctx->lpm_ipv6src);
+    io_ctx->lpm_ipv6src = NULL;
+    SCLpmFree(io_ctx->lpm_ipv6dst);
+    io_ctx->lpm_ipv6dst = NULL;
+
     if (io_ctx->sig_init_array)
         SCFree(io_ctx->sig_init_array);
     io_ctx->sig_init_array = NULL;
@@ -937,7 +1071,9 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx)
  */
 void DetectEngineIPOnlyThreadDeinit(DetectEngineIPOnlyThreadCtx *io_tctx)
 {
-    SCFree(io_tctx->sig_match_array);
+    if (io_tctx->sig_match_array != NULL)
+        SCFreeAligned(io_tctx->sig_match_array);
+    io_tctx->sig_match_array = NULL;
 }
 
 static inline
@@ -984,18 +1120,34 @@ void IPOnlyMatchPacket(ThreadVars *tv,
     void *user_data_src = NULL, *user_data_dst = NULL;
 
     if (p->src.family == AF_INET) {
-        (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&GET_IPV4_SRC_ADDR_U32(p),
+        if (io_ctx->lpm_ipv4src != NULL)
+            user_data_src = SCLpmLookup(io_ctx->lpm_ipv4src,
+                                        (uint8_t *)&GET_IPV4_SRC_ADDR_U32(p));
+        else
+            (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&GET_IPV4_SRC_ADDR_U32(p),
                                               io_ctx->tree_ipv4src, &user_data_src);
     } else if (p->src.family == AF_INET6) {
-        (void)SCRadixFindKeyIPV6BestMatch((uint8_t *)&GET_IPV6_SRC_ADDR(p),
+        if (io_ctx->lpm_ipv6src != NULL)
+            user_data_src = SCLpmLookup(io_ctx->lpm_ipv6src,
+                                        (uint8_t *)&GET_IPV6_SRC_ADDR(p));
+        else
+            (void)SCRadixFindKeyIPV6BestMatch((uint8_t *)&GET_IPV6_SRC_ADDR(p),
                                               io_ctx->tree_ipv6src, &user_data_src);
     }
 
     if (p->dst.family == AF_INET) {
-        (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&GET_IPV4_DST_ADDR_U32(p),
+        if (io_ctx->lpm_ipv4dst != NULL)
+            user_data_dst = SCLpmLookup(io_ctx->lpm_ipv4dst,
+                                        (uint8_t *)&GET_IPV4_DST_ADDR_U32(p));
+        else
+            (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&GET_IPV4_DST_ADDR_U32(p),
                                               io_ctx->tree_ipv4dst, &user_data_dst);
     } else if (p->dst.family == AF_INET6) {
-        (void)SCRadixFindKeyIPV6BestMatch((uint8_t *)&GET_IPV6_DST_ADDR(p),
+        if (io_ctx->lpm_ipv6dst != NULL)
+            user_data_dst = SCLpmLookup(io_ctx->lpm_ipv6dst,
+                                        (uint8_t *)&GET_IPV6_DST_ADDR(p));
+        else
+            (void)SCRadixFindKeyIPV6BestMatch((uint8_t *)&GET_IPV6_DST_ADDR(p),
                                               io_ctx->tree_ipv6dst, &user_data_dst);
     }
 
@@ -1005,101 +1157,97 @@ void IPOnlyMatchPacket(ThreadVars *tv,
     if (src == NULL || dst == NULL)
         return;
 
+    /* The final results will be at io_tctx */
+    uint64_t *res = io_tctx->sig_match_array;
+    SigNumArrayAnd(res, src->array, dst->array, src->size);
+
     uint32_t u;
     for (u = 0; u < src->size; u++) {
-        SCLogDebug("And %"PRIu8" & %"PRIu8, src->array[u], dst->array[u]);
-
-        /* The final results will be at io_tctx */
-        io_tctx->sig_match_array[u] = dst->array[u] & src->array[u];
-
         /* We have to move the logic of the signature checking
          * to the main detect loop, in order to apply the
          * priority of actions (pass, drop, reject, alert) */
-        if (io_tctx->sig_match_array[u] != 0) {
+        uint64_t bitarray = res[u];
+        while (bitarray != 0) {
             /* We have a match :) Let's see from which signum's */
-            uint8_t bitarray = io_tctx->sig_match_array[u];
-            uint8_t i = 0;
+            const uint32_t i = __builtin_ctzll(bitarray);
+            bitarray &= bitarray - 1;
 
-            for (; i < 8; i++, bitarray = bitarray >> 1) {
-                if (bitarray & 0x01) {
-                    Signature *s = de_ctx->sig_array[u * 8 + i];
+            Signature *s = de_ctx->sig_array[u * 64 + i];
 
-                    if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
-                    if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
+            if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
+                SCLogDebug("ip version didn't match");
+                continue;
+            }
+            if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
+                SCLogDebug("ip version didn't match");
+                continue;
+            }
 
-                    if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
-                        SCLogDebug("proto didn't match");
+            if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
+                SCLogDebug("proto didn't match");
+                continue;
+            }
+
+            /* check the source & dst port in the sig */
+            if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
+                if (!(s->flags & SIG_FLAG_DP_ANY)) {
+                    if (p->flags & PKT_IS_FRAGMENT)
                         continue;
-                    }
 
-                    /* check the source & dst port in the sig */
-                    if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
-                        if (!(s->flags & SIG_FLAG_DP_ANY)) {
-                            if (p->flags & PKT_IS_FRAGMENT)
-                                continue;
-
-                            DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
-                            if (dport == NULL) {
-                                SCLogDebug("dport didn't match.");
-                                continue;
-                            }
-                        }
-                        if (!(s->flags & SIG_FLAG_SP_ANY)) {
-                            if (p->flags & PKT_IS_FRAGMENT)
-                                continue;
-
-                            DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
-                            if (sport == NULL) {
-                                SCLogDebug("sport didn't match.");
-                                continue;
-                            }
-                        }
-                    } else if ((s->flags & (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) != (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) {
-                        SCLogDebug("port-less protocol and sig needs ports");
+                    DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
+                    if (dport == NULL) {
+                        SCLogDebug("dport didn't match.");
                         continue;
                     }
+                }
+                if (!(s->flags & SIG_FLAG_SP_ANY)) {
+                    if (p->flags & PKT_IS_FRAGMENT)
+                        continue;
 
-                    if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
+                    DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
+                    if (sport == NULL) {
+                        SCLogDebug("sport didn't match.");
                         continue;
                     }
+                }
+            } else if ((s->flags & (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) != (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) {
+                SCLogDebug("port-less protocol and sig needs ports");
+                continue;
+            }
 
-                    SCLogDebug("Signum %"PRIu16" match (sid: %"PRIu16", msg: %s)",
-                               u * 8 + i, s->id, s->msg);
-
-                    if (s->sm_arrays[DETECT_SM_LIST_POSTMATCH] != NULL) {
-                        KEYWORD_PROFILING_SET_LIST(det_ctx, DETECT_SM_LIST_POSTMATCH);
-                        SigMatchData *smd = s->sm_arrays[DETECT_SM_LIST_POSTMATCH];
-
-                        SCLogDebug("running match functions, sm %p", smd);
-
-                        if (smd != NULL) {
-                            while (1) {
-                                KEYWORD_PROFILING_START;
-                                (void)sigmatch_table[smd->type].Match(tv, det_ctx, p, s, smd->ctx);
-                                KEYWORD_PROFILING_END(det_ctx, smd->type, 1);
-                                if (smd->is_last)
-                                    break;
-                                smd++;
-                            }
-                        }
-                    }
-                    if (!(s->flags & SIG_FLAG_NOALERT)) {
-                        if (s->action & ACTION_DROP)
-                            PacketAlertAppend(det_ctx, s, p, 0, PACKET_ALERT_FLAG_DROP_FLOW);
-                        else
-                            PacketAlertAppend(det_ctx, s, p, 0, 0);
-                    } else {
-                        /* apply actions for noalert/rule suppressed as well */
-                        DetectSignatureApplyActions(p, s, 0);
+            if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
+                continue;
+            }
+
+            SCLogDebug("Signum %"PRIu32" match (sid: %"PRIu32", msg: %s)",
+                       u * 64 + i, s->id, s->msg);
+
+            if (s->sm_arrays[DETECT_SM_LIST_POSTMATCH] != NULL) {
+                KEYWORD_PROFILING_SET_LIST(det_ctx, DETECT_SM_LIST_POSTMATCH);
+                SigMatchData *smd = s->sm_arrays[DETECT_SM_LIST_POSTMATCH];
+
+                SCLogDebug("running match functions, sm %p", smd);
+
+                if (smd != NULL) {
+                    while (1) {
+                        KEYWORD_PROFILING_START;
+                        (void)sigmatch_table[smd->type].Match(tv, det_ctx, p, s, smd->ctx);
+                        KEYWORD_PROFILING_END(det_ctx, smd->type, 1);
+                        if (smd->is_last)
+                            break;
+                        smd++;
                     }
                 }
             }
+            if (!(s->flags & SIG_FLAG_NOALERT)) {
+                if (s->action & ACTION_DROP)
+                    PacketAlertAppend(det_ctx, s, p, 0, PACKET_ALERT_FLAG_DROP_FLOW);
+                else
+                    PacketAlertAppend(det_ctx, s, p, 0, 0);
+            } else {
+                /* apply actions for noalert/rule suppressed as well */
+                DetectSignatureApplyActions(p, s, 0);
+            }
         }
     }
 }
@@ -1160,14 +1308,14 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     SigNumArray *sna = SigNumArrayNew(de_ctx, &de_ctx->io_ctx);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (src->signum % 8);
+                    uint64_t tmp = 1ULL << (src->signum % 64);
 
                     if (src->negated > 0)
                         /* Unset it */
-                        sna->array[src->signum / 8] &= ~tmp;
+                        sna->array[src->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[src->signum / 8] |= tmp;
+                        sna->array[src->signum / 64] |= tmp;
 
                     if (src->netmask == 32)
                         node = SCRadixAddKeyIPV4((uint8_t *)&src->ip[0],
@@ -1188,14 +1336,14 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     sna = SigNumArrayCopy((SigNumArray *) user_data);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (src->signum % 8);
+                    uint64_t tmp = 1ULL << (src->signum % 64);
 
                     if (src->negated > 0)
                         /* Unset it */
-                        sna->array[src->signum / 8] &= ~tmp;
+                        sna->array[src->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[src->signum / 8] |= tmp;
+                        sna->array[src->signum / 64] |= tmp;
 
                     if (src->netmask == 32)
                         node = SCRadixAddKeyIPV4((uint8_t *)&src->ip[0],
@@ -1221,14 +1369,14 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                 SigNumArray *sna = (SigNumArray *)user_data;
 
                 /* Update the sig */
-                uint8_t tmp = 1 << (src->signum % 8);
+                uint64_t tmp = 1ULL << (src->signum % 64);
 
                 if (src->negated > 0)
                     /* Unset it */
-                    sna->array[src->signum / 8] &= ~tmp;
+                    sna->array[src->signum / 64] &= ~tmp;
                 else
                     /* Set it */
-                    sna->array[src->signum / 8] |= tmp;
+                    sna->array[src->signum / 64] |= tmp;
             }
         } else if (src->family == AF_INET6) {
             SCLogDebug("To IPv6");
@@ -1254,14 +1402,14 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     SigNumArray *sna = SigNumArrayNew(de_ctx, &de_ctx->io_ctx);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (src->signum % 8);
+                    uint64_t tmp = 1ULL << (src->signum % 64);
 
                     if (src->negated > 0)
                         /* Unset it */
-                        sna->array[src->signum / 8] &= ~tmp;
+                        sna->array[src->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[src->signum / 8] |= tmp;
+                        sna->array[src->signum / 64] |= tmp;
 
                     if (src->netmask == 128)
                         node = SCRadixAddKeyIPV6((uint8_t *)&src->ip[0],
@@ -1279,13 +1427,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     sna = SigNumArrayCopy((SigNumArray *)user_data);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (src->signum % 8);
+                    uint64_t tmp = 1ULL << (src->signum % 64);
                     if (src->negated > 0)
                         /* Unset it */
-                        sna->array[src->signum / 8] &= ~tmp;
+                        sna->array[src->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[src->signum / 8] |= tmp;
+                        sna->array[src->signum / 64] |= tmp;
 
                     if (src->netmask == 128)
                         node = SCRadixAddKeyIPV6((uint8_t *)&src->ip[0],
@@ -1303,13 +1451,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                 SigNumArray *sna = (SigNumArray *)user_data;
 
                 /* Update the sig */
-                uint8_t tmp = 1 << (src->signum % 8);
+                uint64_t tmp = 1ULL << (src->signum % 64);
                 if (src->negated > 0)
                     /* Unset it */
-                    sna->array[src->signum / 8] &= ~tmp;
+                    sna->array[src->signum / 64] &= ~tmp;
                 else
                     /* Set it */
-                    sna->array[src->signum / 8] |= tmp;
+                    sna->array[src->signum / 64] |= tmp;
             }
         }
         IPOnlyCIDRItem *tmpaux = src;
@@ -1356,13 +1504,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     SigNumArray *sna = SigNumArrayNew(de_ctx, &de_ctx->io_ctx);
 
                     /** Update the sig */
-                    uint8_t tmp = 1 << (dst->signum % 8);
+                    uint64_t tmp = 1ULL << (dst->signum % 64);
                     if (dst->negated > 0)
                         /** Unset it */
-                        sna->array[dst->signum / 8] &= ~tmp;
+                        sna->array[dst->signum / 64] &= ~tmp;
                     else
                         /** Set it */
-                        sna->array[dst->signum / 8] |= tmp;
+                        sna->array[dst->signum / 64] |= tmp;
 
                     if (dst->netmask == 32)
                         node = SCRadixAddKeyIPV4((uint8_t *)&dst->ip[0],
@@ -1383,13 +1531,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     sna = SigNumArrayCopy((SigNumArray *) user_data);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (dst->signum % 8);
+                    uint64_t tmp = 1ULL << (dst->signum % 64);
                     if (dst->negated > 0)
                         /* Unset it */
-                        sna->array[dst->signum / 8] &= ~tmp;
+                        sna->array[dst->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[dst->signum / 8] |= tmp;
+                        sna->array[dst->signum / 64] |= tmp;
 
                     if (dst->netmask == 32)
                         node = SCRadixAddKeyIPV4((uint8_t *)&dst->ip[0],
@@ -1410,13 +1558,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                 SigNumArray *sna = (SigNumArray *)user_data;
 
                 /* Update the sig */
-                uint8_t tmp = 1 << (dst->signum % 8);
+                uint64_t tmp = 1ULL << (dst->signum % 64);
                 if (dst->negated > 0)
                     /* Unset it */
-                    sna->array[dst->signum / 8] &= ~tmp;
+                    sna->array[dst->signum / 64] &= ~tmp;
                 else
                     /* Set it */
-                    sna->array[dst->signum / 8] |= tmp;
+                    sna->array[dst->signum / 64] |= tmp;
             }
         } else if (dst->family == AF_INET6) {
             SCLogDebug("To IPv6");
@@ -1444,13 +1592,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     SigNumArray *sna = SigNumArrayNew(de_ctx, &de_ctx->io_ctx);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (dst->signum % 8);
+                    uint64_t tmp = 1ULL << (dst->signum % 64);
                     if (dst->negated > 0)
                         /* Unset it */
-                        sna->array[dst->signum / 8] &= ~tmp;
+                        sna->array[dst->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[dst->signum / 8] |= tmp;
+                        sna->array[dst->signum / 64] |= tmp;
 
                     if (dst->netmask == 128)
                         node = SCRadixAddKeyIPV6((uint8_t *)&dst->ip[0],
@@ -1469,13 +1617,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                     sna = SigNumArrayCopy((SigNumArray *)user_data);
 
                     /* Update the sig */
-                    uint8_t tmp = 1 << (dst->signum % 8);
+                    uint64_t tmp = 1ULL << (dst->signum % 64);
                     if (dst->negated > 0)
                         /* Unset it */
-                        sna->array[dst->signum / 8] &= ~tmp;
+                        sna->array[dst->signum / 64] &= ~tmp;
                     else
                         /* Set it */
-                        sna->array[dst->signum / 8] |= tmp;
+                        sna->array[dst->signum / 64] |= tmp;
 
                     if (dst->netmask == 128)
                         node = SCRadixAddKeyIPV6((uint8_t *)&dst->ip[0],
@@ -1494,13 +1642,13 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
                 SigNumArray *sna = (SigNumArray *)user_data;
 
                 /* Update the sig */
-                uint8_t tmp = 1 << (dst->signum % 8);
+                uint64_t tmp = 1ULL << (dst->signum % 64);
                 if (dst->negated > 0)
                     /* Unset it */
-                    sna->array[dst->signum / 8] &= ~tmp;
+                    sna->array[dst->signum / 64] &= ~tmp;
                 else
                     /* Set it */
-                    sna->array[dst->signum / 8] |= tmp;
+                    sna->array[dst->signum / 64] |= tmp;
             }
         }
         IPOnlyCIDRItem *tmpaux = dst;
@@ -1508,6 +1656,14 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
         SCFree(tmpaux);
     }
 
+    IPOnlyDedupSigNumArrays(&de_ctx->io_ctx);
+
+    /* the trees are complete: compile the lookup tables */
+    (de_ctx->io_ctx).lpm_ipv4src = SCLpmCreateFromRadixTree((de_ctx->io_ctx).tree_ipv4src, AF_INET);
+    (de_ctx->io_ctx).lpm_ipv4dst = SCLpmCreateFromRadixTree((de_ctx->io_ctx).tree_ipv4dst, AF_INET);
+    (de_ctx->io_ctx).lpm_ipv6src = SCLpmCreateFromRadixTree((de_ctx->io_ctx).tree_ipv6src, AF_INET6);
+    (de_ctx->io_ctx).lpm_ipv6dst = SCLpmCreateFromRadixTree((de_ctx->io_ctx).tree_ipv6dst, AF_INET6);
+
     /* print all the trees: for debuggin it might print too much info
     SCLogDebug("Radix tree src ipv4:");
     SCRadixPrintTree((de_ctx->io_ctx).tree_ipv4src);
@@ -2252,6 +2408,60 @@ static int IPOnlyTestSig17(void)
     return result;
 }
 
+/**
+ * \test more than 64 sigs and sharing of identical sig num arrays
+ */
+static int IPOnlyTestSig18(void)
+{
+    uint8_t *buf = (uint8_t *)"Hi all!";
+    uint16_t buflen = strlen((char *)buf);
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    char sig[128];
+    uint32_t i;
+
+    memset(&tv, 0, sizeof(tv));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    for (i = 1; i < 70; i++) {
+        snprintf(sig, sizeof(sig), "alert ip [10.0.0.1,10.0.0.2] any -> "
+                "172.16.0.1 any (sid:%u;)", i);
+        FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, sig));
+    }
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert ip [10.0.0.1,10.0.0.2] "
+                "any -> 192.168.1.1 any (sid:70;)"));
+    FAIL_IF(SigGroupBuild(de_ctx) < 0);
+
+    void *user1 = NULL, *user2 = NULL;
+    struct in_addr a;
+    inet_pton(AF_INET, "10.0.0.1", &a);
+    (void)SCRadixFindKeyIPV4ExactMatch((uint8_t *)&a,
+            de_ctx->io_ctx.tree_ipv4src, &user1);
+    inet_pton(AF_INET, "10.0.0.2", &a);
+    (void)SCRadixFindKeyIPV4ExactMatch((uint8_t *)&a,
+            de_ctx->io_ctx.tree_ipv4src, &user2);
+    FAIL_IF_NULL(user1);
+    FAIL_IF_NOT(user1 == user2);
+    FAIL_IF(((SigNumArray *)user1)->refcnt < 2);
+
+    Packet *p = UTHBuildPacketSrcDst(buf, buflen, IPPROTO_TCP,
+            "10.0.0.2", "192.168.1.1");
+    FAIL_IF_NULL(p);
+
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 70));
+    FAIL_IF(PacketAlertCheck(p, 1));
+
+    UTHFreePackets(&p, 1);
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void IPOnlyRegisterTests(void)
@@ -2287,6 +2497,7 @@ void IPOnlyRegisterTests(void)
     UtRegisterTest("IPOnlyTestSig16", IPOnlyTestSig16);
 
     UtRegisterTest("IPOnlyTestSig17", IPOnlyTestSig17);
+    UtRegisterTest("IPOnlyTestSig18", IPOnlyTestSig18);
 #endif
 
     return;
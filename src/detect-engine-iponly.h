@@ -31,8 +31,9 @@
  * at IP Only we store SigNumArrays at the radix trees
  */
 typedef struct SigNumArray_ {
-    uint8_t *array; /* bit array of sig nums */
-    uint32_t size;  /* size in bytes of the array */
+    uint64_t *array; /* bit array of sig nums, 64 byte aligned */
+    uint32_t size;   /* size in 64 bit words of the array */
+    uint32_t refcnt; /* identical arrays are shared by the radix trees */
 } SigNumArray;
 
 void IPOnlyCIDRListFree(IPOnlyCIDRItem *tmphead);
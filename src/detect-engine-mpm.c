@@ -71,6 +71,13 @@
 #include "util-debug.h"
 #include "util-print.h"
 #include "util-validate.h"
+#ifdef BENCHMARKS
+#include "util-spm.h"
+#ifdef BUILD_HYPERSCAN
+#include "util-mpm-hs.h"
+#endif
+#include "decode-ethernet.h"
+#endif
 
 const char *builtin_mpms[] = {
     "toserver TCP packet",
@@ -1025,11 +1032,56 @@ void MpmStoreFree(DetectEngineCtx *de_ctx)
     return;
 }
 
-static void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
+/** \internal
+ *  \brief add the fast patterns of the store's signatures to a mpm ctx */
+static void MpmStoreAddPatterns(const DetectEngineCtx *de_ctx,
+        const MpmStore *ms, MpmCtx *mpm_ctx)
 {
     const Signature *s = NULL;
     uint32_t sig;
 
+    for (sig = 0; sig < (ms->sid_array_size * 8); sig++) {
+        if (ms->sid_array[sig / 8] & (1 << (sig % 8))) {
+            s = de_ctx->sig_array[sig];
+            if (s == NULL)
+                continue;
+            if ((s->flags & ms->direction) == 0)
+                continue;
+            if (s->init_data->mpm_sm == NULL)
+                continue;
+            int list = SigMatchListSMBelongsTo(s, s->init_data->mpm_sm);
+            if (list < 0)
+                continue;
+            if (list != ms->sm_list)
+                continue;
+
+            SCLogDebug("adding %u", s->id);
+
+            const DetectContentData *cd = (DetectContentData *)s->init_data->mpm_sm->ctx;
+
+            int skip = 0;
+            /* negated logic: if mpm match can't be used to be sure about this
+             * pattern, we have to inspect the rule fully regardless of mpm
+             * match. So in this case there is no point of adding it at all.
+             * The non-mpm list entry for the sig will make sure the sig is
+             * inspected. */
+            if ((cd->flags & DETECT_CONTENT_NEGATED) &&
+                !(DETECT_CONTENT_MPM_IS_CONCLUSIVE(cd)))
+            {
+                skip = 1;
+                SCLogDebug("not adding negated mpm as it's not 'single'");
+            }
+
+            if (!skip) {
+                PopulateMpmHelperAddPattern(mpm_ctx,
+                        cd, s, 0, (cd->flags & DETECT_CONTENT_FAST_PATTERN_CHOP));
+            }
+        }
+    }
+}
+
+static void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
+{
     int dir = 0;
 
     if (ms->buffer != MPMB_MAX) {
@@ -1070,44 +1122,7 @@ static void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
     MpmInitCtx(ms->mpm_ctx, de_ctx->mpm_matcher);
 
     /* add the patterns */
-    for (sig = 0; sig < (ms->sid_array_size * 8); sig++) {
-        if (ms->sid_array[sig / 8] & (1 << (sig % 8))) {
-            s = de_ctx->sig_array[sig];
-            if (s == NULL)
-                continue;
-            if ((s->flags & ms->direction) == 0)
-                continue;
-            if (s->init_data->mpm_sm == NULL)
-                continue;
-            int list = SigMatchListSMBelongsTo(s, s->init_data->mpm_sm);
-            if (list < 0)
-                continue;
-            if (list != ms->sm_list)
-                continue;
-
-            SCLogDebug("adding %u", s->id);
-
-            const DetectContentData *cd = (DetectContentData *)s->init_data->mpm_sm->ctx;
-
-            int skip = 0;
-            /* negated logic: if mpm match can't be used to be sure about this
-             * pattern, we have to inspect the rule fully regardless of mpm
-             * match. So in this case there is no point of adding it at all.
-             * The non-mpm list entry for the sig will make sure the sig is
-             * inspected. */
-            if ((cd->flags & DETECT_CONTENT_NEGATED) &&
-                !(DETECT_CONTENT_MPM_IS_CONCLUSIVE(cd)))
-            {
-                skip = 1;
-                SCLogDebug("not adding negated mpm as it's not 'single'");
-            }
-
-            if (!skip) {
-                PopulateMpmHelperAddPattern(ms->mpm_ctx,
-                        cd, s, 0, (cd->flags & DETECT_CONTENT_FAST_PATTERN_CHOP));
-            }
-        }
-    }
+    MpmStoreAddPatterns(de_ctx, ms, ms->mpm_ctx);
 
     if (ms->mpm_ctx->pattern_cnt == 0) {
         MpmFactoryReClaimMpmCtx(de_ctx, ms->mpm_ctx);
@@ -1587,3 +1602,423 @@ int DetectSetFastPatternAndItsId(DetectEngineCtx *de_ctx)
 
     return 0;
 }
+
+#ifdef BENCHMARKS
+
+#define MPM_BENCH_SYNTH_BUFS    2048
+#define MPM_BENCH_SYNTH_BUFLEN  1460
+#define MPM_BENCH_MAX_BYTES     (16 * 1024 * 1024)
+/** needles are scanned one by one, so cap their number */
+#define MPM_BENCH_SPM_NEEDLES   1000
+
+typedef struct MpmBenchBuf_ {
+    uint64_t offset;
+    uint32_t len;
+} MpmBenchBuf;
+
+typedef struct MpmBenchCorpus_ {
+    uint8_t *data;
+    uint64_t data_len;
+    MpmBenchBuf *bufs;
+    uint32_t bufs_cnt;
+} MpmBenchCorpus;
+
+typedef struct MpmBenchNeedle_ {
+    const uint8_t *content;
+    uint16_t content_len;
+    int nocase;
+} MpmBenchNeedle;
+
+static uint64_t MpmBenchUsecs(const struct timeval *start, const struct timeval *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000ULL + (end->tv_usec - start->tv_usec);
+}
+
+static uint64_t MpmBenchRand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/** \internal
+ *  \brief get the tcp or udp payload of a frame, or the whole frame if
+ *         it's not something we can parse */
+static const uint8_t *MpmBenchPayload(int datalink, const uint8_t *pkt,
+        uint32_t len, uint32_t *plen)
+{
+    const uint8_t *p = pkt;
+    uint32_t left = len;
+    uint8_t proto;
+
+    if (datalink == LINKTYPE_ETHERNET) {
+        if (left < 14)
+            goto whole;
+        uint16_t type = (p[12] << 8) | p[13];
+        p += 14;
+        left -= 14;
+        if (type == ETHERNET_TYPE_VLAN && left >= 4) {
+            type = (p[2] << 8) | p[3];
+            p += 4;
+            left -= 4;
+        }
+        if (type != ETHERNET_TYPE_IP && type != ETHERNET_TYPE_IPV6)
+            goto whole;
+    } else if (datalink != LINKTYPE_RAW && datalink != LINKTYPE_IPV4) {
+        goto whole;
+    }
+
+    if (left >= 20 && (p[0] >> 4) == 4) {
+        uint32_t hlen = (p[0] & 0x0f) * 4;
+        if (hlen < 20 || hlen > left)
+            goto whole;
+        proto = p[9];
+        p += hlen;
+        left -= hlen;
+    } else if (left >= 40 && (p[0] >> 4) == 6) {
+        proto = p[6];
+        p += 40;
+        left -= 40;
+    } else {
+        goto whole;
+    }
+
+    if (proto == IPPROTO_TCP && left >= 20) {
+        uint32_t hlen = (p[12] >> 4) * 4;
+        if (hlen < 20 || hlen > left)
+            goto whole;
+        p += hlen;
+        left -= hlen;
+    } else if (proto == IPPROTO_UDP && left >= 8) {
+        p += 8;
+        left -= 8;
+    } else {
+        goto whole;
+    }
+    *plen = left;
+    return p;
+
+whole:
+    *plen = len;
+    return pkt;
+}
+
+static int MpmBenchCorpusAdd(MpmBenchCorpus *c, const uint8_t *buf, uint32_t len)
+{
+    if ((c->bufs_cnt % 1024) == 0) {
+        void *ptmp = SCRealloc(c->bufs, (c->bufs_cnt + 1024) * sizeof(MpmBenchBuf));
+        if (ptmp == NULL)
+            return -1;
+        c->bufs = ptmp;
+    }
+    memcpy(c->data + c->data_len, buf, len);
+    c->bufs[c->bufs_cnt].offset = c->data_len;
+    c->bufs[c->bufs_cnt].len = len;
+    c->bufs_cnt++;
+    c->data_len += len;
+    return 0;
+}
+
+/** \internal
+ *  \brief load the tcp and udp payloads of a pcap, up to
+ *         MPM_BENCH_MAX_BYTES */
+static int MpmBenchCorpusLoadPcap(MpmBenchCorpus *c, const char *file)
+{
+    char errbuf[PCAP_ERRBUF_SIZE] = "";
+    pcap_t *pcap = pcap_open_offline(file, errbuf);
+    if (pcap == NULL) {
+        SCLogError(SC_ERR_PCAP_OPEN_OFFLINE, "mpm bench: failed to open "
+                "%s: %s", file, errbuf);
+        return -1;
+    }
+    const int datalink = pcap_datalink(pcap);
+
+    c->data = SCMalloc(MPM_BENCH_MAX_BYTES);
+    if (c->data == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "mpm bench: failed to allocate "
+                "the corpus buffer");
+        pcap_close(pcap);
+        return -1;
+    }
+
+    struct pcap_pkthdr *h = NULL;
+    const u_char *pkt = NULL;
+    while (pcap_next_ex(pcap, &h, &pkt) == 1) {
+        uint32_t len = 0;
+        const uint8_t *payload = MpmBenchPayload(datalink, pkt, h->caplen, &len);
+        if (len == 0)
+            continue;
+        if (c->data_len + len > MPM_BENCH_MAX_BYTES)
+            break;
+        if (MpmBenchCorpusAdd(c, payload, len) < 0)
+            break;
+    }
+    pcap_close(pcap);
+
+    if (c->bufs_cnt == 0) {
+        SCLogError(SC_ERR_PCAP_OPEN_OFFLINE, "mpm bench: no tcp or udp "
+                "payloads in %s", file);
+        return -1;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief printable noise, with a rule pattern planted in every 8th buffer
+ *         so the match paths get some exercise too */
+static int MpmBenchCorpusSynthetic(MpmBenchCorpus *c,
+        const MpmBenchNeedle *needles, uint32_t needles_cnt)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint8_t buf[MPM_BENCH_SYNTH_BUFLEN];
+
+    c->data = SCMalloc(MPM_BENCH_SYNTH_BUFS * MPM_BENCH_SYNTH_BUFLEN);
+    if (c->data == NULL)
+        return -1;
+
+    for (uint32_t i = 0; i < MPM_BENCH_SYNTH_BUFS; i++) {
+        for (uint32_t u = 0; u < sizeof(buf); u++)
+            buf[u] = 0x20 + (MpmBenchRand(&state) % 95);
+        if (needles_cnt > 0 && (i % 8) == 0) {
+            const MpmBenchNeedle *n = &needles[MpmBenchRand(&state) % needles_cnt];
+            if (n->content_len <= sizeof(buf)) {
+                uint32_t off = MpmBenchRand(&state) % (sizeof(buf) - n->content_len + 1);
+                memcpy(buf + off, n->content, n->content_len);
+            }
+        }
+        if (MpmBenchCorpusAdd(c, buf, sizeof(buf)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void MpmBenchCorpusFree(MpmBenchCorpus *c)
+{
+    if (c->data != NULL)
+        SCFree(c->data);
+    if (c->bufs != NULL)
+        SCFree(c->bufs);
+    memset(c, 0, sizeof(*c));
+}
+
+/** \internal
+ *  \brief build all mpm stores with one engine and scan the corpus with
+ *         each of them, like a packet hitting every rule group
+ *
+ *  Hyperscan's database cache is bypassed while building, so every group
+ *  gets its own database even if the rule groups share pattern sets or
+ *  the detect engine already built them. The build time and memory shown
+ *  are then for compiling all groups, like the other engines. */
+static void MpmBenchEngine(const DetectEngineCtx *de_ctx, uint16_t matcher,
+        const MpmBenchCorpus *c, uint32_t stores_cnt)
+{
+    struct timeval start, end;
+    MpmCtx *ctxs = SCCalloc(stores_cnt, sizeof(MpmCtx));
+    if (ctxs == NULL)
+        return;
+
+    uint32_t n = 0;
+    uint64_t patterns = 0, memory = 0;
+    HashListTableBucket *htb;
+
+#ifdef BUILD_HYPERSCAN
+    if (matcher == MPM_HS)
+        MpmHSSetDbCacheBypass(true);
+#endif
+    gettimeofday(&start, NULL);
+    for (htb = HashListTableGetListHead(de_ctx->mpm_hash_table);
+            htb != NULL && n < stores_cnt;
+            htb = HashListTableGetListNext(htb))
+    {
+        const MpmStore *ms = (MpmStore *)HashListTableGetListData(htb);
+        if (ms == NULL || ms->mpm_ctx == NULL)
+            continue;
+
+        MpmCtx *mpm_ctx = &ctxs[n];
+        memset(mpm_ctx, 0, sizeof(*mpm_ctx));
+        MpmInitCtx(mpm_ctx, matcher);
+        MpmStoreAddPatterns(de_ctx, ms, mpm_ctx);
+        if (mpm_ctx->pattern_cnt == 0) {
+            mpm_table[matcher].DestroyCtx(mpm_ctx);
+            continue;
+        }
+        patterns += mpm_ctx->pattern_cnt;
+        if (mpm_table[matcher].Prepare != NULL)
+            mpm_table[matcher].Prepare(mpm_ctx);
+        memory += mpm_ctx->memory_size;
+        n++;
+    }
+    gettimeofday(&end, NULL);
+    const uint64_t build_usec = MpmBenchUsecs(&start, &end);
+#ifdef BUILD_HYPERSCAN
+    if (matcher == MPM_HS)
+        MpmHSSetDbCacheBypass(false);
+#endif
+
+    /* thread ctx after the prepare, hs sizes its scratch for all dbs */
+    MpmThreadCtx mpm_thread_ctx;
+    memset(&mpm_thread_ctx, 0, sizeof(mpm_thread_ctx));
+    MpmInitThreadCtx(&mpm_thread_ctx, matcher);
+    PrefilterRuleStore pmq;
+    memset(&pmq, 0, sizeof(pmq));
+    PmqSetup(&pmq);
+
+    uint64_t matches = 0;
+    gettimeofday(&start, NULL);
+    for (uint32_t b = 0; b < c->bufs_cnt; b++) {
+        const uint8_t *buf = c->data + c->bufs[b].offset;
+        const uint32_t len = c->bufs[b].len;
+        for (uint32_t i = 0; i < n; i++) {
+            if (len < ctxs[i].minlen)
+                continue;
+            matches += mpm_table[matcher].Search(&ctxs[i], &mpm_thread_ctx,
+                    &pmq, buf, len);
+            PmqReset(&pmq);
+        }
+    }
+    gettimeofday(&end, NULL);
+    const uint64_t scan_usec = MpmBenchUsecs(&start, &end);
+    const uint64_t scanned = c->data_len * n;
+
+    printf("mpm %-8s %6u groups %8"PRIu64" patterns, built in %6"PRIu64" ms, "
+            "%8"PRIu64" KiB ctx + %6u KiB thread, %"PRIu64" matches, "
+            "%8.1f MB/s%s\n", mpm_table[matcher].name, n, patterns,
+            build_usec / 1000, memory / 1024, mpm_thread_ctx.memory_size / 1024,
+            matches, scan_usec ? (double)scanned / scan_usec : 0,
+            matcher == MPM_HS ? " (uncached, a db per group)" : "");
+
+    PmqFree(&pmq);
+    mpm_table[matcher].DestroyThreadCtx(NULL, &mpm_thread_ctx);
+    for (uint32_t i = 0; i < n; i++)
+        mpm_table[matcher].DestroyCtx(&ctxs[i]);
+    SCFree(ctxs);
+}
+
+static void MpmBenchSpm(uint16_t matcher, const MpmBenchCorpus *c,
+        const MpmBenchNeedle *needles, uint32_t needles_cnt)
+{
+    struct timeval start, end;
+    SpmCtx **ctxs = SCCalloc(needles_cnt, sizeof(SpmCtx *));
+    if (ctxs == NULL)
+        return;
+    SpmGlobalThreadCtx *g_thread_ctx = SpmInitGlobalThreadCtx(matcher);
+    if (g_thread_ctx == NULL) {
+        SCFree(ctxs);
+        return;
+    }
+
+    gettimeofday(&start, NULL);
+    for (uint32_t i = 0; i < needles_cnt; i++) {
+        ctxs[i] = SpmInitCtx(needles[i].content, needles[i].content_len,
+                needles[i].nocase, g_thread_ctx);
+    }
+    gettimeofday(&end, NULL);
+    const uint64_t build_usec = MpmBenchUsecs(&start, &end);
+
+    SpmThreadCtx *thread_ctx = SpmMakeThreadCtx(g_thread_ctx);
+    uint64_t matches = 0, scanned = 0;
+    gettimeofday(&start, NULL);
+    for (uint32_t i = 0; thread_ctx != NULL && i < needles_cnt; i++) {
+        if (ctxs[i] == NULL)
+            continue;
+        for (uint32_t b = 0; b < c->bufs_cnt; b++) {
+            matches += (SpmScan(ctxs[i], thread_ctx, c->data + c->bufs[b].offset,
+                        c->bufs[b].len) != NULL);
+        }
+        scanned += c->data_len;
+    }
+    gettimeofday(&end, NULL);
+    const uint64_t scan_usec = MpmBenchUsecs(&start, &end);
+
+    printf("spm %-8s %6u needles, built in %6"PRIu64" ms, %"PRIu64" matches, "
+            "%8.1f MB/s\n", spm_table[matcher].name, needles_cnt,
+            build_usec / 1000, matches, scan_usec ? (double)scanned / scan_usec : 0);
+
+    if (thread_ctx != NULL)
+        SpmDestroyThreadCtx(thread_ctx);
+    for (uint32_t i = 0; i < needles_cnt; i++) {
+        if (ctxs[i] != NULL)
+            SpmDestroyCtx(ctxs[i]);
+    }
+    SpmDestroyGlobalThreadCtx(g_thread_ctx);
+    SCFree(ctxs);
+}
+
+/**
+ * \brief run the rule groups' fast patterns through every mpm and spm
+ *        engine, if --bench-mpm was given
+ *
+ * Called from SigGroupBuild while the signature init data is still around.
+ * The corpus is "detect.bench-mpm": the tcp and udp payloads of a pcap,
+ * or synthetic buffers if it's empty or "synthetic".
+ */
+void MpmStoreBenchmark(const DetectEngineCtx *de_ctx)
+{
+    const char *corpus = NULL;
+    if (ConfGet("detect.bench-mpm", &corpus) != 1 || de_ctx->mpm_hash_table == NULL)
+        return;
+
+    uint32_t stores_cnt = 0;
+    HashListTableBucket *htb;
+    for (htb = HashListTableGetListHead(de_ctx->mpm_hash_table);
+            htb != NULL; htb = HashListTableGetListNext(htb))
+    {
+        const MpmStore *ms = (MpmStore *)HashListTableGetListData(htb);
+        if (ms != NULL && ms->mpm_ctx != NULL)
+            stores_cnt++;
+    }
+
+    MpmBenchNeedle *needles = SCCalloc(MPM_BENCH_SPM_NEEDLES, sizeof(MpmBenchNeedle));
+    if (needles == NULL)
+        return;
+    uint32_t needles_cnt = 0;
+    for (uint32_t sig = 0; sig < de_ctx->sig_array_len &&
+            needles_cnt < MPM_BENCH_SPM_NEEDLES; sig++)
+    {
+        const Signature *s = de_ctx->sig_array[sig];
+        if (s == NULL || s->init_data == NULL || s->init_data->mpm_sm == NULL)
+            continue;
+        const DetectContentData *cd = (DetectContentData *)s->init_data->mpm_sm->ctx;
+        needles[needles_cnt].content = cd->content;
+        needles[needles_cnt].content_len = cd->content_len;
+        needles[needles_cnt].nocase = (cd->flags & DETECT_CONTENT_NOCASE) != 0;
+        needles_cnt++;
+    }
+
+    MpmBenchCorpus c;
+    memset(&c, 0, sizeof(c));
+    int r;
+    if (corpus == NULL || *corpus == '\0' || strcmp(corpus, "synthetic") == 0) {
+        r = MpmBenchCorpusSynthetic(&c, needles, needles_cnt);
+        corpus = "synthetic";
+    } else {
+        r = MpmBenchCorpusLoadPcap(&c, corpus);
+    }
+    if (r < 0) {
+        MpmBenchCorpusFree(&c);
+        SCFree(needles);
+        return;
+    }
+
+    printf("corpus %s: %u buffers, %"PRIu64" bytes; %u rule groups with "
+            "mpm, %u spm needles\n", corpus, c.bufs_cnt, c.data_len,
+            stores_cnt, needles_cnt);
+
+    for (uint16_t m = MPM_NOTSET + 1; m < MPM_TABLE_SIZE; m++) {
+        if (mpm_table[m].name == NULL || mpm_table[m].InitCtx == NULL)
+            continue;
+        MpmBenchEngine(de_ctx, m, &c, stores_cnt);
+    }
+    for (uint16_t m = 0; m < SPM_TABLE_SIZE; m++) {
+        if (spm_table[m].name == NULL || spm_table[m].InitCtx == NULL)
+            continue;
+        MpmBenchSpm(m, &c, needles, needles_cnt);
+    }
+
+    MpmBenchCorpusFree(&c);
+    SCFree(needles);
+}
+#endif /* BENCHMARKS */
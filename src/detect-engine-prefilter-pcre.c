@@ -0,0 +1,664 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Regex-set prefilter for rules without a fast_pattern.
+ *
+ * The pcre's used as prefilter are compiled into a single Hyperscan
+ * database per rule group and buffer, in Hyperscan's prefilter mode.
+ * One scan of the buffer tells which of the pcre's can match, only the
+ * rules of those are inspected. The scan may report false positives,
+ * but never misses a match, so the full pcre inspection still decides.
+ *
+ * Without Hyperscan the pcre keyword doesn't support prefiltering.
+ */
+
+#include "suricata-common.h"
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-prefilter-pcre.h"
+#include "detect-pcre.h"
+
+#include "stream-tcp.h"
+#include "stream-tcp-reassemble.h"
+
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+#ifdef BUILD_HYPERSCAN
+
+#include <hs.h>
+
+/* prototype scratch, grown for each database. Detect threads clone it. */
+static hs_scratch_t *g_pcre_set_scratch_proto = NULL;
+static SCMutex g_pcre_set_scratch_proto_mutex = SCMUTEX_INITIALIZER;
+
+typedef struct PrefilterPcreSet_ {
+    hs_database_t *db;      /**< NULL if compilation failed: all rules
+                             *   are added on every run */
+    int thread_ctx_id;
+
+    /* hs pattern id to rule */
+    uint32_t sigs_cnt;
+    SigIntId *sigs_array;
+
+    /* tx buffer getter, not used for the payload engine */
+    int list_id;
+    InspectionBufferGetDataPtr GetData;
+    const DetectEngineTransforms *transforms;
+} PrefilterPcreSet;
+
+struct PrefilterPcreScanData {
+    DetectEngineThreadCtx *det_ctx;
+    const PrefilterPcreSet *set;
+};
+
+static unsigned int PrefilterPcreHSFlags(int opts)
+{
+    unsigned int flags = HS_FLAG_PREFILTER | HS_FLAG_SINGLEMATCH;
+    if (opts & PCRE_CASELESS)
+        flags |= HS_FLAG_CASELESS;
+    if (opts & PCRE_MULTILINE)
+        flags |= HS_FLAG_MULTILINE;
+    if (opts & PCRE_DOTALL)
+        flags |= HS_FLAG_DOTALL;
+    /* PCRE_ANCHORED, PCRE_DOLLAR_ENDONLY and PCRE_UNGREEDY only restrict
+     * or move the match, ignoring them gives a superset. */
+    return flags;
+}
+
+/**
+ *  \brief check if Hyperscan can compile the regex in prefilter mode
+ *
+ *  Regexes matching the empty buffer are rejected, they would always
+ *  report a match anyway.
+ */
+bool PrefilterPcreRegexIsSupported(const char *re, int opts)
+{
+    /* hs has no extended syntax flag */
+    if (opts & PCRE_EXTENDED)
+        return false;
+
+    hs_expr_info_t *info = NULL;
+    hs_compile_error_t *compile_err = NULL;
+    hs_error_t err = hs_expression_info(re, PrefilterPcreHSFlags(opts),
+            &info, &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogDebug("regex \"%s\" not supported: %s", re,
+                compile_err ? compile_err->message : "unknown");
+        hs_free_compile_error(compile_err);
+        return false;
+    }
+
+    bool supported = (info->min_width > 0);
+    SCFree(info);
+    return supported;
+}
+
+/** \internal
+ *  \brief check if the regex of a pcre can be used in the set
+ *
+ *  The Hyperscan check is done on the first call only, so that it's
+ *  skipped for all pcre's no prefilter is set up for. An unsupported
+ *  regex is dropped from the pcre data.
+ */
+static bool PrefilterPcreDataUsable(DetectPcreData *pd)
+{
+    if (pd->set_re != NULL && !pd->set_checked) {
+        pd->set_checked = true;
+        if (!PrefilterPcreRegexIsSupported(pd->set_re, pd->set_opts)) {
+            SCFree(pd->set_re);
+            pd->set_re = NULL;
+        }
+    }
+    return pd->set_re != NULL;
+}
+
+static bool PrefilterPcreListUsable(const DetectEngineCtx *de_ctx,
+        const Signature *s, const int list)
+{
+    if (list == DETECT_SM_LIST_PMATCH)
+        return true;
+
+    /* tx buffers need a generic getter */
+    const DetectMpmAppLayerRegistery *reg = de_ctx->app_mpms_list;
+    for ( ; reg != NULL; reg = reg->next) {
+        if (reg->sm_list == list && reg->v2.GetData != NULL &&
+                (s->flags & reg->direction))
+            return true;
+    }
+    return false;
+}
+
+bool PrefilterPcreIsPrefilterable(const Signature *s)
+{
+    for (uint32_t i = 0; i < s->init_data->smlists_array_size; i++) {
+        const SigMatch *sm = s->init_data->smlists[i];
+        for ( ; sm != NULL; sm = sm->next) {
+            if (sm->type == DETECT_PCRE &&
+                    PrefilterPcreDataUsable((DetectPcreData *)sm->ctx))
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *  \brief get the pcre of a rule to use as prefilter
+ *
+ *  \retval sm first usable pcre or NULL if there is none
+ */
+SigMatch *PrefilterPcreGetSm(const DetectEngineCtx *de_ctx, const Signature *s)
+{
+    for (uint32_t i = 0; i < s->init_data->smlists_array_size; i++) {
+        SigMatch *sm = s->init_data->smlists[i];
+        for ( ; sm != NULL; sm = sm->next) {
+            if (sm->type != DETECT_PCRE)
+                continue;
+            if (PrefilterPcreListUsable(de_ctx, s, i) &&
+                    PrefilterPcreDataUsable((DetectPcreData *)sm->ctx))
+                return sm;
+        }
+    }
+    return NULL;
+}
+
+static void *PrefilterPcreThreadInit(void *data)
+{
+    hs_scratch_t **proto = (hs_scratch_t **)data;
+    hs_scratch_t *scratch = NULL;
+
+    SCMutexLock(&g_pcre_set_scratch_proto_mutex);
+    hs_error_t err = hs_clone_scratch(*proto, &scratch);
+    SCMutexUnlock(&g_pcre_set_scratch_proto_mutex);
+    if (err != HS_SUCCESS) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to clone pcre-set scratch");
+        return NULL;
+    }
+    return scratch;
+}
+
+static void PrefilterPcreThreadFree(void *ctx)
+{
+    if (ctx != NULL)
+        hs_free_scratch((hs_scratch_t *)ctx);
+}
+
+static int PrefilterPcreMatch(unsigned int id, unsigned long long from,
+        unsigned long long to, unsigned int flags, void *ctx)
+{
+    struct PrefilterPcreScanData *sd = ctx;
+    PrefilterAddSids(&sd->det_ctx->pmq, &sd->set->sigs_array[id], 1);
+    return 0;
+}
+
+static void PrefilterPcreScan(DetectEngineThreadCtx *det_ctx,
+        const PrefilterPcreSet *set, const uint8_t *buf, const uint32_t buf_len)
+{
+    hs_scratch_t *scratch = NULL;
+    if (set->db != NULL) {
+        scratch = DetectThreadCtxGetKeywordThreadCtx(det_ctx, set->thread_ctx_id);
+    }
+    if (scratch == NULL) {
+        PrefilterAddSids(&det_ctx->pmq, set->sigs_array, set->sigs_cnt);
+        return;
+    }
+
+    struct PrefilterPcreScanData sd = { det_ctx, set };
+    hs_error_t err = hs_scan(set->db, (const char *)buf, buf_len, 0,
+            scratch, PrefilterPcreMatch, &sd);
+    if (err != HS_SUCCESS) {
+        /* can't tell what matched, so inspect all */
+        SCLogDebug("hs_scan failed: %d", err);
+        PrefilterAddSids(&det_ctx->pmq, set->sigs_array, set->sigs_cnt);
+    }
+}
+
+static int PrefilterPcreStreamFunc(void *cb_data, const uint8_t *data,
+        const uint32_t data_len)
+{
+    struct PrefilterPcreScanData *sd = cb_data;
+    PrefilterPcreScan(sd->det_ctx, sd->set, data, data_len);
+    return 0;
+}
+
+static void PrefilterPcrePayload(DetectEngineThreadCtx *det_ctx,
+        Packet *p, const void *pectx)
+{
+    const PrefilterPcreSet *set = (const PrefilterPcreSet *)pectx;
+
+    /* the same data the stream and payload inspection will look at. Use
+     * a local progress so we don't interfere with the stream mpm. */
+    if (p->flags & PKT_DETECT_HAS_STREAMDATA) {
+        struct PrefilterPcreScanData sd = { det_ctx, set };
+        uint64_t unused;
+        StreamReassembleRaw(p->flow->protoctx, p,
+                PrefilterPcreStreamFunc, &sd, &unused, false);
+    }
+    if (p->payload_len > 0) {
+        PrefilterPcreScan(det_ctx, set, p->payload, p->payload_len);
+    }
+}
+
+static void PrefilterPcreTx(DetectEngineThreadCtx *det_ctx,
+        const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
+{
+    const PrefilterPcreSet *set = (const PrefilterPcreSet *)pectx;
+
+    InspectionBuffer *buffer = set->GetData(det_ctx, set->transforms,
+            f, flags, txv, set->list_id);
+    if (buffer == NULL || buffer->inspect == NULL || buffer->inspect_len == 0)
+        return;
+
+    PrefilterPcreScan(det_ctx, set, buffer->inspect, buffer->inspect_len);
+}
+
+static void PrefilterPcreSetFree(void *ptr)
+{
+    PrefilterPcreSet *set = ptr;
+    if (set->db != NULL)
+        hs_free_database(set->db);
+    SCFree(set->sigs_array);
+    SCFree(set);
+}
+
+static bool PrefilterPcreSigInSet(const Signature *s, const int list,
+        const int direction)
+{
+    if (s->init_data->prefilter_sm == NULL ||
+            s->init_data->prefilter_sm->type != DETECT_PCRE)
+        return false;
+    if (direction != 0 && (s->flags & direction) == 0)
+        return false;
+    if (SigMatchListSMBelongsTo(s, s->init_data->prefilter_sm) != list)
+        return false;
+    return PrefilterPcreDataUsable((DetectPcreData *)s->init_data->prefilter_sm->ctx);
+}
+
+/** \internal
+ *  \brief compile the pcre's of a list into a set
+ *
+ *  \param direction SIG_FLAG_TOSERVER/SIG_FLAG_TOCLIENT or 0 for both
+ *
+ *  \retval set or NULL if no rules use the list or on memory error
+ */
+static PrefilterPcreSet *PrefilterPcreSetBuild(DetectEngineCtx *de_ctx,
+        const SigGroupHead *sgh, const int list, const int direction)
+{
+    uint32_t cnt = 0;
+    for (uint32_t sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s != NULL && PrefilterPcreSigInSet(s, list, direction))
+            cnt++;
+    }
+    if (cnt == 0)
+        return NULL;
+
+    PrefilterPcreSet *set = SCCalloc(1, sizeof(*set));
+    if (set == NULL)
+        return NULL;
+    set->sigs_array = SCCalloc(cnt, sizeof(SigIntId));
+    const char **exprs = SCCalloc(cnt, sizeof(char *));
+    unsigned int *flags = SCCalloc(cnt, sizeof(unsigned int));
+    unsigned int *ids = SCCalloc(cnt, sizeof(unsigned int));
+    if (set->sigs_array == NULL || exprs == NULL || flags == NULL || ids == NULL)
+        goto error;
+
+    for (uint32_t sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s == NULL || !PrefilterPcreSigInSet(s, list, direction))
+            continue;
+
+        const DetectPcreData *pd =
+            (const DetectPcreData *)s->init_data->prefilter_sm->ctx;
+        exprs[set->sigs_cnt] = pd->set_re;
+        flags[set->sigs_cnt] = PrefilterPcreHSFlags(pd->set_opts);
+        ids[set->sigs_cnt] = set->sigs_cnt;
+        set->sigs_array[set->sigs_cnt] = s->num;
+        set->sigs_cnt++;
+    }
+
+    hs_compile_error_t *compile_err = NULL;
+    hs_error_t err = hs_compile_multi(exprs, flags, ids, set->sigs_cnt,
+            HS_MODE_BLOCK, NULL, &set->db, &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogWarning(SC_ERR_PCRE_COMPILE, "failed to compile pcre set of %u "
+                "regexes for list %s, inspecting them all: %s", set->sigs_cnt,
+                DetectBufferTypeGetNameById(de_ctx, list),
+                compile_err ? compile_err->message : "unknown error");
+        hs_free_compile_error(compile_err);
+        set->db = NULL;
+    } else {
+        SCMutexLock(&g_pcre_set_scratch_proto_mutex);
+        err = hs_alloc_scratch(set->db, &g_pcre_set_scratch_proto);
+        SCMutexUnlock(&g_pcre_set_scratch_proto_mutex);
+        if (err != HS_SUCCESS) {
+            SCLogWarning(SC_ERR_MEM_ALLOC, "failed to allocate pcre set "
+                    "scratch, inspecting all regexes");
+            hs_free_database(set->db);
+            set->db = NULL;
+        }
+    }
+    if (set->db != NULL) {
+        set->thread_ctx_id = DetectRegisterThreadCtxFuncs(de_ctx, "pcre-set",
+                PrefilterPcreThreadInit, (void *)&g_pcre_set_scratch_proto,
+                PrefilterPcreThreadFree, 1);
+        if (set->thread_ctx_id == -1) {
+            hs_free_database(set->db);
+            set->db = NULL;
+        }
+    }
+
+    SCLogDebug("list %d: %u regexes in set", list, set->sigs_cnt);
+    SCFree(exprs);
+    SCFree(flags);
+    SCFree(ids);
+    return set;
+
+error:
+    if (set->sigs_array != NULL)
+        SCFree(set->sigs_array);
+    SCFree(set);
+    if (exprs != NULL)
+        SCFree(exprs);
+    if (flags != NULL)
+        SCFree(flags);
+    if (ids != NULL)
+        SCFree(ids);
+    return NULL;
+}
+
+int PrefilterSetupPcre(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
+{
+    if (sgh == NULL)
+        return 0;
+
+    /* lists used by the pcre prefilters of this group */
+    const int nlists = de_ctx->buffer_type_id;
+    uint8_t lists[nlists];
+    memset(lists, 0, nlists);
+    bool found = false;
+
+    for (uint32_t sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        if (s == NULL || s->init_data->prefilter_sm == NULL ||
+                s->init_data->prefilter_sm->type != DETECT_PCRE)
+            continue;
+        const int list = SigMatchListSMBelongsTo(s, s->init_data->prefilter_sm);
+        if (list >= 0 && list < nlists) {
+            lists[list] = 1;
+            found = true;
+        }
+    }
+    if (!found)
+        return 0;
+
+    if (lists[DETECT_SM_LIST_PMATCH]) {
+        PrefilterPcreSet *set = PrefilterPcreSetBuild(de_ctx, sgh,
+                DETECT_SM_LIST_PMATCH, 0);
+        if (set != NULL) {
+            if (PrefilterAppendPayloadEngine(de_ctx, sgh, PrefilterPcrePayload,
+                        set, PrefilterPcreSetFree, "pcre-set") != 0) {
+                PrefilterPcreSetFree(set);
+                return -1;
+            }
+        }
+    }
+
+    const DetectMpmAppLayerRegistery *reg = de_ctx->app_mpms_list;
+    for ( ; reg != NULL; reg = reg->next) {
+        if (reg->sm_list < 0 || reg->sm_list >= nlists ||
+                !lists[reg->sm_list] || reg->v2.GetData == NULL)
+            continue;
+
+        PrefilterPcreSet *set = PrefilterPcreSetBuild(de_ctx, sgh,
+                reg->sm_list, reg->direction);
+        if (set == NULL)
+            continue;
+        set->list_id = reg->sm_list;
+        set->GetData = reg->v2.GetData;
+        set->transforms = &reg->v2.transforms;
+
+        if (PrefilterAppendTxEngine(de_ctx, sgh, PrefilterPcreTx,
+                    reg->v2.alproto, reg->v2.tx_min_progress,
+                    set, PrefilterPcreSetFree, "pcre-set") != 0) {
+            PrefilterPcreSetFree(set);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void PrefilterPcreGlobalCleanup(void)
+{
+    SCMutexLock(&g_pcre_set_scratch_proto_mutex);
+    if (g_pcre_set_scratch_proto != NULL) {
+        hs_free_scratch(g_pcre_set_scratch_proto);
+        g_pcre_set_scratch_proto = NULL;
+    }
+    SCMutexUnlock(&g_pcre_set_scratch_proto_mutex);
+}
+
+#else /* BUILD_HYPERSCAN */
+
+SigMatch *PrefilterPcreGetSm(const DetectEngineCtx *de_ctx, const Signature *s)
+{
+    return NULL;
+}
+
+#endif /* BUILD_HYPERSCAN */
+
+#if defined(UNITTESTS) && defined(BUILD_HYPERSCAN)
+#include "detect-engine-build.h"
+#include "app-layer-parser.h"
+#include "flow-util.h"
+
+/** \test only the rules of the regexes found by the set are inspected */
+static int PrefilterPcreTest01(void)
+{
+    uint8_t *buf = (uint8_t *)"GET /index.php HTTP/1.0\r\n\r\n";
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    Packet *p = UTHBuildPacket(buf, strlen((char *)buf), IPPROTO_UDP);
+    FAIL_IF_NULL(p);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_setting = DETECT_PREFILTER_AUTO;
+
+    Signature *s1 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(pcre:\"/GET \\/[a-z]+\\.php/\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    Signature *s2 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(pcre:\"/^POST \\//\"; sid:2;)");
+    FAIL_IF_NULL(s2);
+    /* negated, can't be prefiltered by the set */
+    Signature *s3 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(pcre:!\"/xyz/\"; sid:3;)");
+    FAIL_IF_NULL(s3);
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NOT(s1->flags & SIG_FLAG_PREFILTER);
+    FAIL_IF_NOT(s2->flags & SIG_FLAG_PREFILTER);
+    FAIL_IF(s3->flags & SIG_FLAG_PREFILTER);
+
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    FAIL_IF_NULL(sgh->payload_engines);
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+    FAIL_IF_NOT(PacketAlertCheck(p, 3));
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
+/** \test pcre's on a tx buffer get a tx engine */
+static int PrefilterPcreTest02(void)
+{
+    uint8_t httpbuf[] = "GET /index.php HTTP/1.0\r\n"
+                        "Host: www.example.com\r\n"
+                        "\r\n";
+    uint32_t httplen = sizeof(httpbuf) - 1;
+    ThreadVars th_v;
+    TcpSession ssn;
+    Flow f;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    Packet *p = UTHBuildPacket(httpbuf, httplen, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    f.proto = IPPROTO_TCP;
+    f.flags |= FLOW_IPV4;
+    f.alproto = ALPROTO_HTTP;
+    p->flow = &f;
+    p->flowflags |= FLOW_PKT_TOSERVER|FLOW_PKT_ESTABLISHED;
+    p->flags |= PKT_HAS_FLOW|PKT_STREAM_EST;
+
+    StreamTcpInitConfig(TRUE);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_setting = DETECT_PREFILTER_AUTO;
+
+    Signature *s1 = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; pcre:\"/\\/[a-z]+\\.php/\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    Signature *s2 = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; pcre:\"/\\/admin\\//\"; sid:2;)");
+    FAIL_IF_NULL(s2);
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NOT(s1->flags & SIG_FLAG_PREFILTER);
+    FAIL_IF_NOT(s2->flags & SIG_FLAG_PREFILTER);
+
+    const SigGroupHead *sgh = SigMatchSignaturesGetSgh(de_ctx, p);
+    FAIL_IF_NULL(sgh);
+    FAIL_IF_NULL(sgh->tx_engines);
+    bool found = false;
+    for (const PrefilterEngine *e = sgh->tx_engines; ; e++) {
+        const char *name = PrefilterStoreGetNameById(de_ctx, e->gid);
+        if (e->alproto == ALPROTO_HTTP && name != NULL &&
+                strcmp(name, "pcre-set") == 0)
+            found = true;
+        if (e->is_last)
+            break;
+    }
+    FAIL_IF_NOT(found);
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    FLOWLOCK_WRLOCK(&f);
+    int r = AppLayerParserParse(NULL, alp_tctx, &f, ALPROTO_HTTP,
+            STREAM_TOSERVER, httpbuf, httplen);
+    FLOWLOCK_UNLOCK(&f);
+    FAIL_IF(r != 0);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    UTHFreePacket(p);
+    PASS;
+}
+
+/** \test the regex is only checked for prefilter use if a pcre
+ *        prefilter is set up for the rule, whatever the rule text says */
+static int PrefilterPcreTest03(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_setting = DETECT_PREFILTER_MPM;
+
+    Signature *s1 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(msg:\"prefilter\"; pcre:\"/GET \\/[a-z]+\\.php/\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    Signature *s2 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(pcre:\"/GET \\/[a-z]+\\.php/\"; prefilter; sid:2;)");
+    FAIL_IF_NULL(s2);
+    /* hs has no extended syntax, so this one is dropped from the set */
+    Signature *s3 = DetectEngineAppendSig(de_ctx, "alert udp any any -> any any "
+            "(pcre:\"/GET \\/ [a-z]+/x\"; prefilter; sid:3;)");
+    FAIL_IF_NULL(s3);
+
+    const SigMatch *sm = s1->init_data->smlists[DETECT_SM_LIST_PMATCH];
+    FAIL_IF_NULL(sm);
+    const DetectPcreData *pd1 = (const DetectPcreData *)sm->ctx;
+    sm = s2->init_data->smlists[DETECT_SM_LIST_PMATCH];
+    FAIL_IF_NULL(sm);
+    const DetectPcreData *pd2 = (const DetectPcreData *)sm->ctx;
+    sm = s3->init_data->smlists[DETECT_SM_LIST_PMATCH];
+    FAIL_IF_NULL(sm);
+    const DetectPcreData *pd3 = (const DetectPcreData *)sm->ctx;
+
+    /* nothing is checked at parse time */
+    FAIL_IF(pd1->set_checked || pd2->set_checked || pd3->set_checked);
+
+    SigGroupBuild(de_ctx);
+
+    FAIL_IF(pd1->set_checked);
+    FAIL_IF_NOT(pd2->set_checked);
+    FAIL_IF_NULL(pd2->set_re);
+    FAIL_IF_NOT(pd3->set_checked);
+    FAIL_IF_NOT_NULL(pd3->set_re);
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+#endif /* UNITTESTS && BUILD_HYPERSCAN */
+
+void PrefilterPcreRegisterTests(void)
+{
+#if defined(UNITTESTS) && defined(BUILD_HYPERSCAN)
+    UtRegisterTest("PrefilterPcreTest01", PrefilterPcreTest01);
+    UtRegisterTest("PrefilterPcreTest02", PrefilterPcreTest02);
+    UtRegisterTest("PrefilterPcreTest03", PrefilterPcreTest03);
+#endif
+}
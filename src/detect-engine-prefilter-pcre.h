@@ -0,0 +1,32 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __DETECT_ENGINE_PREFILTER_PCRE_H__
+#define __DETECT_ENGINE_PREFILTER_PCRE_H__
+
+SigMatch *PrefilterPcreGetSm(const DetectEngineCtx *de_ctx, const Signature *s);
+
+#ifdef BUILD_HYPERSCAN
+bool PrefilterPcreRegexIsSupported(const char *re, int opts);
+bool PrefilterPcreIsPrefilterable(const Signature *s);
+int PrefilterSetupPcre(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+void PrefilterPcreGlobalCleanup(void);
+#endif
+
+void PrefilterPcreRegisterTests(void);
+
+#endif /* __DETECT_ENGINE_PREFILTER_PCRE_H__ */
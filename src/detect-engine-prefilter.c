@@ -49,6 +49,7 @@
 
 #include "detect-engine-prefilter.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-sampling.h"
 
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
@@ -114,8 +115,10 @@ void DetectRunPrefilterTx(DetectEngineThreadCtx *det_ctx,
         }
 
         PREFILTER_PROFILING_START;
+        SAMPLING_PREFILTER_START(det_ctx);
         engine->cb.PrefilterTx(det_ctx, engine->pectx,
                 p, p->flow, tx->tx_ptr, tx->tx_id, flow_flags);
+        SAMPLING_PREFILTER_END(det_ctx, engine->gid);
         PREFILTER_PROFILING_END(det_ctx, engine->gid);
 
         if (tx->tx_progress > engine->tx_min_progress) {
@@ -147,7 +150,9 @@ void Prefilter(DetectEngineThreadCtx *det_ctx, const SigGroupHead *sgh,
         PrefilterEngine *engine = sgh->pkt_engines;
         do {
             PREFILTER_PROFILING_START;
+            SAMPLING_PREFILTER_START(det_ctx);
             engine->cb.Prefilter(det_ctx, p, engine->pectx);
+            SAMPLING_PREFILTER_END(det_ctx, engine->gid);
             PREFILTER_PROFILING_END(det_ctx, engine->gid);
 
             if (engine->is_last)
@@ -166,7 +171,9 @@ void Prefilter(DetectEngineThreadCtx *det_ctx, const SigGroupHead *sgh,
         PrefilterEngine *engine = sgh->payload_engines;
         while (1) {
             PREFILTER_PROFILING_START;
+            SAMPLING_PREFILTER_START(det_ctx);
             engine->cb.Prefilter(det_ctx, p, engine->pectx);
+            SAMPLING_PREFILTER_END(det_ctx, engine->gid);
             PREFILTER_PROFILING_END(det_ctx, engine->gid);
 
             if (engine->is_last)
@@ -300,6 +307,53 @@ static void PrefilterFreeEngineList(PrefilterEngineList *e)
     SCFreeAligned(e);
 }
 
+/**
+ *  \brief queue a buffer for a vectored mpm search
+ *
+ *  Prefilters that get multiple buffers per tx for the same mpm ctx,
+ *  like DNS queries or files, queue them here and then search them
+ *  all at once with PrefilterVectorSearch(). If we can't grow the
+ *  queue, the buffer is searched right away.
+ *
+ *  \param tag caller defined, e.g. the local id of the buffer
+ */
+void PrefilterVectorAdd(DetectEngineThreadCtx *det_ctx, const MpmCtx *mpm_ctx,
+        const uint8_t *buf, const uint32_t buf_len, const uint32_t tag)
+{
+    if (det_ctx->mpm_vector_cnt == det_ctx->mpm_vector_size) {
+        uint32_t new_size = det_ctx->mpm_vector_size ?
+            det_ctx->mpm_vector_size * 2 : 8;
+        void *ptr = SCRealloc(det_ctx->mpm_vector,
+                new_size * sizeof(MpmVectorBuffer));
+        if (ptr == NULL) {
+            (void)mpm_table[mpm_ctx->mpm_type].Search(mpm_ctx,
+                    &det_ctx->mtcu, &det_ctx->pmq, buf, buf_len);
+            return;
+        }
+        det_ctx->mpm_vector = ptr;
+        det_ctx->mpm_vector_size = new_size;
+    }
+
+    MpmVectorBuffer *vb = &det_ctx->mpm_vector[det_ctx->mpm_vector_cnt++];
+    vb->buf = buf;
+    vb->len = buf_len;
+    vb->tag = tag;
+    vb->matches = 0;
+}
+
+/**
+ *  \brief search the queued buffers and empty the queue
+ */
+void PrefilterVectorSearch(DetectEngineThreadCtx *det_ctx, const MpmCtx *mpm_ctx)
+{
+    if (det_ctx->mpm_vector_cnt == 0)
+        return;
+
+    (void)MpmSearchVector(mpm_ctx, &det_ctx->mtcu, &det_ctx->pmq,
+            det_ctx->mpm_vector, det_ctx->mpm_vector_cnt);
+    det_ctx->mpm_vector_cnt = 0;
+}
+
 void PrefilterFreeEnginesList(PrefilterEngineList *list)
 {
     PrefilterEngineList *t = list;
@@ -547,6 +601,15 @@ static const PrefilterStore *PrefilterStoreGetStore(const DetectEngineCtx *de_ct
     return store;
 }
 
+/** \brief get the name of prefilter engine 'id' of de_ctx
+ *  \warning slow */
+const char *PrefilterStoreGetNameById(const DetectEngineCtx *de_ctx,
+        const uint32_t id)
+{
+    const PrefilterStore *store = PrefilterStoreGetStore(de_ctx, id);
+    return store ? store->name : NULL;
+}
+
 #ifdef PROFILING
 const char *PrefilterStoreGetName(const uint32_t id)
 {
@@ -60,11 +60,17 @@ void DetectRunPrefilterTx(DetectEngineThreadCtx *det_ctx,
         void *alstate,
         DetectTransaction *tx);
 
+void PrefilterVectorAdd(DetectEngineThreadCtx *det_ctx, const MpmCtx *mpm_ctx,
+        const uint8_t *buf, const uint32_t buf_len, const uint32_t tag);
+void PrefilterVectorSearch(DetectEngineThreadCtx *det_ctx, const MpmCtx *mpm_ctx);
+
 void PrefilterFreeEnginesList(PrefilterEngineList *list);
 
 void PrefilterSetupRuleGroup(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
 void PrefilterCleanupRuleGroup(const DetectEngineCtx *de_ctx, SigGroupHead *sgh);
 
+const char *PrefilterStoreGetNameById(const DetectEngineCtx *de_ctx,
+        const uint32_t id);
 #ifdef PROFILING
 const char *PrefilterStoreGetName(const uint32_t id);
 #endif
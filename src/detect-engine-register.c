@@ -142,6 +142,7 @@
 #include "detect-dce-stub-data.h"
 #include "detect-urilen.h"
 #include "detect-bsize.h"
+#include "detect-dataset.h"
 #include "detect-detection-filter.h"
 #include "detect-http-client-body.h"
 #include "detect-http-server-body.h"
@@ -490,6 +491,7 @@ void SigTableSetup(void)
     DetectNfsVersionRegister();
     DetectUrilenRegister();
     DetectBsizeRegister();
+    DetectDatasetRegister();
     DetectDetectionFilterRegister();
     DetectAsn1Register();
     DetectSshProtocolRegister();
@@ -100,6 +100,7 @@ enum {
     DETECT_MARK,
 
     DETECT_BSIZE,
+    DETECT_DATASET,
 
     DETECT_AL_TLS_VERSION,
     DETECT_AL_TLS_SUBJECT,
@@ -0,0 +1,502 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampled cost accounting for the detection engine.
+ *
+ * Each detect thread counts down its inspections: rule inspections and
+ * prefilter engine runs. Every detect.sampling.rate'th one is timed with
+ * the cpu tick counter and added to a per thread table, per rule, per
+ * buffer and per prefilter engine. The inspect engines of a sampled rule
+ * are timed too, which gives the per buffer numbers.
+ *
+ * The tables are only written by their thread. The unix socket dump sums
+ * them up without stopping the threads, so a dump can be off by the
+ * samples taken while it runs.
+ */
+
+#include "suricata-common.h"
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-prefilter.h"
+#include "detect-parse.h"
+#include "detect-engine-sampling.h"
+
+#include "conf.h"
+#include "conf-yaml-loader.h"
+#include "flow-util.h"
+#include "stream-tcp.h"
+#include "app-layer-parser.h"
+
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+/** threads with sampling tables, for the dump */
+static SCMutex g_sampling_lock = SCMUTEX_INITIALIZER;
+static DetectSamplingThreadData *g_sampling_threads = NULL;
+
+static void DetectSamplingThreadDataFree(DetectSamplingThreadData *sd)
+{
+    if (sd->rules != NULL)
+        SCFree(sd->rules);
+    if (sd->lists != NULL)
+        SCFree(sd->lists);
+    if (sd->prefilter != NULL)
+        SCFree(sd->prefilter);
+    SCFree(sd);
+}
+
+/**
+ *  \brief set up the sampling tables of a detect thread
+ *
+ *  \retval 0 ok, also if sampling is disabled
+ *  \retval -1 out of memory
+ */
+int DetectSamplingThreadSetup(const DetectEngineCtx *de_ctx,
+        DetectEngineThreadCtx *det_ctx)
+{
+    det_ctx->sampling = NULL;
+    det_ctx->sampling_countdown = 0;
+    det_ctx->sampling_rule_active = false;
+
+    if (de_ctx->sampling_rate == 0)
+        return 0;
+
+    DetectSamplingThreadData *sd = SCCalloc(1, sizeof(*sd));
+    if (unlikely(sd == NULL))
+        return -1;
+    sd->de_ctx = de_ctx;
+    sd->rate = de_ctx->sampling_rate;
+
+    sd->rules_size = de_ctx->sig_array_len;
+    sd->lists_size = de_ctx->buffer_type_id;
+    sd->prefilter_size = de_ctx->prefilter_id;
+    if (sd->rules_size > 0) {
+        sd->rules = SCCalloc(sd->rules_size, sizeof(DetectSamplingRecord));
+        if (sd->rules == NULL)
+            goto error;
+    }
+    if (sd->lists_size > 0) {
+        sd->lists = SCCalloc(sd->lists_size, sizeof(DetectSamplingRecord));
+        if (sd->lists == NULL)
+            goto error;
+    }
+    if (sd->prefilter_size > 0) {
+        sd->prefilter = SCCalloc(sd->prefilter_size, sizeof(DetectSamplingRecord));
+        if (sd->prefilter == NULL)
+            goto error;
+    }
+
+    SCMutexLock(&g_sampling_lock);
+    sd->next = g_sampling_threads;
+    g_sampling_threads = sd;
+    SCMutexUnlock(&g_sampling_lock);
+
+    det_ctx->sampling = sd;
+    det_ctx->sampling_countdown = sd->rate;
+    return 0;
+
+error:
+    DetectSamplingThreadDataFree(sd);
+    return -1;
+}
+
+void DetectSamplingThreadCleanup(DetectEngineThreadCtx *det_ctx)
+{
+    DetectSamplingThreadData *sd = det_ctx->sampling;
+    if (sd == NULL)
+        return;
+
+    SCMutexLock(&g_sampling_lock);
+    DetectSamplingThreadData **p = &g_sampling_threads;
+    while (*p != NULL && *p != sd)
+        p = &(*p)->next;
+    if (*p != NULL)
+        *p = sd->next;
+    SCMutexUnlock(&g_sampling_lock);
+
+    DetectSamplingThreadDataFree(sd);
+    det_ctx->sampling = NULL;
+    det_ctx->sampling_countdown = 0;
+}
+
+/** \brief clear the tables of all threads */
+void DetectSamplingReset(void)
+{
+    SCMutexLock(&g_sampling_lock);
+    for (DetectSamplingThreadData *sd = g_sampling_threads; sd != NULL; sd = sd->next) {
+        memset(sd->rules, 0, sd->rules_size * sizeof(DetectSamplingRecord));
+        memset(sd->lists, 0, sd->lists_size * sizeof(DetectSamplingRecord));
+        memset(sd->prefilter, 0, sd->prefilter_size * sizeof(DetectSamplingRecord));
+    }
+    SCMutexUnlock(&g_sampling_lock);
+}
+
+#ifdef HAVE_LIBJANSSON
+typedef struct DetectSamplingSorted_ {
+    uint32_t id;
+    DetectSamplingRecord r;
+} DetectSamplingSorted;
+
+static int DetectSamplingSortedCmp(const void *a, const void *b)
+{
+    const DetectSamplingSorted *sa = a;
+    const DetectSamplingSorted *sb = b;
+    if (sa->r.ticks == sb->r.ticks)
+        return 0;
+    return (sa->r.ticks < sb->r.ticks) ? 1 : -1;
+}
+
+/** \internal
+ *  \brief sort the records with samples by ticks, most expensive first
+ *
+ *  \retval cnt number of records with samples
+ */
+static uint32_t DetectSamplingSort(const DetectSamplingRecord *sums,
+        uint32_t size, DetectSamplingSorted *out)
+{
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (sums[i].cnt == 0)
+            continue;
+        out[cnt].id = i;
+        out[cnt].r = sums[i];
+        cnt++;
+    }
+    qsort(out, cnt, sizeof(DetectSamplingSorted), DetectSamplingSortedCmp);
+    return cnt;
+}
+
+static json_t *DetectSamplingRecordJson(const DetectSamplingRecord *r,
+        const uint32_t rate)
+{
+    json_t *js = json_object();
+    if (js == NULL)
+        return NULL;
+    json_object_set_new(js, "samples", json_integer(r->cnt));
+    json_object_set_new(js, "ticks_total", json_integer(r->ticks));
+    json_object_set_new(js, "ticks_avg", json_integer(r->ticks / r->cnt));
+    /* what all inspections would have cost at this sample rate */
+    json_object_set_new(js, "ticks_estimated", json_integer(r->ticks * rate));
+    return js;
+}
+
+static const char *DetectSamplingListName(const DetectEngineCtx *de_ctx, int list)
+{
+    if (list < DETECT_SM_LIST_DYNAMIC_START)
+        return DetectListToHumanString(list);
+    if ((uint32_t)list >= de_ctx->buffer_type_map_elements)
+        return NULL;
+    return DetectBufferTypeGetNameById(de_ctx, list);
+}
+
+/**
+ *  \brief sum up the samples of all threads using de_ctx
+ *
+ *  \param top number of rules to list
+ *
+ *  \retval js object with the top rules, and all buffers and prefilter
+ *          engines that were sampled, sorted by cost
+ */
+json_t *DetectSamplingTopJson(const DetectEngineCtx *de_ctx, uint32_t top)
+{
+    const uint32_t rules_size = de_ctx->sig_array_len;
+    const uint32_t lists_size = de_ctx->buffer_type_id;
+    const uint32_t prefilter_size = de_ctx->prefilter_id;
+    const uint32_t size = MAX(rules_size, MAX(lists_size, prefilter_size));
+    uint32_t threads = 0;
+    json_t *js = NULL;
+
+    DetectSamplingRecord *rules = SCCalloc(rules_size + 1, sizeof(DetectSamplingRecord));
+    DetectSamplingRecord *lists = SCCalloc(lists_size + 1, sizeof(DetectSamplingRecord));
+    DetectSamplingRecord *prefilter = SCCalloc(prefilter_size + 1, sizeof(DetectSamplingRecord));
+    DetectSamplingSorted *sorted = SCCalloc(size + 1, sizeof(DetectSamplingSorted));
+    if (rules == NULL || lists == NULL || prefilter == NULL || sorted == NULL)
+        goto end;
+
+    SCMutexLock(&g_sampling_lock);
+    for (DetectSamplingThreadData *sd = g_sampling_threads; sd != NULL; sd = sd->next) {
+        if (sd->de_ctx != de_ctx)
+            continue;
+        for (uint32_t i = 0; i < sd->rules_size && i < rules_size; i++) {
+            rules[i].ticks += sd->rules[i].ticks;
+            rules[i].cnt += sd->rules[i].cnt;
+        }
+        for (uint32_t i = 0; i < sd->lists_size && i < lists_size; i++) {
+            lists[i].ticks += sd->lists[i].ticks;
+            lists[i].cnt += sd->lists[i].cnt;
+        }
+        for (uint32_t i = 0; i < sd->prefilter_size && i < prefilter_size; i++) {
+            prefilter[i].ticks += sd->prefilter[i].ticks;
+            prefilter[i].cnt += sd->prefilter[i].cnt;
+        }
+        threads++;
+    }
+    SCMutexUnlock(&g_sampling_lock);
+
+    js = json_object();
+    if (js == NULL)
+        goto end;
+    json_object_set_new(js, "rate", json_integer(de_ctx->sampling_rate));
+    json_object_set_new(js, "threads", json_integer(threads));
+
+    json_t *jrules = json_array();
+    if (jrules != NULL) {
+        uint32_t cnt = DetectSamplingSort(rules, rules_size, sorted);
+        for (uint32_t i = 0; i < cnt && i < top; i++) {
+            const Signature *s = de_ctx->sig_array[sorted[i].id];
+            json_t *jr = DetectSamplingRecordJson(&sorted[i].r, de_ctx->sampling_rate);
+            if (s == NULL || jr == NULL) {
+                json_decref(jr);
+                continue;
+            }
+            json_object_set_new(jr, "signature_id", json_integer(s->id));
+            json_object_set_new(jr, "gid", json_integer(s->gid));
+            json_object_set_new(jr, "rev", json_integer(s->rev));
+            if (s->msg != NULL)
+                json_object_set_new(jr, "msg", json_string(s->msg));
+            json_array_append_new(jrules, jr);
+        }
+        json_object_set_new(js, "rules", jrules);
+    }
+
+    json_t *jlists = json_array();
+    if (jlists != NULL) {
+        uint32_t cnt = DetectSamplingSort(lists, lists_size, sorted);
+        for (uint32_t i = 0; i < cnt; i++) {
+            const char *name = DetectSamplingListName(de_ctx, sorted[i].id);
+            json_t *jl = DetectSamplingRecordJson(&sorted[i].r, de_ctx->sampling_rate);
+            if (name == NULL || jl == NULL) {
+                json_decref(jl);
+                continue;
+            }
+            json_object_set_new(jl, "name", json_string(name));
+            json_array_append_new(jlists, jl);
+        }
+        json_object_set_new(js, "buffers", jlists);
+    }
+
+    json_t *jpf = json_array();
+    if (jpf != NULL) {
+        uint32_t cnt = DetectSamplingSort(prefilter, prefilter_size, sorted);
+        for (uint32_t i = 0; i < cnt; i++) {
+            const char *name = PrefilterStoreGetNameById(de_ctx, sorted[i].id);
+            json_t *jp = DetectSamplingRecordJson(&sorted[i].r, de_ctx->sampling_rate);
+            if (name == NULL || jp == NULL) {
+                json_decref(jp);
+                continue;
+            }
+            json_object_set_new(jp, "name", json_string(name));
+            json_array_append_new(jpf, jp);
+        }
+        json_object_set_new(js, "prefilter", jpf);
+    }
+
+end:
+    if (rules != NULL)
+        SCFree(rules);
+    if (lists != NULL)
+        SCFree(lists);
+    if (prefilter != NULL)
+        SCFree(prefilter);
+    if (sorted != NULL)
+        SCFree(sorted);
+    return js;
+}
+#endif /* HAVE_LIBJANSSON */
+
+#ifdef UNITTESTS
+/** \test one in rate inspections is sampled, none if disabled */
+static int DetectSamplingTest01(void)
+{
+    DetectEngineThreadCtx det_ctx;
+    DetectSamplingThreadData sd;
+    memset(&det_ctx, 0, sizeof(det_ctx));
+    memset(&sd, 0, sizeof(sd));
+
+    for (int i = 0; i < 100; i++)
+        FAIL_IF(DetectSamplingStart(&det_ctx) != 0);
+
+    sd.rate = 10;
+    det_ctx.sampling = &sd;
+    det_ctx.sampling_countdown = sd.rate;
+    int sampled = 0;
+    for (int i = 0; i < 100; i++) {
+        if (DetectSamplingStart(&det_ctx) != 0)
+            sampled++;
+    }
+    FAIL_IF_NOT(sampled == 10);
+
+    DetectSamplingRecord r[2];
+    memset(&r, 0, sizeof(r));
+    DetectSamplingRecordAdd(r, 2, 1, UtilCpuGetTicks());
+    DetectSamplingRecordAdd(r, 2, 2, UtilCpuGetTicks());
+    FAIL_IF_NOT(r[0].cnt == 0 && r[1].cnt == 1);
+    PASS;
+}
+
+#ifdef HAVE_LIBJANSSON
+/** \internal
+ *  \brief find an entry in one of the arrays of the sampling dump
+ *
+ *  \param id signature id to look for in "rules", or 0
+ *  \param name name to look for in "buffers" or "prefilter", or NULL
+ */
+static json_t *DetectSamplingTestFind(json_t *js, const char *array,
+        json_int_t id, const char *name)
+{
+    json_t *arr = json_object_get(js, array);
+    if (arr == NULL)
+        return NULL;
+    size_t i;
+    json_t *e;
+    json_array_foreach(arr, i, e) {
+        if (name != NULL) {
+            const char *n = json_string_value(json_object_get(e, "name"));
+            if (n != NULL && strcmp(n, name) == 0)
+                return e;
+        } else if (json_integer_value(json_object_get(e, "signature_id")) == id) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/** \test with a rate of 1 every inspection is sampled and the dump
+ *        attributes them to the right rules, buffers and prefilter
+ *        engines, for packet and tx rules */
+static int DetectSamplingTest02(void)
+{
+    char conf[] = "\
+%YAML 1.1\n\
+---\n\
+detect:\n\
+  sampling:\n\
+    rate: 1\n\
+";
+    uint8_t httpbuf[] = "GET /index.html HTTP/1.0\r\n"
+                        "Host: www.example.com\r\n"
+                        "\r\n";
+    uint32_t httplen = sizeof(httpbuf) - 1;
+    ThreadVars th_v;
+    TcpSession ssn;
+    Flow f;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(conf, strlen(conf));
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    Packet *p = UTHBuildPacket(httpbuf, httplen, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    f.proto = IPPROTO_TCP;
+    f.flags |= FLOW_IPV4;
+    f.alproto = ALPROTO_HTTP;
+    p->flow = &f;
+    p->flowflags |= FLOW_PKT_TOSERVER|FLOW_PKT_ESTABLISHED;
+    p->flags |= PKT_HAS_FLOW|PKT_STREAM_EST;
+
+    StreamTcpInitConfig(TRUE);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    FAIL_IF_NOT(de_ctx->sampling_rate == 1);
+
+    /* packet rule without app inspection, and a tx rule */
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(flow:to_server; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+                "(content:\"/index\"; http_uri; sid:2;)"));
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+    FAIL_IF_NULL(det_ctx->sampling);
+
+    FLOWLOCK_WRLOCK(&f);
+    int r = AppLayerParserParse(NULL, alp_tctx, &f, ALPROTO_HTTP,
+            STREAM_TOSERVER, httpbuf, httplen);
+    FLOWLOCK_UNLOCK(&f);
+    FAIL_IF(r != 0);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p, 2));
+
+    json_t *js = DetectSamplingTopJson(de_ctx, 10);
+    FAIL_IF_NULL(js);
+    FAIL_IF_NOT(json_integer_value(json_object_get(js, "rate")) == 1);
+    FAIL_IF_NOT(json_integer_value(json_object_get(js, "threads")) == 1);
+
+    /* the packet rule is accounted to the packet list, the tx rule
+     * to the buffer its inspect engine ran on */
+    json_t *e = DetectSamplingTestFind(js, "rules", 1, NULL);
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(json_integer_value(json_object_get(e, "samples")) == 1);
+    e = DetectSamplingTestFind(js, "rules", 2, NULL);
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(json_integer_value(json_object_get(e, "samples")) == 1);
+    FAIL_IF_NULL(DetectSamplingTestFind(js, "buffers", 0, "packet"));
+    FAIL_IF_NULL(DetectSamplingTestFind(js, "buffers", 0, "http_uri"));
+    FAIL_IF_NOT_NULL(DetectSamplingTestFind(js, "buffers", 0, "payload"));
+
+    /* the uri mpm ran as a prefilter engine */
+    e = DetectSamplingTestFind(js, "prefilter", 0, "http_uri");
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(json_integer_value(json_object_get(e, "samples")) >= 1);
+    json_decref(js);
+
+    /* a reset clears the counts */
+    DetectSamplingReset();
+    js = DetectSamplingTopJson(de_ctx, 10);
+    FAIL_IF_NULL(js);
+    FAIL_IF_NOT(json_array_size(json_object_get(js, "rules")) == 0);
+    FAIL_IF_NOT(json_array_size(json_object_get(js, "prefilter")) == 0);
+    json_decref(js);
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    UTHFreePacket(p);
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+#endif /* HAVE_LIBJANSSON */
+#endif
+
+void DetectSamplingRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectSamplingTest01", DetectSamplingTest01);
+#ifdef HAVE_LIBJANSSON
+    UtRegisterTest("DetectSamplingTest02", DetectSamplingTest02);
+#endif
+#endif
+}
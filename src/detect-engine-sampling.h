@@ -0,0 +1,139 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampled cost accounting for rules, inspection buffers and prefilter
+ * engines. Unlike rule profiling this is always built in: one in every
+ * detect.sampling.rate inspections is timed.
+ */
+
+#ifndef __DETECT_ENGINE_SAMPLING_H__
+#define __DETECT_ENGINE_SAMPLING_H__
+
+#include "util-cpu.h"
+
+#define DETECT_SAMPLING_DEFAULT_RATE    1000
+
+typedef struct DetectSamplingRecord_ {
+    uint64_t ticks;
+    uint64_t cnt;
+} DetectSamplingRecord;
+
+/** per thread tables, only written by the owning thread */
+typedef struct DetectSamplingThreadData_ {
+    const DetectEngineCtx *de_ctx;
+    uint32_t rate;
+
+    DetectSamplingRecord *rules;        /**< by Signature::num */
+    uint32_t rules_size;
+    DetectSamplingRecord *lists;        /**< by buffer type id */
+    uint32_t lists_size;
+    DetectSamplingRecord *prefilter;    /**< by PrefilterEngine::gid */
+    uint32_t prefilter_size;
+
+    struct DetectSamplingThreadData_ *next;
+} DetectSamplingThreadData;
+
+int DetectSamplingThreadSetup(const DetectEngineCtx *de_ctx,
+        DetectEngineThreadCtx *det_ctx);
+void DetectSamplingThreadCleanup(DetectEngineThreadCtx *det_ctx);
+void DetectSamplingReset(void);
+#ifdef HAVE_LIBJANSSON
+json_t *DetectSamplingTopJson(const DetectEngineCtx *de_ctx, uint32_t top);
+#endif
+
+/** \retval ticks if this inspection is sampled, 0 otherwise */
+static inline uint64_t DetectSamplingStart(DetectEngineThreadCtx *det_ctx)
+{
+    if (likely(det_ctx->sampling_countdown != 1)) {
+        /* 0 means disabled */
+        if (det_ctx->sampling_countdown != 0)
+            det_ctx->sampling_countdown--;
+        return 0;
+    }
+    det_ctx->sampling_countdown = det_ctx->sampling->rate;
+    return UtilCpuGetTicks();
+}
+
+static inline void DetectSamplingRecordAdd(DetectSamplingRecord *r,
+        const uint32_t size, const uint32_t id, const uint64_t start)
+{
+    if (id < size) {
+        r[id].ticks += UtilCpuGetTicks() - start;
+        r[id].cnt++;
+    }
+}
+
+/** \brief time a rule inspection. Sets sampling_rule_active so the
+ *         inspect engines of the rule get timed per buffer as well. */
+#define SAMPLING_RULE_START(det_ctx)                                        \
+    const uint64_t sampling_rule_start_ = DetectSamplingStart((det_ctx));   \
+    (det_ctx)->sampling_rule_active = (sampling_rule_start_ != 0)
+
+#define SAMPLING_RULE_END(det_ctx, s)                                       \
+    if (unlikely(sampling_rule_start_ != 0)) {                              \
+        DetectSamplingRecordAdd((det_ctx)->sampling->rules,                 \
+                (det_ctx)->sampling->rules_size, (s)->num,                  \
+                sampling_rule_start_);                                      \
+        (det_ctx)->sampling_rule_active = false;                            \
+    }
+
+/** \brief packet rules have no inspect engines, account them to the
+ *         payload list if they inspect it, or to the packet list. Rules
+ *         with app inspection are only passed over here, they are
+ *         accounted in DetectRunTx. */
+#define SAMPLING_PACKET_RULE_END(det_ctx, s)                                \
+    if (unlikely(sampling_rule_start_ != 0)) {                              \
+        if ((s)->app_inspect == NULL) {                                     \
+            DetectSamplingRecordAdd((det_ctx)->sampling->lists,             \
+                    (det_ctx)->sampling->lists_size,                        \
+                    (s)->sm_arrays[DETECT_SM_LIST_PMATCH] != NULL ?         \
+                        DETECT_SM_LIST_PMATCH : DETECT_SM_LIST_MATCH,       \
+                    sampling_rule_start_);                                  \
+            DetectSamplingRecordAdd((det_ctx)->sampling->rules,             \
+                    (det_ctx)->sampling->rules_size, (s)->num,              \
+                    sampling_rule_start_);                                  \
+        }                                                                   \
+        (det_ctx)->sampling_rule_active = false;                            \
+    }
+
+#define SAMPLING_LIST_START(det_ctx)                                        \
+    const uint64_t sampling_list_start_ =                                   \
+        unlikely((det_ctx)->sampling_rule_active) ? UtilCpuGetTicks() : 0
+
+#define SAMPLING_LIST_END(det_ctx, list)                                    \
+    if (unlikely(sampling_list_start_ != 0)) {                              \
+        DetectSamplingRecordAdd((det_ctx)->sampling->lists,                 \
+                (det_ctx)->sampling->lists_size, (list),                    \
+                sampling_list_start_);                                      \
+    }
+
+#define SAMPLING_PREFILTER_START(det_ctx)                                   \
+    const uint64_t sampling_prefilter_start_ = DetectSamplingStart((det_ctx))
+
+#define SAMPLING_PREFILTER_END(det_ctx, gid)                                \
+    if (unlikely(sampling_prefilter_start_ != 0)) {                         \
+        DetectSamplingRecordAdd((det_ctx)->sampling->prefilter,             \
+                (det_ctx)->sampling->prefilter_size, (gid),                 \
+                sampling_prefilter_start_);                                 \
+    }
+
+void DetectSamplingRegisterTests(void);
+
+#endif /* __DETECT_ENGINE_SAMPLING_H__ */
@@ -517,15 +517,17 @@ void TagHandlePacket(DetectEngineCtx *de_ctx,
         TagHandlePacketFlow(p->flow, p);
     }
 
-    Host *src = HostLookupHostFromHash(&p->src);
+    Host *src = HostLookupHostFromHashNoLock(&p->src);
     if (src) {
+        HostLock(src);
         if (TagHostHasTag(src)) {
             TagHandlePacketHost(src,p);
         }
         HostRelease(src);
     }
-    Host *dst = HostLookupHostFromHash(&p->dst);
+    Host *dst = HostLookupHostFromHashNoLock(&p->dst);
     if (dst) {
+        HostLock(dst);
         if (TagHostHasTag(dst)) {
             TagHandlePacketHost(dst,p);
         }
@@ -647,6 +647,35 @@ static int ThresholdHandlePacketRule(DetectEngineCtx *de_ctx, Packet *p,
     return ret;
 }
 
+/** \internal
+ *  \brief get the *LOCKED* host for a threshold
+ *
+ *  Most packets hit hosts that are already in the hash, find those
+ *  without taking the row lock. Only create the host on a miss. The
+ *  threshold data is still only touched with the host locked.
+ */
+static Host *ThresholdHostGet(Address *a)
+{
+    Host *h = HostLookupHostFromHashNoLock(a);
+    if (h != NULL) {
+        HostLock(h);
+        return h;
+    }
+    return HostGetHostFromHash(a);
+}
+
+/** \internal
+ *  \brief get the *LOCKED* ippair for a threshold, see ThresholdHostGet */
+static IPPair *ThresholdIPPairGet(Address *a, Address *b)
+{
+    IPPair *pair = IPPairLookupIPPairFromHashNoLock(a, b);
+    if (pair != NULL) {
+        IPPairLock(pair);
+        return pair;
+    }
+    return IPPairGetIPPairFromHash(a, b);
+}
+
 /**
  * \brief Make the threshold logic for signatures
  *
@@ -672,19 +701,19 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
     if (td->type == TYPE_SUPPRESS) {
         ret = ThresholdHandlePacketSuppress(p,td,s->id,s->gid);
     } else if (td->track == TRACK_SRC) {
-        Host *src = HostGetHostFromHash(&p->src);
+        Host *src = ThresholdHostGet(&p->src);
         if (src) {
             ret = ThresholdHandlePacketHost(src,p,td,s->id,s->gid,pa);
             HostRelease(src);
         }
     } else if (td->track == TRACK_DST) {
-        Host *dst = HostGetHostFromHash(&p->dst);
+        Host *dst = ThresholdHostGet(&p->dst);
         if (dst) {
             ret = ThresholdHandlePacketHost(dst,p,td,s->id,s->gid,pa);
             HostRelease(dst);
         }
     } else if (td->track == TRACK_BOTH) {
-        IPPair *pair = IPPairGetIPPairFromHash(&p->src, &p->dst);
+        IPPair *pair = ThresholdIPPairGet(&p->src, &p->dst);
         if (pair) {
             ret = ThresholdHandlePacketIPPair(pair, p, td, s->id, s->gid, pa);
             IPPairRelease(pair);
@@ -43,6 +43,7 @@
 #include "detect-engine-port.h"
 #include "detect-engine-prefilter.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-sampling.h"
 #include "detect-engine-iponly.h"
 #include "detect-engine-tag.h"
 
@@ -1971,6 +1972,24 @@ static int DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx)
             break;
     }
 
+    int sampling_enabled = 1;
+    (void)ConfGetBool("detect.sampling.enabled", &sampling_enabled);
+    de_ctx->sampling_rate = 0;
+    if (sampling_enabled) {
+        intmax_t rate = DETECT_SAMPLING_DEFAULT_RATE;
+        if (ConfGetInt("detect.sampling.rate", &rate) == 1 &&
+                (rate <= 0 || rate > UINT32_MAX)) {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "invalid value "
+                    "for detect.sampling.rate, using default %u",
+                    DETECT_SAMPLING_DEFAULT_RATE);
+            rate = DETECT_SAMPLING_DEFAULT_RATE;
+        }
+        de_ctx->sampling_rate = (uint32_t)rate;
+        SCLogConfig("sampling: timing 1 in %u rule inspections", de_ctx->sampling_rate);
+    } else {
+        SCLogConfig("sampling: disabled");
+    }
+
     return 0;
 }
 
@@ -2241,13 +2260,24 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
         return TM_ECODE_FAILED;
     }
 
-    /* Allocate space for base64 decoded data. */
+    /* Allocate space for base64 decoded data: one block split over
+     * the cache entries, as many as fit the cache memory limit. */
     if (de_ctx->base64_decode_max_len) {
-        det_ctx->base64_decoded = SCMalloc(de_ctx->base64_decode_max_len);
-        if (det_ctx->base64_decoded == NULL) {
+        const uint32_t max_len = de_ctx->base64_decode_max_len;
+        uint32_t entries = DETECT_BASE64_CACHE_MAX_BYTES / max_len;
+        entries = MAX(1, MIN(entries, DETECT_BASE64_CACHE_SIZE));
+
+        uint8_t *block = SCMalloc((size_t)entries * max_len);
+        if (block == NULL) {
             return TM_ECODE_FAILED;
         }
-        det_ctx->base64_decoded_len_max = de_ctx->base64_decode_max_len;
+        for (uint32_t i = 0; i < entries; i++) {
+            det_ctx->base64_cache[i].decoded = block + (size_t)i * max_len;
+        }
+        det_ctx->base64_cache_size = entries;
+        det_ctx->base64_cache_next = 0;
+        det_ctx->base64_decoded = block;
+        det_ctx->base64_decoded_len_max = max_len;
         det_ctx->base64_decoded_len = 0;
     }
 
@@ -2264,6 +2294,11 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
 
     DetectEngineThreadCtxInitKeywords(de_ctx, det_ctx);
     DetectEngineThreadCtxInitGlobalKeywords(det_ctx);
+    if (DetectSamplingThreadSetup(de_ctx, det_ctx) != 0) {
+        return TM_ECODE_FAILED;
+    }
+    SC_ATOMIC_INIT(det_ctx->srep_seq);
+    SRepThreadRegister(det_ctx);
 #ifdef PROFILING
     SCProfilingRuleThreadSetup(de_ctx->profile_ctx, det_ctx);
     SCProfilingKeywordThreadSetup(de_ctx->profile_keyword_ctx, det_ctx);
@@ -2423,6 +2458,9 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         det_ctx->tenant_array = NULL;
     }
 
+    DetectSamplingThreadCleanup(det_ctx);
+    SRepThreadDeregister(det_ctx);
+
 #ifdef PROFILING
     SCProfilingRuleThreadCleanup(det_ctx);
     SCProfilingKeywordThreadCleanup(det_ctx);
@@ -2462,9 +2500,9 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         SCFree(det_ctx->hcbd);
     }
 
-    /* Decoded base64 data. */
-    if (det_ctx->base64_decoded != NULL) {
-        SCFree(det_ctx->base64_decoded);
+    /* Decoded base64 data, entry 0 holds the block of all entries. */
+    if (det_ctx->base64_cache[0].decoded != NULL) {
+        SCFree(det_ctx->base64_cache[0].decoded);
     }
 
     if (det_ctx->inspect_buffers) {
@@ -2483,6 +2521,9 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         }
         SCFree(det_ctx->multi_inspect_buffers);
     }
+    if (det_ctx->mpm_vector) {
+        SCFree(det_ctx->mpm_vector);
+    }
 
 
     DetectEngineThreadCtxDeinitGlobalKeywords(det_ctx);
@@ -185,22 +185,22 @@ static int DetectHostbitMatchIsset (Packet *p, const DetectXbitsData *fd)
     switch (fd->tracker) {
         case DETECT_XBITS_TRACK_IPSRC:
             if (p->host_src == NULL) {
-                p->host_src = HostLookupHostFromHash(&p->src);
+                p->host_src = HostLookupHostFromHashNoLock(&p->src);
                 if (p->host_src == NULL)
                     return 0;
-            } else
-                HostLock(p->host_src);
+            }
+            HostLock(p->host_src);
 
             r = HostBitIsset(p->host_src,fd->idx, p->ts.tv_sec);
             HostUnlock(p->host_src);
             return r;
         case DETECT_XBITS_TRACK_IPDST:
             if (p->host_dst == NULL) {
-                p->host_dst = HostLookupHostFromHash(&p->dst);
+                p->host_dst = HostLookupHostFromHashNoLock(&p->dst);
                 if (p->host_dst == NULL)
                     return 0;
-            } else
-                HostLock(p->host_dst);
+            }
+            HostLock(p->host_dst);
 
             r = HostBitIsset(p->host_dst,fd->idx, p->ts.tv_sec);
             HostUnlock(p->host_dst);
@@ -215,22 +215,22 @@ static int DetectHostbitMatchIsnotset (Packet *p, const DetectXbitsData *fd)
     switch (fd->tracker) {
         case DETECT_XBITS_TRACK_IPSRC:
             if (p->host_src == NULL) {
-                p->host_src = HostLookupHostFromHash(&p->src);
+                p->host_src = HostLookupHostFromHashNoLock(&p->src);
                 if (p->host_src == NULL)
                     return 1;
-            } else
-                HostLock(p->host_src);
+            }
+            HostLock(p->host_src);
 
             r = HostBitIsnotset(p->host_src,fd->idx, p->ts.tv_sec);
             HostUnlock(p->host_src);
             return r;
         case DETECT_XBITS_TRACK_IPDST:
             if (p->host_dst == NULL) {
-                p->host_dst = HostLookupHostFromHash(&p->dst);
+                p->host_dst = HostLookupHostFromHashNoLock(&p->dst);
                 if (p->host_dst == NULL)
                     return 1;
-            } else
-                HostLock(p->host_dst);
+            }
+            HostLock(p->host_dst);
 
             r = HostBitIsnotset(p->host_dst,fd->idx, p->ts.tv_sec);
             HostUnlock(p->host_dst);
@@ -73,81 +73,72 @@ void DetectIPRepRegister (void)
 
 static uint8_t GetHostRepSrc(Packet *p, uint8_t cat, uint32_t version)
 {
-    uint8_t val = 0;
     Host *h = NULL;
 
     if (p->flags & PKT_HOST_SRC_LOOKED_UP && p->host_src == NULL) {
         return 0;
     } else if (p->host_src != NULL) {
         h = (Host *)p->host_src;
-        HostLock(h);
     } else {
-        h = HostLookupHostFromHash(&(p->src));
+        /* the packet keeps the reference */
+        h = HostLookupHostFromHashNoLock(&(p->src));
 
         p->flags |= PKT_HOST_SRC_LOOKED_UP;
 
         if (h == NULL)
             return 0;
 
-        HostReference(&p->host_src, h);
+        p->host_src = h;
     }
 
-    if (h->iprep == NULL) {
-        HostRelease(h);
+    /* no need to lock the host: the iprep storage is only freed once the
+     * host is unreferenced, and is updated in place by reloads */
+    const SReputation *r = (const SReputation *)h->iprep;
+    if (r == NULL)
         return 0;
-    }
-
-    SReputation *r = (SReputation *)h->iprep;
 
     /* allow higher versions as this happens during
      * rule reload */
     if (r->version >= version)
-        val = r->rep[cat];
-    else
-        SCLogDebug("version mismatch %u != %u", r->version, version);
+        return r->rep[cat];
 
-    HostRelease(h);
-    return val;
+    SCLogDebug("version mismatch %u != %u", r->version, version);
+    return 0;
 }
 
 static uint8_t GetHostRepDst(Packet *p, uint8_t cat, uint32_t version)
 {
-    uint8_t val = 0;
     Host *h = NULL;
 
     if (p->flags & PKT_HOST_DST_LOOKED_UP && p->host_dst == NULL) {
         return 0;
     } else if (p->host_dst != NULL) {
         h = (Host *)p->host_dst;
-        HostLock(h);
     } else {
-        h = HostLookupHostFromHash(&(p->dst));
+        /* the packet keeps the reference */
+        h = HostLookupHostFromHashNoLock(&(p->dst));
 
         p->flags |= PKT_HOST_DST_LOOKED_UP;
 
-        if (h == NULL) {
+        if (h == NULL)
             return 0;
-        }
 
-        HostReference(&p->host_dst, h);
+        p->host_dst = h;
     }
 
-    if (h->iprep == NULL) {
-        HostRelease(h);
+    /* no need to lock the host: the iprep storage is only freed once the
+     * host is unreferenced, and is updated in place by reloads */
+    const SReputation *r = (const SReputation *)h->iprep;
+    if (r == NULL)
         return 0;
-    }
-
-    SReputation *r = (SReputation *)h->iprep;
 
     /* allow higher versions as this happens during
      * rule reload */
     if (r->version >= version)
-        val = r->rep[cat];
-    else
-        SCLogDebug("version mismatch %u != %u", r->version, version);
+        return r->rep[cat];
 
-    HostRelease(h);
-    return val;
+    SCLogDebug("version mismatch %u != %u", r->version, version);
+    return 0;
 }
 
 static inline int RepMatch(uint8_t op, uint8_t val1, uint8_t val2)
@@ -162,19 +153,10 @@ static inline int RepMatch(uint8_t op, uint8_t val1, uint8_t val2)
     return 0;
 }
 
-/*
- * returns 0: no match
- *         1: match
- *        -1: error
- */
-static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
-        const Signature *s, const SigMatchCtx *ctx)
+static int DetectIPRepMatchTree(Packet *p, const DetectIPRepData *rd,
+        SRepCIDRTree *cidr_ctx)
 {
-    const DetectIPRepData *rd = (const DetectIPRepData *)ctx;
-    if (rd == NULL)
-        return 0;
-
-    uint32_t version = det_ctx->de_ctx->srep_version;
+    uint32_t version = cidr_ctx->version;
     uint8_t val = 0;
 
     SCLogDebug("rd->cmd %u", rd->cmd);
@@ -182,14 +164,14 @@ static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
         case DETECT_IPREP_CMD_ANY:
             val = GetHostRepSrc(p, rd->cat, version);
             if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepSrc(cidr_ctx, p, rd->cat, version);
             if (val > 0) {
                 if (RepMatch(rd->op, val, rd->val) == 1)
                     return 1;
             }
             val = GetHostRepDst(p, rd->cat, version);
             if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepDst(cidr_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -199,7 +181,7 @@ static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
             val = GetHostRepSrc(p, rd->cat, version);
             SCLogDebug("checking src -- val %u (looking for cat %u, val %u)", val, rd->cat, rd->val);
             if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepSrc(cidr_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -209,7 +191,7 @@ static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
             SCLogDebug("checking dst");
             val = GetHostRepDst(p, rd->cat, version);
             if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepDst(cidr_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -218,12 +200,12 @@ static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
         case DETECT_IPREP_CMD_BOTH:
             val = GetHostRepSrc(p, rd->cat, version);
             if (val == 0)
-                val = SRepCIDRGetIPRepSrc(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepSrc(cidr_ctx, p, rd->cat, version);
             if (val == 0 || RepMatch(rd->op, val, rd->val) == 0)
                 return 0;
             val = GetHostRepDst(p, rd->cat, version);
             if (val == 0)
-                val = SRepCIDRGetIPRepDst(det_ctx->de_ctx->srepCIDR_ctx, p, rd->cat, version);
+                val = SRepCIDRGetIPRepDst(cidr_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -233,6 +215,33 @@ static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
     return 0;
 }
 
+/*
+ * returns 0: no match
+ *         1: match
+ *        -1: error
+ */
+static int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
+        const Signature *s, const SigMatchCtx *ctx)
+{
+    const DetectIPRepData *rd = (const DetectIPRepData *)ctx;
+    if (rd == NULL)
+        return 0;
+
+    /* iprep-reload replaces the tree, and frees the old one once this
+     * thread is seen outside of this section. The add is a full barrier,
+     * so the tree is loaded after entering: it pairs with the barrier
+     * between the publish and the check in SRepReloadDo. The field is
+     * volatile, so it's loaded once: one tree and its version are used
+     * for the whole match. */
+    (void)SC_ATOMIC_ADD(det_ctx->srep_seq, 1);
+    SRepCIDRTree *cidr_ctx = det_ctx->de_ctx->srepCIDR_ctx;
+    int r = 0;
+    if (cidr_ctx != NULL)
+        r = DetectIPRepMatchTree(p, rd, cidr_ctx);
+    (void)SC_ATOMIC_ADD(det_ctx->srep_seq, 1);
+    return r;
+}
+
 int DetectIPRepSetup (DetectEngineCtx *de_ctx, Signature *s, const char *rawstr)
 {
     DetectIPRepData *cd = NULL;
@@ -990,6 +999,146 @@ end:
     HostShutdown();
     return result;
 }
+
+static int DetectIPRepTestReloadMatch(ThreadVars *th_v, DetectEngineCtx *de_ctx,
+        DetectEngineThreadCtx *det_ctx, const char *src)
+{
+    Packet *p = UTHBuildPacketSrcDst((uint8_t *)"lalala", 6, IPPROTO_TCP,
+            src, "192.168.0.2");
+    if (p == NULL)
+        return -1;
+
+    SigMatchSignatures(th_v, de_ctx, det_ctx, p);
+    int cnt = p->alerts.cnt;
+    if (p->host_src != NULL)
+        HostDecrUsecnt((Host *)p->host_src);
+    UTHFreePacket(p);
+    return cnt;
+}
+
+/** \test iprep-reload replaces netblocks and outdates hosts */
+static int DetectIPRepTest10(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    const char *rep1 = "10.0.0.0/24,1,20\n10.0.1.5,1,30\n";
+    const char *rep2 = "10.0.2.0/24,1,20\n";
+
+    HostInitConfig(HOST_QUIET);
+    memset(&th_v, 0, sizeof(th_v));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    SRepInit(de_ctx);
+    SRepResetVersion();
+
+    FILE *fd = DetectIPRepGenerateCategoriesDummy();
+    FAIL_IF_NULL(fd);
+    FAIL_IF(SRepLoadCatFileFromFD(fd) < 0);
+
+    fd = SCFmemopen((void *)rep1, strlen(rep1), "r");
+    FAIL_IF_NULL(fd);
+    FAIL_IF(SRepLoadFileFromFD(de_ctx->srepCIDR_ctx, fd) < 0);
+    fclose(fd);
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(iprep:src,BadHosts,>,9; sid:1;)"));
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.0.1") == 1);
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.1.5") == 1);
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.2.1") == 0);
+
+    SRepCIDRTree *old = de_ctx->srepCIDR_ctx;
+    uint32_t old_version = old->version;
+    fd = SCFmemopen((void *)rep2, strlen(rep2), "r");
+    FAIL_IF_NULL(fd);
+    FAIL_IF_NOT(SRepReloadFromFD(de_ctx, fd) == 0);
+    fclose(fd);
+    FAIL_IF(de_ctx->srepCIDR_ctx == old);
+    /* no thread in a match: old tree freed right away */
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx_retired == NULL);
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx->version > old_version);
+
+    /* no rebuild of the engine or the thread ctx */
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.0.1") == 0);
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.1.5") == 0);
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.2.1") == 1);
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    HostShutdown();
+    PASS;
+}
+
+/** \test iprep-reload keeps the replaced tree while a thread may use it,
+ *        and refuses to reload until it's freed */
+static int DetectIPRepTest11(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    const char *rep1 = "10.0.0.0/24,1,20\n";
+    const char *rep2 = "10.0.2.0/24,1,20\n";
+
+    HostInitConfig(HOST_QUIET);
+    memset(&th_v, 0, sizeof(th_v));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    SRepInit(de_ctx);
+    SRepResetVersion();
+
+    FILE *fd = DetectIPRepGenerateCategoriesDummy();
+    FAIL_IF_NULL(fd);
+    FAIL_IF(SRepLoadCatFileFromFD(fd) < 0);
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(iprep:src,BadHosts,>,9; sid:1;)"));
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    /* the thread is in a match that loaded the current tree */
+    (void)SC_ATOMIC_ADD(det_ctx->srep_seq, 1);
+
+    SRepCIDRTree *old = de_ctx->srepCIDR_ctx;
+    fd = SCFmemopen((void *)rep1, strlen(rep1), "r");
+    FAIL_IF_NULL(fd);
+    FAIL_IF_NOT(SRepReloadFromFD(de_ctx, fd) == 0);
+    fclose(fd);
+    FAIL_IF(de_ctx->srepCIDR_ctx == old);
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx_retired == old);
+
+    /* still in the same match: refuse */
+    SRepCIDRTree *cur = de_ctx->srepCIDR_ctx;
+    fd = SCFmemopen((void *)rep2, strlen(rep2), "r");
+    FAIL_IF_NULL(fd);
+    FAIL_IF_NOT(SRepReloadFromFD(de_ctx, fd) == -2);
+    fclose(fd);
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx == cur);
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx_retired == old);
+
+    /* match done: the retired tree is freed and the reload goes through */
+    (void)SC_ATOMIC_ADD(det_ctx->srep_seq, 1);
+    fd = SCFmemopen((void *)rep2, strlen(rep2), "r");
+    FAIL_IF_NULL(fd);
+    FAIL_IF_NOT(SRepReloadFromFD(de_ctx, fd) == 0);
+    fclose(fd);
+    FAIL_IF(de_ctx->srepCIDR_ctx == cur);
+    FAIL_IF_NOT(de_ctx->srepCIDR_ctx_retired == NULL);
+
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.0.1") == 0);
+    FAIL_IF_NOT(DetectIPRepTestReloadMatch(&th_v, de_ctx, det_ctx, "10.0.2.1") == 1);
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    HostShutdown();
+    PASS;
+}
 #endif /* UNITTESTS */
 
 /**
@@ -1007,5 +1156,7 @@ void IPRepRegisterTests(void)
     UtRegisterTest("DetectIPRepTest07", DetectIPRepTest07);
     UtRegisterTest("DetectIPRepTest08", DetectIPRepTest08);
     UtRegisterTest("DetectIPRepTest09", DetectIPRepTest09);
+    UtRegisterTest("DetectIPRepTest10", DetectIPRepTest10);
+    UtRegisterTest("DetectIPRepTest11", DetectIPRepTest11);
 #endif /* UNITTESTS */
 }
@@ -40,6 +40,7 @@
 #include "detect-engine-sigorder.h"
 #include "detect-engine-mpm.h"
 #include "detect-engine-state.h"
+#include "detect-engine-prefilter-pcre.h"
 
 #include "util-var-name.h"
 #include "util-unittest-helper.h"
@@ -47,6 +48,8 @@
 #include "util-unittest.h"
 #include "util-print.h"
 #include "util-pool.h"
+#include "util-spm-bs.h"
+#include "util-profiling.h"
 
 #include "conf.h"
 #include "app-layer.h"
@@ -75,8 +78,42 @@ static pcre_extra *parse_regex_study;
 static pcre *parse_capture_regex;
 static pcre_extra *parse_capture_regex_study;
 
+/* skip pcre_exec if the literal prefix of the regex is not in the buffer */
+static int pcre_prefix_prescan = 0;
+
 #ifdef PCRE_HAVE_JIT
 static int pcre_use_jit = 1;
+
+/* JIT stack size per detect thread. The default stack PCRE uses is
+ * only 32k, regexes needing more fail to match. */
+#define PCRE_JIT_STACK_START    (32 * 1024)
+#define PCRE_JIT_STACK_MAX      (512 * 1024)
+
+static int pcre_jit_thread_id = -1;
+/* stack of the thread's det_ctx, handed to PCRE by DetectPcreJitStack() */
+static __thread pcre_jit_stack *pcre_thread_jit_stack = NULL;
+
+static pcre_jit_stack *DetectPcreJitStack(void *data)
+{
+    return pcre_thread_jit_stack;
+}
+
+static void *DetectPcreThreadInit(void *data)
+{
+    pcre_jit_stack *stack = pcre_jit_stack_alloc(PCRE_JIT_STACK_START,
+            PCRE_JIT_STACK_MAX);
+    if (stack == NULL) {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "failed to allocate PCRE JIT stack, "
+                "using the default");
+    }
+    return stack;
+}
+
+static void DetectPcreThreadFree(void *ctx)
+{
+    if (ctx != NULL)
+        pcre_jit_stack_free((pcre_jit_stack *)ctx);
+}
 #endif
 
 static int DetectPcreSetup (DetectEngineCtx *, Signature *, const char *);
@@ -124,6 +161,12 @@ void DetectPcreRegister (void)
         }
     }
 
+    int prescan = 0;
+    if (ConfGetBool("pcre.prefix-prescan", &prescan) == 1 && prescan) {
+        pcre_prefix_prescan = 1;
+        SCLogConfig("PCRE literal prefix prescan enabled");
+    }
+
     DetectSetupParseRegexes(PARSE_REGEX, &parse_regex, &parse_regex_study);
 
     /* setup the capture regex, as it needs PCRE_UNGREEDY we do it manually */
@@ -148,12 +191,47 @@ void DetectPcreRegister (void)
         SCLogConfig("PCRE won't use JIT as OS doesn't allow RWX pages");
         pcre_use_jit = 0;
     }
+    if (pcre_use_jit) {
+        pcre_jit_thread_id = DetectRegisterThreadCtxGlobalFuncs("pcre",
+                DetectPcreThreadInit, NULL, DetectPcreThreadFree);
+    }
+#endif
+
+#ifdef BUILD_HYPERSCAN
+    sigmatch_table[DETECT_PCRE].SupportsPrefilter = PrefilterPcreIsPrefilterable;
+    sigmatch_table[DETECT_PCRE].SetupPrefilter = PrefilterSetupPcre;
 #endif
 
     DetectParseRegexAddToFreeList(parse_capture_regex, parse_capture_regex_study);
     return;
 }
 
+/**
+ * \brief Check if the literal prefix of the regex is in the buffer.
+ */
+static inline bool DetectPcrePrefixFound(const DetectPcreData *pe,
+        const uint8_t *buf, uint32_t buf_len)
+{
+    if (buf_len < pe->prefix_len)
+        return false;
+
+    if (pe->flags & DETECT_PCRE_CASELESS) {
+        return BasicSearchNocase(buf, buf_len, pe->prefix, pe->prefix_len) != NULL;
+    }
+
+    /* memchr for the first byte, then compare the rest */
+    const uint8_t *end = buf + buf_len - pe->prefix_len + 1;
+    while (buf < end) {
+        const uint8_t *c = memchr(buf, pe->prefix[0], end - buf);
+        if (c == NULL)
+            return false;
+        if (memcmp(c + 1, pe->prefix + 1, pe->prefix_len - 1) == 0)
+            return true;
+        buf = c + 1;
+    }
+    return false;
+}
+
 /**
  * \brief Match a regex on a single payload.
  *
@@ -195,8 +273,17 @@ int DetectPcrePayloadMatch(DetectEngineThreadCtx *det_ctx, const Signature *s,
         start_offset = (payload + det_ctx->pcre_match_start_offset - ptr);
     }
 
-    /* run the actual pcre detection */
-    ret = pcre_exec(pe->re, pe->sd, (char *)ptr, len, start_offset, 0, ov, MAX_SUBSTRINGS);
+    if (pe->prefix_len > 0 && start_offset >= 0 && start_offset <= len &&
+            !DetectPcrePrefixFound(pe, ptr + start_offset, len - start_offset)) {
+        ret = PCRE_ERROR_NOMATCH;
+    } else {
+#ifdef PCRE_HAVE_JIT
+        pcre_thread_jit_stack = DetectThreadCtxGetGlobalKeywordThreadCtx(det_ctx,
+                pcre_jit_thread_id);
+#endif
+        /* run the actual pcre detection */
+        ret = pcre_exec(pe->re, pe->sd, (char *)ptr, len, start_offset, 0, ov, MAX_SUBSTRINGS);
+    }
     SCLogDebug("ret %d (negating %s)", ret, (pe->flags & DETECT_PCRE_NEGATE) ? "set" : "not set");
 
     if (ret == PCRE_ERROR_NOMATCH) {
@@ -276,12 +363,59 @@ int DetectPcrePayloadMatch(DetectEngineThreadCtx *det_ctx, const Signature *s,
         }
 
     } else {
-        SCLogDebug("pcre had matching error");
+        SCLogDebug("pcre had matching error %d", ret);
+        if (ret == PCRE_ERROR_MATCHLIMIT || ret == PCRE_ERROR_RECURSIONLIMIT) {
+            RULE_PROFILING_PCRE_LIMIT(det_ctx, s);
+        }
         ret = 0;
     }
     SCReturnInt(ret);
 }
 
+/** \internal
+ *  \brief get the literal every match of the regex has to start with
+ *
+ *  Conservative: stops at the first metacharacter, drops a literal
+ *  that is made optional by a quantifier and gives up on alternations.
+ */
+static void DetectPcreSetupPrefix(DetectPcreData *pd, const char *re, int opts)
+{
+    pd->prefix_len = 0;
+
+    if (opts & PCRE_EXTENDED || strchr(re, '|') != NULL)
+        return;
+
+    uint8_t len = 0;
+    const char *c = re;
+    while (*c != '\0' && len < DETECT_PCRE_PREFIX_MAX) {
+        char lit;
+        if (*c == '\\') {
+            /* escaped punctuation is literal, escaped alnum are classes,
+             * assertions or escapes we don't decode */
+            if (c[1] == '\0' || isalnum((unsigned char)c[1]))
+                break;
+            lit = c[1];
+            c += 2;
+        } else if (strchr("^$.[()?*+{", *c) != NULL) {
+            break;
+        } else {
+            lit = *c;
+            c++;
+        }
+
+        if (*c == '?' || *c == '*' || *c == '{')
+            break;
+        pd->prefix[len++] = (opts & PCRE_CASELESS) ?
+            u8_tolower((unsigned char)lit) : (uint8_t)lit;
+        if (*c == '+')
+            break;
+    }
+
+    /* a single byte doesn't reject enough to be worth it */
+    if (len >= 2)
+        pd->prefix_len = len;
+}
+
 static int DetectPcreSetList(int list, int set)
 {
     if (list != DETECT_SM_LIST_NOTSET) {
@@ -632,9 +766,24 @@ static DetectPcreData *DetectPcreParse (DetectEngineCtx *de_ctx, const char *reg
         SCLogDebug("PCRE JIT compiler does not support: %s. "
                 "Falling back to regular PCRE handling (%s:%d)",
                 regexstr, de_ctx->rule_file, de_ctx->rule_line);
+    } else {
+        pcre_assign_jit_stack(pd->sd, DetectPcreJitStack, NULL);
     }
 #endif /*PCRE_HAVE_JIT*/
 
+    if (pcre_prefix_prescan)
+        DetectPcreSetupPrefix(pd, re, opts);
+
+#ifdef BUILD_HYPERSCAN
+    /* relative and negated pcre's can't tell if a rule can match from
+     * a scan of the whole buffer. If Hyperscan supports the regex is
+     * only checked once a pcre prefilter is set up for the rule. */
+    if (!(pd->flags & (DETECT_PCRE_RELATIVE|DETECT_PCRE_NEGATE))) {
+        pd->set_re = SCStrdup(re);
+        pd->set_opts = opts;
+    }
+#endif
+
     if (pd->sd == NULL)
         pd->sd = (pcre_extra *) SCCalloc(1,sizeof(pcre_extra));
 
@@ -669,6 +818,8 @@ error:
         pcre_free(pd->re);
     if (pd != NULL && pd->sd != NULL)
         pcre_free_study(pd->sd);
+    if (pd != NULL && pd->set_re != NULL)
+        SCFree(pd->set_re);
     if (pd)
         SCFree(pd);
     return NULL;
@@ -900,6 +1051,8 @@ static void DetectPcreFree(void *ptr)
         pcre_free(pd->re);
     if (pd->sd != NULL)
         pcre_free_study(pd->sd);
+    if (pd->set_re != NULL)
+        SCFree(pd->set_re);
 
     SCFree(pd);
     return;
@@ -3481,6 +3634,97 @@ static int DetectPcreParseCaptureTest(void)
     PASS;
 }
 
+/** \test literal prefix extraction for the prescan */
+static int DetectPcreTestPrefix01(void)
+{
+    DetectPcreData pd;
+    memset(&pd, 0, sizeof(pd));
+
+    DetectPcreSetupPrefix(&pd, "GET \\/[a-z]+", 0);
+    FAIL_IF_NOT(pd.prefix_len == 5);
+    FAIL_IF(memcmp(pd.prefix, "GET /", 5) != 0);
+
+    /* 'c' is optional */
+    DetectPcreSetupPrefix(&pd, "abc?def", 0);
+    FAIL_IF_NOT(pd.prefix_len == 2);
+    FAIL_IF(memcmp(pd.prefix, "ab", 2) != 0);
+
+    DetectPcreSetupPrefix(&pd, "UsEr-AgEnt", PCRE_CASELESS);
+    FAIL_IF_NOT(pd.prefix_len == 10);
+    FAIL_IF(memcmp(pd.prefix, "user-agent", 10) != 0);
+
+    DetectPcreSetupPrefix(&pd, "abcdefghijklmnopqrstuvwxyz", 0);
+    FAIL_IF_NOT(pd.prefix_len == DETECT_PCRE_PREFIX_MAX);
+
+    DetectPcreSetupPrefix(&pd, "abc|def", 0);
+    FAIL_IF_NOT(pd.prefix_len == 0);
+    DetectPcreSetupPrefix(&pd, "\\d+abc", 0);
+    FAIL_IF_NOT(pd.prefix_len == 0);
+    DetectPcreSetupPrefix(&pd, "^abc", 0);
+    FAIL_IF_NOT(pd.prefix_len == 0);
+    DetectPcreSetupPrefix(&pd, "a(bc)", 0);
+    FAIL_IF_NOT(pd.prefix_len == 0);
+    PASS;
+}
+
+/** \test pcre with the prefix prescan on: the prescan either finds the
+ *        prefix and pcre decides, or it doesn't and pcre isn't run */
+static int DetectPcreTestPrefix02(void)
+{
+    const int prescan = pcre_prefix_prescan;
+    pcre_prefix_prescan = 1;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/GET \\/[a-z]+\\.php/\"; sid:1;)");
+    const int prefix_len = (s != NULL && s->init_data->smlists[DETECT_SM_LIST_PMATCH] != NULL) ?
+        ((DetectPcreData *)s->init_data->smlists[DETECT_SM_LIST_PMATCH]->ctx)->prefix_len : -1;
+    DetectEngineCtxFree(de_ctx);
+
+    struct {
+        const char *buf;
+        const char *sig;
+        int match;
+    } tests[] = {
+        /* prefix found, pcre matches */
+        { "xx GET /index.php HTTP/1.0", "pcre:\"/GET \\/[a-z]+\\.php/\";", 1 },
+        /* prefix found twice, pcre matches on the second */
+        { "GET /1 GET /index.php", "pcre:\"/GET \\/[a-z]+\\.php/\";", 1 },
+        /* prefix found, pcre fails */
+        { "xx GET /123.php HTTP/1.0", "pcre:\"/GET \\/[a-z]+\\.php/\";", 0 },
+        /* prefix not found */
+        { "xx POST /index.php HTTP/1.0", "pcre:\"/GET \\/[a-z]+\\.php/\";", 0 },
+        /* caseless prefix */
+        { "xx uSeR-aGeNt: abc", "pcre:\"/User-Agent: [a-z]+/i\";", 1 },
+        { "xx User-Agent: 123", "pcre:\"/User-Agent: [a-z]+/i\";", 0 },
+        /* negated, prefix not found means a match */
+        { "xx POST /index.php HTTP/1.0", "pcre:!\"/GET \\/[a-z]+/\";", 1 },
+        { "xx GET /index.php HTTP/1.0", "pcre:!\"/GET \\/[a-z]+/\";", 0 },
+    };
+
+    int result = 1;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        char sig[256];
+        snprintf(sig, sizeof(sig), "alert tcp any any -> any any (%s sid:1;)",
+                tests[i].sig);
+        Packet *p = UTHBuildPacket((uint8_t *)tests[i].buf,
+                strlen(tests[i].buf), IPPROTO_TCP);
+        if (p == NULL || UTHPacketMatchSig(p, sig) != tests[i].match) {
+            SCLogDebug("test %u failed", (uint32_t)i);
+            result = 0;
+        }
+        if (p != NULL)
+            UTHFreePacket(p);
+    }
+
+    pcre_prefix_prescan = prescan;
+    FAIL_IF_NOT(prefix_len == 5);
+    FAIL_IF_NOT(result);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -3569,6 +3813,10 @@ static void DetectPcreRegisterTests(void)
 
     UtRegisterTest("DetectPcreParseHttpHost", DetectPcreParseHttpHost);
     UtRegisterTest("DetectPcreParseCaptureTest", DetectPcreParseCaptureTest);
+    UtRegisterTest("DetectPcreTestPrefix01", DetectPcreTestPrefix01);
+    UtRegisterTest("DetectPcreTestPrefix02", DetectPcreTestPrefix02);
+
+    PrefilterPcreRegisterTests();
 
 #endif /* UNITTESTS */
 }
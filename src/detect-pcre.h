@@ -33,6 +33,7 @@
 #define DETECT_PCRE_NEGATE              0x00080
 
 #define DETECT_PCRE_CAPTURE_MAX         8
+#define DETECT_PCRE_PREFIX_MAX          16
 
 typedef struct DetectPcreData_ {
     /* pcre options */
@@ -43,6 +44,16 @@ typedef struct DetectPcreData_ {
     uint8_t idx;
     uint8_t captypes[DETECT_PCRE_CAPTURE_MAX];
     uint32_t capids[DETECT_PCRE_CAPTURE_MAX];
+    /* literal every match starts with, used to skip pcre_exec on
+     * buffers that don't contain it. Lowercase if caseless. */
+    uint8_t prefix_len;
+    uint8_t prefix[DETECT_PCRE_PREFIX_MAX];
+    /* regex and compile options for the regex-set prefilter. NULL if
+     * the pcre can't be used as prefilter. Hyperscan support for the
+     * regex is checked on first use, set_checked tells if that's done. */
+    char *set_re;
+    int set_opts;
+    bool set_checked;
 } DetectPcreData;
 
 /* prototypes */
@@ -114,9 +114,10 @@ static int DetectIPPairbitMatchSet (Packet *p, const DetectXbitsData *fd)
 static int DetectIPPairbitMatchIsset (Packet *p, const DetectXbitsData *fd)
 {
     int r = 0;
-    IPPair *pair = IPPairLookupIPPairFromHash(&p->src, &p->dst);
+    IPPair *pair = IPPairLookupIPPairFromHashNoLock(&p->src, &p->dst);
     if (pair == NULL)
         return 0;
+    IPPairLock(pair);
 
     r = IPPairBitIsset(pair,fd->idx,p->ts.tv_sec);
     IPPairRelease(pair);
@@ -126,9 +127,10 @@ static int DetectIPPairbitMatchIsset (Packet *p, const DetectXbitsData *fd)
 static int DetectIPPairbitMatchIsnotset (Packet *p, const DetectXbitsData *fd)
 {
     int r = 0;
-    IPPair *pair = IPPairLookupIPPairFromHash(&p->src, &p->dst);
+    IPPair *pair = IPPairLookupIPPairFromHashNoLock(&p->src, &p->dst);
     if (pair == NULL)
         return 1;
+    IPPairLock(pair);
 
     r = IPPairBitIsnotset(pair,fd->idx,p->ts.tv_sec);
     IPPairRelease(pair);
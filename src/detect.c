@@ -48,6 +48,7 @@
 #include "detect-engine-prefilter.h"
 #include "detect-engine-state.h"
 #include "detect-engine-analyzer.h"
+#include "detect-engine-sampling.h"
 
 #include "detect-engine-filedata.h"
 
@@ -787,6 +788,7 @@ static inline void DetectRulePacketRules(
     }
     while (match_cnt--) {
         RULE_PROFILING_START(p);
+        SAMPLING_RULE_START(det_ctx);
         uint8_t alert_flags = 0;
         bool state_alert = false;
 #ifdef PROFILING
@@ -900,6 +902,7 @@ static inline void DetectRulePacketRules(
 next:
         DetectVarProcessList(det_ctx, pflow, p);
         DetectReplaceFree(det_ctx);
+        SAMPLING_PACKET_RULE_END(det_ctx, s);
         RULE_PROFILING_END(det_ctx, s, smatch, p);
 
         det_ctx->flags = 0;
@@ -1218,6 +1221,7 @@ static bool DetectRunTxInspectRule(ThreadVars *tv,
                 TRACE_SID_TXS(s->id, tx, "stream skipped, stored result %d used instead", match);
             } else {
                 KEYWORD_PROFILING_SET_LIST(det_ctx, engine->sm_list);
+                SAMPLING_LIST_START(det_ctx);
                 if (engine->Callback) {
                     match = engine->Callback(tv, de_ctx, det_ctx,
                             s, engine->smd, f, flow_flags, alstate, tx->tx_ptr, tx->tx_id);
@@ -1226,6 +1230,7 @@ static bool DetectRunTxInspectRule(ThreadVars *tv,
                     match = engine->v2.Callback(de_ctx, det_ctx, engine,
                             s, f, flow_flags, alstate, tx->tx_ptr, tx->tx_id);
                 }
+                SAMPLING_LIST_END(det_ctx, engine->sm_list);
                 TRACE_SID_TXS(s->id, tx, "engine %p match %d", engine, match);
                 if (engine->stream) {
                     can->stream_stored = true;
@@ -1369,7 +1374,8 @@ static void DetectRunTx(ThreadVars *tv,
     uint64_t tx_id_min = AppLayerParserGetTransactionInspectId(f->alparser, flow_flags);
     const int tx_end_state = AppLayerParserGetStateProgressCompletionStatus(alproto, flow_flags);
 
-    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxIterator(ipproto, alproto);
+    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxListIterator(ipproto, alproto,
+            alstate, tx_id_min, total_txs);
     AppLayerGetTxIterState state;
     memset(&state, 0, sizeof(state));
 
@@ -1542,8 +1548,10 @@ static void DetectRunTx(ThreadVars *tv,
 
             /* call individual rule inspection */
             RULE_PROFILING_START(p);
+            SAMPLING_RULE_START(det_ctx);
             const int r = DetectRunTxInspectRule(tv, de_ctx, det_ctx, p, f, flow_flags,
                     alstate, &tx, s, inspect_flags, can, scratch);
+            SAMPLING_RULE_END(det_ctx, s);
             if (r == 1) {
                 /* match */
                 DetectRunPostMatch(tv, det_ctx, p, s);
@@ -42,6 +42,7 @@
 #include "util-debug.h"
 #include "util-error.h"
 #include "util-radix-tree.h"
+#include "util-lpm.h"
 #include "util-file.h"
 #include "reputation.h"
 
@@ -619,8 +620,8 @@ typedef struct DetectVarList_ {
 } DetectVarList;
 
 typedef struct DetectEngineIPOnlyThreadCtx_ {
-    uint8_t *sig_match_array; /* bit array of sig nums */
-    uint32_t sig_match_size;  /* size in bytes of the array */
+    uint64_t *sig_match_array; /* bit array of sig nums */
+    uint32_t sig_match_size;   /* size in 64 bit words of the array */
 } DetectEngineIPOnlyThreadCtx;
 
 /** \brief IP only rules matching ctx. */
@@ -633,6 +634,11 @@ typedef struct DetectEngineIPOnlyCtx_ {
     SCRadixTree *tree_ipv4src, *tree_ipv4dst;
     SCRadixTree *tree_ipv6src, *tree_ipv6dst;
 
+    /* Lookup tables compiled from the trees. NULL if compiling failed,
+     * in which case the trees are used directly. */
+    SCLpmTable *lpm_ipv4src, *lpm_ipv4dst;
+    SCLpmTable *lpm_ipv6src, *lpm_ipv6dst;
+
     /* Used to build the radix trees */
     IPOnlyCIDRItem *ip_src, *ip_dst;
 
@@ -724,11 +730,13 @@ typedef struct DetectEngineCtx_ {
     Signature *sig_list;
     uint32_t sig_cnt;
 
-    /* version of the srep data */
-    uint32_t srep_version;
-
-    /* reputation for netblocks */
-    SRepCIDRTree *srepCIDR_ctx;
+    /* reputation for netblocks, along with the version of the srep data.
+     * Replaced by iprep-reload while the engine is in use, so packet
+     * threads load it once per match. */
+    SRepCIDRTree * volatile srepCIDR_ctx;
+    /* tree replaced by an iprep-reload that packet threads may still be
+     * using, freed by the next reload once they are done with it */
+    SRepCIDRTree *srepCIDR_ctx_retired;
 
     Signature **sig_array;
     uint32_t sig_array_size; /* size in bytes */
@@ -844,6 +852,9 @@ typedef struct DetectEngineCtx_ {
 #endif
     uint32_t prefilter_maxid;
 
+    /** time one in this many inspections, 0 disables sampling */
+    uint32_t sampling_rate;
+
     char config_prefix[64];
 
     enum DetectEngineType type;
@@ -954,6 +965,23 @@ typedef struct RuleMatchCandidateTx {
     const Signature *s;     /**< ptr to sig */
 } RuleMatchCandidateTx;
 
+/** max number of base64_decode results kept per inspection round */
+#define DETECT_BASE64_CACHE_SIZE        4
+/** memory limit for the base64_decode result cache, per thread */
+#define DETECT_BASE64_CACHE_MAX_BYTES   (256 * 1024)
+
+/** base64_decode result, valid for the packet (ticker) and tx it was
+ *  decoded in */
+typedef struct DetectBase64CacheEntry_ {
+    const uint8_t *src;     /**< start of the encoded data */
+    uint32_t src_len;       /**< number of bytes decoded */
+    int decoded_len;
+    uint64_t ticker;
+    uint64_t tx_id;
+    uint16_t tx_id_set;
+    uint8_t *decoded;       /**< base64_decoded_len_max bytes */
+} DetectBase64CacheEntry;
+
 /**
   * Detection engine thread data.
   */
@@ -1055,6 +1083,11 @@ typedef struct DetectEngineThreadCtx_ {
     MpmThreadCtx mtcs;  /**< thread ctx for stream mpm */
     PrefilterRuleStore pmq;
 
+    /** buffers queued for a vectored mpm search, see PrefilterVectorAdd() */
+    MpmVectorBuffer *mpm_vector;
+    uint32_t mpm_vector_cnt;
+    uint32_t mpm_vector_size;
+
     /** SPM thread context used for scanning. This has been cloned from the
      * prototype held by DetectEngineCtx. */
     SpmThreadCtx *spm_thread_ctx;
@@ -1086,13 +1119,30 @@ typedef struct DetectEngineThreadCtx_ {
     int global_keyword_ctxs_size;
     void **global_keyword_ctxs_array;
 
+    /** result of the last base64_decode, points into base64_cache */
     uint8_t *base64_decoded;
     int base64_decoded_len;
     int base64_decoded_len_max;
+    /** base64_decode results of this inspection round, so rules decoding
+     *  the same data share the work. */
+    DetectBase64CacheEntry base64_cache[DETECT_BASE64_CACHE_SIZE];
+    uint32_t base64_cache_size;     /**< entries in use, memory bound */
+    uint32_t base64_cache_next;     /**< next entry to replace */
 
     AppLayerDecoderEvents *decoder_events;
     uint16_t events;
 
+    /** odd while an iprep match uses de_ctx->srepCIDR_ctx, so iprep-reload
+     *  knows when the tree it replaced can be freed */
+    SC_ATOMIC_DECLARE(uint32_t, srep_seq);
+    /** list of thread ctxs iprep-reload waits for, see reputation.c */
+    struct DetectEngineThreadCtx_ *srep_next;
+
+    /** sampled cost accounting, see detect-engine-sampling.h */
+    struct DetectSamplingThreadData_ *sampling;
+    uint32_t sampling_countdown;    /**< inspections until the next sample, 0 off */
+    bool sampling_rule_active;      /**< current rule is sampled, time its buffers */
+
 #ifdef DEBUG
     uint64_t pkt_stream_add_cnt;
     uint64_t payload_mpm_cnt;
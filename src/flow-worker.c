@@ -169,6 +169,9 @@ static TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *pr
 
     SCLogDebug("packet %"PRIu64, p->pcap_cnt);
 
+    /* tx list may be left over from another flow */
+    AppLayerTxListReset();
+
     /* update time */
     if (!(PKT_IS_PSEUDOPKT(p))) {
         TimeSetByThread(tv->id, &p->ts);
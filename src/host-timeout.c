@@ -171,8 +171,11 @@ uint32_t HostTimeoutHash(struct timeval *ts)
             continue;
         }
 
-        /* we have a host, or more than one */
+        /* we have a host, or more than one. Mark the row as changing
+         * before checking use_cnt, see HostLookupHostFromHashNoLock */
+        HOST_ROW_CHANGE_BEGIN(hb);
         cnt += HostHashRowTimeout(hb, hb->tail, ts);
+        HOST_ROW_CHANGE_END(hb);
         HRLOCK_UNLOCK(hb);
     }
 
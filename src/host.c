@@ -34,6 +34,7 @@
 #include "util-random.h"
 #include "util-misc.h"
 #include "util-byte.h"
+#include "util-unittest.h"
 
 #include "host-queue.h"
 
@@ -244,6 +245,7 @@ void HostInitConfig(char quiet)
     uint32_t i = 0;
     for (i = 0; i < host_config.hash_size; i++) {
         HRLOCK_INIT(&host_hash[i]);
+        SC_ATOMIC_INIT(host_hash[i].seq);
     }
     (void) SC_ATOMIC_ADD(host_memuse, (host_config.hash_size * sizeof(HostHashRow)));
 
@@ -321,6 +323,7 @@ void HostShutdown(void)
             }
 
             HRLOCK_DESTROY(&host_hash[u]);
+            SC_ATOMIC_DESTROY(host_hash[u].seq);
         }
         SCFreeAligned(host_hash);
         host_hash = NULL;
@@ -351,6 +354,7 @@ void HostCleanup(void)
             h = host_hash[u].head;
             HostHashRow *hb = &host_hash[u];
             HRLOCK_LOCK(hb);
+            HOST_ROW_CHANGE_BEGIN(hb);
             while (h) {
                 if ((SC_ATOMIC_GET(h->use_cnt) > 0) && (h->iprep != NULL)) {
                     /* iprep is attached to host only clear local storage */
@@ -374,6 +378,7 @@ void HostCleanup(void)
                     h = n;
                 }
             }
+            HOST_ROW_CHANGE_END(hb);
             HRLOCK_UNLOCK(hb);
         }
     }
@@ -516,11 +521,13 @@ Host *HostGetHostFromHash (Address *a)
         }
 
         /* host is locked */
+        HOST_ROW_CHANGE_BEGIN(hb);
         hb->head = h;
         hb->tail = h;
 
         /* got one, now lock, initialize and return */
         HostInit(h,a);
+        HOST_ROW_CHANGE_END(hb);
 
         HRLOCK_UNLOCK(hb);
         return h;
@@ -538,11 +545,13 @@ Host *HostGetHostFromHash (Address *a)
             h = h->hnext;
 
             if (h == NULL) {
-                h = ph->hnext = HostGetNew(a);
+                h = HostGetNew(a);
                 if (h == NULL) {
                     HRLOCK_UNLOCK(hb);
                     return NULL;
                 }
+                HOST_ROW_CHANGE_BEGIN(hb);
+                ph->hnext = h;
                 hb->tail = h;
 
                 /* host is locked */
@@ -551,6 +560,7 @@ Host *HostGetHostFromHash (Address *a)
 
                 /* initialize and return */
                 HostInit(h,a);
+                HOST_ROW_CHANGE_END(hb);
 
                 HRLOCK_UNLOCK(hb);
                 return h;
@@ -559,6 +569,7 @@ Host *HostGetHostFromHash (Address *a)
             if (HostCompare(h, a) != 0) {
                 /* we found our host, lets put it on top of the
                  * hash list -- this rewards active hosts */
+                HOST_ROW_CHANGE_BEGIN(hb);
                 if (h->hnext) {
                     h->hnext->hprev = h->hprev;
                 }
@@ -573,6 +584,7 @@ Host *HostGetHostFromHash (Address *a)
                 h->hprev = NULL;
                 hb->head->hprev = h;
                 hb->head = h;
+                HOST_ROW_CHANGE_END(hb);
 
                 /* found our host, lock & return */
                 SCMutexLock(&h->m);
@@ -628,6 +640,7 @@ Host *HostLookupHostFromHash (Address *a)
             if (HostCompare(h, a) != 0) {
                 /* we found our host, lets put it on top of the
                  * hash list -- this rewards active hosts */
+                HOST_ROW_CHANGE_BEGIN(hb);
                 if (h->hnext) {
                     h->hnext->hprev = h->hprev;
                 }
@@ -642,6 +655,7 @@ Host *HostLookupHostFromHash (Address *a)
                 h->hprev = NULL;
                 hb->head->hprev = h;
                 hb->head = h;
+                HOST_ROW_CHANGE_END(hb);
 
                 /* found our host, lock & return */
                 SCMutexLock(&h->m);
@@ -659,6 +673,68 @@ Host *HostLookupHostFromHash (Address *a)
     return h;
 }
 
+#define HOST_NOLOCK_TRIES     2
+#define HOST_NOLOCK_MAX_WALK  1024
+
+/** \brief look up a host in the hash without locking the row or the host
+ *
+ *  For callers that only read from the host, like iprep. Hosts are
+ *  recycled through the spare queue but never freed while the engine
+ *  runs, so walking a row that is being changed doesn't touch freed
+ *  memory. Writers bump the row sequence around each change and before
+ *  deciding a host can be recycled (see HOST_ROW_CHANGE_BEGIN), so the
+ *  walk and the reference taken at the end are only trusted if the
+ *  sequence didn't change meanwhile. Otherwise the lookup is retried,
+ *  and finally done under the row lock.
+ *
+ *  Unlike HostLookupHostFromHash, a found host is not moved to the head
+ *  of the row, so lookups don't write to shared memory except use_cnt.
+ *
+ *  \param a address to look up
+ *
+ *  \retval h *UNLOCKED* host with a reference taken, or NULL. The caller
+ *          must drop the reference with HostDecrUsecnt or HostDeReference.
+ */
+Host *HostLookupHostFromHashNoLock (Address *a)
+{
+    HostHashRow *hb = &host_hash[HostGetKey(a)];
+
+    for (int tries = 0; tries < HOST_NOLOCK_TRIES; tries++) {
+        const uint32_t seq = SC_ATOMIC_GET(hb->seq);
+        if (seq & 1)
+            continue;
+        hw_barrier();
+
+        Host *h = hb->head;
+        uint32_t walked = 0;
+        while (h != NULL && HostCompare(h, a) == 0 &&
+                ++walked < HOST_NOLOCK_MAX_WALK)
+        {
+            h = h->hnext;
+        }
+        if (walked == HOST_NOLOCK_MAX_WALK)
+            break;
+
+        /* the atomic increment orders the walk before the re-read of
+         * the sequence, for a miss we need an explicit barrier */
+        if (h != NULL)
+            (void) HostIncrUsecnt(h);
+        else
+            hw_barrier();
+
+        if (SC_ATOMIC_GET(hb->seq) == seq)
+            return h;
+
+        if (h != NULL)
+            (void) HostDecrUsecnt(h);
+    }
+
+    Host *h = HostLookupHostFromHash(a);
+    if (h != NULL)
+        HostUnlock(h);
+    return h;
+}
+
 /** \internal
  *  \brief Get a host from the hash directly.
  *
@@ -696,8 +772,12 @@ static Host *HostGetUsedHost(void)
         }
 
         /** never prune a host that is used by a packets
-         *  we are currently processing in one of the threads */
+         *  we are currently processing in one of the threads.
+         *  Start the row change first, so that a lock-free reader
+         *  taking a reference now will see it. */
+        HOST_ROW_CHANGE_BEGIN(hb);
         if (SC_ATOMIC_GET(h->use_cnt) > 0) {
+            HOST_ROW_CHANGE_END(hb);
             HRLOCK_UNLOCK(hb);
             SCMutexUnlock(&h->m);
             continue;
@@ -715,6 +795,7 @@ static Host *HostGetUsedHost(void)
 
         h->hnext = NULL;
         h->hprev = NULL;
+        HOST_ROW_CHANGE_END(hb);
         HRLOCK_UNLOCK(hb);
 
         HostClearMemory (h);
@@ -728,8 +809,53 @@ static Host *HostGetUsedHost(void)
     return NULL;
 }
 
+#ifdef UNITTESTS
+/** \test lock-free lookup in a row with more than one host */
+static int HostTestNoLockLookup01(void)
+{
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("host.hash-size", "1") == 1);
+    HostInitConfig(HOST_QUIET);
+
+    Address a[3];
+    memset(&a, 0x00, sizeof(a));
+    for (int i = 0; i < 3; i++) {
+        a[i].family = AF_INET;
+        a[i].addr_data32[0] = i + 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        Host *h = HostGetHostFromHash(&a[i]);
+        FAIL_IF_NULL(h);
+        HostRelease(h);
+    }
+
+    /* new hosts are added at the tail, so a[1] is the second in the
+     * only row and the lookup has to walk past the head */
+    Host *h = HostLookupHostFromHashNoLock(&a[1]);
+    FAIL_IF_NULL(h);
+    FAIL_IF_NOT(CMP_ADDR(&h->a, &a[1]));
+    FAIL_IF(h == host_hash[0].head);
+    FAIL_IF_NOT(SC_ATOMIC_GET(h->use_cnt) == 1);
+    /* returned unlocked */
+    FAIL_IF(SCMutexTrylock(&h->m) != 0);
+    HostUnlock(h);
+    HostDecrUsecnt(h);
+
+    FAIL_IF_NOT_NULL(HostLookupHostFromHashNoLock(&a[2]));
+
+    HostShutdown();
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+#endif /* UNITTESTS */
+
 void HostRegisterUnittests(void)
 {
     RegisterHostStorageTests();
+#ifdef UNITTESTS
+    UtRegisterTest("HostTestNoLockLookup01", HostTestNoLockLookup01);
+#endif
 }
 
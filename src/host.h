@@ -84,8 +84,17 @@ typedef struct HostHashRow_ {
     HRLOCK_TYPE lock;
     Host *head;
     Host *tail;
+    /** odd while the row is being changed, see HostLookupHostFromHashNoLock */
+    SC_ATOMIC_DECLARE(uint32_t, seq);
 } __attribute__((aligned(CLS))) HostHashRow;
 
+/** bracket changes to a *LOCKED* row's chain, or to whether a host in it
+ *  can be recycled, so lock-free readers can detect them */
+#define HOST_ROW_CHANGE_BEGIN(hb) \
+    (void)SC_ATOMIC_ADD((hb)->seq, 1)
+#define HOST_ROW_CHANGE_END(hb) \
+    (void)SC_ATOMIC_ADD((hb)->seq, 1)
+
 /** host hash table */
 HostHashRow *host_hash;
 
@@ -138,6 +147,7 @@ void HostShutdown(void);
 void HostCleanup(void);
 
 Host *HostLookupHostFromHash (Address *);
+Host *HostLookupHostFromHashNoLock (Address *);
 Host *HostGetHostFromHash (Address *);
 void HostRelease(Host *);
 void HostLock(Host *);
@@ -157,8 +157,11 @@ uint32_t IPPairTimeoutHash(struct timeval *ts)
             continue;
         }
 
-        /* we have a ippair, or more than one */
+        /* we have a ippair, or more than one. Mark the row as changing
+         * before checking use_cnt, see IPPairLookupIPPairFromHashNoLock */
+        IPPAIR_ROW_CHANGE_BEGIN(hb);
         cnt += IPPairHashRowTimeout(hb, hb->tail, ts);
+        IPPAIR_ROW_CHANGE_END(hb);
         HRLOCK_UNLOCK(hb);
     }
 
@@ -41,6 +41,7 @@
 #include "detect-engine-threshold.h"
 
 #include "util-hash-lookup3.h"
+#include "util-unittest.h"
 
 static IPPair *IPPairGetUsedIPPair(void);
 
@@ -240,6 +241,7 @@ void IPPairInitConfig(char quiet)
     uint32_t i = 0;
     for (i = 0; i < ippair_config.hash_size; i++) {
         HRLOCK_INIT(&ippair_hash[i]);
+        SC_ATOMIC_INIT(ippair_hash[i].seq);
     }
     (void) SC_ATOMIC_ADD(ippair_memuse, (ippair_config.hash_size * sizeof(IPPairHashRow)));
 
@@ -317,6 +319,7 @@ void IPPairShutdown(void)
             }
 
             HRLOCK_DESTROY(&ippair_hash[u]);
+            SC_ATOMIC_DESTROY(ippair_hash[u].seq);
         }
         SCFreeAligned(ippair_hash);
         ippair_hash = NULL;
@@ -347,6 +350,7 @@ void IPPairCleanup(void)
             h = ippair_hash[u].head;
             IPPairHashRow *hb = &ippair_hash[u];
             HRLOCK_LOCK(hb);
+            IPPAIR_ROW_CHANGE_BEGIN(hb);
             while (h) {
                 if ((SC_ATOMIC_GET(h->use_cnt) > 0)) {
                     /* iprep is attached to ippair only clear local storage */
@@ -370,6 +374,7 @@ void IPPairCleanup(void)
                     h = n;
                 }
             }
+            IPPAIR_ROW_CHANGE_END(hb);
             HRLOCK_UNLOCK(hb);
         }
     }
@@ -560,11 +565,13 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
         }
 
         /* ippair is locked */
+        IPPAIR_ROW_CHANGE_BEGIN(hb);
         hb->head = h;
         hb->tail = h;
 
         /* got one, now lock, initialize and return */
         IPPairInit(h,a,b);
+        IPPAIR_ROW_CHANGE_END(hb);
 
         HRLOCK_UNLOCK(hb);
         return h;
@@ -582,11 +589,13 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
             h = h->hnext;
 
             if (h == NULL) {
-                h = ph->hnext = IPPairGetNew(a,b);
+                h = IPPairGetNew(a,b);
                 if (h == NULL) {
                     HRLOCK_UNLOCK(hb);
                     return NULL;
                 }
+                IPPAIR_ROW_CHANGE_BEGIN(hb);
+                ph->hnext = h;
                 hb->tail = h;
 
                 /* ippair is locked */
@@ -595,6 +604,7 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
 
                 /* initialize and return */
                 IPPairInit(h,a,b);
+                IPPAIR_ROW_CHANGE_END(hb);
 
                 HRLOCK_UNLOCK(hb);
                 return h;
@@ -603,6 +613,7 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
             if (IPPairCompare(h, a, b) != 0) {
                 /* we found our ippair, lets put it on top of the
                  * hash list -- this rewards active ippairs */
+                IPPAIR_ROW_CHANGE_BEGIN(hb);
                 if (h->hnext) {
                     h->hnext->hprev = h->hprev;
                 }
@@ -617,6 +628,7 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
                 h->hprev = NULL;
                 hb->head->hprev = h;
                 hb->head = h;
+                IPPAIR_ROW_CHANGE_END(hb);
 
                 /* found our ippair, lock & return */
                 SCMutexLock(&h->m);
@@ -672,6 +684,7 @@ IPPair *IPPairLookupIPPairFromHash (Address *a, Address *b)
             if (IPPairCompare(h, a, b) != 0) {
                 /* we found our ippair, lets put it on top of the
                  * hash list -- this rewards active ippairs */
+                IPPAIR_ROW_CHANGE_BEGIN(hb);
                 if (h->hnext) {
                     h->hnext->hprev = h->hprev;
                 }
@@ -686,6 +699,7 @@ IPPair *IPPairLookupIPPairFromHash (Address *a, Address *b)
                 h->hprev = NULL;
                 hb->head->hprev = h;
                 hb->head = h;
+                IPPAIR_ROW_CHANGE_END(hb);
 
                 /* found our ippair, lock & return */
                 SCMutexLock(&h->m);
@@ -703,6 +717,56 @@ IPPair *IPPairLookupIPPairFromHash (Address *a, Address *b)
     return h;
 }
 
+#define IPPAIR_NOLOCK_TRIES     2
+#define IPPAIR_NOLOCK_MAX_WALK  1024
+
+/** \brief look up a ippair in the hash without locking the row
+ *
+ *  Lock-free counterpart of IPPairLookupIPPairFromHash, see
+ *  HostLookupHostFromHashNoLock for how it works. A found ippair is not
+ *  moved to the head of the row.
+ *
+ *  \retval h *UNLOCKED* ippair with a reference taken, or NULL. The caller
+ *          must lock it to access its storage, and drop the reference.
+ */
+IPPair *IPPairLookupIPPairFromHashNoLock (Address *a, Address *b)
+{
+    IPPairHashRow *hb = &ippair_hash[IPPairGetKey(a, b)];
+
+    for (int tries = 0; tries < IPPAIR_NOLOCK_TRIES; tries++) {
+        const uint32_t seq = SC_ATOMIC_GET(hb->seq);
+        if (seq & 1)
+            continue;
+        hw_barrier();
+
+        IPPair *h = hb->head;
+        uint32_t walked = 0;
+        while (h != NULL && IPPairCompare(h, a, b) == 0 &&
+                ++walked < IPPAIR_NOLOCK_MAX_WALK)
+        {
+            h = h->hnext;
+        }
+        if (walked == IPPAIR_NOLOCK_MAX_WALK)
+            break;
+
+        if (h != NULL)
+            (void) IPPairIncrUsecnt(h);
+        else
+            hw_barrier();
+
+        if (SC_ATOMIC_GET(hb->seq) == seq)
+            return h;
+
+        if (h != NULL)
+            (void) IPPairDecrUsecnt(h);
+    }
+
+    IPPair *h = IPPairLookupIPPairFromHash(a, b);
+    if (h != NULL)
+        IPPairUnlock(h);
+    return h;
+}
+
 /** \internal
  *  \brief Get a ippair from the hash directly.
  *
@@ -740,8 +804,12 @@ static IPPair *IPPairGetUsedIPPair(void)
         }
 
         /** never prune a ippair that is used by a packets
-         *  we are currently processing in one of the threads */
+         *  we are currently processing in one of the threads.
+         *  Start the row change first, so that a lock-free reader
+         *  taking a reference now will see it. */
+        IPPAIR_ROW_CHANGE_BEGIN(hb);
         if (SC_ATOMIC_GET(h->use_cnt) > 0) {
+            IPPAIR_ROW_CHANGE_END(hb);
             HRLOCK_UNLOCK(hb);
             SCMutexUnlock(&h->m);
             continue;
@@ -759,6 +827,7 @@ static IPPair *IPPairGetUsedIPPair(void)
 
         h->hnext = NULL;
         h->hprev = NULL;
+        IPPAIR_ROW_CHANGE_END(hb);
         HRLOCK_UNLOCK(hb);
 
         IPPairClearMemory (h);
@@ -772,7 +841,55 @@ static IPPair *IPPairGetUsedIPPair(void)
     return NULL;
 }
 
+#ifdef UNITTESTS
+/** \test lock-free lookup in a row with more than one ippair */
+static int IPPairTestNoLockLookup01(void)
+{
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF_NOT(ConfSet("ippair.hash-size", "1") == 1);
+    IPPairInitConfig(IPPAIR_QUIET);
+
+    Address a[4];
+    memset(&a, 0x00, sizeof(a));
+    for (int i = 0; i < 4; i++) {
+        a[i].family = AF_INET;
+        a[i].addr_data32[0] = i + 1;
+    }
+    /* pairs 1-2 and 3-4 */
+    for (int i = 0; i < 4; i += 2) {
+        IPPair *h = IPPairGetIPPairFromHash(&a[i], &a[i + 1]);
+        FAIL_IF_NULL(h);
+        IPPairRelease(h);
+    }
+
+    /* new pairs are added at the tail, so 3-4 is the second in the only
+     * row and the lookup has to walk past the head. It's found in both
+     * directions. */
+    IPPair *h = IPPairLookupIPPairFromHashNoLock(&a[3], &a[2]);
+    FAIL_IF_NULL(h);
+    FAIL_IF_NOT((CMP_ADDR(&h->a[0], &a[2]) && CMP_ADDR(&h->a[1], &a[3])) ||
+                (CMP_ADDR(&h->a[0], &a[3]) && CMP_ADDR(&h->a[1], &a[2])));
+    FAIL_IF(h == ippair_hash[0].head);
+    FAIL_IF_NOT(SC_ATOMIC_GET(h->use_cnt) == 1);
+    /* returned unlocked */
+    FAIL_IF(SCMutexTrylock(&h->m) != 0);
+    IPPairUnlock(h);
+    IPPairDecrUsecnt(h);
+
+    FAIL_IF_NOT_NULL(IPPairLookupIPPairFromHashNoLock(&a[0], &a[2]));
+
+    IPPairShutdown();
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+#endif /* UNITTESTS */
+
 void IPPairRegisterUnittests(void)
 {
     RegisterIPPairStorageTests();
+#ifdef UNITTESTS
+    UtRegisterTest("IPPairTestNoLockLookup01", IPPairTestNoLockLookup01);
+#endif
 }
@@ -81,8 +81,17 @@ typedef struct IPPairHashRow_ {
     HRLOCK_TYPE lock;
     IPPair *head;
     IPPair *tail;
+    /** odd while the row is being changed, see IPPairLookupIPPairFromHashNoLock */
+    SC_ATOMIC_DECLARE(uint32_t, seq);
 } __attribute__((aligned(CLS))) IPPairHashRow;
 
+/** bracket changes to a *LOCKED* row's chain, or to whether an ippair in
+ *  it can be recycled, so lock-free readers can detect them */
+#define IPPAIR_ROW_CHANGE_BEGIN(hb) \
+    (void)SC_ATOMIC_ADD((hb)->seq, 1)
+#define IPPAIR_ROW_CHANGE_END(hb) \
+    (void)SC_ATOMIC_ADD((hb)->seq, 1)
+
 /** ippair hash table */
 IPPairHashRow *ippair_hash;
 
@@ -135,6 +144,7 @@ void IPPairShutdown(void);
 void IPPairCleanup(void);
 
 IPPair *IPPairLookupIPPairFromHash (Address *, Address *);
+IPPair *IPPairLookupIPPairFromHashNoLock (Address *, Address *);
 IPPair *IPPairGetIPPairFromHash (Address *, Address *);
 void IPPairRelease(IPPair *);
 void IPPairLock(IPPair *);
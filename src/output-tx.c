@@ -165,7 +165,8 @@ static TmEcode OutputTxLog(ThreadVars *tv, Packet *p, void *thread_data)
     int logged = 0;
     int gap = 0;
 
-    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxIterator(ipproto, alproto);
+    AppLayerGetTxIteratorFunc IterFunc = AppLayerGetTxListIterator(ipproto, alproto,
+            alstate, tx_id, total_txs);
     AppLayerGetTxIterState state;
     memset(&state, 0, sizeof(state));
 
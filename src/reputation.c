@@ -36,6 +36,7 @@
 #include "host.h"
 #include "conf.h"
 #include "detect.h"
+#include "detect-engine.h"
 #include "reputation.h"
 
 /** effective reputation version, atomic as the host
@@ -47,6 +48,20 @@ SC_ATOMIC_DECLARE(uint32_t, srep_eversion);
  *  so hosts will always have a minial value of 1 */
 static uint32_t srep_version = 0;
 
+/** serializes loading of reputation data: initial load, engine reloads
+ *  and iprep-reloads all update srep_version and the host table */
+static SCMutex srep_load_lock = SCMUTEX_INITIALIZER;
+
+/** detect thread ctxs, for iprep-reload to wait for before freeing the
+ *  tree it replaced */
+static SCMutex srep_threads_lock = SCMUTEX_INITIALIZER;
+static DetectEngineThreadCtx *srep_threads = NULL;
+
+/** how long iprep-reload waits for the packet threads to leave their iprep
+ *  matches: loops of SREP_WAIT_USEC */
+#define SREP_WAIT_LOOPS     1000
+#define SREP_WAIT_USEC      100
+
 static uint32_t SRepIncrVersion(void)
 {
     return ++srep_version;
@@ -121,10 +136,51 @@ static void SRepCIDRAddNetblock(SRepCIDRTree *cidr_ctx, char *ip, int cat, int v
     }
 }
 
+/**
+ *  \brief compile the netblock trees into lookup tables
+ *
+ *  The trees are kept: a category/family whose table failed to compile,
+ *  e.g. as it doesn't fit in detect.lpm-memcap, keeps using its tree.
+ */
+static void SRepCIDRCompile(SRepCIDRTree *cidr_ctx)
+{
+    uint64_t memuse = 0;
+    uint32_t tables = 0, trees = 0;
+    int i;
+    for (i = 0; i < SREP_MAX_CATS; i++) {
+        if (cidr_ctx->srepIPV4_tree[i] != NULL) {
+            cidr_ctx->srepIPV4_lpm[i] = SCLpmCreateFromRadixTree(cidr_ctx->srepIPV4_tree[i], AF_INET);
+            if (cidr_ctx->srepIPV4_lpm[i] != NULL) {
+                memuse += SCLpmMemuse(cidr_ctx->srepIPV4_lpm[i]);
+                tables++;
+            } else {
+                trees++;
+            }
+        }
+        if (cidr_ctx->srepIPV6_tree[i] != NULL) {
+            cidr_ctx->srepIPV6_lpm[i] = SCLpmCreateFromRadixTree(cidr_ctx->srepIPV6_tree[i], AF_INET6);
+            if (cidr_ctx->srepIPV6_lpm[i] != NULL) {
+                memuse += SCLpmMemuse(cidr_ctx->srepIPV6_lpm[i]);
+                tables++;
+            } else {
+                trees++;
+            }
+        }
+    }
+    if (tables > 0 || trees > 0) {
+        SCLogConfig("reputation netblocks: %u lookup tables using %"PRIu64" KiB, "
+                "%u radix trees (lpm memuse %"PRIu64"/%"PRIu64" KiB)", tables,
+                memuse / 1024, trees, SCLpmGetMemuse() / 1024, SCLpmGetMemcap() / 1024);
+    }
+}
+
 static uint8_t SRepCIDRGetIPv4IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv4_addr, uint8_t cat)
 {
     void *user_data = NULL;
-    (void)SCRadixFindKeyIPV4BestMatch(ipv4_addr, cidr_ctx->srepIPV4_tree[cat], &user_data);
+    if (cidr_ctx->srepIPV4_lpm[cat] != NULL)
+        user_data = SCLpmLookup(cidr_ctx->srepIPV4_lpm[cat], ipv4_addr);
+    else
+        (void)SCRadixFindKeyIPV4BestMatch(ipv4_addr, cidr_ctx->srepIPV4_tree[cat], &user_data);
     if (user_data == NULL)
         return 0;
 
@@ -135,7 +191,10 @@ static uint8_t SRepCIDRGetIPv4IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv4_addr,
 static uint8_t SRepCIDRGetIPv6IPRep(SRepCIDRTree *cidr_ctx, uint8_t *ipv6_addr, uint8_t cat)
 {
     void *user_data = NULL;
-    (void)SCRadixFindKeyIPV6BestMatch(ipv6_addr, cidr_ctx->srepIPV6_tree[cat], &user_data);
+    if (cidr_ctx->srepIPV6_lpm[cat] != NULL)
+        user_data = SCLpmLookup(cidr_ctx->srepIPV6_lpm[cat], ipv6_addr);
+    else
+        (void)SCRadixFindKeyIPV6BestMatch(ipv6_addr, cidr_ctx->srepIPV6_tree[cat], &user_data);
     if (user_data == NULL)
         return 0;
 
@@ -171,7 +230,9 @@ uint8_t SRepCIDRGetIPRepDst(SRepCIDRTree *cidr_ctx, Packet *p, uint8_t cat, uint
  *         a rule/reputatio reload is complete. */
 void SRepReloadComplete(void)
 {
-    (void) SC_ATOMIC_ADD(srep_eversion, 1);
+    SCMutexLock(&srep_load_lock);
+    (void) SC_ATOMIC_SET(srep_eversion, SRepGetVersion());
+    SCMutexUnlock(&srep_load_lock);
     SCLogDebug("effective Reputation version %u", SRepGetEffectiveVersion());
 }
 
@@ -482,9 +543,13 @@ int SRepLoadFileFromFD(SRepCIDRTree *cidr_ctx, FILE *fp)
                 //SCLogInfo("host %p", h);
 
                 if (h->iprep == NULL) {
-                    h->iprep = SCMalloc(sizeof(SReputation));
-                    if (h->iprep != NULL) {
-                        memset(h->iprep, 0x00, sizeof(SReputation));
+                    /* iprep is read without the host lock, so only
+                     * publish it when it's initialized */
+                    SReputation *new_rep = SCMalloc(sizeof(SReputation));
+                    if (new_rep != NULL) {
+                        memset(new_rep, 0x00, sizeof(SReputation));
+                        hw_barrier();
+                        h->iprep = new_rep;
 
                         HostIncrUsecnt(h);
                     }
@@ -566,6 +631,37 @@ static char *SRepCompleteFilePath(char *file)
     return path;
 }
 
+/**
+ *  \brief load the reputation files into cidr_ctx and the host table
+ *
+ *  Must be called with srep_load_lock held.
+ *
+ *  \retval cnt number of files that failed to load
+ */
+static int SRepLoadFiles(SRepCIDRTree *cidr_ctx, ConfNode *files, int failure_fatal)
+{
+    ConfNode *file = NULL;
+    int failed = 0;
+
+    TAILQ_FOREACH(file, &files->head, next) {
+        char *sfile = SRepCompleteFilePath(file->val);
+        if (sfile == NULL) {
+            failed++;
+            continue;
+        }
+        SCLogInfo("Loading reputation file: %s", sfile);
+
+        if (SRepLoadFile(cidr_ctx, sfile) < 0) {
+            if (failure_fatal == 1) {
+                exit(EXIT_FAILURE);
+            }
+            failed++;
+        }
+        SCFree(sfile);
+    }
+    return failed;
+}
+
 /** \brief init reputation
  *
  *  \param de_ctx detection engine ctx for tracking iprep version
@@ -579,9 +675,6 @@ static char *SRepCompleteFilePath(char *file)
 int SRepInit(DetectEngineCtx *de_ctx)
 {
     ConfNode *files;
-    ConfNode *file = NULL;
-    int r = 0;
-    char *sfile = NULL;
     const char *filename = NULL;
     int init = 0;
     int i = 0;
@@ -630,24 +723,14 @@ int SRepInit(DetectEngineCtx *de_ctx)
         }
     }
 
-    de_ctx->srep_version = SRepIncrVersion();
-    SCLogDebug("Reputation version %u", de_ctx->srep_version);
+    SCMutexLock(&srep_load_lock);
+    cidr_ctx->version = SRepIncrVersion();
+    SCLogDebug("Reputation version %u", cidr_ctx->version);
 
     /* ok, let's load signature files from the general config */
-    if (files != NULL) {
-        TAILQ_FOREACH(file, &files->head, next) {
-            sfile = SRepCompleteFilePath(file->val);
-            SCLogInfo("Loading reputation file: %s", sfile);
-
-            r = SRepLoadFile(cidr_ctx, sfile);
-            if (r < 0){
-                if (de_ctx->failure_fatal == 1) {
-                    exit(EXIT_FAILURE);
-                }
-            }
-            SCFree(sfile);
-        }
-    }
+    SRepLoadFiles(cidr_ctx, files, de_ctx->failure_fatal);
+    SRepCIDRCompile(cidr_ctx);
+    SCMutexUnlock(&srep_load_lock);
 
     /* Set effective rep version.
      * On live reload we will handle this after de_ctx has been swapped */
@@ -659,29 +742,212 @@ int SRepInit(DetectEngineCtx *de_ctx)
     return 0;
 }
 
-void SRepDestroy(DetectEngineCtx *de_ctx) {
-    if (de_ctx->srepCIDR_ctx != NULL) {
-        int i;
-        for (i = 0; i < SREP_MAX_CATS; i++) {
-            if (de_ctx->srepCIDR_ctx->srepIPV4_tree[i] != NULL) {
-                SCRadixReleaseRadixTree(de_ctx->srepCIDR_ctx->srepIPV4_tree[i]);
-                de_ctx->srepCIDR_ctx->srepIPV4_tree[i] = NULL;
-            }
+static void SRepCIDRFree(SRepCIDRTree *cidr_ctx)
+{
+    int i;
+    for (i = 0; i < SREP_MAX_CATS; i++) {
+        if (cidr_ctx->srepIPV4_tree[i] != NULL) {
+            SCRadixReleaseRadixTree(cidr_ctx->srepIPV4_tree[i]);
+            cidr_ctx->srepIPV4_tree[i] = NULL;
+        }
+
+        if (cidr_ctx->srepIPV6_tree[i] != NULL) {
+            SCRadixReleaseRadixTree(cidr_ctx->srepIPV6_tree[i]);
+            cidr_ctx->srepIPV6_tree[i] = NULL;
+        }
+
+        SCLpmFree(cidr_ctx->srepIPV4_lpm[i]);
+        cidr_ctx->srepIPV4_lpm[i] = NULL;
+        SCLpmFree(cidr_ctx->srepIPV6_lpm[i]);
+        cidr_ctx->srepIPV6_lpm[i] = NULL;
+    }
+    SCFree(cidr_ctx);
+}
+
+void SRepThreadRegister(DetectEngineThreadCtx *det_ctx)
+{
+    SCMutexLock(&srep_threads_lock);
+    det_ctx->srep_next = srep_threads;
+    srep_threads = det_ctx;
+    SCMutexUnlock(&srep_threads_lock);
+}
+
+void SRepThreadDeregister(DetectEngineThreadCtx *det_ctx)
+{
+    SCMutexLock(&srep_threads_lock);
+    DetectEngineThreadCtx **p = &srep_threads;
+    while (*p != NULL && *p != det_ctx)
+        p = &(*p)->srep_next;
+    if (*p != NULL)
+        *p = det_ctx->srep_next;
+    det_ctx->srep_next = NULL;
+    SCMutexUnlock(&srep_threads_lock);
+}
 
-            if (de_ctx->srepCIDR_ctx->srepIPV6_tree[i] != NULL) {
-                SCRadixReleaseRadixTree(de_ctx->srepCIDR_ctx->srepIPV6_tree[i]);
-                de_ctx->srepCIDR_ctx->srepIPV6_tree[i] = NULL;
+/** \internal
+ *  \brief wait for the threads using de_ctx to pass a sync point
+ *
+ *  A thread is past the sync point once it's seen outside of an iprep
+ *  match, or in a newer one. Its next match loads the tree published
+ *  before this call, so a tree replaced before this call isn't used
+ *  anymore.
+ *
+ *  \retval 1 all threads passed the sync point
+ *  \retval 0 timed out
+ */
+static int SRepWaitForThreads(const DetectEngineCtx *de_ctx)
+{
+    int r = 1;
+
+    /* order the publish of the tree before reading the sequences */
+    hw_barrier();
+
+    SCMutexLock(&srep_threads_lock);
+    DetectEngineThreadCtx *det_ctx = srep_threads;
+    for ( ; det_ctx != NULL; det_ctx = det_ctx->srep_next) {
+        if (det_ctx->de_ctx != de_ctx)
+            continue;
+
+        const uint32_t seq = SC_ATOMIC_GET(det_ctx->srep_seq);
+        int loops = 0;
+        while ((seq & 1) && SC_ATOMIC_GET(det_ctx->srep_seq) == seq) {
+            if (++loops > SREP_WAIT_LOOPS) {
+                r = 0;
+                goto end;
             }
+            usleep(SREP_WAIT_USEC);
         }
+    }
+end:
+    SCMutexUnlock(&srep_threads_lock);
+    return r;
+}
 
-        SCFree(de_ctx->srepCIDR_ctx);
+void SRepDestroy(DetectEngineCtx *de_ctx) {
+    if (de_ctx->srepCIDR_ctx != NULL) {
+        SRepCIDRFree(de_ctx->srepCIDR_ctx);
         de_ctx->srepCIDR_ctx = NULL;
     }
+    if (de_ctx->srepCIDR_ctx_retired != NULL) {
+        SRepCIDRFree(de_ctx->srepCIDR_ctx_retired);
+        de_ctx->srepCIDR_ctx_retired = NULL;
+    }
+}
+
+/**
+ *  \brief load a new version of the reputation data for de_ctx
+ *
+ *  Used by the iprep-reload command. Only the reputation files are
+ *  processed: the detection engine isn't rebuilt and the categories file
+ *  isn't reloaded, as the rules refer to the categories.
+ *
+ *  The new netblocks are loaded into a new SRepCIDRTree. Hosts are updated
+ *  in place with the new version, which packet threads accept as the
+ *  version is higher than the one they expect. Once loaded the tree is
+ *  published, and it carries the version so threads switch to both at
+ *  once.
+ *
+ *  Hosts that are no longer in the files keep their outdated entry, which
+ *  the iprep keyword ignores as its version is lower than the tree's. The
+ *  entries hold a host reference, so the host timeout code doesn't clean
+ *  them up.
+ *
+ *  The replaced tree is freed once all packet threads using de_ctx passed
+ *  a sync point, see SRepWaitForThreads. If that takes too long it's kept
+ *  as srepCIDR_ctx_retired, and the next reload is refused until it's
+ *  freed.
+ *
+ *  \param fp file to load instead of the configured files, for unittests
+ *
+ *  \retval cnt number of files that failed to load
+ *  \retval -1 reputation not configured or out of memory
+ *  \retval -2 the tree replaced by the previous reload is still in use
+ */
+static int SRepReloadDo(DetectEngineCtx *de_ctx, FILE *fp)
+{
+    ConfNode *files = ConfGetNode("reputation-files");
+    int failed = 0;
+
+    if (de_ctx->srepCIDR_ctx == NULL || (fp == NULL && files == NULL)) {
+        SCLogError(SC_ERR_NO_REPUTATION, "IP reputation not enabled");
+        return -1;
+    }
+
+    SCMutexLock(&srep_load_lock);
+    if (de_ctx->srepCIDR_ctx_retired != NULL) {
+        if (SRepWaitForThreads(de_ctx) == 0) {
+            SCMutexUnlock(&srep_load_lock);
+            SCLogError(SC_ERR_NO_REPUTATION, "IP reputation from the previous "
+                    "reload is still in use, not reloading");
+            return -2;
+        }
+        SRepCIDRFree(de_ctx->srepCIDR_ctx_retired);
+        de_ctx->srepCIDR_ctx_retired = NULL;
+    }
+
+    SRepCIDRTree *cidr_ctx = SCCalloc(1, sizeof(SRepCIDRTree));
+    if (unlikely(cidr_ctx == NULL)) {
+        SCMutexUnlock(&srep_load_lock);
+        return -1;
+    }
+    cidr_ctx->version = SRepIncrVersion();
+    SCLogConfig("reloading IP reputation, version %u", cidr_ctx->version);
+
+    if (fp != NULL) {
+        if (SRepLoadFileFromFD(cidr_ctx, fp) < 0)
+            failed++;
+    } else {
+        failed = SRepLoadFiles(cidr_ctx, files, 0);
+    }
+    SRepCIDRCompile(cidr_ctx);
+
+    SRepCIDRTree *old = de_ctx->srepCIDR_ctx;
+
+    /* make sure the tree is complete before threads can see it */
+    hw_barrier();
+    de_ctx->srepCIDR_ctx = cidr_ctx;
+    hw_barrier();
+
+    (void) SC_ATOMIC_SET(srep_eversion, cidr_ctx->version);
+
+    if (SRepWaitForThreads(de_ctx) == 1) {
+        SRepCIDRFree(old);
+    } else {
+        SCLogWarning(SC_ERR_NO_REPUTATION, "IP reputation version %u is "
+                "still in use, freeing it on the next reload", old->version);
+        de_ctx->srepCIDR_ctx_retired = old;
+    }
+    SCMutexUnlock(&srep_load_lock);
+
+    HostPrintStats();
+    return failed;
+}
+
+/**
+ *  \brief reload the configured reputation files for the current engine
+ *
+ *  \retval cnt number of files that failed to load
+ *  \retval -1 error
+ */
+int SRepReload(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineGetCurrent();
+    if (de_ctx == NULL)
+        return -1;
+
+    int r = SRepReloadDo(de_ctx, NULL);
+    DetectEngineDeReference(&de_ctx);
+    return r;
+}
+
+/** \brief reload reputation from a single file, for unittests */
+int SRepReloadFromFD(DetectEngineCtx *de_ctx, FILE *fp)
+{
+    return SRepReloadDo(de_ctx, fp);
 }
 
 #ifdef UNITTESTS
 #include "conf-yaml-loader.h"
-#include "detect-engine.h"
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
 #include "stream-tcp.h"
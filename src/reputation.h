@@ -27,12 +27,22 @@
 #define __REPUTATION_H__
 
 #include "host.h"
+#include "util-lpm.h"
+
+struct DetectEngineThreadCtx_;
 
 #define SREP_MAX_CATS 60
 
 typedef struct SRepCIDRTree_ {
+    /** version of the reputation data loaded with this tree. Hosts with
+     *  a lower version are outdated. */
+    uint32_t version;
+
     SCRadixTree *srepIPV4_tree[SREP_MAX_CATS];
     SCRadixTree *srepIPV6_tree[SREP_MAX_CATS];
+    /** compiled from the trees once all files are loaded */
+    SCLpmTable *srepIPV4_lpm[SREP_MAX_CATS];
+    SCLpmTable *srepIPV6_lpm[SREP_MAX_CATS];
 } SRepCIDRTree;
 
 typedef struct SReputation_ {
@@ -44,6 +54,9 @@ uint8_t SRepCatGetByShortname(char *shortname);
 int SRepInit(struct DetectEngineCtx_ *de_ctx);
 void SRepDestroy(struct DetectEngineCtx_ *de_ctx);
 void SRepReloadComplete(void);
+int SRepReload(void);
+void SRepThreadRegister(struct DetectEngineThreadCtx_ *det_ctx);
+void SRepThreadDeregister(struct DetectEngineThreadCtx_ *det_ctx);
 int SRepHostTimedOut(Host *);
 
 /** Reputation numbers (types) that we can use to lookup/update, etc
@@ -87,6 +100,7 @@ uint8_t SRepCIDRGetIPRepDst(SRepCIDRTree *cidr_ctx, Packet *p, uint8_t cat, uint
 void SRepResetVersion(void);
 int SRepLoadCatFileFromFD(FILE *fp);
 int SRepLoadFileFromFD(SRepCIDRTree *cidr_ctx, FILE *fp);
+int SRepReloadFromFD(struct DetectEngineCtx_ *de_ctx, FILE *fp);
 
 #if 0
 /** Reputation Data */
@@ -33,6 +33,7 @@
 #include "detect-engine-proto.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter-pcre.h"
 #include "detect-engine-sigorder.h"
 #include "detect-engine-payload.h"
 #include "detect-engine-dcepayload.h"
@@ -52,6 +53,7 @@
 #include "detect-engine-tag.h"
 #include "detect-engine-modbus.h"
 #include "detect-engine-filedata.h"
+#include "detect-engine-sampling.h"
 #include "detect-fast-pattern.h"
 #include "flow.h"
 #include "flow-timeout.h"
@@ -82,6 +84,7 @@
 
 #include "util-action.h"
 #include "util-radix-tree.h"
+#include "util-lpm.h"
 #include "util-host-os-info.h"
 #include "util-cidr.h"
 #include "util-unittest-helper.h"
@@ -104,6 +107,8 @@
 #include "util-bloomfilter.h"
 #include "util-bloomfilter-counting.h"
 #include "util-pool.h"
+#include "util-arena.h"
+#include "datasets.h"
 #include "util-byte.h"
 #include "util-proto-name.h"
 #include "util-memrchr.h"
@@ -153,6 +158,8 @@ static void RegisterUnittests(void)
     BloomFilterRegisterTests();
     BloomFilterCountingRegisterTests();
     PoolRegisterTests();
+    MemArenaRegisterTests();
+    DatasetsRegisterTests();
     ByteRegisterTests();
     MpmRegisterTests();
     FlowBitRegisterTests();
@@ -182,6 +189,7 @@ static void RegisterUnittests(void)
     IPPairRegisterUnittests();
     SCSigRegisterSignatureOrderingTests();
     SCRadixRegisterTests();
+    SCLpmRegisterTests();
     DefragRegisterTests();
     SigGroupHeadRegisterTests();
     SCHInfoRegisterTests();
@@ -214,6 +222,7 @@ static void RegisterUnittests(void)
     DetectEngineHttpHRHRegisterTests();
     DetectEngineInspectModbusRegisterTests();
     DetectEngineRegisterTests();
+    DetectSamplingRegisterTests();
     DetectEngineSMTPFiledataRegisterTests();
     SCLogRegisterTests();
     MagicRegisterTests();
@@ -317,6 +326,7 @@ void RunUnittests(int list_unittests, const char *regex_arg)
         UtCleanup();
 #ifdef BUILD_HYPERSCAN
         MpmHSGlobalCleanup();
+        PrefilterPcreGlobalCleanup();
 #endif
         if (failed) {
             exit(EXIT_FAILURE);
@@ -43,6 +43,7 @@
 #include "app-layer.h"
 #include "app-layer-htp-mem.h"
 #include "host-bit.h"
+#include "datasets.h"
 
 #include "util-misc.h"
 #include "util-profiling.h"
@@ -998,6 +999,104 @@ TmEcode UnixSocketUnregisterTenant(json_t *cmd, json_t* answer, void *data)
     return TM_ECODE_OK;
 }
 
+/** \internal
+ *  \brief get the set for a dataset command, setting the answer on error */
+static Dataset *UnixSocketDatasetGet(json_t *cmd, json_t *answer, const char **value)
+{
+    /* 1 get dataset name */
+    json_t *jarg = json_object_get(cmd, "setname");
+    if (!json_is_string(jarg)) {
+        json_object_set_new(answer, "message", json_string("setname is not a string"));
+        return NULL;
+    }
+    const char *set_name = json_string_value(jarg);
+
+    /* 2 get the data type */
+    jarg = json_object_get(cmd, "settype");
+    if (!json_is_string(jarg)) {
+        json_object_set_new(answer, "message", json_string("settype is not a string"));
+        return NULL;
+    }
+    const char *type = json_string_value(jarg);
+
+    /* 3 get value */
+    jarg = json_object_get(cmd, "datavalue");
+    if (!json_is_string(jarg)) {
+        json_object_set_new(answer, "message", json_string("datavalue is not string"));
+        return NULL;
+    }
+    *value = json_string_value(jarg);
+
+    enum DatasetTypes t = DatasetGetTypeFromString(type);
+    if (t == DATASET_TYPE_NOTSET) {
+        json_object_set_new(answer, "message", json_string("unknown settype"));
+        return NULL;
+    }
+
+    Dataset *set = DatasetFind(set_name, t);
+    if (set == NULL) {
+        json_object_set_new(answer, "message", json_string("set not found or wrong type"));
+        return NULL;
+    }
+    return set;
+}
+
+/**
+ * \brief Command to add data to a dataset
+ *
+ * \param cmd the content of command Arguments as a json_t object
+ * \param answer the json_t object that has to be used to answer
+ */
+TmEcode UnixSocketDatasetAdd(json_t *cmd, json_t* answer, void *data)
+{
+    const char *value = NULL;
+    Dataset *set = UnixSocketDatasetGet(cmd, answer, &value);
+    if (set == NULL)
+        return TM_ECODE_FAILED;
+
+    SCLogInfo("dataset-add: set %s value %s", set->name, value);
+
+    int r = DatasetAddSerialized(set, value);
+    if (r == 1) {
+        json_object_set_new(answer, "message", json_string("data added"));
+        return TM_ECODE_OK;
+    } else if (r == 0) {
+        json_object_set_new(answer, "message", json_string("data already in set"));
+        return TM_ECODE_OK;
+    } else {
+        json_object_set_new(answer, "message", json_string("failed to add data"));
+        return TM_ECODE_FAILED;
+    }
+}
+
+/**
+ * \brief Command to remove data from a dataset
+ *
+ * \param cmd the content of command Arguments as a json_t object
+ * \param answer the json_t object that has to be used to answer
+ */
+TmEcode UnixSocketDatasetRemove(json_t *cmd, json_t* answer, void *data)
+{
+    const char *value = NULL;
+    Dataset *set = UnixSocketDatasetGet(cmd, answer, &value);
+    if (set == NULL)
+        return TM_ECODE_FAILED;
+
+    SCLogInfo("dataset-remove: set %s value %s", set->name, value);
+
+    int r = DatasetRemoveSerialized(set, value);
+    if (r == 1) {
+        json_object_set_new(answer, "message", json_string("data removed"));
+        return TM_ECODE_OK;
+    } else if (r == 0) {
+        json_object_set_new(answer, "message", json_string("data is not in set"));
+        return TM_ECODE_OK;
+    } else {
+        json_object_set_new(answer, "message", json_string("failed to remove data"));
+        return TM_ECODE_FAILED;
+    }
+}
+
 /**
  * \brief Command to add a hostbit
  *
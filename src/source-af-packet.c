@@ -237,6 +237,13 @@ typedef struct AFPThreadVars_
     /* references to packet and drop counters */
     uint16_t capture_kernel_packets;
     uint16_t capture_kernel_drops;
+#ifdef HAVE_TPACKET_V3
+    /* tpacket v3 block counters */
+    uint16_t capture_afp_blocks;
+    uint16_t capture_afp_block_pkts;
+    uint16_t capture_afp_block_latency;
+    uint16_t capture_afp_block_latency_max;
+#endif
 
     /* handle state */
     uint8_t afp_state;
@@ -1121,18 +1128,53 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
     SCReturnInt(AFP_READ_OK);
 }
 
+/**
+ * \brief update the per block counters
+ *
+ * Latency is the time in usec between the kernel storing the first
+ * packet in the block and us starting to process the block. It shows
+ * how long packets wait in the ring, which is driven by the block size,
+ * the block timeout and how far behind the worker is.
+ */
+static inline void AFPBlockStatsUpdate(AFPThreadVars *ptv, struct tpacket_block_desc *pbd)
+{
+    StatsIncr(ptv->tv, ptv->capture_afp_blocks);
+    StatsAddUI64(ptv->tv, ptv->capture_afp_block_pkts, pbd->hdr.bh1.num_pkts);
+
+    if (pbd->hdr.bh1.num_pkts == 0)
+        return;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    const int64_t first_usec = (int64_t)pbd->hdr.bh1.ts_first_pkt.ts_sec * 1000000 +
+                               pbd->hdr.bh1.ts_first_pkt.ts_nsec / 1000;
+    const int64_t now_usec = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+    if (now_usec > first_usec) {
+        const uint64_t latency = (uint64_t)(now_usec - first_usec);
+        StatsAddUI64(ptv->tv, ptv->capture_afp_block_latency, latency);
+        StatsSetUI64(ptv->tv, ptv->capture_afp_block_latency_max, latency);
+    }
+}
+
 static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pbd)
 {
     int num_pkts = pbd->hdr.bh1.num_pkts, i;
     uint8_t *ppd;
 
+    AFPBlockStatsUpdate(ptv, pbd);
+
     ppd = (uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt;
     for (i = 0; i < num_pkts; ++i) {
+        uint8_t *next = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
+        /* get the next header in cache while this packet is processed */
+        if (i + 1 < num_pkts) {
+            __builtin_prefetch(next);
+        }
         if (unlikely(AFPParsePacketV3(ptv, pbd,
                              (struct tpacket3_hdr *)ppd) == AFP_FAILURE)) {
             SCReturnInt(AFP_READ_FAILURE);
         }
-        ppd = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
+        ppd = next;
     }
 
     SCReturnInt(AFP_READ_OK);
@@ -2586,6 +2628,18 @@ TmEcode ReceiveAFPThreadInit(ThreadVars *tv, const void *initdata, void **data)
     ptv->capture_kernel_drops = StatsRegisterCounter("capture.kernel_drops",
             ptv->tv);
 #endif
+#ifdef HAVE_TPACKET_V3
+    if (ptv->flags & AFP_TPACKET_V3) {
+        ptv->capture_afp_blocks = StatsRegisterCounter("capture.afpacket.blocks",
+                ptv->tv);
+        ptv->capture_afp_block_pkts = StatsRegisterAvgCounter("capture.afpacket.block_pkts",
+                ptv->tv);
+        ptv->capture_afp_block_latency = StatsRegisterAvgCounter("capture.afpacket.block_latency_usec",
+                ptv->tv);
+        ptv->capture_afp_block_latency_max = StatsRegisterMaxCounter("capture.afpacket.block_latency_usec_max",
+                ptv->tv);
+    }
+#endif
 
     ptv->copy_mode = afpconfig->copy_mode;
     if (ptv->copy_mode != AFP_COPY_MODE_NONE) {
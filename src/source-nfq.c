@@ -50,6 +50,7 @@
 #include "util-byte.h"
 #include "util-privs.h"
 #include "util-device.h"
+#include "util-unittest.h"
 
 #include "runmodes.h"
 
@@ -115,6 +116,9 @@ static int runmode_workers;
 
 #define NFQ_BURST_FACTOR 4
 
+/** room for the netlink messages of a verdict batch */
+#define NFQ_VERDICT_BATCH_BUFSIZE (64 * 1024)
+
 #ifndef SOL_NETLINK
 #define SOL_NETLINK 270
 #endif
@@ -132,6 +136,9 @@ typedef struct NFQThreadVars_
     int datalen; /** Length of per function and thread data */
 
     CaptureStats stats;
+
+    uint16_t counter_latency[NFQ_LATENCY_BUCKETS];
+    uint64_t latency_synced;    /**< latency_cnt at the last counter sync */
 } NFQThreadVars;
 /* shared vars for all for nfq queues and threads */
 static NFQGlobalVars nfq_g;
@@ -155,6 +162,9 @@ TmEcode DecodeNFQThreadInit(ThreadVars *, const void *, void **);
 TmEcode DecodeNFQThreadDeinit(ThreadVars *tv, void *data);
 
 TmEcode NFQSetVerdict(Packet *p);
+#ifdef UNITTESTS
+static void NFQVerdictRegisterTests(void);
+#endif
 
 typedef enum NFQMode_ {
     NFQ_ACCEPT_MODE,
@@ -201,7 +211,11 @@ void TmModuleVerdictNFQRegister (void)
     tmm_modules[TMM_VERDICTNFQ].Func = VerdictNFQ;
     tmm_modules[TMM_VERDICTNFQ].ThreadExitPrintStats = NULL;
     tmm_modules[TMM_VERDICTNFQ].ThreadDeinit = VerdictNFQThreadDeinit;
+#ifdef UNITTESTS
+    tmm_modules[TMM_VERDICTNFQ].RegisterTests = NFQVerdictRegisterTests;
+#else
     tmm_modules[TMM_VERDICTNFQ].RegisterTests = NULL;
+#endif
 }
 
 void TmModuleDecodeNFQRegister (void)
@@ -277,17 +291,13 @@ void NFQInitConfig(char quiet)
     }
 
     if ((ConfGetInt("nfq.batchcount", &value)) == 1) {
-#ifdef HAVE_NFQ_SET_VERDICT_BATCH
-        if (value > 255) {
-            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "nfq.batchcount cannot exceed 255.");
-            value = 255;
+        if (value > NFQ_VERDICT_BATCH_MAX) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "nfq.batchcount cannot exceed %d.",
+                    NFQ_VERDICT_BATCH_MAX);
+            value = NFQ_VERDICT_BATCH_MAX;
         }
         if (value > 1)
-            nfq_config.batchcount = (uint8_t) (value - 1);
-#else
-        SCLogWarning(SC_ERR_NFQ_NOSUPPORT,
-                   "nfq.%s set but NFQ library has no support for it.", "batchcount");
-#endif
+            nfq_config.batchcount = (uint8_t)value;
     }
 
     if (!quiet) {
@@ -308,84 +318,161 @@ void NFQInitConfig(char quiet)
 
 }
 
-static uint8_t NFQVerdictCacheLen(NFQQueueVars *t)
+static const char *nfq_latency_names[NFQ_LATENCY_BUCKETS] = {
+    "nfq.verdict_latency_us.lt_16",
+    "nfq.verdict_latency_us.lt_32",
+    "nfq.verdict_latency_us.lt_64",
+    "nfq.verdict_latency_us.lt_128",
+    "nfq.verdict_latency_us.lt_256",
+    "nfq.verdict_latency_us.lt_512",
+    "nfq.verdict_latency_us.lt_1024",
+    "nfq.verdict_latency_us.lt_2048",
+    "nfq.verdict_latency_us.lt_4096",
+    "nfq.verdict_latency_us.lt_8192",
+    "nfq.verdict_latency_us.ge_8192",
+};
+
+/**
+ * \brief Add a verdict to the latency histogram of the queue
+ *
+ * \param ts packet timestamp, as set by the kernel when it queued it
+ * \param now time the verdict was sent
+ */
+static void NFQLatencyUpdate(NFQQueueVars *t, const struct timeval *ts,
+        const struct timeval *now)
 {
-#ifdef HAVE_NFQ_SET_VERDICT_BATCH
-    return t->verdict_cache.len;
-#else
-    return 0;
-#endif
+    int64_t usec = (int64_t)(now->tv_sec - ts->tv_sec) * 1000000 +
+        (now->tv_usec - ts->tv_usec);
+    int b = 0;
+    if (usec >= 16) {
+        b = 64 - __builtin_clzll((uint64_t)usec) - 4;
+        if (b >= NFQ_LATENCY_BUCKETS)
+            b = NFQ_LATENCY_BUCKETS - 1;
+    }
+    t->latency[b]++;
+    t->latency_cnt++;
+}
+
+static inline uint8_t NFQVerdictBatchLen(NFQQueueVars *t)
+{
+    return t->verdict_batch.cnt;
 }
 
-static void NFQVerdictCacheFlush(NFQQueueVars *t)
+/**
+ * \brief Send all batched verdicts of a queue in a single datagram.
+ *
+ * On failure the verdicts are kept so the next flush retries them.
+ */
+static void NFQVerdictBatchFlush(NFQQueueVars *t)
 {
-#ifdef HAVE_NFQ_SET_VERDICT_BATCH
+    if (t->verdict_batch.cnt == 0)
+        return;
+
+    struct sockaddr_nl nladdr;
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+
     int ret;
     int iter = 0;
-
     do {
-        if (t->verdict_cache.mark_valid)
-            ret = nfq_set_verdict_batch2(t->qh,
-                                         t->verdict_cache.packet_id,
-                                         t->verdict_cache.verdict,
-                                         t->verdict_cache.mark);
-        else
-            ret = nfq_set_verdict_batch(t->qh,
-                                        t->verdict_cache.packet_id,
-                                        t->verdict_cache.verdict);
+        ret = sendto(t->fd, t->verdict_batch.buf, t->verdict_batch.len, 0,
+                (struct sockaddr *)&nladdr, sizeof(nladdr));
     } while ((ret < 0) && (iter++ < NFQ_VERDICT_RETRY_TIME));
 
     if (ret < 0) {
-        SCLogWarning(SC_ERR_NFQ_SET_VERDICT, "nfq_set_verdict_batch failed: %s",
-                     strerror(errno));
-    } else {
-        t->verdict_cache.len = 0;
-        t->verdict_cache.mark_valid = 0;
+        SCLogWarning(SC_ERR_NFQ_SET_VERDICT, "sending %u batched verdicts "
+                "failed: %s", t->verdict_batch.cnt, strerror(errno));
+        return;
     }
-#endif
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    for (uint8_t i = 0; i < t->verdict_batch.cnt; i++) {
+        NFQLatencyUpdate(t, &t->verdict_batch.ts[i], &now);
+    }
+    t->verdict_batch.len = 0;
+    t->verdict_batch.cnt = 0;
+}
+
+static uint8_t *NFQNlAttrPut(uint8_t *a, uint16_t type, const void *data,
+        uint16_t len)
+{
+    struct nlattr *nla = (struct nlattr *)a;
+    nla->nla_type = type;
+    nla->nla_len = NLA_HDRLEN + len;
+    memcpy(a + NLA_HDRLEN, data, len);
+    return a + NLA_ALIGN(nla->nla_len);
 }
 
-static int NFQVerdictCacheAdd(NFQQueueVars *t, Packet *p, uint32_t verdict)
+/**
+ * \brief Add the verdict of a packet to the batch of its queue
+ *
+ * Builds the same NFQNL_MSG_VERDICT message nfq_set_verdict2() would
+ * send, including the mark and a modified payload, so drops and
+ * modified packets are batched as well.
+ *
+ * \retval 0 batched
+ * \retval -1 not batched, the caller has to send the verdict
+ */
+static int NFQVerdictBatchAdd(NFQQueueVars *t, Packet *p, uint32_t verdict,
+        int set_mark, uint32_t mark)
 {
-#ifdef HAVE_NFQ_SET_VERDICT_BATCH
-    if (t->verdict_cache.maxlen == 0)
+    if (t->verdict_batch.maxcnt == 0)
         return -1;
 
-    if (p->flags & PKT_STREAM_MODIFIED || verdict == NF_DROP)
-        goto flush;
-
-    if (p->flags & PKT_MARK_MODIFIED) {
-        if (!t->verdict_cache.mark_valid) {
-            if (t->verdict_cache.len)
-                goto flush;
-            t->verdict_cache.mark_valid = 1;
-            t->verdict_cache.mark = p->nfq_v.mark;
-        } else if (t->verdict_cache.mark != p->nfq_v.mark) {
-            goto flush;
-        }
-    } else if (t->verdict_cache.mark_valid) {
-        goto flush;
+    const int set_payload = (p->flags & PKT_STREAM_MODIFIED) != 0;
+    const uint32_t payload_len = set_payload ? GET_PKT_LEN(p) : 0;
+    if (payload_len > UINT16_MAX - NLA_HDRLEN)
+        return -1;
+
+    const uint32_t msg_len = NLMSG_SPACE(sizeof(struct nfgenmsg)) +
+        NLA_ALIGN(NLA_HDRLEN + sizeof(struct nfqnl_msg_verdict_hdr)) +
+        (set_mark ? NLA_ALIGN(NLA_HDRLEN + sizeof(uint32_t)) : 0) +
+        (set_payload ? NLA_ALIGN(NLA_HDRLEN + payload_len) : 0);
+    if (msg_len > NFQ_VERDICT_BATCH_BUFSIZE)
+        return -1;
+
+    if (t->verdict_batch.cnt >= t->verdict_batch.maxcnt ||
+            t->verdict_batch.len + msg_len > NFQ_VERDICT_BATCH_BUFSIZE) {
+        NFQVerdictBatchFlush(t);
+        /* flush failed, don't grow the batch */
+        if (t->verdict_batch.cnt > 0)
+            return -1;
     }
 
-    if (t->verdict_cache.len == 0) {
-        t->verdict_cache.verdict = verdict;
-    } else if (t->verdict_cache.verdict != verdict)
-        goto flush;
+    uint8_t *buf = t->verdict_batch.buf + t->verdict_batch.len;
+    memset(buf, 0, msg_len);
+
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    nlh->nlmsg_len = msg_len;
+    nlh->nlmsg_type = (NFNL_SUBSYS_QUEUE << 8) | NFQNL_MSG_VERDICT;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+
+    struct nfgenmsg *nfg = NLMSG_DATA(nlh);
+    nfg->nfgen_family = AF_UNSPEC;
+    nfg->version = NFNETLINK_V0;
+    nfg->res_id = htons(t->queue_num);
+
+    uint8_t *a = buf + NLMSG_SPACE(sizeof(struct nfgenmsg));
+    struct nfqnl_msg_verdict_hdr vh = {
+        .verdict = htonl(verdict),
+        .id = htonl(p->nfq_v.id),
+    };
+    a = NFQNlAttrPut(a, NFQA_VERDICT_HDR, &vh, sizeof(vh));
+    if (set_mark) {
+        uint32_t nmark = htonl(mark);
+        a = NFQNlAttrPut(a, NFQA_MARK, &nmark, sizeof(nmark));
+    }
+    if (set_payload) {
+        a = NFQNlAttrPut(a, NFQA_PAYLOAD, GET_PKT_DATA(p), payload_len);
+    }
 
-    /* same verdict, mark not set or identical -> can cache */
-    t->verdict_cache.packet_id = p->nfq_v.id;
+    t->verdict_batch.ts[t->verdict_batch.cnt++] = p->ts;
+    t->verdict_batch.len += msg_len;
 
-    if (t->verdict_cache.len >= t->verdict_cache.maxlen)
-        NFQVerdictCacheFlush(t);
-    else
-        t->verdict_cache.len++;
+    if (t->verdict_batch.cnt >= t->verdict_batch.maxcnt)
+        NFQVerdictBatchFlush(t);
     return 0;
- flush:
-    /* can't cache. Flush current cache and signal caller it should send single verdict */
-    if (NFQVerdictCacheLen(t) > 0)
-        NFQVerdictCacheFlush(t);
-#endif
-    return -1;
 }
 
 static inline void NFQMutexInit(NFQQueueVars *nq)
@@ -706,13 +793,16 @@ static TmEcode NFQInitThread(NFQThreadVars *t, uint32_t queue_maxlen)
     }
 #endif
 
-#ifdef HAVE_NFQ_SET_VERDICT_BATCH
-    if (runmode_workers) {
-        q->verdict_cache.maxlen = nfq_config.batchcount;
+    if (runmode_workers && nfq_config.batchcount) {
+        q->verdict_batch.buf = SCMalloc(NFQ_VERDICT_BATCH_BUFSIZE);
+        if (q->verdict_batch.buf == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "can't allocate verdict batch buffer");
+            return TM_ECODE_FAILED;
+        }
+        q->verdict_batch.maxcnt = nfq_config.batchcount;
     } else if (nfq_config.batchcount) {
         SCLogError(SC_ERR_INVALID_ARGUMENT, "nfq.batchcount is only valid in workers runmode.");
     }
-#endif
 
     /* set a timeout to the socket so we can check for a signal
      * in case we don't get packets for a longer period. */
@@ -780,9 +870,17 @@ TmEcode ReceiveNFQThreadDeinit(ThreadVars *t, void *data)
     NFQMutexLock(nq);
     SCLogDebug("starting... will close queuenum %" PRIu32 "", nq->queue_num);
     if (nq->qh) {
+        NFQVerdictBatchFlush(nq);
         nfq_destroy_queue(nq->qh);
         nq->qh = NULL;
     }
+    if (nq->verdict_batch.buf != NULL) {
+        SCFree(nq->verdict_batch.buf);
+        nq->verdict_batch.buf = NULL;
+    }
+    nq->verdict_batch.maxcnt = 0;
+    nq->verdict_batch.cnt = 0;
+    nq->verdict_batch.len = 0;
     NFQMutexUnlock(nq);
 
     return TM_ECODE_OK;
@@ -794,6 +892,9 @@ TmEcode VerdictNFQThreadInit(ThreadVars *tv, const void *initdata, void **data)
     NFQThreadVars *ntv = (NFQThreadVars *) initdata;
 
     CaptureStatsSetup(tv, &ntv->stats);
+    for (int i = 0; i < NFQ_LATENCY_BUCKETS; i++) {
+        ntv->counter_latency[i] = StatsRegisterCounter(nfq_latency_names[i], tv);
+    }
 
     *data = (void *)ntv;
     return TM_ECODE_OK;
@@ -906,7 +1007,7 @@ void *NFQGetThread(int number)
 static void NFQRecvPkt(NFQQueueVars *t, NFQThreadVars *tv)
 {
     int rv, ret;
-    int flag = NFQVerdictCacheLen(t) ? MSG_DONTWAIT : 0;
+    int flag = NFQVerdictBatchLen(t) ? MSG_DONTWAIT : 0;
 
     /* XXX what happens on rv == 0? */
     rv = recv(t->fd, tv->data, tv->datalen, flag);
@@ -915,7 +1016,7 @@ static void NFQRecvPkt(NFQQueueVars *t, NFQThreadVars *tv)
         if (errno == EINTR || errno == EWOULDBLOCK) {
             /* no error on timeout */
             if (flag)
-                NFQVerdictCacheFlush(t);
+                NFQVerdictBatchFlush(t);
         } else {
 #ifdef COUNTERS
             NFQMutexLock(t);
@@ -964,6 +1065,7 @@ TmEcode ReceiveNFQLoop(ThreadVars *tv, void *data, void *slot)
         if (suricata_ctl_flags != 0) {
             NFQMutexLock(nq);
             if (nq->qh) {
+                NFQVerdictBatchFlush(nq);
                 nfq_destroy_queue(nq->qh);
                 nq->qh = NULL;
             }
@@ -1053,10 +1155,24 @@ TmEcode NFQSetVerdict(Packet *p)
 #endif /* COUNTERS */
     }
 
-    ret = NFQVerdictCacheAdd(t, p, verdict);
-    if (ret == 0) {
-        NFQMutexUnlock(t);
-        return TM_ECODE_OK;
+    if (t->verdict_batch.maxcnt > 0) {
+        int set_mark = 0;
+        uint32_t mark = 0;
+        if (nfq_config.mode == NFQ_REPEAT_MODE) {
+            set_mark = 1;
+            mark = (nfq_config.mark & nfq_config.mask) |
+                (p->nfq_v.mark & ~nfq_config.mask);
+        } else if (p->flags & PKT_MARK_MODIFIED) {
+            set_mark = 1;
+            mark = p->nfq_v.mark;
+        }
+        if (NFQVerdictBatchAdd(t, p, verdict, set_mark, mark) == 0) {
+            NFQMutexUnlock(t);
+            return TM_ECODE_OK;
+        }
+        /* send the verdicts batched so far first, so that they reach
+         * the kernel in packet order */
+        NFQVerdictBatchFlush(t);
     }
 
     do {
@@ -1122,6 +1238,12 @@ TmEcode NFQSetVerdict(Packet *p)
         }
     } while ((ret < 0) && (iter++ < NFQ_VERDICT_RETRY_TIME));
 
+    if (ret >= 0) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        NFQLatencyUpdate(t, &p->ts, &now);
+    }
+
     NFQMutexUnlock(t);
 
     if (ret < 0) {
@@ -1133,6 +1255,22 @@ TmEcode NFQSetVerdict(Packet *p)
     return TM_ECODE_OK;
 }
 
+/**
+ * \brief Copy the verdict latency histogram of the queue into the
+ *        thread's counters, if it changed.
+ */
+static void NFQLatencySyncCounters(ThreadVars *tv, NFQThreadVars *ntv)
+{
+    NFQQueueVars *nq = g_nfq_q + ntv->nfq_index;
+
+    if (nq->latency_cnt == ntv->latency_synced)
+        return;
+    for (int i = 0; i < NFQ_LATENCY_BUCKETS; i++) {
+        StatsSetUI64(tv, ntv->counter_latency[i], nq->latency[i]);
+    }
+    ntv->latency_synced = nq->latency_cnt;
+}
+
 /**
  * \brief NFQ verdict module packet entry function
  */
@@ -1162,6 +1300,7 @@ TmEcode VerdictNFQ(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, Packe
             return ret;
         }
     }
+    NFQLatencySyncCounters(tv, ntv);
     return TM_ECODE_OK;
 }
 
@@ -1228,5 +1367,120 @@ TmEcode DecodeNFQThreadDeinit(ThreadVars *tv, void *data)
     SCReturnInt(TM_ECODE_OK);
 }
 
+#ifdef UNITTESTS
+typedef struct NFQTestMsg_ {
+    const struct nfqnl_msg_verdict_hdr *vh;
+    const uint32_t *mark;
+    const uint8_t *payload;
+    uint16_t payload_len;
+} NFQTestMsg;
+
+/** \internal
+ *  \brief walk the attributes of a batched verdict message
+ *  \retval length of the message, 0 if it's malformed */
+static uint32_t NFQTestParseMsg(const uint8_t *buf, uint32_t len,
+        uint16_t queue_num, NFQTestMsg *m)
+{
+    memset(m, 0, sizeof(*m));
+    const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf;
+    if (!NLMSG_OK(nlh, len) ||
+            nlh->nlmsg_type != ((NFNL_SUBSYS_QUEUE << 8) | NFQNL_MSG_VERDICT) ||
+            !(nlh->nlmsg_flags & NLM_F_REQUEST))
+        return 0;
+    const struct nfgenmsg *nfg = NLMSG_DATA(nlh);
+    if (nfg->version != NFNETLINK_V0 || nfg->res_id != htons(queue_num))
+        return 0;
+
+    const uint8_t *a = buf + NLMSG_SPACE(sizeof(struct nfgenmsg));
+    const uint8_t *end = buf + nlh->nlmsg_len;
+    while (a + NLA_HDRLEN <= end) {
+        const struct nlattr *nla = (const struct nlattr *)a;
+        if (nla->nla_len < NLA_HDRLEN || a + nla->nla_len > end)
+            return 0;
+        const uint8_t *data = a + NLA_HDRLEN;
+        const uint16_t data_len = nla->nla_len - NLA_HDRLEN;
+        switch (nla->nla_type) {
+            case NFQA_VERDICT_HDR:
+                if (data_len != sizeof(struct nfqnl_msg_verdict_hdr))
+                    return 0;
+                m->vh = (const struct nfqnl_msg_verdict_hdr *)data;
+                break;
+            case NFQA_MARK:
+                if (data_len != sizeof(uint32_t))
+                    return 0;
+                m->mark = (const uint32_t *)data;
+                break;
+            case NFQA_PAYLOAD:
+                m->payload = data;
+                m->payload_len = data_len;
+                break;
+            default:
+                return 0;
+        }
+        a += NLA_ALIGN(nla->nla_len);
+    }
+    return (a == end) ? NLMSG_ALIGN(nlh->nlmsg_len) : 0;
+}
+
+/** \test layout of a batch with a marked and modified packet followed
+ *        by a plain drop */
+static int NFQVerdictBatchTest01(void)
+{
+    NFQQueueVars t;
+    memset(&t, 0, sizeof(t));
+    t.fd = -1;
+    t.queue_num = 3;
+    t.verdict_batch.maxcnt = 4;
+    t.verdict_batch.buf = SCMalloc(NFQ_VERDICT_BATCH_BUFSIZE);
+    FAIL_IF_NULL(t.verdict_batch.buf);
+
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    /* odd length so the attribute needs padding */
+    uint8_t payload[] = { 0x45, 0x00, 0x00, 0x1d, 0x01 };
+    FAIL_IF(PacketCopyData(p, payload, sizeof(payload)) != 0);
+
+    p->nfq_v.id = 42;
+    p->flags |= PKT_STREAM_MODIFIED;
+    FAIL_IF_NOT(NFQVerdictBatchAdd(&t, p, NF_ACCEPT, 1, 0x1234) == 0);
+    p->nfq_v.id = 43;
+    p->flags &= ~PKT_STREAM_MODIFIED;
+    FAIL_IF_NOT(NFQVerdictBatchAdd(&t, p, NF_DROP, 0, 0) == 0);
+    FAIL_IF_NOT(t.verdict_batch.cnt == 2);
+
+    NFQTestMsg m;
+    uint32_t off = NFQTestParseMsg(t.verdict_batch.buf, t.verdict_batch.len,
+            t.queue_num, &m);
+    FAIL_IF(off == 0);
+    FAIL_IF_NULL(m.vh);
+    FAIL_IF_NOT(ntohl(m.vh->id) == 42);
+    FAIL_IF_NOT(ntohl(m.vh->verdict) == NF_ACCEPT);
+    FAIL_IF_NULL(m.mark);
+    FAIL_IF_NOT(ntohl(*m.mark) == 0x1234);
+    FAIL_IF_NULL(m.payload);
+    FAIL_IF_NOT(m.payload_len == sizeof(payload));
+    FAIL_IF(memcmp(m.payload, payload, sizeof(payload)) != 0);
+
+    uint32_t len = NFQTestParseMsg(t.verdict_batch.buf + off,
+            t.verdict_batch.len - off, t.queue_num, &m);
+    FAIL_IF(len == 0);
+    FAIL_IF_NULL(m.vh);
+    FAIL_IF_NOT(ntohl(m.vh->id) == 43);
+    FAIL_IF_NOT(ntohl(m.vh->verdict) == NF_DROP);
+    FAIL_IF_NOT_NULL(m.mark);
+    FAIL_IF_NOT_NULL(m.payload);
+    FAIL_IF_NOT(off + len == t.verdict_batch.len);
+
+    PacketFree(p);
+    SCFree(t.verdict_batch.buf);
+    PASS;
+}
+
+static void NFQVerdictRegisterTests(void)
+{
+    UtRegisterTest("NFQVerdictBatchTest01", NFQVerdictBatchTest01);
+}
+#endif /* UNITTESTS */
+
 #endif /* NFQ */
 
@@ -32,6 +32,13 @@
 
 #define NFQ_MAX_QUEUE 16
 
+/** max verdicts sent in one netlink batch (nfq.batchcount) */
+#define NFQ_VERDICT_BATCH_MAX 255
+
+/** verdict latency histogram: bucket i counts latencies below
+ *  2^(i + 4) usec, the last one everything above */
+#define NFQ_LATENCY_BUCKETS 11
+
 /* idea: set the recv-thread id in the packet to
  * select an verdict-queue */
 
@@ -72,14 +79,17 @@ typedef struct NFQQueueVars_
     uint32_t accepted;
     uint32_t dropped;
     uint32_t replaced;
+    /* verdict messages waiting to be sent in one go, workers only */
     struct {
-        uint32_t packet_id; /* id of last processed packet */
-        uint32_t verdict;
-        uint32_t mark;
-        uint8_t mark_valid:1;
-        uint8_t len;
-        uint8_t maxlen;
-    } verdict_cache;
+        uint8_t *buf;
+        uint32_t len;
+        uint8_t cnt;
+        uint8_t maxcnt;     /* 0: batching disabled */
+        struct timeval ts[NFQ_VERDICT_BATCH_MAX]; /* for the latency */
+    } verdict_batch;
+
+    uint64_t latency[NFQ_LATENCY_BUCKETS];
+    uint64_t latency_cnt;
 
 } NFQQueueVars;
 
@@ -27,6 +27,11 @@
 #include "util-checksum.h"
 #include "util-profiling.h"
 #include "source-pcap-file.h"
+#ifdef BENCHMARKS
+#include "runmodes.h"
+#include "util-conf.h"
+#include "util-cpu.h"
+#endif
 
 extern int max_pending_packets;
 extern PcapFileGlobalVars pcap_g;
@@ -237,4 +242,251 @@ TmEcode ValidateLinkType(int datalink, Decoder *decoder)
 
     SCReturnInt(TM_ECODE_OK);
 }
+
+#ifdef BENCHMARKS
+/** gap between the replay loops, so the flows of the previous loop time out */
+#define PCAP_REPLAY_LOOP_GAP 3600
+
+typedef struct PcapReplayPacket_ {
+    struct timeval ts;
+    uint32_t caplen;
+    uint64_t offset;    /**< into PcapReplay::data */
+} PcapReplayPacket;
+
+typedef struct PcapReplay_ {
+    PcapReplayPacket *pkts;
+    uint32_t pkts_cnt;
+    uint32_t pkts_size;
+
+    uint8_t *data;
+    uint64_t data_len;
+    uint64_t data_size;
+} PcapReplay;
+
+static void PcapReplayFree(PcapReplay *r)
+{
+    if (r->pkts != NULL)
+        SCFree(r->pkts);
+    if (r->data != NULL)
+        SCFree(r->data);
+    memset(r, 0, sizeof(*r));
+}
+
+/** \brief read the whole file into memory, so the replay does no I/O */
+static int PcapReplayLoad(PcapFileFileVars *pfv, PcapReplay *r)
+{
+    struct pcap_pkthdr *h = NULL;
+    const u_char *pkt = NULL;
+    int ret;
+
+    while ((ret = pcap_next_ex(pfv->pcap_handle, &h, &pkt)) == 1) {
+        if (r->pkts_cnt == r->pkts_size) {
+            uint32_t size = r->pkts_size ? r->pkts_size * 2 : 4096;
+            void *ptmp = SCRealloc(r->pkts, size * sizeof(PcapReplayPacket));
+            if (ptmp == NULL)
+                goto error;
+            r->pkts = ptmp;
+            r->pkts_size = size;
+        }
+        if (r->data_len + h->caplen > r->data_size) {
+            uint64_t size = r->data_size ? r->data_size * 2 : 1024 * 1024;
+            while (size < r->data_len + h->caplen)
+                size *= 2;
+            void *ptmp = SCRealloc(r->data, size);
+            if (ptmp == NULL)
+                goto error;
+            r->data = ptmp;
+            r->data_size = size;
+        }
+
+        PcapReplayPacket *rp = &r->pkts[r->pkts_cnt++];
+        rp->ts = h->ts;
+        rp->caplen = h->caplen;
+        rp->offset = r->data_len;
+        memcpy(r->data + r->data_len, pkt, h->caplen);
+        r->data_len += h->caplen;
+    }
+    if (ret == -1) {
+        SCLogError(SC_ERR_PCAP_DISPATCH, "error reading %s: %s",
+                pfv->filename, pcap_geterr(pfv->pcap_handle));
+        PcapReplayFree(r);
+        return -1;
+    }
+    return 0;
+
+error:
+    SCLogError(SC_ERR_MEM_ALLOC, "failed to load %s into memory "
+            "(%"PRIu32" packets, %"PRIu64" bytes so far)",
+            pfv->filename, r->pkts_cnt, r->data_len);
+    PcapReplayFree(r);
+    return -1;
+}
+
+static void PcapReplayReport(PcapFileFileVars *pfv, uint32_t loops,
+        uint64_t pkts, uint64_t bytes, double secs, uint64_t cycles)
+{
+    const double pps = secs > 0 ? pkts / secs : 0;
+    const double gbps = secs > 0 ? (bytes * 8) / secs / 1000000000.0 : 0;
+
+    SCLogNotice("replay of %s: %"PRIu32" loops, %"PRIu64" packets in "
+            "%.3fs: %.0f pkts/s, %.3f Gbps", pfv->filename, loops, pkts,
+            secs, pps, gbps);
+
+#ifdef HAVE_LIBJANSSON
+    const char *runmode = RunmodeGetActive();
+    const uint32_t workers = TmThreadCountThreadsByTmmFlags(TM_FLAG_DETECT_TM);
+
+    json_t *js = json_object();
+    if (js == NULL)
+        return;
+    json_object_set_new(js, "pcap", json_string(pfv->filename));
+    json_object_set_new(js, "runmode", json_string(runmode ? runmode : "unknown"));
+    json_object_set_new(js, "workers", json_integer(workers));
+    json_object_set_new(js, "loops", json_integer(loops));
+    json_object_set_new(js, "packets", json_integer(pkts));
+    json_object_set_new(js, "bytes", json_integer(bytes));
+    json_object_set_new(js, "seconds", json_real(secs));
+    json_object_set_new(js, "pkts_per_sec", json_real(pps));
+    json_object_set_new(js, "gbps", json_real(gbps));
+    /* elapsed cycles per packet, the inverse of the throughput */
+    json_object_set_new(js, "cycles_per_packet",
+            json_real(pkts ? (double)cycles / pkts : 0));
+
+#ifdef PROFILING
+    SCProfilePacketStages st;
+    SCProfilingGetPacketStages(&st);
+    if (st.pkts > 0) {
+        const struct {
+            const char *name;
+            uint64_t ticks;
+        } stages[] = {
+            { "total", st.total },
+            { "receive", st.receive },
+            { "decode", st.decode },
+            { "flowworker", st.flowworker },
+            { "flow", st.flow },
+            { "stream", st.stream },
+            { "app_layer", st.app_layer },
+            { "detect", st.detect },
+            { "output", st.output },
+        };
+        json_t *jstages = json_object();
+        if (jstages != NULL) {
+            for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+                json_t *jst = json_object();
+                if (jst == NULL)
+                    continue;
+                json_object_set_new(jst, "ticks", json_integer(stages[i].ticks));
+                json_object_set_new(jst, "cycles_per_packet",
+                        json_real((double)stages[i].ticks / st.pkts));
+                json_object_set_new(jstages, stages[i].name, jst);
+            }
+            json_object_set_new(js, "profiled_packets", json_integer(st.pkts));
+            json_object_set_new(js, "stages", jstages);
+        }
+    }
+#endif
+
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/bench-replay.json",
+            ConfigGetLogDirectory());
+    if (json_dump_file(js, filename, JSON_INDENT(2)) != 0) {
+        SCLogError(SC_ERR_FOPEN, "failed to write %s", filename);
+    } else {
+        SCLogNotice("replay report written to %s", filename);
+    }
+    json_decref(js);
+#endif /* HAVE_LIBJANSSON */
+}
+
+/**
+ *  \brief replay a pcap from memory a number of times
+ *
+ *  The file is loaded once, then fed to the pipeline \a loops times with
+ *  the timestamps moved forward on each loop. Afterwards the report with
+ *  the throughput and, in profiling builds, the per stage cycles is
+ *  written to bench-replay.json in the log dir.
+ */
+TmEcode PcapFileReplay(PcapFileFileVars *ptv, uint32_t loops)
+{
+    SCEnter();
+
+    PcapReplay r;
+    memset(&r, 0, sizeof(r));
+    strlcpy(pcap_filename, ptv->filename, sizeof(pcap_filename));
+
+    if (PcapReplayLoad(ptv, &r) < 0)
+        SCReturnInt(TM_ECODE_FAILED);
+    if (r.pkts_cnt == 0) {
+        SCLogWarning(SC_ERR_PCAP_DISPATCH, "%s has no packets to replay",
+                ptv->filename);
+        PcapReplayFree(&r);
+        SCReturnInt(TM_ECODE_DONE);
+    }
+    SCLogNotice("replaying %s from memory: %"PRIu32" packets, %"PRIu64
+            " bytes, %"PRIu32" loops", ptv->filename, r.pkts_cnt,
+            r.data_len, loops);
+
+    const time_t span = r.pkts[r.pkts_cnt - 1].ts.tv_sec - r.pkts[0].ts.tv_sec + 1;
+    const time_t shift = (span > 0 ? span : 1) + PCAP_REPLAY_LOOP_GAP;
+    const uint64_t pkts_start = ptv->shared->pkts;
+    const uint64_t bytes_start = ptv->shared->bytes;
+    TmEcode result = TM_ECODE_DONE;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const uint64_t cycles_start = UtilCpuGetTicks();
+
+    for (uint32_t l = 0; l < loops && result == TM_ECODE_DONE; l++) {
+        for (uint32_t i = 0; i < r.pkts_cnt; i++) {
+            /* check the pool and the stop flag in batches, like
+             * PcapFileDispatch does around pcap_dispatch */
+            if ((i & 63) == 0) {
+                if (suricata_ctl_flags & SURICATA_STOP) {
+                    result = TM_ECODE_OK;
+                    break;
+                }
+                PacketPoolWait();
+                StatsSyncCountersIfSignalled(ptv->shared->tv);
+            }
+
+            const PcapReplayPacket *rp = &r.pkts[i];
+            struct pcap_pkthdr h;
+            memset(&h, 0, sizeof(h));
+            h.ts = rp->ts;
+            h.ts.tv_sec += l * shift;
+            h.caplen = h.len = rp->caplen;
+
+            PcapFileCallbackLoop((char *)ptv, &h, r.data + rp->offset);
+            if (ptv->shared->cb_result == TM_ECODE_FAILED) {
+                SCLogError(SC_ERR_PCAP_DISPATCH,
+                        "Pcap callback PcapFileCallbackLoop failed for %s",
+                        ptv->filename);
+                result = TM_ECODE_FAILED;
+                break;
+            }
+        }
+    }
+
+    /* with autofp the workers may still be busy: wait for all our
+     * packets to be returned to the pool */
+    if (result == TM_ECODE_DONE)
+        PacketPoolWaitForN(max_pending_packets);
+
+    const uint64_t cycles_end = UtilCpuGetTicks();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (result == TM_ECODE_DONE) {
+        ptv->shared->files++;
+        const double secs = (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+        PcapReplayReport(ptv, loops, ptv->shared->pkts - pkts_start,
+                ptv->shared->bytes - bytes_start, secs,
+                cycles_end - cycles_start);
+    }
+
+    PcapReplayFree(&r);
+    SCReturnInt(result);
+}
+#endif /* BENCHMARKS */
 /* eof */
@@ -86,6 +86,17 @@ typedef int (*Decoder)(ThreadVars *, DecodeThreadVars *, Packet *, uint8_t *, ui
  */
 TmEcode PcapFileDispatch(PcapFileFileVars *ptv);
 
+#ifdef BENCHMARKS
+/**
+ * Load a file into memory and replay it through the pipeline, writing
+ * a throughput report to bench-replay.json in the log dir.
+ * @param ptv PcapFileFileVars object to be replayed
+ * @param loops number of times to replay the file
+ * @return
+ */
+TmEcode PcapFileReplay(PcapFileFileVars *ptv, uint32_t loops);
+#endif
+
 /**
  * From a PcapFileFileVars, prepare the filename for processing by setting
  * pcap_handle, datalink, and filter
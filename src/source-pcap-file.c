@@ -49,6 +49,9 @@ typedef struct PcapFileThreadVars_
 {
     PcapFileBehaviorVar behavior;
     bool is_directory;
+#ifdef BENCHMARKS
+    uint32_t replay_loops;  /**< replay the file from memory, --bench-replay */
+#endif
 
     PcapFileSharedVars shared;
 } PcapFileThreadVars;
@@ -165,6 +168,11 @@ TmEcode ReceivePcapFileLoop(ThreadVars *tv, void *data, void *slot)
 
     if(ptv->is_directory == 0) {
         SCLogInfo("Starting file run for %s", ptv->behavior.file->filename);
+#ifdef BENCHMARKS
+        if (ptv->replay_loops > 0)
+            status = PcapFileReplay(ptv->behavior.file, ptv->replay_loops);
+        else
+#endif
         status = PcapFileDispatch(ptv->behavior.file);
         if (!RunModeUnixSocketIsActive()) {
             EngineStop();
@@ -245,6 +253,22 @@ TmEcode ReceivePcapFileThreadInit(ThreadVars *tv, const void *initdata, void **d
         SCReturnInt(status);
     }
 
+#ifdef BENCHMARKS
+    intmax_t replay_loops = 0;
+    if (ConfGetInt("pcap-file.bench-replay-loops", &replay_loops) == 1) {
+        if (replay_loops > 0 && replay_loops < UINT_MAX) {
+            ptv->replay_loops = (uint32_t)replay_loops;
+        } else {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "replay loops out of range");
+        }
+        if (directory != NULL) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "replay benchmark only "
+                    "supports a single pcap file, reading the directory");
+            ptv->replay_loops = 0;
+        }
+    }
+#endif
+
     if(directory == NULL) {
         SCLogInfo("Argument %s was a file", (char *)initdata);
         PcapFileFileVars *pv = SCMalloc(sizeof(PcapFileFileVars));
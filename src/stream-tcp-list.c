@@ -149,6 +149,37 @@ static inline bool CheckOverlap(struct TCPSEG *tree, TcpSegment *seg)
     return false;
 }
 
+/** \internal
+ *  \brief append an in-order segment to the tree
+ *
+ *  If the segment starts at or beyond the right edge of all segments
+ *  we have, it can't overlap. It also sorts after the current tail, so
+ *  it can be linked in as the tail's right child without descending
+ *  the tree. Only the rebalancing is left to do.
+ *
+ *  \retval true segment appended
+ *  \retval false segment needs the regular insert
+ */
+static inline bool DoAppendSegment(TcpStream *stream, TcpSegment *seg)
+{
+    TcpSegment *tail = stream->seg_tree_tail;
+    if (tail == NULL)
+        return false;
+    if (SEQ_LT(seg->seq, stream->segs_right_edge))
+        return false;
+    if (TcpSegmentCompare(seg, tail) <= 0)
+        return false;
+
+    DEBUG_VALIDATE_BUG_ON(RB_RIGHT(tail, rb) != NULL);
+    RB_SET(seg, tail, rb);
+    RB_RIGHT(tail, rb) = seg;
+    TCPSEG_RB_INSERT_COLOR(&stream->seg_tree, seg);
+
+    stream->seg_tree_tail = seg;
+    stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
+    return true;
+}
+
 /** \internal
  *  \brief insert the segment into the proper place in the tree
  *         don't worry about the data or overlaps
@@ -175,10 +206,18 @@ static int DoInsertSegment (TcpStream *stream, TcpSegment *seg, TcpSegment **dup
         SCLogDebug("empty tree, inserting seg %p seq %" PRIu32 ", "
                    "len %" PRIu32 "", seg, seg->seq, TCP_SEG_LEN(seg));
         TCPSEG_RB_INSERT(&stream->seg_tree, seg);
+        stream->seg_tree_tail = seg;
         stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
         return 0;
     }
 
+    /* in order data: append without overlap checks */
+    if (DoAppendSegment(stream, seg)) {
+        SCLogDebug("appended seg %p seq %"PRIu32", len %"PRIu32,
+                seg, seg->seq, TCP_SEG_LEN(seg));
+        return 0;
+    }
+
     /* insert and then check if there was any overlap with other segments */
     TcpSegment *res = TCPSEG_RB_INSERT(&stream->seg_tree, seg);
     if (res) {
@@ -190,6 +229,8 @@ static int DoInsertSegment (TcpStream *stream, TcpSegment *seg, TcpSegment **dup
     } else {
         if (SEQ_GT(SEG_SEQ_RIGHT_EDGE(seg), stream->segs_right_edge))
             stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(seg);
+        if (TCPSEG_RB_NEXT(seg) == NULL)
+            stream->seg_tree_tail = seg;
 
         /* insert succeeded, now check if we overlap with someone */
         if (CheckOverlap(&stream->seg_tree, seg) == true) {
@@ -547,6 +588,53 @@ static int DoHandleData(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
     return 0;
 }
 
+/**
+ *  \brief add in-order data to the stream's tail segment
+ *
+ *  When segment coalescing is enabled, data that directly follows the
+ *  last segment is added to the streaming buffer and accounted to that
+ *  segment instead of using a new one. On bulk transfers this bounds
+ *  the number of segments per stream to roughly the amount of buffered
+ *  data divided by the coalesce size.
+ *
+ *  \retval 1 data added to the tail segment
+ *  \retval 0 not possible, caller needs to insert a new segment
+ *  \retval -1 error
+ */
+int StreamTcpReassembleAppendToTail(TcpStream *stream,
+        uint32_t seq, uint8_t *data, uint16_t data_len)
+{
+    if (stream_config.reassembly_coalesce_size == 0 || StreamTcpInlineMode())
+        return 0;
+
+    TcpSegment *tail = stream->seg_tree_tail;
+    if (tail == NULL)
+        return 0;
+    /* must continue the tail exactly and be beyond everything else */
+    if (!(SEQ_EQ(seq, SEG_SEQ_RIGHT_EDGE(tail)) &&
+          SEQ_EQ(seq, stream->segs_right_edge) &&
+          SEQ_GEQ(seq, stream->base_seq)))
+        return 0;
+    if ((uint32_t)TCP_SEG_LEN(tail) + data_len > stream_config.reassembly_coalesce_size)
+        return 0;
+
+    const uint64_t stream_offset = STREAM_BASE_OFFSET(stream) + (seq - stream->base_seq);
+    if (tail->sbseg.stream_offset + tail->sbseg.segment_len != stream_offset)
+        return 0;
+
+    StreamingBufferSegment sbseg;
+    if (StreamingBufferInsertAt(&stream->sb, &sbseg, data, data_len, stream_offset) != 0)
+        return -1;
+
+    tail->sbseg.segment_len += sbseg.segment_len;
+    TCP_SEG_LEN(tail) += data_len;
+    stream->segs_right_edge = SEG_SEQ_RIGHT_EDGE(tail);
+
+    SCLogDebug("stream %p: coalesced %u bytes into seg %p seq %u, len now %u",
+            stream, data_len, tail, tail->seq, TCP_SEG_LEN(tail));
+    return 1;
+}
+
 /**
  *  \retval -1 segment not inserted
  *
@@ -786,6 +874,8 @@ static inline uint64_t GetLeftEdge(TcpSession *ssn, TcpStream *stream)
 
 static void StreamTcpRemoveSegmentFromStream(TcpStream *stream, TcpSegment *seg)
 {
+    if (stream->seg_tree_tail == seg)
+        stream->seg_tree_tail = TCPSEG_RB_PREV(seg);
     RB_REMOVE(TCPSEG, &stream->seg_tree, seg);
 }
 
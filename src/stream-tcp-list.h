@@ -26,6 +26,9 @@
 
 #include "stream-tcp-private.h"
 
+int StreamTcpReassembleAppendToTail(TcpStream *stream,
+        uint32_t seq, uint8_t *data, uint16_t data_len);
+
 #ifdef UNITTESTS
 void StreamTcpListRegisterTests(void);
 #endif
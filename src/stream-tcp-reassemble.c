@@ -320,6 +320,7 @@ void StreamTcpReturnStreamSegments (TcpStream *stream)
         RB_REMOVE(TCPSEG, &stream->seg_tree, seg);
         StreamTcpSegmentReturntoPool(seg);
     }
+    stream->seg_tree_tail = NULL;
 }
 
 #ifdef UNITTESTS
@@ -521,17 +522,18 @@ static uint32_t StreamTcpReassembleCheckDepth(TcpSession *ssn, TcpStream *stream
 {
     SCEnter();
 
+    /* if the final flag is set, we're not accepting anymore. It can also
+     * be set without a depth limit, e.g. for elephant flows. */
+    if (stream->flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED) {
+        SCReturnUInt(0);
+    }
+
     /* if the configured depth value is 0, it means there is no limit on
        reassembly depth. Otherwise carry on my boy ;) */
     if (ssn->reassembly_depth == 0) {
         SCReturnUInt(size);
     }
 
-    /* if the final flag is set, we're not accepting anymore */
-    if (stream->flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED) {
-        SCReturnUInt(0);
-    }
-
     uint64_t seg_depth;
     if (SEQ_GT(stream->base_seq, seq)) {
         if (SEQ_LEQ(seq+size, stream->base_seq)) {
@@ -637,6 +639,16 @@ int StreamTcpReassembleHandleSegmentHandleData(ThreadVars *tv, TcpReassemblyThre
     if (size > p->payload_len)
         size = p->payload_len;
 
+    /* in order data can be merged into the last segment */
+    int r = StreamTcpReassembleAppendToTail(stream, TCP_GET_SEQ(p), p->payload, size);
+    if (r == 1) {
+        StatsIncr(tv, ra_ctx->counter_tcp_reass_coalesced);
+        SCReturnInt(0);
+    } else if (r < 0) {
+        StatsIncr(tv, ra_ctx->counter_tcp_reass_data_normal_fail);
+        SCReturnInt(-1);
+    }
+
     TcpSegment *seg = StreamTcpGetSegment(tv, ra_ctx);
     if (seg == NULL) {
         SCLogDebug("segment_pool is empty");
@@ -77,6 +77,8 @@ typedef struct TcpReassemblyThreadCtx_ {
     uint16_t counter_tcp_reass_data_normal_fail;
     uint16_t counter_tcp_reass_data_overlap_fail;
     uint16_t counter_tcp_reass_list_fail;
+    /** count in-order data merged into an existing segment */
+    uint16_t counter_tcp_reass_coalesced;
 } TcpReassemblyThreadCtx;
 
 #define OS_POLICY_DEFAULT   OS_POLICY_BSD
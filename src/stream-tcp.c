@@ -85,6 +85,7 @@
 #define STREAMTCP_DEFAULT_TOSERVER_CHUNK_SIZE   2560
 #define STREAMTCP_DEFAULT_TOCLIENT_CHUNK_SIZE   2560
 #define STREAMTCP_DEFAULT_MAX_SYNACK_QUEUED     5
+#define STREAMTCP_DEFAULT_ELEPHANT_MIN_BYTES    (10 * 1024 * 1024) /* 10mb */
 
 #define STREAMTCP_NEW_TIMEOUT                   60
 #define STREAMTCP_EST_TIMEOUT                   3600
@@ -628,6 +629,54 @@ void StreamTcpInitConfig(char quiet)
             stream_config.reassembly_toclient_chunk_size);
     }
 
+    const char *temp_stream_reassembly_coalesce_str;
+    if (ConfGetValue("stream.reassembly.segment-coalesce-size",
+                &temp_stream_reassembly_coalesce_str) == 1) {
+        if (ParseSizeStringU16(temp_stream_reassembly_coalesce_str,
+                               &stream_config.reassembly_coalesce_size) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                       "stream.reassembly.segment-coalesce-size "
+                       "from conf file - %s.  Killing engine",
+                       temp_stream_reassembly_coalesce_str);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        stream_config.reassembly_coalesce_size = 0;
+    }
+    if (!quiet) {
+        SCLogConfig("stream.reassembly \"segment-coalesce-size\": %"PRIu16,
+            stream_config.reassembly_coalesce_size);
+    }
+
+    const char *temp_elephant_str;
+    if (ConfGetValue("stream.reassembly.elephant-flow.rate", &temp_elephant_str) == 1) {
+        if (ParseSizeStringU64(temp_elephant_str, &stream_config.elephant_rate) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                       "stream.reassembly.elephant-flow.rate "
+                       "from conf file - %s.  Killing engine",
+                       temp_elephant_str);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        stream_config.elephant_rate = 0;
+    }
+    if (ConfGetValue("stream.reassembly.elephant-flow.min-bytes", &temp_elephant_str) == 1) {
+        if (ParseSizeStringU64(temp_elephant_str, &stream_config.elephant_min_bytes) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                       "stream.reassembly.elephant-flow.min-bytes "
+                       "from conf file - %s.  Killing engine",
+                       temp_elephant_str);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        stream_config.elephant_min_bytes = STREAMTCP_DEFAULT_ELEPHANT_MIN_BYTES;
+    }
+    if (!quiet && stream_config.elephant_rate > 0) {
+        SCLogConfig("stream.reassembly.elephant-flow: rate %"PRIu64" bytes/s, "
+                "min-bytes %"PRIu64, stream_config.elephant_rate,
+                stream_config.elephant_min_bytes);
+    }
+
     int enable_raw = 1;
     if (ConfGetBool("stream.reassembly.raw", &enable_raw) == 1) {
         if (!enable_raw) {
@@ -4666,6 +4715,90 @@ static inline int StreamTcpStateDispatch(ThreadVars *tv, Packet *p,
     return 0;
 }
 
+/** \internal
+ *  \brief check if a session should be treated as an elephant flow
+ *
+ *  A session qualifies once the app-layer protocol is known (or the app
+ *  layer is disabled), it has moved at least elephant-flow.min-bytes and
+ *  its average byte rate since the start of the flow is at or above
+ *  elephant-flow.rate.
+ */
+static inline bool StreamTcpElephantCheck(const TcpSession *ssn, const Packet *p)
+{
+    if (stream_config.elephant_rate == 0)
+        return false;
+    if (ssn->flags & STREAMTCP_FLAG_ELEPHANT)
+        return false;
+    if ((ssn->client.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED) &&
+        (ssn->server.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED))
+        return false;
+
+    const Flow *f = p->flow;
+    if (f->alproto == ALPROTO_UNKNOWN &&
+            !(ssn->flags & STREAMTCP_FLAG_APP_LAYER_DISABLED))
+        return false;
+
+    const uint64_t bytes = f->todstbytecnt + f->tosrcbytecnt;
+    if (bytes < stream_config.elephant_min_bytes)
+        return false;
+
+    /* use at least one second so short bursts don't qualify */
+    uint64_t msecs = 0;
+    if (p->ts.tv_sec > f->startts.tv_sec ||
+        (p->ts.tv_sec == f->startts.tv_sec && p->ts.tv_usec > f->startts.tv_usec))
+    {
+        msecs = (uint64_t)(p->ts.tv_sec - f->startts.tv_sec) * 1000 +
+                ((int64_t)p->ts.tv_usec - (int64_t)f->startts.tv_usec) / 1000;
+    }
+    if (msecs < 1000)
+        msecs = 1000;
+
+    return (bytes * 1000 / msecs >= stream_config.elephant_rate);
+}
+
+/** \internal
+ *  \brief stop reassembly for both directions of an elephant flow
+ *
+ *  Marks both streams as having reached their depth and tells the
+ *  app-layer parser both directions are truncated. This is done here
+ *  and not left to the reassembly's depth handling, as the flow may
+ *  be bypassed on this same packet, after which the reassembly never
+ *  runs again. Data that was not yet acked is not passed on.
+ */
+static void StreamTcpElephantCutoff(TcpSession *ssn, Flow *f)
+{
+    SCLogDebug("ssn %p: elephant flow, stopping reassembly", ssn);
+    ssn->flags |= STREAMTCP_FLAG_ELEPHANT;
+    ssn->client.flags |= STREAMTCP_STREAM_FLAG_DEPTH_REACHED;
+    ssn->server.flags |= STREAMTCP_STREAM_FLAG_DEPTH_REACHED;
+
+    if (!(ssn->flags & STREAMTCP_FLAG_APP_LAYER_DISABLED) &&
+            f->alproto != ALPROTO_UNKNOWN && f->alstate != NULL)
+    {
+        AppLayerParserStreamTruncated(f->proto, f->alproto, f->alstate,
+                STREAM_TOSERVER);
+        AppLayerParserStreamTruncated(f->proto, f->alproto, f->alstate,
+                STREAM_TOCLIENT);
+    }
+}
+
+/** \internal
+ *  \brief bypass the flow and account it to the reason counter
+ *
+ *  The counter is only incremented the first time so it counts
+ *  flows, not packets.
+ */
+static inline void StreamTcpBypass(ThreadVars *tv, Packet *p, uint16_t counter)
+{
+    int state = SC_ATOMIC_GET(p->flow->flow_state);
+    if (state != FLOW_STATE_LOCAL_BYPASSED &&
+        state != FLOW_STATE_CAPTURE_BYPASSED)
+    {
+        StatsIncr(tv, counter);
+    }
+    PacketBypassCallback(p);
+}
+
 /* flow is and stays locked */
 int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
                      PacketQueue *pq)
@@ -4824,6 +4957,13 @@ int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
         if (p->flags & PKT_STREAM_MODIFIED) {
             ReCalculateChecksum(p);
         }
+        /* cut off elephant flows: stop reassembly and truncate the
+         * app-layer so that the depth based bypass below kicks in */
+        if (StreamTcpElephantCheck(ssn, p)) {
+            StreamTcpElephantCutoff(ssn, p->flow);
+            StatsIncr(tv, stt->counter_tcp_elephant);
+        }
+
         /* check for conditions that may make us not want to log this packet */
 
         /* streams that hit depth */
@@ -4832,7 +4972,8 @@ int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
         {
             /* we can call bypass callback, if enabled */
             if (StreamTcpBypassEnabled()) {
-                PacketBypassCallback(p);
+                StreamTcpBypass(tv, p, (ssn->flags & STREAMTCP_FLAG_ELEPHANT) ?
+                        stt->counter_tcp_bypass_elephant : stt->counter_tcp_bypass_depth);
             }
         }
 
@@ -4852,7 +4993,7 @@ int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
         if (ssn->flags & STREAMTCP_FLAG_BYPASS) {
             /* we can call bypass callback, if enabled */
             if (StreamTcpBypassEnabled()) {
-                PacketBypassCallback(p);
+                StreamTcpBypass(tv, p, stt->counter_tcp_bypass_app_layer);
             }
 
         /* if stream is dead and we have no detect engine at all, bypass. */
@@ -4862,7 +5003,7 @@ int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
                 StreamTcpBypassEnabled())
         {
             SCLogDebug("bypass as stream is dead and we have no rules");
-            PacketBypassCallback(p);
+            StreamTcpBypass(tv, p, stt->counter_tcp_bypass_no_detect);
         }
     }
 
@@ -5144,6 +5285,11 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->counter_tcp_synack = StatsRegisterCounter("tcp.synack", tv);
     stt->counter_tcp_rst = StatsRegisterCounter("tcp.rst", tv);
     stt->counter_tcp_midstream_pickups = StatsRegisterCounter("tcp.midstream_pickups", tv);
+    stt->counter_tcp_elephant = StatsRegisterCounter("tcp.elephant_flows", tv);
+    stt->counter_tcp_bypass_depth = StatsRegisterCounter("tcp.bypass.depth", tv);
+    stt->counter_tcp_bypass_elephant = StatsRegisterCounter("tcp.bypass.elephant", tv);
+    stt->counter_tcp_bypass_app_layer = StatsRegisterCounter("tcp.bypass.app_layer", tv);
+    stt->counter_tcp_bypass_no_detect = StatsRegisterCounter("tcp.bypass.no_detect", tv);
 
     /* init reassembly ctx */
     stt->ra_ctx = StreamTcpReassembleInitThreadCtx(tv);
@@ -5159,6 +5305,7 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->ra_ctx->counter_tcp_reass_data_normal_fail = StatsRegisterCounter("tcp.insert_data_normal_fail", tv);
     stt->ra_ctx->counter_tcp_reass_data_overlap_fail = StatsRegisterCounter("tcp.insert_data_overlap_fail", tv);
     stt->ra_ctx->counter_tcp_reass_list_fail = StatsRegisterCounter("tcp.insert_list_fail", tv);
+    stt->ra_ctx->counter_tcp_reass_coalesced = StatsRegisterCounter("tcp.segment_coalesced", tv);
 
 
     SCLogDebug("StreamTcp thread specific ctx online at %p, reassembly ctx %p",
@@ -10738,6 +10885,97 @@ end:
     return ret;
 }
 
+/** \test elephant flow classification on rate, size and app-layer state */
+static int StreamTcpElephantTest01(void)
+{
+    TcpSession ssn;
+    Flow f;
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+
+    memset(&ssn, 0, sizeof(ssn));
+    memset(&f, 0, sizeof(f));
+    p->flow = &f;
+
+    const uint64_t rate = stream_config.elephant_rate;
+    const uint64_t min_bytes = stream_config.elephant_min_bytes;
+    stream_config.elephant_rate = 1000000;
+    stream_config.elephant_min_bytes = 1000;
+
+    f.alproto = ALPROTO_TLS;
+    f.startts.tv_sec = 100;
+    p->ts.tv_sec = 110;
+
+    /* 500kb/s */
+    f.todstbytecnt = 5000000;
+    FAIL_IF(StreamTcpElephantCheck(&ssn, p));
+    /* 2mb/s */
+    f.tosrcbytecnt = 15000000;
+    FAIL_IF_NOT(StreamTcpElephantCheck(&ssn, p));
+
+    /* protocol not yet known */
+    f.alproto = ALPROTO_UNKNOWN;
+    FAIL_IF(StreamTcpElephantCheck(&ssn, p));
+    f.alproto = ALPROTO_TLS;
+
+    StreamTcpElephantCutoff(&ssn, &f);
+    FAIL_IF_NOT(ssn.flags & STREAMTCP_FLAG_ELEPHANT);
+    FAIL_IF_NOT(ssn.client.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED);
+    FAIL_IF_NOT(ssn.server.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED);
+    /* only classified once */
+    FAIL_IF(StreamTcpElephantCheck(&ssn, p));
+
+    stream_config.elephant_rate = rate;
+    stream_config.elephant_min_bytes = min_bytes;
+    SCFree(p);
+    PASS;
+}
+
+static uint8_t elephant_truncated = 0;
+
+static void StreamTcpElephantTruncate(void *state, uint8_t direction)
+{
+    elephant_truncated |= (direction & (STREAM_TOSERVER|STREAM_TOCLIENT));
+}
+
+/** \test the parser is told about the truncation by the elephant cutoff
+ *         itself, as a bypass may follow on the same packet */
+static int StreamTcpElephantTest02(void)
+{
+    TcpSession ssn;
+    Flow f;
+    int state = 0;
+
+    memset(&ssn, 0, sizeof(ssn));
+    memset(&f, 0, sizeof(f));
+    f.proto = IPPROTO_TCP;
+    f.alproto = ALPROTO_TEST;
+    f.alstate = &state;
+
+    AppLayerParserBackupParserTable();
+    AppLayerParserRegisterTruncateFunc(IPPROTO_TCP, ALPROTO_TEST,
+            StreamTcpElephantTruncate);
+
+    elephant_truncated = 0;
+    StreamTcpElephantCutoff(&ssn, &f);
+    const uint8_t seen = elephant_truncated;
+
+    /* app-layer disabled on the session: nothing to tell */
+    memset(&ssn, 0, sizeof(ssn));
+    ssn.flags |= STREAMTCP_FLAG_APP_LAYER_DISABLED;
+    elephant_truncated = 0;
+    StreamTcpElephantCutoff(&ssn, &f);
+    const uint8_t seen_disabled = elephant_truncated;
+
+    AppLayerParserRestoreParserTable();
+
+    FAIL_IF_NOT(seen == (STREAM_TOSERVER|STREAM_TOCLIENT));
+    FAIL_IF_NOT(seen_disabled == 0);
+    FAIL_IF_NOT(ssn.client.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED);
+    FAIL_IF_NOT(ssn.server.flags & STREAMTCP_STREAM_FLAG_DEPTH_REACHED);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void StreamTcpRegisterTests (void)
@@ -10814,6 +11052,8 @@ void StreamTcpRegisterTests (void)
     UtRegisterTest("StreamTcpTest43 -- SYN/ACK queue", StreamTcpTest43);
     UtRegisterTest("StreamTcpTest44 -- SYN/ACK queue", StreamTcpTest44);
     UtRegisterTest("StreamTcpTest45 -- SYN/ACK queue", StreamTcpTest45);
+    UtRegisterTest("StreamTcpElephantTest01", StreamTcpElephantTest01);
+    UtRegisterTest("StreamTcpElephantTest02", StreamTcpElephantTest02);
 
     /* set up the reassembly tests as well */
     StreamTcpReassembleRegisterTests();
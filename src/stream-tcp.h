@@ -61,6 +61,11 @@ typedef struct TcpStreamCnf_ {
 
     uint16_t reassembly_toserver_chunk_size;
     uint16_t reassembly_toclient_chunk_size;
+    uint16_t reassembly_coalesce_size; /**< max size in-order data is merged into
+                                        *   a single segment. 0: disabled */
+
+    uint64_t elephant_rate;     /**< bytes/sec above which a flow is an elephant. 0: disabled */
+    uint64_t elephant_min_bytes; /**< min flow size before the rate is considered */
 
     bool streaming_log_api;
 
@@ -96,6 +101,13 @@ typedef struct StreamTcpThread_ {
     uint16_t counter_tcp_rst;
     /** midstream pickups */
     uint16_t counter_tcp_midstream_pickups;
+    /** sessions classified as elephant flows */
+    uint16_t counter_tcp_elephant;
+    /** sessions bypassed, per reason */
+    uint16_t counter_tcp_bypass_depth;
+    uint16_t counter_tcp_bypass_elephant;
+    uint16_t counter_tcp_bypass_app_layer;
+    uint16_t counter_tcp_bypass_no_detect;
 
     /** tcp reassembly thread data */
     TcpReassemblyThreadCtx *ra_ctx;
@@ -63,6 +63,7 @@
 #include "detect-engine-address.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter-pcre.h"
 
 #include "tm-queuehandlers.h"
 #include "tm-queues.h"
@@ -111,6 +112,7 @@
 
 #include "ippair.h"
 #include "ippair-bit.h"
+#include "datasets.h"
 
 #include "host.h"
 #include "unix-manager.h"
@@ -173,6 +175,7 @@
 #include "host-storage.h"
 
 #include "util-lua.h"
+#include "util-lpm.h"
 
 #ifdef HAVE_RUST
 #include "rust.h"
@@ -365,6 +368,7 @@ static void GlobalsDestroy(SCInstance *suri)
         DetectEngineDeReference(&de_ctx);
     }
     DetectEnginePruneFreeList();
+    DatasetsDestroy();
 
     AppLayerDeSetup();
 
@@ -397,6 +401,7 @@ static void GlobalsDestroy(SCInstance *suri)
 
 #ifdef BUILD_HYPERSCAN
     MpmHSGlobalCleanup();
+    PrefilterPcreGlobalCleanup();
 #endif
 
     ConfDeInit();
@@ -1433,6 +1438,32 @@ static void ParseCommandLineAFL(const char *opt_name, char *opt_arg)
     }
 }
 
+#ifdef BENCHMARKS
+static void ParseCommandLineBenchmark(SCInstance *suri, const char *opt_name, char *opt_arg)
+{
+    if (strcmp(opt_name, "bench-lpm") == 0) {
+        exit(SCLpmBenchmark(opt_arg));
+    } else if (strcmp(opt_name, "bench-replay") == 0) {
+        /* used with -r, the replay itself runs in the pcap file thread */
+        if (ConfSetFinal("pcap-file.bench-replay-loops",
+                    opt_arg ? opt_arg : "10") != 1) {
+            fprintf(stderr, "ERROR: Failed to set pcap-file.bench-replay-loops.\n");
+            exit(EXIT_FAILURE);
+        }
+    } else if (strcmp(opt_name, "bench-mpm") == 0) {
+        /* the benchmark runs while the rules are built, so load them
+         * like -T does and exit */
+        if (ConfSetFinal("detect.bench-mpm", opt_arg ? opt_arg : "synthetic") != 1) {
+            fprintf(stderr, "ERROR: Failed to set detect.bench-mpm.\n");
+            exit(EXIT_FAILURE);
+        }
+        suri->run_mode = RUNMODE_CONF_TEST;
+    } else {
+        abort();
+    }
+}
+#endif
+
 static TmEcode ParseCommandLine(int argc, char** argv, SCInstance *suri)
 {
     int opt;
@@ -1513,6 +1544,12 @@ static TmEcode ParseCommandLine(int argc, char** argv, SCInstance *suri)
         {"afl-decoder-ipv6-serie", required_argument, 0 , 0},
         {"afl-der", required_argument, 0, 0},
 
+#ifdef BENCHMARKS
+        {"bench-lpm", optional_argument, 0, 0},
+        {"bench-replay", optional_argument, 0, 0},
+        {"bench-mpm", optional_argument, 0, 0},
+#endif
+
 #ifdef BUILD_UNIX_SOCKET
         {"unix-socket", optional_argument, 0, 0},
 #endif
@@ -1657,6 +1694,10 @@ static TmEcode ParseCommandLine(int argc, char** argv, SCInstance *suri)
                 }
             } else if(strncmp((long_opts[option_index]).name, "afl-", 4) == 0) {
                 ParseCommandLineAFL((long_opts[option_index]).name, optarg);
+#ifdef BENCHMARKS
+            } else if(strncmp((long_opts[option_index]).name, "bench-", 6) == 0) {
+                ParseCommandLineBenchmark(suri, (long_opts[option_index]).name, optarg);
+#endif
             } else if(strcmp((long_opts[option_index]).name, "simulate-ips") == 0) {
                 SCLogInfo("Setting IPS mode");
                 EngineModeSetIPS();
@@ -2765,6 +2806,13 @@ static int PostConfLoadedSetup(SCInstance *suri)
     HostBitInitCtx();
     IPPairBitInitCtx();
 
+    if (DatasetsInit() < 0) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY,
+                "datasets setup failed. Please check %s for errors",
+                suri->conf_filename);
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
     if (DetectAddressTestConfVars() < 0) {
         SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY,
                 "basic address vars test failed. Please check %s for errors",
@@ -2807,6 +2855,7 @@ static int PostConfLoadedSetup(SCInstance *suri)
     }
 
     HostInitConfig(HOST_VERBOSE);
+    SCLpmInitConfig();
 #ifdef HAVE_MAGIC
     if (MagicInit() != 0)
         SCReturnInt(TM_ECODE_FAILED);
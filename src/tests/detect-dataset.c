@@ -0,0 +1,187 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "../util-unittest.h"
+#include "../util-unittest-helper.h"
+#include "../app-layer-parser.h"
+#include "../flow-util.h"
+#include "../stream-tcp.h"
+
+static int DetectDatasetTest01(void)
+{
+    DetectDatasetOpts opts;
+    FAIL_IF_NOT(DetectDatasetParse("isset,ioc-domains", &opts) == 0);
+    FAIL_IF_NOT(opts.cmd == DETECT_DATASET_CMD_ISSET);
+    FAIL_IF_NOT(strcmp(opts.name, "ioc-domains") == 0);
+    FAIL_IF_NOT(opts.type == DATASET_TYPE_NOTSET);
+
+    FAIL_IF_NOT(DetectDatasetParse(" isnotset , ioc-md5, type md5, "
+                "load md5.lst, memcap 10mb, hashsize 4096", &opts) == 0);
+    FAIL_IF_NOT(opts.cmd == DETECT_DATASET_CMD_ISNOTSET);
+    FAIL_IF_NOT(strcmp(opts.name, "ioc-md5") == 0);
+    FAIL_IF_NOT(opts.type == DATASET_TYPE_MD5);
+    FAIL_IF_NOT(strcmp(opts.load, "md5.lst") == 0);
+    FAIL_IF_NOT(opts.memcap == 10 * 1024 * 1024);
+    FAIL_IF_NOT(opts.hashsize == 4096);
+
+    FAIL_IF_NOT(DetectDatasetParse("isset", &opts) < 0);
+    FAIL_IF_NOT(DetectDatasetParse("set,ioc", &opts) < 0);
+    FAIL_IF_NOT(DetectDatasetParse("isset,ioc,type blob", &opts) < 0);
+    FAIL_IF_NOT(DetectDatasetParse("isset,ioc,type", &opts) < 0);
+    FAIL_IF_NOT(DetectDatasetParse("isset,ioc,size 10", &opts) < 0);
+    PASS;
+}
+
+static int DetectDatasetTest02(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert dns any any -> any any "
+            "(dns_query; dataset:isset,detect-dataset-test02,type string; sid:1;)");
+    FAIL_IF_NULL(s);
+    /* existing set, type can be omitted but must match if given */
+    s = DetectEngineAppendSig(de_ctx, "alert dns any any -> any any "
+            "(dns_query; dataset:isnotset,detect-dataset-test02; sid:2;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert dns any any -> any any "
+            "(dns_query; dataset:isset,detect-dataset-test02,type md5; sid:3;)");
+    FAIL_IF_NOT_NULL(s);
+    /* new set needs a type */
+    s = DetectEngineAppendSig(de_ctx, "alert dns any any -> any any "
+            "(dns_query; dataset:isset,detect-dataset-test02-x; sid:4;)");
+    FAIL_IF_NOT_NULL(s);
+    /* needs a sticky buffer */
+    s = DetectEngineAppendSig(de_ctx, "alert dns any any -> any any "
+            "(dataset:isset,detect-dataset-test02; sid:5;)");
+    FAIL_IF_NOT_NULL(s);
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+static int DetectDatasetTest03(void)
+{
+    Dataset *set = DatasetGet("detect-dataset-test03", DATASET_TYPE_SHA256,
+            NULL, 0, 0);
+    FAIL_IF_NULL(set);
+    const char *sha = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    FAIL_IF_NOT(DatasetAddSerialized(set, sha) == 1);
+
+    DetectDatasetData isset = { .set = set, .cmd = DETECT_DATASET_CMD_ISSET };
+    DetectDatasetData isnotset = { .set = set, .cmd = DETECT_DATASET_CMD_ISNOTSET };
+
+    FAIL_IF_NOT(DetectDatasetBufferMatch(NULL, &isset, (const uint8_t *)sha, strlen(sha)) == 1);
+    FAIL_IF_NOT(DetectDatasetBufferMatch(NULL, &isnotset, (const uint8_t *)sha, strlen(sha)) == 0);
+    /* not a sha256 at all, so neither set nor not set */
+    FAIL_IF_NOT(DetectDatasetBufferMatch(NULL, &isset, (const uint8_t *)"abc", 3) == 0);
+    FAIL_IF_NOT(DetectDatasetBufferMatch(NULL, &isnotset, (const uint8_t *)"abc", 3) == 0);
+
+    FAIL_IF_NOT(DatasetRemoveSerialized(set, sha) == 1);
+    FAIL_IF_NOT(DetectDatasetBufferMatch(NULL, &isset, (const uint8_t *)sha, strlen(sha)) == 0);
+    PASS;
+}
+
+/** \test dataset on a sticky buffer, through the detection engine */
+static int DetectDatasetTest04(void)
+{
+    TcpSession ssn;
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    Flow f;
+    uint8_t http_buf[] =
+        "GET /index.html HTTP/1.0\r\n"
+        "Host: www.openinfosecfoundation.org\r\n"
+        "\r\n";
+    uint32_t http_len = sizeof(http_buf) - 1;
+
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    Packet *p = UTHBuildPacket(NULL, 0, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    f.proto = IPPROTO_TCP;
+    f.flags |= FLOW_IPV4;
+    f.alproto = ALPROTO_HTTP;
+
+    p->flow = &f;
+    p->flowflags |= FLOW_PKT_TOSERVER | FLOW_PKT_ESTABLISHED;
+    p->flags |= PKT_HAS_FLOW | PKT_STREAM_EST;
+
+    StreamTcpInitConfig(TRUE);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; dataset:isset,detect-dataset-test04,"
+            "type string; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; dataset:isnotset,detect-dataset-test04; "
+            "sid:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; dataset:isset,detect-dataset-test04-empty,"
+            "type string; sid:3;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http_request_line; dataset:isnotset,detect-dataset-test04-empty; "
+            "sid:4;)"));
+
+    Dataset *set = DatasetFind("detect-dataset-test04", DATASET_TYPE_STRING);
+    FAIL_IF_NULL(set);
+    FAIL_IF_NOT(DatasetAddSerialized(set, "GET /index.html HTTP/1.0") == 1);
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    FLOWLOCK_WRLOCK(&f);
+    int r = AppLayerParserParse(&th_v, alp_tctx, &f, ALPROTO_HTTP,
+            STREAM_TOSERVER, http_buf, http_len);
+    FLOWLOCK_UNLOCK(&f);
+    FAIL_IF(r != 0);
+    FAIL_IF_NULL(f.alstate);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+    FAIL_IF(PacketAlertCheck(p, 3));
+    FAIL_IF_NOT(PacketAlertCheck(p, 4));
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
+static void DetectDatasetRegisterTests(void)
+{
+    UtRegisterTest("DetectDatasetTest01", DetectDatasetTest01);
+    UtRegisterTest("DetectDatasetTest02", DetectDatasetTest02);
+    UtRegisterTest("DetectDatasetTest03", DetectDatasetTest03);
+    UtRegisterTest("DetectDatasetTest04", DetectDatasetTest04);
+}
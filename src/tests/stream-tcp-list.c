@@ -708,6 +708,82 @@ static int StreamTcpReassembleTest32(void)
     OVERLAP_END;
 }
 
+/** \test in order segments are appended at the tail, out of order ones
+ *        still go through the tree insert and overlap handling */
+static int StreamTcpReassembleTest33(void)
+{
+    OVERLAP_START(0, OS_POLICY_BSD);
+    OVERLAP_STEP(1, "AAAAA", 5, "AAAAA", 5);
+    FAIL_IF(stream->seg_tree_tail != RB_MAX(TCPSEG, &stream->seg_tree));
+    OVERLAP_STEP(6, "BBBBB", 5, "AAAAABBBBB", 10);
+    FAIL_IF(stream->seg_tree_tail != RB_MAX(TCPSEG, &stream->seg_tree));
+    OVERLAP_STEP(16, "DDDDD", 5, "AAAAABBBBB\0\0\0\0\0DDDDD", 20);
+    FAIL_IF(stream->seg_tree_tail != RB_MAX(TCPSEG, &stream->seg_tree));
+    FAIL_IF(stream->seg_tree_tail->seq != stream->isn + 16);
+    /* fill the hole: not at the tail */
+    OVERLAP_STEP(11, "CCCCC", 5, "AAAAABBBBBCCCCCDDDDD", 20);
+    FAIL_IF(stream->seg_tree_tail->seq != stream->isn + 16);
+    /* overlaps the tail: regular insert with overlap handling */
+    OVERLAP_STEP(19, "EEEE", 4, "AAAAABBBBBCCCCCDDDDDEE", 22);
+    FAIL_IF(stream->seg_tree_tail != RB_MAX(TCPSEG, &stream->seg_tree));
+    OVERLAP_STEP(23, "FF", 2, "AAAAABBBBBCCCCCDDDDDEEFF", 24);
+    FAIL_IF(stream->seg_tree_tail != RB_MAX(TCPSEG, &stream->seg_tree));
+
+    uint32_t seq = 0;
+    TcpSegment *seg = NULL;
+    RB_FOREACH(seg, TCPSEG, &stream->seg_tree) {
+        FAIL_IF(SEQ_LT(seg->seq, seq));
+        seq = seg->seq;
+    }
+    OVERLAP_END;
+}
+
+static int SegmentCount(TcpStream *stream)
+{
+    int cnt = 0;
+    TcpSegment *seg = NULL;
+    RB_FOREACH(seg, TCPSEG, &stream->seg_tree) {
+        cnt++;
+    }
+    return cnt;
+}
+
+static int StreamTcpReassembleTest34Run(void)
+{
+    OVERLAP_START(0, OS_POLICY_BSD);
+    stream_config.reassembly_coalesce_size = 12;
+
+    OVERLAP_STEP(1, "AAAAA", 5, "AAAAA", 5);
+    OVERLAP_STEP(6, "BBBBB", 5, "AAAAABBBBB", 10);
+    FAIL_IF(SegmentCount(stream) != 1);
+    FAIL_IF(TCP_SEG_LEN(stream->seg_tree_tail) != 10);
+    FAIL_IF(stream->seg_tree_tail->sbseg.segment_len != 10);
+    /* would exceed the coalesce size: new segment */
+    OVERLAP_STEP(11, "CCCCC", 5, "AAAAABBBBBCCCCC", 15);
+    FAIL_IF(SegmentCount(stream) != 2);
+    /* gap: new segment */
+    OVERLAP_STEP(21, "EEEEE", 5, "AAAAABBBBBCCCCC\0\0\0\0\0EEEEE", 25);
+    FAIL_IF(SegmentCount(stream) != 3);
+    /* fill the gap: regular insert, not merged into the tail */
+    OVERLAP_STEP(16, "DDDDD", 5, "AAAAABBBBBCCCCCDDDDDEEEEE", 25);
+    FAIL_IF(SegmentCount(stream) != 4);
+    OVERLAP_STEP(26, "FF", 2, "AAAAABBBBBCCCCCDDDDDEEEEEFF", 27);
+    FAIL_IF(SegmentCount(stream) != 4);
+    FAIL_IF(stream->segs_right_edge != stream->isn + 28);
+    OVERLAP_END;
+}
+
+/** \test with coalescing enabled in-order data is merged into the tail
+ *        segment up to the configured size */
+static int StreamTcpReassembleTest34(void)
+{
+    /* the steps return on failure, so restore the setting out here */
+    const uint16_t coalesce_size = stream_config.reassembly_coalesce_size;
+    int r = StreamTcpReassembleTest34Run();
+    stream_config.reassembly_coalesce_size = coalesce_size;
+    return r;
+}
+
 void StreamTcpListRegisterTests(void)
 {
     UtRegisterTest("StreamTcpReassembleTest01 -- BSD policy",
@@ -729,5 +805,9 @@ void StreamTcpListRegisterTests(void)
             StreamTcpReassembleTest31);
     UtRegisterTest("StreamTcpReassembleTest32",
             StreamTcpReassembleTest32);
+    UtRegisterTest("StreamTcpReassembleTest33",
+            StreamTcpReassembleTest33);
+    UtRegisterTest("StreamTcpReassembleTest34",
+            StreamTcpReassembleTest34);
 
 }
@@ -25,6 +25,8 @@
 #include "suricata.h"
 #include "unix-manager.h"
 #include "detect-engine.h"
+#include "detect-engine-sampling.h"
+#include "reputation.h"
 #include "tm-threads.h"
 #include "runmodes.h"
 #include "conf.h"
@@ -773,6 +775,32 @@ static TmEcode UnixManagerNonBlockingReloadRules(json_t *cmd, json_t *server_msg
     return UnixManagerReloadRulesWrapper(cmd, server_msg, data, 0);
 }
 
+static TmEcode UnixManagerIPRepReloadCommand(json_t *cmd,
+                                             json_t *server_msg, void *data)
+{
+    SCEnter();
+
+    int r = SRepReload();
+    if (r == -2) {
+        json_object_set_new(server_msg, "message",
+                            json_string("previous reload still in use, "
+                                        "try again later"));
+        SCReturnInt(TM_ECODE_FAILED);
+    } else if (r < 0) {
+        json_object_set_new(server_msg, "message",
+                            json_string("IP reputation reload failed"));
+        SCReturnInt(TM_ECODE_FAILED);
+    } else if (r > 0) {
+        json_object_set_new(server_msg, "message",
+                            json_string("reloaded, but some reputation files "
+                                        "failed to load"));
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    json_object_set_new(server_msg, "message", json_string("done"));
+    SCReturnInt(TM_ECODE_OK);
+}
+
 static TmEcode UnixManagerReloadTimeCommand(json_t *cmd,
                                             json_t *server_msg, void *data)
 {
@@ -854,6 +882,69 @@ error:
     SCReturnInt(TM_ECODE_FAILED);
 }
 
+/**
+ * \brief Command to list the most expensive rules, buffers and prefilter
+ *        engines, as measured by detect.sampling
+ *
+ * One entry per detect engine, so per tenant. Optional argument 'count'
+ * is the number of rules to list, 10 by default.
+ */
+static TmEcode UnixManagerRulesetSamplingTopCommand(json_t *cmd,
+                                                    json_t *server_msg, void *data)
+{
+    SCEnter();
+    uint32_t top = 10;
+
+    json_t *jarg = json_object_get(cmd, "count");
+    if (jarg != NULL) {
+        if (!json_is_integer(jarg) || json_integer_value(jarg) <= 0) {
+            json_object_set_new(server_msg, "message",
+                                json_string("count is not a positive integer"));
+            SCReturnInt(TM_ECODE_FAILED);
+        }
+        top = (uint32_t)MIN(json_integer_value(jarg), UINT32_MAX);
+    }
+
+    DetectEngineCtx *de_ctx = DetectEngineGetCurrent();
+    if (de_ctx == NULL) {
+        json_object_set_new(server_msg, "message", json_string("Unable to get info"));
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    if (de_ctx->sampling_rate == 0) {
+        DetectEngineDeReference(&de_ctx);
+        json_object_set_new(server_msg, "message",
+                            json_string("detect.sampling is disabled"));
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+
+    json_t *js_engines = json_array();
+    if (js_engines == NULL) {
+        DetectEngineDeReference(&de_ctx);
+        json_object_set_new(server_msg, "message", json_string("Unable to get info"));
+        SCReturnInt(TM_ECODE_FAILED);
+    }
+    for (DetectEngineCtx *list = de_ctx; list != NULL; list = list->next) {
+        json_t *jdata = DetectSamplingTopJson(list, top);
+        if (jdata == NULL)
+            continue;
+        json_object_set_new(jdata, "tenant_id", json_integer(list->tenant_id));
+        json_array_append_new(js_engines, jdata);
+    }
+    DetectEngineDeReference(&de_ctx);
+
+    json_object_set_new(server_msg, "message", js_engines);
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static TmEcode UnixManagerRulesetSamplingResetCommand(json_t *cmd,
+                                                      json_t *server_msg, void *data)
+{
+    SCEnter();
+    DetectSamplingReset();
+    json_object_set_new(server_msg, "message", json_string("done"));
+    SCReturnInt(TM_ECODE_OK);
+}
+
 static TmEcode UnixManagerConfGetCommand(json_t *cmd,
                                          json_t *server_msg, void *data)
 {
@@ -1074,8 +1165,11 @@ int UnixManagerInit(void)
     UnixManagerRegisterCommand("ruleset-reload-rules", UnixManagerReloadRules, NULL, 0);
     UnixManagerRegisterCommand("ruleset-reload-nonblocking", UnixManagerNonBlockingReloadRules, NULL, 0);
     UnixManagerRegisterCommand("ruleset-reload-time", UnixManagerReloadTimeCommand, NULL, 0);
+    UnixManagerRegisterCommand("iprep-reload", UnixManagerIPRepReloadCommand, NULL, 0);
     UnixManagerRegisterCommand("ruleset-stats", UnixManagerRulesetStatsCommand, NULL, 0);
     UnixManagerRegisterCommand("ruleset-failed-rules", UnixManagerShowFailedRules, NULL, 0);
+    UnixManagerRegisterCommand("ruleset-sampling-top", UnixManagerRulesetSamplingTopCommand, &command, UNIX_CMD_TAKE_ARGS);
+    UnixManagerRegisterCommand("ruleset-sampling-reset", UnixManagerRulesetSamplingResetCommand, NULL, 0);
     UnixManagerRegisterCommand("register-tenant-handler", UnixSocketRegisterTenantHandler, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("unregister-tenant-handler", UnixSocketUnregisterTenantHandler, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("register-tenant", UnixSocketRegisterTenant, &command, UNIX_CMD_TAKE_ARGS);
@@ -1084,6 +1178,8 @@ int UnixManagerInit(void)
     UnixManagerRegisterCommand("add-hostbit", UnixSocketHostbitAdd, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("remove-hostbit", UnixSocketHostbitRemove, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("list-hostbit", UnixSocketHostbitList, &command, UNIX_CMD_TAKE_ARGS);
+    UnixManagerRegisterCommand("dataset-add", UnixSocketDatasetAdd, &command, UNIX_CMD_TAKE_ARGS);
+    UnixManagerRegisterCommand("dataset-remove", UnixSocketDatasetRemove, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("reopen-log-files", UnixManagerReopenLogFiles, NULL, 0);
     UnixManagerRegisterCommand("memcap-set", UnixSocketSetMemcap, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("memcap-show", UnixSocketShowMemcap, &command, UNIX_CMD_TAKE_ARGS);
@@ -0,0 +1,262 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Bump allocator. Memory is taken from the current chunk until it is
+ * full, then a new chunk is added. Allocations larger than a quarter
+ * of the chunk size that don't fit get a chunk of their own, so they
+ * don't waste the rest of the current one.
+ */
+
+#include "suricata-common.h"
+#include "util-arena.h"
+#include "util-unittest.h"
+#include "util-debug.h"
+
+#define MEM_ARENA_ALIGN     16
+#define MEM_ARENA_ROUNDUP(x) (((x) + (MEM_ARENA_ALIGN - 1)) & ~(MEM_ARENA_ALIGN - 1))
+
+static int MemArenaReserve(MemArena *arena, uint64_t size)
+{
+    if (arena->CheckMemcap != NULL && arena->CheckMemcap(size) == 0)
+        return -1;
+    if (arena->IncrMemuse != NULL)
+        arena->IncrMemuse(size);
+    arena->memuse += size;
+    return 0;
+}
+
+static void MemArenaRelease(MemArena *arena, uint64_t size)
+{
+    if (arena->DecrMemuse != NULL)
+        arena->DecrMemuse(size);
+    arena->memuse -= size;
+}
+
+/**
+ *  \brief create an arena
+ *
+ *  \param chunk_size size of the chunks memory is handed out from
+ *  \param CheckMemcap optional, returns 0 if 'size' can't be alloc'd
+ *  \param IncrMemuse optional, called for each chunk alloc
+ *  \param DecrMemuse optional, called for each chunk free
+ *
+ *  \retval arena or NULL on error
+ */
+MemArena *MemArenaCreate(uint32_t chunk_size,
+        int (*CheckMemcap)(uint64_t), void (*IncrMemuse)(uint64_t),
+        void (*DecrMemuse)(uint64_t))
+{
+    if (CheckMemcap != NULL && CheckMemcap(sizeof(MemArena)) == 0)
+        return NULL;
+
+    MemArena *arena = SCMalloc(sizeof(*arena));
+    if (unlikely(arena == NULL))
+        return NULL;
+    memset(arena, 0, sizeof(*arena));
+
+    arena->chunk_size = MEM_ARENA_ROUNDUP(chunk_size);
+    arena->CheckMemcap = CheckMemcap;
+    arena->IncrMemuse = IncrMemuse;
+    arena->DecrMemuse = DecrMemuse;
+
+    if (IncrMemuse != NULL)
+        IncrMemuse(sizeof(MemArena));
+    arena->memuse = sizeof(MemArena);
+    return arena;
+}
+
+static MemArenaChunk *MemArenaChunkAlloc(MemArena *arena, uint32_t size)
+{
+    const uint64_t alloc_size = sizeof(MemArenaChunk) + size;
+    if (MemArenaReserve(arena, alloc_size) < 0)
+        return NULL;
+
+    MemArenaChunk *chunk = SCMalloc(alloc_size);
+    if (unlikely(chunk == NULL)) {
+        MemArenaRelease(arena, alloc_size);
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+/**
+ *  \brief get memory from the arena
+ *
+ *  Memory is aligned to 16 bytes and is not zeroed.
+ *
+ *  \retval ptr or NULL if out of memory or over memcap
+ */
+void *MemArenaAlloc(MemArena *arena, size_t size)
+{
+    if (size == 0 || size > UINT32_MAX - MEM_ARENA_ALIGN)
+        return NULL;
+    const uint32_t asize = MEM_ARENA_ROUNDUP((uint32_t)size);
+
+    MemArenaChunk *chunk = arena->chunks;
+    if (chunk != NULL && chunk->size - chunk->used >= asize) {
+        void *ptr = chunk->data + chunk->used;
+        chunk->used += asize;
+        return ptr;
+    }
+
+    if (asize > arena->chunk_size / 4) {
+        /* big alloc: own chunk, keep using the current one after it */
+        MemArenaChunk *big = MemArenaChunkAlloc(arena, asize);
+        if (big == NULL)
+            return NULL;
+        big->used = asize;
+        if (chunk != NULL) {
+            big->next = chunk->next;
+            chunk->next = big;
+        } else {
+            arena->chunks = big;
+        }
+        return big->data;
+    }
+
+    MemArenaChunk *new_chunk = MemArenaChunkAlloc(arena, arena->chunk_size);
+    if (new_chunk == NULL)
+        return NULL;
+    new_chunk->next = chunk;
+    arena->chunks = new_chunk;
+    new_chunk->used = asize;
+    return new_chunk->data;
+}
+
+/**
+ *  \brief get zeroed memory from the arena
+ */
+void *MemArenaCalloc(MemArena *arena, size_t size)
+{
+    void *ptr = MemArenaAlloc(arena, size);
+    if (ptr != NULL)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+/**
+ *  \brief free the arena and all memory handed out from it
+ */
+void MemArenaDestroy(MemArena *arena)
+{
+    if (arena == NULL)
+        return;
+
+    MemArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        MemArenaChunk *next = chunk->next;
+        MemArenaRelease(arena, sizeof(MemArenaChunk) + chunk->size);
+        SCFree(chunk);
+        chunk = next;
+    }
+    if (arena->DecrMemuse != NULL)
+        arena->DecrMemuse(sizeof(MemArena));
+    SCFree(arena);
+}
+
+#ifdef UNITTESTS
+static uint64_t arena_test_memuse = 0;
+
+static int MemArenaTestCheckMemcap(uint64_t size)
+{
+    return (arena_test_memuse + size <= 4096);
+}
+
+static void MemArenaTestIncrMemuse(uint64_t size)
+{
+    arena_test_memuse += size;
+}
+
+static void MemArenaTestDecrMemuse(uint64_t size)
+{
+    arena_test_memuse -= size;
+}
+
+/** \test small allocs share a chunk, big ones get their own */
+static int MemArenaTest01(void)
+{
+    MemArena *arena = MemArenaCreate(1024, NULL, NULL, NULL);
+    FAIL_IF_NULL(arena);
+
+    uint8_t *a = MemArenaAlloc(arena, 10);
+    FAIL_IF_NULL(a);
+    uint8_t *b = MemArenaCalloc(arena, 20);
+    FAIL_IF_NULL(b);
+    FAIL_IF(b != a + 16);
+    FAIL_IF(b[19] != 0);
+    FAIL_IF(((uintptr_t)b % MEM_ARENA_ALIGN) != 0);
+    FAIL_IF_NOT(arena->chunks->used == 48);
+
+    /* big alloc that doesn't fit goes into its own chunk, the small
+     * chunk stays current */
+    uint8_t *c = MemArenaAlloc(arena, 1000);
+    FAIL_IF_NULL(c);
+    uint8_t *d = MemArenaAlloc(arena, 8);
+    FAIL_IF(d != b + 32);
+    FAIL_IF_NULL(arena->chunks->next);
+    FAIL_IF_NOT(arena->chunks->next->size == 1008);
+
+    /* fill up the chunk: a new one is added */
+    FAIL_IF_NULL(MemArenaAlloc(arena, 200));
+    FAIL_IF_NULL(MemArenaAlloc(arena, 200));
+    FAIL_IF_NULL(MemArenaAlloc(arena, 200));
+    FAIL_IF_NULL(MemArenaAlloc(arena, 200));
+    FAIL_IF_NULL(MemArenaAlloc(arena, 200));
+    FAIL_IF_NULL(arena->chunks->next->next);
+    FAIL_IF_NOT(arena->chunks->used == 208);
+
+    FAIL_IF_NOT(MemArenaAlloc(arena, 0) == NULL);
+    MemArenaDestroy(arena);
+    PASS;
+}
+
+/** \test memcap accounting */
+static int MemArenaTest02(void)
+{
+    arena_test_memuse = 0;
+    MemArena *arena = MemArenaCreate(1024, MemArenaTestCheckMemcap,
+            MemArenaTestIncrMemuse, MemArenaTestDecrMemuse);
+    FAIL_IF_NULL(arena);
+    FAIL_IF_NOT(arena_test_memuse == sizeof(MemArena));
+
+    FAIL_IF_NULL(MemArenaAlloc(arena, 100));
+    FAIL_IF_NOT(arena_test_memuse == sizeof(MemArena) + sizeof(MemArenaChunk) + 1024);
+    FAIL_IF_NOT(arena->memuse == arena_test_memuse);
+
+    /* over memcap */
+    FAIL_IF_NOT(MemArenaAlloc(arena, 8000) == NULL);
+    FAIL_IF_NOT(arena->memuse == arena_test_memuse);
+
+    MemArenaDestroy(arena);
+    FAIL_IF_NOT(arena_test_memuse == 0);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void MemArenaRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("MemArenaTest01", MemArenaTest01);
+    UtRegisterTest("MemArenaTest02", MemArenaTest02);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,56 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Bump allocator for objects that share a lifetime, like the objects
+ * making up a transaction. Objects can't be freed individually, the
+ * whole arena is released at once.
+ */
+
+#ifndef __UTIL_ARENA_H__
+#define __UTIL_ARENA_H__
+
+typedef struct MemArenaChunk_ {
+    struct MemArenaChunk_ *next;
+    uint32_t size;                  /**< usable size of data */
+    uint32_t used;
+    uint8_t data[];
+} MemArenaChunk;
+
+typedef struct MemArena_ {
+    MemArenaChunk *chunks;          /**< current chunk is the head */
+    uint32_t chunk_size;
+    uint64_t memuse;                /**< bytes held, including the arena */
+
+    /** optional memcap accounting hooks */
+    int (*CheckMemcap)(uint64_t size);
+    void (*IncrMemuse)(uint64_t size);
+    void (*DecrMemuse)(uint64_t size);
+} MemArena;
+
+MemArena *MemArenaCreate(uint32_t chunk_size,
+        int (*CheckMemcap)(uint64_t), void (*IncrMemuse)(uint64_t),
+        void (*DecrMemuse)(uint64_t));
+void *MemArenaAlloc(MemArena *arena, size_t size);
+void *MemArenaCalloc(MemArena *arena, size_t size);
+void MemArenaDestroy(MemArena *arena);
+
+void MemArenaRegisterTests(void);
+
+#endif /* __UTIL_ARENA_H__ */
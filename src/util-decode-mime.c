@@ -30,6 +30,7 @@
 #include "util-unittest.h"
 #include "util-memcmp.h"
 #include "util-print.h"
+#include "util-arena.h"
 
 /* Character constants */
 #ifndef CR
@@ -73,6 +74,7 @@
 
 /* Memory Usage Constants */
 #define STACK_FREE_NODES  10
+#define MIME_DEC_ARENA_CHUNK_SIZE 1024 /* arena chunk for the message tree */
 
 /* Other Constants */
 #define MAX_IP4_CHARS  15
@@ -170,6 +172,9 @@ static MimeDecEntity *findLastSibling(MimeDecEntity *node)
     return node;
 }
 
+static void FreeFieldList(MimeDecField *field, const bool free_nodes);
+static void FreeUrlList(MimeDecUrl *url, const bool free_nodes);
+
 /**
  * \brief Frees a mime entity tree
  *
@@ -182,6 +187,8 @@ void MimeDecFreeEntity (MimeDecEntity *entity)
 {
     if (entity == NULL)
         return;
+    /* nodes from the arena are released with it at the end */
+    MemArena *arena = entity->arena;
     MimeDecEntity *lastSibling = findLastSibling(entity);
     while (entity != NULL)
     {
@@ -201,23 +208,26 @@ void MimeDecFreeEntity (MimeDecEntity *entity)
         MimeDecEntity *old = entity;
         entity = entity->next;
 
-        MimeDecFreeField(old->field_list);
-        MimeDecFreeUrl(old->url_list);
+        FreeFieldList(old->field_list, old->arena == NULL);
+        FreeUrlList(old->url_list, old->arena == NULL);
         SCFree(old->filename);
 
-        SCFree(old);
+        if (old->arena == NULL)
+            SCFree(old);
     }
+    MemArenaDestroy(arena);
 }
 
 /**
  * \brief Iteratively frees a header field entry list
  *
  * \param field The header field
+ * \param free_nodes Whether to free the nodes, false if from an arena
  *
  * \return none
  *
  */
-void MimeDecFreeField(MimeDecField *field)
+static void FreeFieldList(MimeDecField *field, const bool free_nodes)
 {
     MimeDecField *temp, *curr;
 
@@ -233,20 +243,35 @@ void MimeDecFreeField(MimeDecField *field)
             SCFree(temp->value);
 
             /* Now free node data */
-            SCFree(temp);
+            if (free_nodes)
+                SCFree(temp);
         }
     }
 }
 
+/**
+ * \brief Iteratively frees a header field entry list
+ *
+ * \param field The header field
+ *
+ * \return none
+ *
+ */
+void MimeDecFreeField(MimeDecField *field)
+{
+    FreeFieldList(field, true);
+}
+
 /**
  * \brief Iteratively frees a URL entry list
  *
  * \param url The url entry
+ * \param free_nodes Whether to free the nodes, false if from an arena
  *
  * \return none
  *
  */
-void MimeDecFreeUrl(MimeDecUrl *url)
+static void FreeUrlList(MimeDecUrl *url, const bool free_nodes)
 {
     MimeDecUrl *temp, *curr;
 
@@ -259,11 +284,25 @@ void MimeDecFreeUrl(MimeDecUrl *url)
 
             /* Now free node data */
             SCFree(temp->url);
-            SCFree(temp);
+            if (free_nodes)
+                SCFree(temp);
         }
     }
 }
 
+/**
+ * \brief Iteratively frees a URL entry list
+ *
+ * \param url The url entry
+ *
+ * \return none
+ *
+ */
+void MimeDecFreeUrl(MimeDecUrl *url)
+{
+    FreeUrlList(url, true);
+}
+
 /**
  * \brief Creates and adds a header field entry to an entity
  *
@@ -277,12 +316,16 @@ void MimeDecFreeUrl(MimeDecUrl *url)
  */
 MimeDecField * MimeDecAddField(MimeDecEntity *entity)
 {
-    MimeDecField *node = SCMalloc(sizeof(MimeDecField));
+    MimeDecField *node;
+    if (entity->arena != NULL) {
+        node = MemArenaCalloc(entity->arena, sizeof(MimeDecField));
+    } else {
+        node = SCCalloc(1, sizeof(MimeDecField));
+    }
     if (unlikely(node == NULL)) {
         SCLogError(SC_ERR_MEM_ALLOC, "memory allocation failed");
         return NULL;
     }
-    memset(node, 0x00, sizeof(MimeDecField));
 
     /* If list is empty, then set as head of list */
     if (entity->field_list == NULL) {
@@ -363,12 +406,16 @@ MimeDecField * MimeDecFindField(const MimeDecEntity *entity, const char *name) {
  */
 static MimeDecUrl * MimeDecAddUrl(MimeDecEntity *entity, uint8_t *url, uint32_t url_len, uint8_t flags)
 {
-    MimeDecUrl *node = SCMalloc(sizeof(MimeDecUrl));
+    MimeDecUrl *node;
+    if (entity->arena != NULL) {
+        node = MemArenaCalloc(entity->arena, sizeof(MimeDecUrl));
+    } else {
+        node = SCCalloc(1, sizeof(MimeDecUrl));
+    }
     if (unlikely(node == NULL)) {
         SCLogError(SC_ERR_MEM_ALLOC, "memory allocation failed");
         return NULL;
     }
-    memset(node, 0x00, sizeof(MimeDecUrl));
 
     node->url = url;
     node->url_len = url_len;
@@ -397,12 +444,18 @@ static MimeDecUrl * MimeDecAddUrl(MimeDecEntity *entity, uint8_t *url, uint32_t
  */
 MimeDecEntity * MimeDecAddEntity(MimeDecEntity *parent)
 {
-    MimeDecEntity *curr, *node = SCMalloc(sizeof(MimeDecEntity));
+    MimeDecEntity *curr, *node;
+    if (parent != NULL && parent->arena != NULL) {
+        node = MemArenaCalloc(parent->arena, sizeof(MimeDecEntity));
+    } else {
+        node = SCCalloc(1, sizeof(MimeDecEntity));
+    }
     if (unlikely(node == NULL)) {
         SCLogError(SC_ERR_MEM_ALLOC, "memory allocation failed");
         return NULL;
     }
-    memset(node, 0x00, sizeof(MimeDecEntity));
+    if (parent != NULL)
+        node->arena = parent->arena;
 
     /* If parent is NULL then just return the new pointer */
     if (parent != NULL) {
@@ -2399,14 +2452,27 @@ MimeDecParseState * MimeDecInitParser(void *data,
     }
     memset(state->stack, 0x00, sizeof(MimeDecStack));
 
-    mimeMsg = SCMalloc(sizeof(MimeDecEntity));
+    /* the entities, fields and urls of the message live as long as
+     * the message, so get them from an arena. Fall back to the heap if
+     * that fails. */
+    MemArena *arena = MemArenaCreate(MIME_DEC_ARENA_CHUNK_SIZE, NULL, NULL, NULL);
+    if (arena != NULL) {
+        mimeMsg = MemArenaCalloc(arena, sizeof(MimeDecEntity));
+        if (mimeMsg == NULL) {
+            MemArenaDestroy(arena);
+            arena = NULL;
+        }
+    }
+    if (arena == NULL) {
+        mimeMsg = SCCalloc(1, sizeof(MimeDecEntity));
+    }
     if (unlikely(mimeMsg == NULL)) {
         SCLogError(SC_ERR_MEM_ALLOC, "memory allocation failed");
         SCFree(state->stack);
         SCFree(state);
         return NULL;
     }
-    memset(mimeMsg, 0x00, sizeof(MimeDecEntity));
+    mimeMsg->arena = arena;
     mimeMsg->ctnt_flags |= CTNT_IS_MSG;
 
     /* Init state */
@@ -2414,6 +2480,7 @@ MimeDecParseState * MimeDecInitParser(void *data,
     PushStack(state->stack);
     if (state->stack->top == NULL) {
         SCLogError(SC_ERR_MEM_ALLOC, "memory allocation failed");
+        MimeDecFreeEntity(mimeMsg);
         SCFree(state->stack);
         SCFree(state);
         return NULL;
@@ -32,6 +32,7 @@
 #include "suricata.h"
 #include "util-base64.h"
 #include "util-debug.h"
+#include "util-arena.h"
 
 /* Content Flags */
 #define CTNT_IS_MSG           1
@@ -144,6 +145,7 @@ typedef struct MimeDecEntity {
     uint8_t *msg_id;  /**< Quick access pointer to message Id */
     struct MimeDecEntity *next;  /**< Pointer to list of sibling entities */
     struct MimeDecEntity *child;  /**< Pointer to list of child entities */
+    MemArena *arena;  /**< Arena of the message the entity, its fields and urls are alloc'd from, or NULL */
 } MimeDecEntity;
 
 /**
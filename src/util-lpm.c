@@ -0,0 +1,644 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Longest prefix match tables compiled from a radix tree.
+ *
+ * The radix tree is kept as the structure that is built and modified,
+ * the table is created from it once it is complete and is never changed
+ * afterwards. Prefixes are expanded into the tables (leaf pushing), so
+ * a lookup never has to backtrack: IPv4 takes at most 3 memory accesses,
+ * IPv6 at most 15.
+ *
+ * Leaf pushing makes long IPv6 prefixes expensive: every prefix past /16
+ * can add a 1KiB table per byte. All tables are accounted against
+ * detect.lpm-memcap. A table that doesn't fit isn't created, the caller
+ * then keeps using the radix tree for it.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "util-atomic.h"
+#include "util-debug.h"
+#include "util-ip.h"
+#include "util-lpm.h"
+#include "util-misc.h"
+#include "util-unittest.h"
+
+#define LPM_ROOT_BITS   16
+#define LPM_STRIDE_BITS 8
+
+/** 0 is unlimited */
+static uint64_t lpm_memcap = SC_LPM_DEFAULT_MEMCAP;
+SC_ATOMIC_DECLARE(uint64_t, lpm_memuse);
+
+void SCLpmInitConfig(void)
+{
+    const char *conf_val;
+
+    SC_ATOMIC_INIT(lpm_memuse);
+    if ((ConfGet("detect.lpm-memcap", &conf_val)) == 1) {
+        uint64_t memcap = 0;
+        if (ParseSizeStringU64(conf_val, &memcap) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing detect.lpm-memcap "
+                    "from conf file - %s. Using the default", conf_val);
+            memcap = SC_LPM_DEFAULT_MEMCAP;
+        }
+        lpm_memcap = memcap;
+    }
+    SCLogConfig("lpm memcap: %"PRIu64, lpm_memcap);
+}
+
+void SCLpmSetMemcap(uint64_t size)
+{
+    lpm_memcap = size;
+}
+
+uint64_t SCLpmGetMemcap(void)
+{
+    return lpm_memcap;
+}
+
+/** \brief memory used by all lpm tables */
+uint64_t SCLpmGetMemuse(void)
+{
+    return SC_ATOMIC_GET(lpm_memuse);
+}
+
+/** \internal
+ *  \brief account size bytes to the table, if the memcap allows
+ *
+ *  \retval 0 ok
+ *  \retval -2 memcap reached
+ */
+static int LpmMemuseIncr(SCLpmTable *lpm, uint64_t size)
+{
+    if (lpm_memcap != 0 && SC_ATOMIC_GET(lpm_memuse) + size > lpm_memcap)
+        return -2;
+    (void)SC_ATOMIC_ADD(lpm_memuse, size);
+    lpm->memuse += size;
+    return 0;
+}
+
+static void LpmMemuseDecr(SCLpmTable *lpm, uint64_t size)
+{
+    (void)SC_ATOMIC_SUB(lpm_memuse, size);
+    lpm->memuse -= size;
+}
+
+typedef struct LpmPrefix_ {
+    uint8_t addr[16];
+    uint8_t len;
+    uint32_t value;     /**< 1 based index into values */
+} LpmPrefix;
+
+typedef struct LpmBuild_ {
+    LpmPrefix *prefixes;
+    uint32_t cnt;
+    uint32_t size;
+} LpmBuild;
+
+/** \retval 0 ok, -1 alloc error, -2 memcap reached */
+static int LpmCollectPrefix(SCLpmTable *lpm, LpmBuild *b,
+        const SCRadixPrefix *prefix, const SCRadixUserData *ud)
+{
+    if (b->cnt == b->size) {
+        uint32_t size = b->size ? b->size * 2 : 64;
+        void *ptmp = SCRealloc(b->prefixes, size * sizeof(LpmPrefix));
+        if (ptmp == NULL)
+            return -1;
+        b->prefixes = ptmp;
+
+        const uint64_t grow = (uint64_t)(size - b->size) * sizeof(void *);
+        if (LpmMemuseIncr(lpm, grow) < 0)
+            return -2;
+        ptmp = SCRealloc(lpm->values, size * sizeof(void *));
+        if (ptmp == NULL) {
+            LpmMemuseDecr(lpm, grow);
+            return -1;
+        }
+        lpm->values = ptmp;
+        b->size = size;
+    }
+
+    LpmPrefix *p = &b->prefixes[b->cnt];
+    memset(p, 0, sizeof(*p));
+    memcpy(p->addr, prefix->stream, lpm->key_len);
+    p->len = MIN(ud->netmask, lpm->key_len * 8);
+    MaskIPNetblock(p->addr, p->len, lpm->key_len * 8);
+
+    lpm->values[b->cnt] = ud->user;
+    p->value = ++b->cnt;
+    lpm->values_cnt = b->cnt;
+    return 0;
+}
+
+static int LpmCollect(SCLpmTable *lpm, LpmBuild *b, const SCRadixNode *node)
+{
+    for ( ; node != NULL; node = node->right) {
+        if (node->prefix != NULL && node->prefix->bitlen == lpm->key_len * 8) {
+            const SCRadixUserData *ud;
+            for (ud = node->prefix->user_data; ud != NULL; ud = ud->next) {
+                int r = LpmCollectPrefix(lpm, b, node->prefix, ud);
+                if (r < 0)
+                    return r;
+            }
+        }
+        int r = LpmCollect(lpm, b, node->left);
+        if (r < 0)
+            return r;
+    }
+    return 0;
+}
+
+static int LpmPrefixCompare(const void *a, const void *b)
+{
+    const LpmPrefix *pa = a, *pb = b;
+    if (pa->len != pb->len)
+        return (int)pa->len - (int)pb->len;
+    return (int)pa->value - (int)pb->value;
+}
+
+/** \retval idx of the new table, filled with 'fill', -1 on error or -2
+ *          if the memcap is reached */
+static int64_t LpmNewTable(SCLpmTable *lpm, uint32_t fill)
+{
+    if (lpm->tbls_cnt == lpm->tbls_size) {
+        uint32_t size = lpm->tbls_size ? lpm->tbls_size * 2 : 64;
+        if (size > SC_LPM_CHILD)
+            return -1;
+        const uint64_t grow = ((uint64_t)(size - lpm->tbls_size) << LPM_STRIDE_BITS) *
+            sizeof(uint32_t);
+        if (LpmMemuseIncr(lpm, grow) < 0)
+            return -2;
+        void *ptmp = SCRealloc(lpm->tbls, ((size_t)size << LPM_STRIDE_BITS) * sizeof(uint32_t));
+        if (ptmp == NULL) {
+            LpmMemuseDecr(lpm, grow);
+            return -1;
+        }
+        lpm->tbls = ptmp;
+        lpm->tbls_size = size;
+    }
+
+    uint32_t *tbl = lpm->tbls + ((size_t)lpm->tbls_cnt << LPM_STRIDE_BITS);
+    int i;
+    for (i = 0; i < (1 << LPM_STRIDE_BITS); i++)
+        tbl[i] = fill;
+    return lpm->tbls_cnt++;
+}
+
+/** \brief set an entry, replacing everything below it if it's a child */
+static void LpmSet(SCLpmTable *lpm, uint32_t *e, uint32_t value)
+{
+    if (*e & SC_LPM_CHILD) {
+        uint32_t *tbl = lpm->tbls + ((size_t)(*e & ~SC_LPM_CHILD) << LPM_STRIDE_BITS);
+        int i;
+        for (i = 0; i < (1 << LPM_STRIDE_BITS); i++)
+            LpmSet(lpm, &tbl[i], value);
+    } else {
+        *e = value;
+    }
+}
+
+/**
+ * \brief expand a prefix into the tables
+ *
+ * Prefixes have to be inserted shortest first, so a prefix simply
+ * overwrites whatever covers its range. Child tables are created from
+ * the entry they replace, so the shorter prefix is pushed down into them.
+ *
+ * \retval 0 ok, -1 alloc error, -2 memcap reached
+ */
+static int LpmInsert(SCLpmTable *lpm, const LpmPrefix *p)
+{
+    int64_t t = -1;     /* root */
+    uint32_t level;
+
+    for (level = 0; ; level++) {
+        uint32_t end, idx;
+        if (level == 0) {
+            end = LPM_ROOT_BITS;
+            idx = (p->addr[0] << 8) | p->addr[1];
+        } else {
+            end = LPM_ROOT_BITS + level * LPM_STRIDE_BITS;
+            idx = p->addr[level + 1];
+        }
+        uint32_t *tbl = (t < 0) ? lpm->root :
+            lpm->tbls + ((size_t)t << LPM_STRIDE_BITS);
+
+        if (p->len <= end) {
+            uint32_t span = 1U << (end - p->len);
+            uint32_t u;
+            idx &= ~(span - 1);
+            for (u = idx; u < idx + span; u++)
+                LpmSet(lpm, &tbl[u], p->value);
+            return 0;
+        }
+
+        if (!(tbl[idx] & SC_LPM_CHILD)) {
+            int64_t n = LpmNewTable(lpm, tbl[idx]);
+            if (n < 0)
+                return (int)n;
+            /* tables may have moved */
+            tbl = (t < 0) ? lpm->root :
+                lpm->tbls + ((size_t)t << LPM_STRIDE_BITS);
+            tbl[idx] = SC_LPM_CHILD | (uint32_t)n;
+        }
+        t = tbl[idx] & ~SC_LPM_CHILD;
+    }
+}
+
+/**
+ * \brief compile the prefixes of one family of a radix tree into a table
+ *
+ * \param family AF_INET or AF_INET6. Trees holding both families (e.g.
+ *        config trees) are fine, the other family is skipped.
+ *
+ * \retval lpm table or NULL on error or if it doesn't fit in the memcap,
+ *         in which case the caller is expected to keep using the radix tree
+ */
+SCLpmTable *SCLpmCreateFromRadixTree(const SCRadixTree *tree, int family)
+{
+    LpmBuild b = { NULL, 0, 0 };
+    int r = -1;
+
+    if (tree == NULL || (family != AF_INET && family != AF_INET6))
+        return NULL;
+
+    SCLpmTable *lpm = SCCalloc(1, sizeof(*lpm));
+    if (unlikely(lpm == NULL))
+        return NULL;
+    lpm->key_len = (family == AF_INET) ? 4 : 16;
+
+    r = LpmMemuseIncr(lpm, sizeof(*lpm) + (1 << LPM_ROOT_BITS) * sizeof(uint32_t));
+    if (r < 0)
+        goto error;
+    lpm->root = SCCalloc(1 << LPM_ROOT_BITS, sizeof(uint32_t));
+    if (lpm->root == NULL) {
+        r = -1;
+        goto error;
+    }
+
+    r = LpmCollect(lpm, &b, tree->head);
+    if (r < 0)
+        goto error;
+
+    if (b.cnt > 0) {
+        qsort(b.prefixes, b.cnt, sizeof(LpmPrefix), LpmPrefixCompare);
+
+        uint32_t u;
+        for (u = 0; u < b.cnt; u++) {
+            r = LpmInsert(lpm, &b.prefixes[u]);
+            if (r < 0)
+                goto error;
+        }
+    }
+
+    SCLogDebug("lpm %p: %u prefixes, %u tables, %"PRIu64" bytes",
+            lpm, lpm->values_cnt, lpm->tbls_cnt, SCLpmMemuse(lpm));
+    SCFree(b.prefixes);
+    return lpm;
+
+error:
+    if (r == -2) {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "ipv%d lookup table for %u prefixes "
+                "doesn't fit in detect.lpm-memcap %"PRIu64" (in use %"PRIu64")",
+                family == AF_INET ? 4 : 6, b.cnt, lpm_memcap, SCLpmGetMemuse());
+    } else {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "failed to compile ipv%d lookup table "
+                "for %u prefixes", family == AF_INET ? 4 : 6, b.cnt);
+    }
+    if (b.prefixes != NULL)
+        SCFree(b.prefixes);
+    SCLpmFree(lpm);
+    return NULL;
+}
+
+void SCLpmFree(SCLpmTable *lpm)
+{
+    if (lpm == NULL)
+        return;
+
+    if (lpm->root != NULL)
+        SCFree(lpm->root);
+    if (lpm->tbls != NULL)
+        SCFree(lpm->tbls);
+    if (lpm->values != NULL)
+        SCFree(lpm->values);
+    (void)SC_ATOMIC_SUB(lpm_memuse, lpm->memuse);
+    SCFree(lpm);
+}
+
+uint64_t SCLpmMemuse(const SCLpmTable *lpm)
+{
+    if (lpm == NULL)
+        return 0;
+    return lpm->memuse;
+}
+
+#if defined(BENCHMARKS) || defined(UNITTESTS)
+/** \brief xorshift, so runs are reproducible */
+static uint64_t LpmRand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return (*state = x);
+}
+
+static void LpmRandomAddr(uint64_t *state, uint8_t *addr, int len)
+{
+    int i;
+    for (i = 0; i < len; i += 8) {
+        uint64_t r = LpmRand(state);
+        memcpy(addr + i, &r, MIN(8, len - i));
+    }
+}
+
+/**
+ * \brief add random prefixes to a radix tree
+ *
+ * \param min_len,max_len range of the prefix lengths
+ */
+static void LpmAddRandomPrefixes(SCRadixTree *tree, int family, uint32_t cnt,
+        uint8_t min_len, uint8_t max_len, uint64_t *state)
+{
+    uint32_t u;
+    for (u = 0; u < cnt; u++) {
+        uint8_t addr[16];
+        uint8_t len = min_len + LpmRand(state) % (max_len - min_len + 1);
+        void *user = (void *)(uintptr_t)(u + 1);
+
+        if (family == AF_INET) {
+            LpmRandomAddr(state, addr, 4);
+            if (len == 32)
+                SCRadixAddKeyIPV4(addr, tree, user);
+            else
+                SCRadixAddKeyIPV4Netblock(addr, tree, user, len);
+        } else {
+            LpmRandomAddr(state, addr, 16);
+            if (len == 128)
+                SCRadixAddKeyIPV6(addr, tree, user);
+            else
+                SCRadixAddKeyIPV6Netblock(addr, tree, user, len);
+        }
+    }
+}
+#endif
+
+#ifdef BENCHMARKS
+
+#define LPM_BENCH_LOOKUPS   2000000
+
+static void LpmBenchmarkFamily(int family, uint32_t prefixes)
+{
+    const int key_len = (family == AF_INET) ? 4 : 16;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    struct timeval start, end;
+    uint64_t usec;
+
+    SCRadixTree *tree = SCRadixCreateRadixTree(NULL, NULL);
+    gettimeofday(&start, NULL);
+    if (family == AF_INET)
+        LpmAddRandomPrefixes(tree, family, prefixes, 8, 24, &state);
+    else
+        LpmAddRandomPrefixes(tree, family, prefixes, 16, 48, &state);
+    gettimeofday(&end, NULL);
+    usec = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_usec - start.tv_usec);
+    printf("ipv%d: %u prefixes, radix tree built in %"PRIu64" ms\n",
+            family == AF_INET ? 4 : 6, prefixes, usec / 1000);
+
+    gettimeofday(&start, NULL);
+    SCLpmTable *lpm = SCLpmCreateFromRadixTree(tree, family);
+    gettimeofday(&end, NULL);
+    if (lpm == NULL) {
+        printf("ipv%d: failed to compile lpm table\n", family == AF_INET ? 4 : 6);
+        SCRadixReleaseRadixTree(tree);
+        return;
+    }
+    usec = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_usec - start.tv_usec);
+    printf("ipv%d: lpm table compiled in %"PRIu64" ms, %u tables, %"PRIu64" MiB\n",
+            family == AF_INET ? 4 : 6, usec / 1000, lpm->tbls_cnt,
+            SCLpmMemuse(lpm) / (1024 * 1024));
+
+    uint8_t *keys = SCMalloc((size_t)LPM_BENCH_LOOKUPS * key_len);
+    if (keys == NULL) {
+        SCLpmFree(lpm);
+        SCRadixReleaseRadixTree(tree);
+        return;
+    }
+    LpmRandomAddr(&state, keys, LPM_BENCH_LOOKUPS * key_len);
+
+    uint32_t u, found = 0;
+    void *user = NULL;
+    gettimeofday(&start, NULL);
+    for (u = 0; u < LPM_BENCH_LOOKUPS; u++) {
+        user = NULL;
+        if (family == AF_INET)
+            (void)SCRadixFindKeyIPV4BestMatch(keys + (size_t)u * key_len, tree, &user);
+        else
+            (void)SCRadixFindKeyIPV6BestMatch(keys + (size_t)u * key_len, tree, &user);
+        found += (user != NULL);
+    }
+    gettimeofday(&end, NULL);
+    usec = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_usec - start.tv_usec);
+    printf("ipv%d: radix: %u lookups (%u found) in %"PRIu64" ms: %.1f Mlookups/s\n",
+            family == AF_INET ? 4 : 6, LPM_BENCH_LOOKUPS, found, usec / 1000,
+            usec ? (double)LPM_BENCH_LOOKUPS / usec : 0);
+
+    found = 0;
+    gettimeofday(&start, NULL);
+    for (u = 0; u < LPM_BENCH_LOOKUPS; u++) {
+        found += (SCLpmLookup(lpm, keys + (size_t)u * key_len) != NULL);
+    }
+    gettimeofday(&end, NULL);
+    usec = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_usec - start.tv_usec);
+    printf("ipv%d: lpm:   %u lookups (%u found) in %"PRIu64" ms: %.1f Mlookups/s\n",
+            family == AF_INET ? 4 : 6, LPM_BENCH_LOOKUPS, found, usec / 1000,
+            usec ? (double)LPM_BENCH_LOOKUPS / usec : 0);
+
+    SCFree(keys);
+    SCLpmFree(lpm);
+    SCRadixReleaseRadixTree(tree);
+}
+
+/**
+ * \brief compare radix tree and lpm table lookups
+ *
+ * \param arg "<ipv4 prefixes>[,<ipv6 prefixes>]", defaults to 1M ipv4
+ *            prefixes (/8 to /24) and 100k ipv6 prefixes (/16 to /48)
+ *
+ * \retval exit code
+ */
+int SCLpmBenchmark(const char *arg)
+{
+    uint32_t v4 = 1000000, v6 = 100000;
+
+    if (arg != NULL && *arg != '\0') {
+        if (sscanf(arg, "%u,%u", &v4, &v6) < 1) {
+            fprintf(stderr, "usage: --bench-lpm[=<ipv4 prefixes>[,<ipv6 prefixes>]]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (v4 > 0)
+        LpmBenchmarkFamily(AF_INET, v4);
+    if (v6 > 0)
+        LpmBenchmarkFamily(AF_INET6, v6);
+    return EXIT_SUCCESS;
+}
+#endif /* BENCHMARKS */
+
+#ifdef UNITTESTS
+
+static int SCLpmTest01(void)
+{
+    SCRadixTree *tree = SCRadixCreateRadixTree(NULL, NULL);
+    FAIL_IF_NULL(tree);
+
+    SCRadixAddKeyIPV4String("0.0.0.0/0", tree, (void *)1);
+    SCRadixAddKeyIPV4String("192.168.0.0/16", tree, (void *)2);
+    SCRadixAddKeyIPV4String("192.168.1.0/24", tree, (void *)3);
+    SCRadixAddKeyIPV4String("192.168.1.1", tree, (void *)4);
+    SCRadixAddKeyIPV4String("10.10.10.0/25", tree, (void *)5);
+    SCRadixAddKeyIPV4String("10.0.0.0/7", tree, (void *)6);
+    SCRadixAddKeyIPV6String("2001:db8::/32", tree, (void *)7);
+
+    SCLpmTable *lpm = SCLpmCreateFromRadixTree(tree, AF_INET);
+    FAIL_IF_NULL(lpm);
+    FAIL_IF_NOT(lpm->values_cnt == 6);
+
+    struct in_addr a;
+    inet_pton(AF_INET, "192.168.1.1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)4);
+    inet_pton(AF_INET, "192.168.1.2", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)3);
+    inet_pton(AF_INET, "192.168.2.1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)2);
+    inet_pton(AF_INET, "10.10.10.127", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)5);
+    inet_pton(AF_INET, "10.10.10.128", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)6);
+    inet_pton(AF_INET, "11.1.1.1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)6);
+    inet_pton(AF_INET, "12.1.1.1", &a);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a) == (void *)1);
+    SCLpmFree(lpm);
+
+    lpm = SCLpmCreateFromRadixTree(tree, AF_INET6);
+    FAIL_IF_NULL(lpm);
+    struct in6_addr a6;
+    inet_pton(AF_INET6, "2001:db8::1", &a6);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a6) == (void *)7);
+    inet_pton(AF_INET6, "2001:db9::1", &a6);
+    FAIL_IF_NOT(SCLpmLookup(lpm, (uint8_t *)&a6) == NULL);
+    SCLpmFree(lpm);
+
+    SCRadixReleaseRadixTree(tree);
+    PASS;
+}
+
+/** \test random prefixes, compare against the radix tree */
+static int SCLpmTest02(void)
+{
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    int f;
+
+    for (f = 0; f < 2; f++) {
+        const int family = f ? AF_INET6 : AF_INET;
+        SCRadixTree *tree = SCRadixCreateRadixTree(NULL, NULL);
+        FAIL_IF_NULL(tree);
+        if (family == AF_INET)
+            LpmAddRandomPrefixes(tree, family, 2000, 4, 30, &state);
+        else
+            LpmAddRandomPrefixes(tree, family, 500, 8, 64, &state);
+
+        SCLpmTable *lpm = SCLpmCreateFromRadixTree(tree, family);
+        FAIL_IF_NULL(lpm);
+
+        int i;
+        for (i = 0; i < 100000; i++) {
+            uint8_t addr[16];
+            void *user = NULL;
+            LpmRandomAddr(&state, addr, sizeof(addr));
+
+            if (family == AF_INET)
+                (void)SCRadixFindKeyIPV4BestMatch(addr, tree, &user);
+            else
+                (void)SCRadixFindKeyIPV6BestMatch(addr, tree, &user);
+            FAIL_IF_NOT(SCLpmLookup(lpm, addr) == user);
+        }
+
+        SCLpmFree(lpm);
+        SCRadixReleaseRadixTree(tree);
+    }
+    PASS;
+}
+
+/** \test tables are accounted to the memcap, and not created if they
+ *        don't fit */
+static int SCLpmTest03(void)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    const uint64_t memcap = SCLpmGetMemcap();
+    const uint64_t memuse = SCLpmGetMemuse();
+
+    SCRadixTree *tree = SCRadixCreateRadixTree(NULL, NULL);
+    FAIL_IF_NULL(tree);
+    LpmAddRandomPrefixes(tree, AF_INET6, 1000, 48, 48, &state);
+
+    SCLpmTable *lpm = SCLpmCreateFromRadixTree(tree, AF_INET6);
+    FAIL_IF_NULL(lpm);
+    /* 1000 random /48s: at least a table each below the root */
+    FAIL_IF_NOT(SCLpmMemuse(lpm) > 1000 * 1024);
+    FAIL_IF_NOT(SCLpmGetMemuse() == memuse + SCLpmMemuse(lpm));
+    const uint64_t size = SCLpmMemuse(lpm);
+    SCLpmFree(lpm);
+    FAIL_IF_NOT(SCLpmGetMemuse() == memuse);
+
+    SCLpmSetMemcap(memuse + size / 2);
+    lpm = SCLpmCreateFromRadixTree(tree, AF_INET6);
+    FAIL_IF_NOT_NULL(lpm);
+    FAIL_IF_NOT(SCLpmGetMemuse() == memuse);
+
+    /* small ipv4 table still fits */
+    SCRadixTree *tree4 = SCRadixCreateRadixTree(NULL, NULL);
+    FAIL_IF_NULL(tree4);
+    SCRadixAddKeyIPV4String("192.168.0.0/16", tree4, (void *)1);
+    lpm = SCLpmCreateFromRadixTree(tree4, AF_INET);
+    FAIL_IF_NULL(lpm);
+    SCLpmFree(lpm);
+
+    SCLpmSetMemcap(memcap);
+    SCRadixReleaseRadixTree(tree4);
+    SCRadixReleaseRadixTree(tree);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCLpmRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCLpmTest01", SCLpmTest01);
+    UtRegisterTest("SCLpmTest02", SCLpmTest02);
+    UtRegisterTest("SCLpmTest03", SCLpmTest03);
+#endif
+}
@@ -0,0 +1,89 @@
+/* Copyright (C) 2018 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Read only longest prefix match tables for IPv4 and IPv6, compiled from
+ * a radix tree once it's fully built.
+ */
+
+#ifndef __UTIL_LPM_H__
+#define __UTIL_LPM_H__
+
+#include "util-radix-tree.h"
+
+/** table entry pointing to a child table instead of a value */
+#define SC_LPM_CHILD    0x80000000U
+
+/**
+ * \brief multibit trie: a 16 bit root table followed by 8 bit stride
+ *        tables, with all prefixes expanded into the tables so a lookup
+ *        is one array access per address byte past the first two.
+ *
+ *        Entries: 0 no match, n values[n - 1], SC_LPM_CHILD|i child table i.
+ */
+typedef struct SCLpmTable_ {
+    uint32_t *root;         /**< 65536 entries */
+    uint32_t *tbls;         /**< child tables, 256 entries each */
+    uint32_t tbls_cnt;
+    uint32_t tbls_size;     /**< number of tables allocated */
+
+    void **values;          /**< user data of the radix tree */
+    uint32_t values_cnt;
+
+    uint8_t key_len;        /**< 4 or 16 */
+    uint64_t memuse;        /**< bytes accounted to the lpm memcap */
+} SCLpmTable;
+
+/** default for detect.lpm-memcap, shared by all tables */
+#define SC_LPM_DEFAULT_MEMCAP   (256 * 1024 * 1024)
+
+void SCLpmInitConfig(void);
+void SCLpmSetMemcap(uint64_t size);
+uint64_t SCLpmGetMemcap(void);
+uint64_t SCLpmGetMemuse(void);
+
+SCLpmTable *SCLpmCreateFromRadixTree(const SCRadixTree *tree, int family);
+void SCLpmFree(SCLpmTable *lpm);
+uint64_t SCLpmMemuse(const SCLpmTable *lpm);
+
+/**
+ * \brief longest prefix match
+ *
+ * \param addr address in network byte order, 4 or 16 bytes depending
+ *             on the family the table was created for
+ *
+ * \retval user data of the best matching prefix or NULL
+ */
+static inline void *SCLpmLookup(const SCLpmTable *lpm, const uint8_t *addr)
+{
+    uint32_t e = lpm->root[(addr[0] << 8) | addr[1]];
+    int i = 2;
+    while (e & SC_LPM_CHILD) {
+        e = lpm->tbls[((size_t)(e & ~SC_LPM_CHILD) << 8) | addr[i++]];
+    }
+    return e ? lpm->values[e - 1] : NULL;
+}
+
+#ifdef BENCHMARKS
+int SCLpmBenchmark(const char *arg);
+#endif
+
+void SCLpmRegisterTests(void);
+
+#endif /* __UTIL_LPM_H__ */
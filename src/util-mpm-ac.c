@@ -71,6 +71,9 @@ int SCACAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
 int SCACPreparePatterns(MpmCtx *mpm_ctx);
 uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                     PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen);
+uint32_t SCACSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PrefilterRuleStore *pmq, MpmVectorBuffer *bufs,
+                          uint32_t nbufs);
 void SCACPrintInfo(MpmCtx *mpm_ctx);
 void SCACPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 void SCACRegisterTests(void);
@@ -1015,21 +1018,14 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
 }
 
 /**
- * \brief The aho corasick search function.
+ * \brief Scan a buffer, adding the sids of patterns not yet in 'bitarray'
+ *        to the pmq.
  *
- * \param mpm_ctx        Pointer to the mpm context.
- * \param mpm_thread_ctx Pointer to the mpm thread context.
- * \param pmq            Pointer to the Pattern Matcher Queue to hold
- *                       search matches.
- * \param buf            Buffer to be searched.
- * \param buflen         Buffer length.
- *
- * \retval matches Match count.
+ * \retval matches number of pattern matches in the buffer
  */
-uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen)
+static inline uint32_t SCACScan(const SCACCtx *ctx, uint8_t *bitarray,
+        PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen)
 {
-    const SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
     uint32_t i = 0;
     int matches = 0;
 
@@ -1038,9 +1034,6 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
     /* \todo Change it for stateful MPM.  Supply the state using mpm_thread_ctx */
     const SCACPatternList *pid_pat_list = ctx->pid_pat_list;
 
-    uint8_t bitarray[ctx->pattern_id_bitarray_size];
-    memset(bitarray, 0, ctx->pattern_id_bitarray_size);
-
     if (ctx->state_count < 32767) {
         register SC_AC_STATE_TYPE_U16 state = 0;
         SC_AC_STATE_TYPE_U16 (*state_table_u16)[256] = ctx->state_table_u16;
@@ -1147,6 +1140,55 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
     return matches;
 }
 
+/**
+ * \brief The aho corasick search function.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                    PrefilterRuleStore *pmq, const uint8_t *buf, uint32_t buflen)
+{
+    const SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+
+    uint8_t bitarray[ctx->pattern_id_bitarray_size];
+    memset(bitarray, 0, ctx->pattern_id_bitarray_size);
+
+    return SCACScan(ctx, bitarray, pmq, buf, buflen);
+}
+
+/**
+ * \brief Search a vector of buffers in one call.
+ *
+ *        The pattern id bitarray is shared by the buffers, so the sids
+ *        of a pattern are only added to the pmq once.
+ *
+ * \retval matches total match count. Per buffer counts are stored in
+ *                 the 'matches' field of the buffers.
+ */
+uint32_t SCACSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PrefilterRuleStore *pmq, MpmVectorBuffer *bufs,
+                          uint32_t nbufs)
+{
+    const SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    uint32_t matches = 0;
+
+    uint8_t bitarray[ctx->pattern_id_bitarray_size];
+    memset(bitarray, 0, ctx->pattern_id_bitarray_size);
+
+    for (uint32_t b = 0; b < nbufs; b++) {
+        bufs[b].matches = SCACScan(ctx, bitarray, pmq, bufs[b].buf, bufs[b].len);
+        matches += bufs[b].matches;
+    }
+    return matches;
+}
+
 /**
  * \brief Add a case insensitive pattern.  Although we have different calls for
  *        adding case sensitive and insensitive patterns, we make a single call
@@ -1247,6 +1289,7 @@ void MpmACRegister(void)
     mpm_table[MPM_AC].AddPatternNocase = SCACAddPatternCI;
     mpm_table[MPM_AC].Prepare = SCACPreparePatterns;
     mpm_table[MPM_AC].Search = SCACSearch;
+    mpm_table[MPM_AC].SearchVector = SCACSearchVector;
     mpm_table[MPM_AC].PrintCtx = SCACPrintInfo;
     mpm_table[MPM_AC].PrintThreadCtx = SCACPrintSearchStats;
     mpm_table[MPM_AC].RegisterUnittests = SCACRegisterTests;
@@ -2280,6 +2323,42 @@ end:
     return result;
 }
 
+/** \test vectored search: per buffer match counts, sids added once */
+static int SCACTestVector01(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PrefilterRuleStore pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_AC);
+    SCACInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"wxyz", 4, 0, 0, 1, 1, 0);
+    PmqSetup(&pmq);
+    SCACPreparePatterns(&mpm_ctx);
+
+    MpmVectorBuffer bufs[3] = {
+        { (const uint8_t *)"xxabcdxx", 8, 10, 0 },
+        { (const uint8_t *)"nothing", 7, 11, 0 },
+        { (const uint8_t *)"abcdwxyz", 8, 12, 0 },
+    };
+    uint32_t cnt = MpmSearchVector(&mpm_ctx, &mpm_thread_ctx, &pmq, bufs, 3);
+    FAIL_IF_NOT(cnt == 3);
+    FAIL_IF_NOT(bufs[0].matches == 1);
+    FAIL_IF_NOT(bufs[1].matches == 0);
+    FAIL_IF_NOT(bufs[2].matches == 2);
+    FAIL_IF_NOT(bufs[2].tag == 12);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 2);
+
+    SCACDestroyCtx(&mpm_ctx);
+    SCACDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void SCACRegisterTests(void)
@@ -2315,6 +2394,7 @@ void SCACRegisterTests(void)
     UtRegisterTest("SCACTest27", SCACTest27);
     UtRegisterTest("SCACTest28", SCACTest28);
     UtRegisterTest("SCACTest29", SCACTest29);
+    UtRegisterTest("SCACTestVector01", SCACTestVector01);
 #endif
 
     return;
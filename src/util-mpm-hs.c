@@ -57,6 +57,9 @@ int SCHSAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
 int SCHSPreparePatterns(MpmCtx *mpm_ctx);
 uint32_t SCHSSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                     PrefilterRuleStore *pmq, const uint8_t *buf, const uint32_t buflen);
+uint32_t SCHSSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PrefilterRuleStore *pmq, MpmVectorBuffer *bufs,
+                          uint32_t nbufs);
 void SCHSPrintInfo(MpmCtx *mpm_ctx);
 void SCHSPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 void SCHSRegisterTests(void);
@@ -78,6 +81,10 @@ static SCMutex g_scratch_proto_mutex = SCMUTEX_INITIALIZER;
 static HashTable *g_db_table = NULL;
 static SCMutex g_db_table_mutex = SCMUTEX_INITIALIZER;
 
+/* If set, databases are neither looked up in nor added to g_db_table, so
+ * each one is compiled and accounted for. Used by the mpm benchmark. */
+static bool g_db_cache_bypass = false;
+
 /**
  * \internal
  * \brief Wraps SCMalloc (which is a macro) so that it can be passed to
@@ -444,6 +451,9 @@ typedef struct PatternDatabase_ {
 
     /* Reference count: number of MPM contexts using this pattern database. */
     uint32_t ref_cnt;
+
+    /* database is in g_db_table */
+    bool cached;
 } PatternDatabase;
 
 static uint32_t SCHSPatternHash(const SCHSPattern *p, uint32_t hash)
@@ -626,7 +636,8 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
 
     /* Check global hash table to see if we've seen this pattern database
      * before, and reuse the Hyperscan database if so. */
-    PatternDatabase *pd_cached = HashTableLookup(g_db_table, pd, 1);
+    PatternDatabase *pd_cached = g_db_cache_bypass ? NULL :
+        HashTableLookup(g_db_table, pd, 1);
 
     if (pd_cached != NULL) {
         SCLogDebug("Reusing cached database %p with %" PRIu32
@@ -714,8 +725,15 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
     SCLogDebug("Built %" PRIu32 " patterns into a database of size %" PRIuMAX
                " bytes", mpm_ctx->pattern_cnt, (uintmax_t)ctx->hs_db_size);
 
-    /* Cache this database globally for later. */
     pd->ref_cnt = 1;
+    if (g_db_cache_bypass) {
+        SCMutexUnlock(&g_db_table_mutex);
+        SCHSFreeCompileData(cd);
+        return 0;
+    }
+
+    /* Cache this database globally for later. */
+    pd->cached = true;
     int r = HashTableAdd(g_db_table, pd, 1);
     SCMutexUnlock(&g_db_table_mutex);
     if (r < 0)
@@ -867,7 +885,8 @@ void SCHSDestroyCtx(MpmCtx *mpm_ctx)
         BUG_ON(pd->ref_cnt == 0);
         pd->ref_cnt--;
         if (pd->ref_cnt == 0) {
-            HashTableRemove(g_db_table, pd, 1);
+            if (pd->cached)
+                HashTableRemove(g_db_table, pd, 1);
             PatternDatabaseFree(pd);
         }
     }
@@ -950,6 +969,51 @@ uint32_t SCHSSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
     return ret;
 }
 
+/**
+ * \brief Search a vector of buffers in one call.
+ *
+ *        The buffers are scanned one by one with the same scratch and
+ *        callback ctx. Hyperscan's vectored mode is not used: it needs
+ *        a database compiled in HS_MODE_VECTORED and treats the vector
+ *        as one contiguous block, which breaks offset/depth.
+ *
+ * \retval matches total match count. Per buffer counts are stored in
+ *                 the 'matches' field of the buffers.
+ */
+uint32_t SCHSSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PrefilterRuleStore *pmq, MpmVectorBuffer *bufs,
+                          uint32_t nbufs)
+{
+    uint32_t ret = 0;
+    SCHSCtx *ctx = (SCHSCtx *)mpm_ctx->ctx;
+    SCHSThreadCtx *hs_thread_ctx = (SCHSThreadCtx *)(mpm_thread_ctx->ctx);
+    const PatternDatabase *pd = ctx->pattern_db;
+
+    SCHSCallbackCtx cctx = {.ctx = ctx, .pmq = pmq, .match_count = 0};
+
+    hs_scratch_t *scratch = hs_thread_ctx->scratch;
+    BUG_ON(pd->hs_db == NULL);
+    BUG_ON(scratch == NULL);
+
+    for (uint32_t i = 0; i < nbufs; i++) {
+        bufs[i].matches = 0;
+        if (unlikely(bufs[i].len == 0))
+            continue;
+
+        cctx.match_count = 0;
+        hs_error_t err = hs_scan(pd->hs_db, (const char *)bufs[i].buf,
+                                 bufs[i].len, 0, scratch, SCHSMatchEvent, &cctx);
+        if (err != HS_SUCCESS) {
+            SCLogError(SC_ERR_FATAL, "Hyperscan returned error %d", err);
+            exit(EXIT_FAILURE);
+        }
+        bufs[i].matches = cctx.match_count;
+        ret += cctx.match_count;
+    }
+
+    return ret;
+}
+
 /**
  * \brief Add a case insensitive pattern.  Although we have different calls for
  *        adding case sensitive and insensitive patterns, we make a single call
@@ -1050,6 +1114,7 @@ void MpmHSRegister(void)
     mpm_table[MPM_HS].AddPatternNocase = SCHSAddPatternCI;
     mpm_table[MPM_HS].Prepare = SCHSPreparePatterns;
     mpm_table[MPM_HS].Search = SCHSSearch;
+    mpm_table[MPM_HS].SearchVector = SCHSSearchVector;
     mpm_table[MPM_HS].PrintCtx = SCHSPrintInfo;
     mpm_table[MPM_HS].PrintThreadCtx = SCHSPrintSearchStats;
     mpm_table[MPM_HS].RegisterUnittests = SCHSRegisterTests;
@@ -1082,6 +1147,20 @@ void MpmHSGlobalCleanup(void)
     SCMutexUnlock(&g_db_table_mutex);
 }
 
+#ifdef BENCHMARKS
+/**
+ * \brief bypass the global database cache for the contexts prepared
+ *        from now on, so that their databases are compiled even if an
+ *        identical one exists
+ */
+void MpmHSSetDbCacheBypass(bool bypass)
+{
+    SCMutexLock(&g_db_table_mutex);
+    g_db_cache_bypass = bypass;
+    SCMutexUnlock(&g_db_table_mutex);
+}
+#endif
+
 /*************************************Unittests********************************/
 
 #ifdef UNITTESTS
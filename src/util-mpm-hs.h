@@ -72,5 +72,8 @@ typedef struct SCHSThreadCtx_ {
 void MpmHSRegister(void);
 
 void MpmHSGlobalCleanup(void);
+#ifdef BENCHMARKS
+void MpmHSSetDbCacheBypass(bool bypass);
+#endif
 
 #endif /* __UTIL_MPM_HS__H__ */
@@ -307,6 +307,32 @@ void MpmTableSetup(void)
 #endif /* BUILD_HYPERSCAN */
 }
 
+/**
+ * \brief search a vector of buffers against one mpm ctx
+ *
+ * Matches of all buffers go into the same pmq. The match count of each
+ * buffer is stored in its 'matches' field, so callers can tell which
+ * buffers (by 'tag') matched. Matchers without vector support get the
+ * buffers one by one.
+ *
+ * \retval matches total match count
+ */
+uint32_t MpmSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+        PrefilterRuleStore *pmq, MpmVectorBuffer *bufs, uint32_t nbufs)
+{
+    const MpmTableElmt *m = &mpm_table[mpm_ctx->mpm_type];
+    if (m->SearchVector != NULL)
+        return m->SearchVector(mpm_ctx, mpm_thread_ctx, pmq, bufs, nbufs);
+
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < nbufs; i++) {
+        bufs[i].matches = m->Search(mpm_ctx, mpm_thread_ctx, pmq,
+                bufs[i].buf, bufs[i].len);
+        matches += bufs[i].matches;
+    }
+    return matches;
+}
+
 int MpmAddPatternCS(struct MpmCtx_ *mpm_ctx, uint8_t *pat, uint16_t patlen,
                     uint16_t offset, uint16_t depth,
                     uint32_t pid, SigIntId sid, uint8_t flags)
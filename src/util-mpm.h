@@ -134,6 +134,15 @@ typedef struct MpmCtxFactoryContainer_ {
  *  what is passed through the API */
 #define MPM_PATTERN_CTX_OWNS_ID     0x20
 
+/** buffer for a vectored search. 'tag' is for use by the caller, the
+ *  search sets 'matches' to the number of pattern matches in 'buf'. */
+typedef struct MpmVectorBuffer_ {
+    const uint8_t *buf;
+    uint32_t len;
+    uint32_t tag;
+    uint32_t matches;
+} MpmVectorBuffer;
+
 typedef struct MpmTableElmt_ {
     const char *name;
     void (*InitCtx)(struct MpmCtx_ *);
@@ -156,6 +165,8 @@ typedef struct MpmTableElmt_ {
     int  (*AddPatternNocase)(struct MpmCtx_ *, uint8_t *, uint16_t, uint16_t, uint16_t, uint32_t, SigIntId, uint8_t);
     int  (*Prepare)(struct MpmCtx_ *);
     uint32_t (*Search)(const struct MpmCtx_ *, struct MpmThreadCtx_ *, PrefilterRuleStore *, const uint8_t *, uint32_t);
+    /** optional, search multiple buffers in one call. See MpmSearchVector() */
+    uint32_t (*SearchVector)(const struct MpmCtx_ *, struct MpmThreadCtx_ *, PrefilterRuleStore *, MpmVectorBuffer *, uint32_t);
     void (*PrintCtx)(struct MpmCtx_ *);
     void (*PrintThreadCtx)(struct MpmThreadCtx_ *);
     void (*RegisterUnittests)(void);
@@ -193,6 +204,9 @@ int MpmAddPatternCI(struct MpmCtx_ *mpm_ctx, uint8_t *pat, uint16_t patlen,
 
 void MpmFreePattern(MpmCtx *mpm_ctx, MpmPattern *p);
 
+uint32_t MpmSearchVector(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+        PrefilterRuleStore *pmq, MpmVectorBuffer *bufs, uint32_t nbufs);
+
 int MpmAddPattern(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
                             uint16_t offset, uint16_t depth, uint32_t pid,
                             SigIntId sid, uint8_t flags);
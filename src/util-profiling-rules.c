@@ -50,6 +50,7 @@ typedef struct SCProfileData_ {
     uint64_t max;
     uint64_t ticks_match;
     uint64_t ticks_no_match;
+    uint64_t pcre_limit;    /**< pcre match/recursion limit hits */
 } SCProfileData;
 
 typedef struct SCProfileDetectCtx_ {
@@ -75,6 +76,7 @@ typedef struct SCProfileSummary_ {
     uint64_t max;
     uint64_t ticks_match;
     uint64_t ticks_no_match;
+    uint64_t pcre_limit;
 } SCProfileSummary;
 
 extern int profiling_output_to_file;
@@ -339,6 +341,7 @@ static void DumpJson(FILE *fp, SCProfileSummary *summary,
             json_object_set_new(jsm, "ticks_avg", json_integer(summary[i].avgticks));
             json_object_set_new(jsm, "ticks_avg_match", json_integer(summary[i].avgticks_match));
             json_object_set_new(jsm, "ticks_avg_nomatch", json_integer(summary[i].avgticks_no_match));
+            json_object_set_new(jsm, "pcre_limit", json_integer(summary[i].pcre_limit));
 
             double percent = (long double)summary[i].ticks /
                 (long double)total_ticks * 100;
@@ -380,7 +383,7 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
     fprintf(fp, " Sorted by: %s.\n", sort_desc);
     fprintf(fp, "  ----------------------------------------------"
             "----------------------------\n");
-    fprintf(fp, "   %-8s %-12s %-8s %-8s %-12s %-6s %-8s %-8s %-11s %-11s %-11s %-11s\n", "Num", "Rule", "Gid", "Rev", "Ticks", "%", "Checks", "Matches", "Max Ticks", "Avg Ticks", "Avg Match", "Avg No Match");
+    fprintf(fp, "   %-8s %-12s %-8s %-8s %-12s %-6s %-8s %-8s %-11s %-11s %-11s %-14s %-10s\n", "Num", "Rule", "Gid", "Rev", "Ticks", "%", "Checks", "Matches", "Max Ticks", "Avg Ticks", "Avg Match", "Avg No Match", "PCRE Limit");
     fprintf(fp, "  -------- "
         "------------ "
         "-------- "
@@ -393,6 +396,7 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
         "----------- "
         "----------- "
         "-------------- "
+        "---------- "
         "\n");
     for (i = 0; i < MIN(count, profiling_rules_limit); i++) {
 
@@ -405,7 +409,7 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
         double percent = (long double)summary[i].ticks /
             (long double)total_ticks * 100;
         fprintf(fp,
-            "  %-8"PRIu32" %-12u %-8"PRIu32" %-8"PRIu32" %-12"PRIu64" %-6.2f %-8"PRIu64" %-8"PRIu64" %-11"PRIu64" %-11.2f %-11.2f %-11.2f\n",
+            "  %-8"PRIu32" %-12u %-8"PRIu32" %-8"PRIu32" %-12"PRIu64" %-6.2f %-8"PRIu64" %-8"PRIu64" %-11"PRIu64" %-11.2f %-11.2f %-14.2f %-10"PRIu64"\n",
             i + 1,
             summary[i].sid,
             summary[i].gid,
@@ -417,7 +421,8 @@ static void DumpText(FILE *fp, SCProfileSummary *summary,
             summary[i].max,
             summary[i].avgticks,
             summary[i].avgticks_match,
-            summary[i].avgticks_no_match);
+            summary[i].avgticks_no_match,
+            summary[i].pcre_limit);
     }
 
     fprintf(fp,"\n");
@@ -478,6 +483,7 @@ SCProfilingRuleDump(SCProfileDetectCtx *rules_ctx)
         summary[i].max = rules_ctx->data[i].max;
         summary[i].ticks_match = rules_ctx->data[i].ticks_match;
         summary[i].ticks_no_match = rules_ctx->data[i].ticks_no_match;
+        summary[i].pcre_limit = rules_ctx->data[i].pcre_limit;
         if (summary[i].ticks_match > 0) {
             summary[i].avgticks_match = (long double)summary[i].ticks_match /
                 (long double)summary[i].matches;
@@ -583,6 +589,19 @@ SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *det_ctx, uint16_t id, uint64
     }
 }
 
+/**
+ * \brief Count a pcre match or recursion limit hit for a rule.
+ *
+ * Counted for all packets, not just the profiled ones, as limit hits
+ * mean the rule may silently miss matches.
+ */
+void SCProfilingRulePcreLimit(DetectEngineThreadCtx *det_ctx, uint16_t id)
+{
+    if (det_ctx != NULL && det_ctx->rule_perf_data != NULL && det_ctx->rule_perf_data_size > id) {
+        det_ctx->rule_perf_data[id].pcre_limit++;
+    }
+}
+
 static SCProfileDetectCtx *SCProfilingRuleInitCtx(void)
 {
     SCProfileDetectCtx *ctx = SCMalloc(sizeof(SCProfileDetectCtx));
@@ -636,6 +655,7 @@ static void SCProfilingRuleThreadMerge(DetectEngineCtx *de_ctx, DetectEngineThre
         de_ctx->profile_ctx->data[i].matches += det_ctx->rule_perf_data[i].matches;
         de_ctx->profile_ctx->data[i].ticks_match += det_ctx->rule_perf_data[i].ticks_match;
         de_ctx->profile_ctx->data[i].ticks_no_match += det_ctx->rule_perf_data[i].ticks_no_match;
+        de_ctx->profile_ctx->data[i].pcre_limit += det_ctx->rule_perf_data[i].pcre_limit;
         if (det_ctx->rule_perf_data[i].max > de_ctx->profile_ctx->data[i].max)
             de_ctx->profile_ctx->data[i].max = det_ctx->rule_perf_data[i].max;
     }
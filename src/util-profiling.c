@@ -1192,6 +1192,63 @@ int SCProfileRuleStart(Packet *p)
     return 0;
 }
 
+#ifdef BENCHMARKS
+/**
+ * \brief get the packet profiling totals per pipeline stage
+ *
+ * Used by the pcap replay benchmark. Tunnel records are skipped as those
+ * packets are counted in their proto record as well.
+ */
+void SCProfilingGetPacketStages(SCProfilePacketStages *s)
+{
+    memset(s, 0, sizeof(*s));
+    if (profiling_packets_enabled == 0)
+        return;
+
+    uint64_t app_tcp = 0;
+
+    pthread_mutex_lock(&packet_profile_lock);
+    for (int p = 0; p < 256; p++) {
+        s->pkts += packet_profile_data4[p].cnt + packet_profile_data6[p].cnt;
+        s->total += packet_profile_data4[p].tot + packet_profile_data6[p].tot;
+
+        s->receive += packet_profile_tmm_data4[TMM_RECEIVEPCAPFILE][p].tot +
+                      packet_profile_tmm_data6[TMM_RECEIVEPCAPFILE][p].tot;
+        s->decode += packet_profile_tmm_data4[TMM_DECODEPCAPFILE][p].tot +
+                     packet_profile_tmm_data6[TMM_DECODEPCAPFILE][p].tot;
+        s->flowworker += packet_profile_tmm_data4[TMM_FLOWWORKER][p].tot +
+                         packet_profile_tmm_data6[TMM_FLOWWORKER][p].tot;
+
+        const struct ProfileProtoRecords *r = packet_profile_flowworker_data;
+        s->flow += r[PROFILE_FLOWWORKER_FLOW].records4[p].tot +
+                   r[PROFILE_FLOWWORKER_FLOW].records6[p].tot;
+        s->stream += r[PROFILE_FLOWWORKER_STREAM].records4[p].tot +
+                     r[PROFILE_FLOWWORKER_STREAM].records6[p].tot;
+        s->detect += r[PROFILE_FLOWWORKER_DETECT].records4[p].tot +
+                     r[PROFILE_FLOWWORKER_DETECT].records6[p].tot;
+
+        uint64_t app = packet_profile_app_pd_data4[p].tot +
+                       packet_profile_app_pd_data6[p].tot;
+        for (AppProto a = 0; a < ALPROTO_MAX; a++) {
+            app += packet_profile_app_data4[a][p].tot +
+                   packet_profile_app_data6[a][p].tot;
+        }
+        s->app_layer += app;
+        if (p == IPPROTO_TCP)
+            app_tcp = app;
+
+        for (LoggerId l = 0; l < LOGGER_SIZE; l++) {
+            s->output += packet_profile_log_data4[l][p].tot +
+                         packet_profile_log_data6[l][p].tot;
+        }
+    }
+    pthread_mutex_unlock(&packet_profile_lock);
+
+    /* tcp app-layer parsing runs from the stream engine */
+    s->stream = (s->stream > app_tcp) ? s->stream - app_tcp : 0;
+}
+#endif /* BENCHMARKS */
+
 #define CASE_CODE(E)  case E: return #E
 
 /**
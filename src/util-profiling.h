@@ -59,6 +59,11 @@ int SCProfileRuleStart(Packet *p);
         profiling_rules_entered--; \
     }
 
+#define RULE_PROFILING_PCRE_LIMIT(ctx, s) \
+    if (profiling_rules_enabled) { \
+        SCProfilingRulePcreLimit((ctx), (s)->profiling_id); \
+    }
+
 extern int profiling_keyword_enabled;
 extern __thread int profiling_keyword_entered;
 
@@ -303,6 +308,7 @@ void SCProfilingRulesGlobalInit(void);
 void SCProfilingRuleDestroyCtx(struct SCProfileDetectCtx_ *);
 void SCProfilingRuleInitCounters(DetectEngineCtx *);
 void SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *, uint16_t, uint64_t, int);
+void SCProfilingRulePcreLimit(DetectEngineThreadCtx *, uint16_t);
 void SCProfilingRuleThreadSetup(struct SCProfileDetectCtx_ *, DetectEngineThreadCtx *);
 void SCProfilingRuleThreadCleanup(DetectEngineThreadCtx *);
 
@@ -333,10 +339,29 @@ void SCProfilingDestroy(void);
 void SCProfilingRegisterTests(void);
 void SCProfilingDump(void);
 
+#ifdef BENCHMARKS
+/** ticks spent per pipeline stage, summed over all profiled packets */
+typedef struct SCProfilePacketStages_ {
+    uint64_t pkts;          /**< number of profiled packets */
+    uint64_t total;
+    uint64_t receive;
+    uint64_t decode;
+    uint64_t flowworker;
+    uint64_t flow;
+    uint64_t stream;        /**< excluding the app-layer work done for tcp */
+    uint64_t app_layer;     /**< parsers and protocol detection, tcp and udp */
+    uint64_t detect;
+    uint64_t output;
+} SCProfilePacketStages;
+
+void SCProfilingGetPacketStages(SCProfilePacketStages *s);
+#endif
+
 #else
 
 #define RULE_PROFILING_START(p)
 #define RULE_PROFILING_END(a,b,c,p)
+#define RULE_PROFILING_PCRE_LIMIT(ctx, s)
 
 #define KEYWORD_PROFILING_SET_LIST(a,b)
 #define KEYWORD_PROFILING_START